@@ -26,6 +26,10 @@ extern "C" void app_main(void)
 {
     // Initialize current sensor
     INA226 CurrentSensor;
+    if (!CurrentSensor.ok()) {
+        ESP_LOGE(TAG, "INA226 not available: %s", CurrentSensor.initError().what());
+        return;
+    }
 
     // Configure current sensor
     CurrentSensor.Calibrate(100, 1);
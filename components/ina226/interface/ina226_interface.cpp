@@ -16,12 +16,14 @@
 
 #include "ina226_interface.h"
 #include <utility>
-#include <string>
 #include "esp_err.h"
+#include "esp_log.h"
 
 #define I2C_TIMEOUT_MS 100
 
-std::expected<void, std::runtime_error> INA226::I2C_Write(const Register Register, const uint16_t Value) {
+static const char *TAG = "INA226";
+
+std::expected<void, INA226::Error> INA226::I2C_Write(const Register Register, const uint16_t Value) {
     esp_err_t err;
 
     const uint8_t WriteBuffer[] = {
@@ -31,25 +33,19 @@ std::expected<void, std::runtime_error> INA226::I2C_Write(const Register Registe
     };
 
     if (xSemaphoreTake(Lock, portMAX_DELAY) != pdTRUE) {
-        return std::unexpected(std::runtime_error("I2C write timeout: could not take mutex"));
+        return std::unexpected(Error{ESP_ERR_TIMEOUT, ErrorKind::LOCK_TIMEOUT, true});
     }
 
     err = i2c_master_transmit(i2c_dev_handle, WriteBuffer, sizeof(WriteBuffer), I2C_TIMEOUT_MS);
     xSemaphoreGive(Lock);
 
-    switch (err) {
-        case ESP_OK:
-            return {};
-        case ESP_ERR_INVALID_ARG:
-            return std::unexpected(std::runtime_error("I2C write invalid arg"));
-        case ESP_ERR_TIMEOUT:
-            return std::unexpected(std::runtime_error("I2C write timeout: could not transmit"));
-        default:
-            return std::unexpected(std::runtime_error("I2C write unknown error. err = " + std::to_string(err)));
+    if (err != ESP_OK) {
+        return std::unexpected(MakeError(err, true));
     }
+    return {};
 }
 
-std::expected<uint16_t, std::runtime_error> INA226::I2C_Read(const INA226::Register Register) {
+std::expected<uint16_t, INA226::Error> INA226::I2C_Read(const INA226::Register Register) {
     esp_err_t err;
 
     const auto WriteBuffer = Register;
@@ -57,22 +53,16 @@ std::expected<uint16_t, std::runtime_error> INA226::I2C_Read(const INA226::Regis
     uint16_t ReadBuffer;
 
     if (xSemaphoreTake(Lock, portMAX_DELAY) != pdTRUE) {
-        return std::unexpected(std::runtime_error("I2C read timeout: could not take mutex"));
+        return std::unexpected(Error{ESP_ERR_TIMEOUT, ErrorKind::LOCK_TIMEOUT, false});
     }
 
     err = i2c_master_transmit_receive(i2c_dev_handle, reinterpret_cast<const uint8_t *>(&WriteBuffer), sizeof(WriteBuffer), reinterpret_cast<uint8_t *>(&ReadBuffer), sizeof(ReadBuffer), I2C_TIMEOUT_MS);
     xSemaphoreGive(Lock);
     
-    switch (err) {
-        case ESP_OK:
-            return (ReadBuffer << 8) | (ReadBuffer >> 8);
-        case ESP_ERR_INVALID_ARG:
-            return std::unexpected(std::runtime_error("I2C read invalid arg"));
-        case ESP_ERR_TIMEOUT:
-            return std::unexpected(std::runtime_error("I2C read timeout"));
-        default:
-            return std::unexpected(std::runtime_error("I2C read unknown error. err = " + std::to_string(err)));
+    if (err != ESP_OK) {
+        return std::unexpected(MakeError(err, false));
     }
+    return (ReadBuffer << 8) | (ReadBuffer >> 8);
 }
 
 INA226::INA226(const gpio_num_t sda_io_num, const gpio_num_t scl_io_num, const uint16_t address, const uint32_t scl_frequency, const i2c_port_num_t i2c_port_num)
@@ -95,23 +85,12 @@ INA226::INA226(const gpio_num_t sda_io_num, const gpio_num_t scl_io_num, const u
     } 
     
 {
-    esp_err_t err;
-
-    err = i2c_new_master_bus(&i2c_bus_config, &i2c_bus_handle);
-    if (err != ESP_OK)
-        throw std::runtime_error("I2C bus initialization failed. err = " + std::to_string(err));
-
-    err = i2c_master_bus_add_device(i2c_bus_handle, &i2c_dev_cfg, &i2c_dev_handle);
-    if (err != ESP_OK)
-        throw std::runtime_error("I2C add device failed. err = " + std::to_string(err));
-
-    err = CreateMutex(Lock);
-    if (err != ESP_OK)
-        throw std::runtime_error("I2C mutex creation failed. err = " + std::to_string(err));
-
-    auto start_driver = InitDriver();
-    if (start_driver.has_value() == false)
-        throw std::runtime_error(std::string("INA226 driver initialization failed. err = ") + start_driver.error().what());
+    const esp_err_t err = i2c_new_master_bus(&i2c_bus_config, &i2c_bus_handle);
+    if (err != ESP_OK) {
+        InitFailed("I2C bus initialization", MakeError(err, false));
+        return;
+    }
+    AttachDevice();
 }
 
 INA226::INA226(i2c_master_bus_handle_t bus_handle, const uint16_t address, const uint32_t scl_frequency)
@@ -122,17 +101,33 @@ INA226::INA226(i2c_master_bus_handle_t bus_handle, const uint16_t address, const
         .scl_speed_hz = scl_frequency,
     }
 {
+    AttachDevice();
+}
+
+void INA226::AttachDevice() {
     esp_err_t err = i2c_master_bus_add_device(i2c_bus_handle, &i2c_dev_cfg, &i2c_dev_handle);
-    if (err != ESP_OK)
-        throw std::runtime_error("I2C add device failed. err = " + std::to_string(err));
+    if (err != ESP_OK) {
+        InitFailed("I2C add device", MakeError(err, false));
+        return;
+    }
 
     err = CreateMutex(Lock);
-    if (err != ESP_OK)
-        throw std::runtime_error("I2C mutex creation failed. err = " + std::to_string(err));
+    if (err != ESP_OK) {
+        InitFailed("I2C mutex creation", Error{err, ErrorKind::OTHER, false});
+        return;
+    }
 
     auto start_driver = InitDriver();
-    if (start_driver.has_value() == false)
-        throw std::runtime_error(std::string("INA226 driver initialization failed. err = ") + start_driver.error().what());
+    if (start_driver.has_value() == false) {
+        InitFailed("INA226 driver initialization", start_driver.error());
+        return;
+    }
+    init_ok = true;
+}
+
+void INA226::InitFailed(const char *step, const Error &error) {
+    init_error = error;
+    ESP_LOGE(TAG, "%s failed: %s (%s)", step, error.what(), esp_err_to_name(error.code));
 }
 
 esp_err_t INA226::CreateMutex(SemaphoreHandle_t &mutex) {
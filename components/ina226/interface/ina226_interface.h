@@ -17,7 +17,6 @@
 #pragma once
 
 #include <expected>
-#include <stdexcept>
 #include "ina226_driver.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
@@ -56,27 +55,34 @@ public:
     INA226(i2c_master_bus_handle_t i2c_bus_handle, const uint16_t address = CONFIG_INA226_I2C_ADDRESS, const uint32_t scl_frequency = CONFIG_I2C_MASTER_FREQUENCY);
 
     /**
-     * @brief Whether the device initialized successfully.
+     * @brief Whether the device initialized successfully. The constructors do not throw; check this before use.
      */
     bool ok() const { return init_ok; }
 
+    /**
+     * @brief Why initialization failed. Only meaningful while ok() is false.
+     *
+     * @return Error 
+     */
+    Error initError() const { return init_error; }
+
 protected:
     /**
      * @brief I2C write function for ESP-IDF. Converts from little endian (ESP-IDF) to big endian (INA226).
      * 
      * @param[in] Register The register to write to on INA226
      * @param[in] Value The value to write to the register
-     * @return std::expected<void, std::runtime_error> 
+     * @return std::expected<void, Error> 
      */
-    std::expected<void, std::runtime_error> I2C_Write(const Register Register, const uint16_t Value) override;
+    std::expected<void, Error> I2C_Write(const Register Register, const uint16_t Value) override;
 
     /**
      * @brief I2C read function for ESP-IDF. Converts from big endian (INA226) to little endian (ESP-IDF).
      * 
      * @param[in] Register The register to read from on INA226
-     * @return std::expected<uint16_t, std::runtime_error> 
+     * @return std::expected<uint16_t, Error> 
      */
-    std::expected<uint16_t, std::runtime_error> I2C_Read(const Register Register) override;
+    std::expected<uint16_t, Error> I2C_Read(const Register Register) override;
 
     /**
      * @brief Creates a mutex for I2C bus
@@ -86,6 +92,19 @@ protected:
      */
     esp_err_t CreateMutex(SemaphoreHandle_t &mutex);
 
+    /**
+     * @brief Add the device to the bus, create its lock and initialize the driver. Sets init_ok on success.
+     */
+    void AttachDevice();
+
+    /**
+     * @brief Record and log a failed initialization step.
+     *
+     * @param[in] step What was being initialized.
+     * @param[in] error Why it failed.
+     */
+    void InitFailed(const char *step, const Error &error);
+
 protected:
     SemaphoreHandle_t Lock;
     i2c_master_bus_config_t i2c_bus_config;
@@ -93,4 +112,5 @@ protected:
     i2c_device_config_t i2c_dev_cfg;
     i2c_master_dev_handle_t i2c_dev_handle;
     bool init_ok{false};
+    Error init_error{ESP_OK, ErrorKind::OTHER, false};
 };
@@ -16,7 +16,6 @@
 
 #include "ina226_driver.h"
 #include <cmath>
-#include <format>
 #include <inttypes.h>
 #include <utility>
 
@@ -56,7 +55,87 @@ enum class INA226_Driver::ConfigOffset : uint8_t {
   RESET = 15,
 };
 
-std::expected<void, std::runtime_error>
+// Indexed by [write][kind]: static strings, so reporting an error never builds one.
+static constexpr const char *ERROR_MESSAGES[2][static_cast<size_t>(
+    INA226_Driver::ErrorKind::COUNT)] = {
+    {
+        "I2C read: could not take the bus mutex",
+        "I2C read: invalid argument",
+        "I2C read: timeout",
+        "I2C read: no acknowledge",
+        "INA226 init: configuration register is not at its reset value",
+        "I2C read: unknown error",
+    },
+    {
+        "I2C write: could not take the bus mutex",
+        "I2C write: invalid argument",
+        "I2C write: timeout",
+        "I2C write: no acknowledge",
+        "INA226 init: configuration register is not at its reset value",
+        "I2C write: unknown error",
+    },
+};
+
+const char *INA226_Driver::Error::what() const noexcept {
+  const auto index = static_cast<size_t>(kind);
+  if (index >= static_cast<size_t>(ErrorKind::COUNT)) {
+    return "INA226: invalid error";
+  }
+  return ERROR_MESSAGES[write ? 1 : 0][index];
+}
+
+INA226_Driver::Error INA226_Driver::MakeError(const esp_err_t code,
+                                              const bool write) noexcept {
+  switch (code) {
+  case ESP_ERR_INVALID_ARG:
+    return {code, ErrorKind::INVALID_ARG, write};
+  case ESP_ERR_TIMEOUT:
+    return {code, ErrorKind::TIMEOUT, write};
+  // the I2C master driver reports a NACK as one or the other, depending on
+  // the ESP-IDF version
+  case ESP_ERR_INVALID_STATE:
+  case ESP_ERR_INVALID_RESPONSE:
+    return {code, ErrorKind::NO_ACK, write};
+  default:
+    return {code, ErrorKind::OTHER, write};
+  }
+}
+
+INA226_Driver::Error INA226_Driver::CountError(const Error &Failure) {
+  const auto index = static_cast<size_t>(Failure.kind);
+  if (index < static_cast<size_t>(ErrorKind::COUNT)) {
+    ErrorCounts[index].fetch_add(1, std::memory_order_relaxed);
+  }
+  return Failure;
+}
+
+std::expected<void, INA226_Driver::Error>
+INA226_Driver::WriteRegister(const Register Register, const uint16_t Value) {
+  auto result = I2C_Write(Register, Value);
+  if (!result.has_value()) {
+    return std::unexpected(CountError(result.error()));
+  }
+  return {};
+}
+
+std::expected<uint16_t, INA226_Driver::Error>
+INA226_Driver::ReadRegister(const Register Register) {
+  auto result = I2C_Read(Register);
+  if (!result.has_value()) {
+    return std::unexpected(CountError(result.error()));
+  }
+  return result;
+}
+
+uint32_t INA226_Driver::GetErrorCount(const ErrorKind Kind) const {
+  const auto index = static_cast<size_t>(Kind);
+  if (index >= static_cast<size_t>(ErrorKind::COUNT)) {
+    return 0;
+  }
+  return ErrorCounts[index].load(std::memory_order_relaxed);
+}
+
+std::expected<void, INA226_Driver::Error>
 INA226_Driver::InitDriver(const uint32_t ShuntResistor_mOhm,
                           const uint32_t MaxCurrent_A) {
   Reset();
@@ -65,32 +144,20 @@ INA226_Driver::InitDriver(const uint32_t ShuntResistor_mOhm,
     Calibrate(ShuntResistor_mOhm, MaxCurrent_A);
     return {};
   }
-  return std::unexpected(std::runtime_error(
-      std::format("INA226 Init fail: Reading configuration register {:x} is "
-                  "different from expected {:x} upon reset",
-                  config, std::to_underlying(Const::CONFIG_RESET_VALUE))));
+  return std::unexpected(CountError(
+      {ESP_ERR_INVALID_RESPONSE, ErrorKind::BAD_RESET_VALUE, false}));
 }
 
 int32_t INA226_Driver::GetShuntVoltage_uV() {
-  auto result = I2C_Read(Register::SHUNT_VOLTAGE);
-  if (result.has_value()) {
-    return static_cast<int16_t>(result.value()) *
-           std::to_underlying(Const::SHUNT_VOLTAGE_LSB_nV) / 1000;
-  }
-  return 0;
+  return ReadShuntVoltage_uV().value_or(0);
 }
 
 int32_t INA226_Driver::GetBusVoltage_mV() {
-  auto result = I2C_Read(Register::BUS_VOLTAGE);
-  if (result.has_value()) {
-    return static_cast<int16_t>(result.value()) *
-           std::to_underlying(Const::BUS_VOLTAGE_LSB_uV) / 1000;
-  }
-  return 0;
+  return ReadBusVoltage_mV().value_or(0);
 }
 
 int32_t INA226_Driver::GetBusVoltage_Raw() {
-    auto result = I2C_Read(Register::BUS_VOLTAGE);
+    auto result = ReadRegister(Register::BUS_VOLTAGE);
     if (result.has_value()) {
         return static_cast<int16_t>(result.value());
     }
@@ -98,24 +165,52 @@ int32_t INA226_Driver::GetBusVoltage_Raw() {
 }
 
 int32_t INA226_Driver::GetCurrent_uA() {
-  auto result = I2C_Read(Register::CURRENT);
-  if (result.has_value()) {
-    return static_cast<int16_t>(result.value()) * Current_LSB_uA;
-  }
-  return 0;
+  return ReadCurrent_uA().value_or(0);
 }
 
 int32_t INA226_Driver::GetPower_uW() {
-  auto result = I2C_Read(Register::POWER);
-  if (result.has_value()) {
-    return static_cast<int16_t>(result.value()) *
-           std::to_underlying(Const::POWER_LSB_FACTOR) * Current_LSB_uA;
+  return ReadPower_uW().value_or(0);
+}
+
+std::expected<int32_t, INA226_Driver::Error>
+INA226_Driver::ReadShuntVoltage_uV() {
+  auto result = ReadRegister(Register::SHUNT_VOLTAGE);
+  if (!result.has_value()) {
+    return std::unexpected(result.error());
   }
-  return 0;
+  return static_cast<int16_t>(result.value()) *
+         std::to_underlying(Const::SHUNT_VOLTAGE_LSB_nV) / 1000;
+}
+
+std::expected<int32_t, INA226_Driver::Error>
+INA226_Driver::ReadBusVoltage_mV() {
+  auto result = ReadRegister(Register::BUS_VOLTAGE);
+  if (!result.has_value()) {
+    return std::unexpected(result.error());
+  }
+  return static_cast<int16_t>(result.value()) *
+         std::to_underlying(Const::BUS_VOLTAGE_LSB_uV) / 1000;
+}
+
+std::expected<int32_t, INA226_Driver::Error> INA226_Driver::ReadCurrent_uA() {
+  auto result = ReadRegister(Register::CURRENT);
+  if (!result.has_value()) {
+    return std::unexpected(result.error());
+  }
+  return static_cast<int16_t>(result.value()) * Current_LSB_uA;
+}
+
+std::expected<int32_t, INA226_Driver::Error> INA226_Driver::ReadPower_uW() {
+  auto result = ReadRegister(Register::POWER);
+  if (!result.has_value()) {
+    return std::unexpected(result.error());
+  }
+  return static_cast<int16_t>(result.value()) *
+         std::to_underlying(Const::POWER_LSB_FACTOR) * Current_LSB_uA;
 }
 
 uint16_t INA226_Driver::GetConfig() {
-  auto result = I2C_Read(Register::CONFIGURATION);
+  auto result = ReadRegister(Register::CONFIGURATION);
   if (result.has_value()) {
     return result.value();
   }
@@ -123,7 +218,7 @@ uint16_t INA226_Driver::GetConfig() {
 }
 
 uint16_t INA226_Driver::GetManufacturerID() {
-  auto result = I2C_Read(Register::MANUFACTURER_ID);
+  auto result = ReadRegister(Register::MANUFACTURER_ID);
   if (result.has_value()) {
     return result.value();
   }
@@ -131,7 +226,7 @@ uint16_t INA226_Driver::GetManufacturerID() {
 }
 
 uint16_t INA226_Driver::GetDieID() {
-  auto result = I2C_Read(Register::DIE_ID);
+  auto result = ReadRegister(Register::DIE_ID);
   if (result.has_value()) {
     return result.value();
   }
@@ -166,7 +261,7 @@ INA226_Driver::ConversionTime INA226_Driver::GetShuntVoltageConversionTime() {
 }
 
 uint16_t INA226_Driver::GetAlertTriggerMask() {
-  auto result = I2C_Read(Register::MASK_ENABLE);
+  auto result = ReadRegister(Register::MASK_ENABLE);
   if (result.has_value()) {
     return result.value();
   }
@@ -174,7 +269,7 @@ uint16_t INA226_Driver::GetAlertTriggerMask() {
 }
 
 uint16_t INA226_Driver::GetAlertLimitValue() {
-  auto result = I2C_Read(Register::ALERT_LIMIT);
+  auto result = ReadRegister(Register::ALERT_LIMIT);
   if (result.has_value()) {
     return result.value();
   }
@@ -203,11 +298,11 @@ void INA226_Driver::Calibrate(const uint32_t ShuntResistor_mOhm,
     cal_f = 65535.0f;
   uint16_t cal = static_cast<uint16_t>(cal_f + 0.5f);
 
-  I2C_Write(Register::CALIBRATION, cal);
+  WriteRegister(Register::CALIBRATION, cal);
 }
 
 void INA226_Driver::SetConfig(const uint16_t Config) {
-  I2C_Write(Register::CONFIGURATION, Config);
+  WriteRegister(Register::CONFIGURATION, Config);
 }
 
 void INA226_Driver::SetOperatingMode(OperatingMode Mode) {
@@ -215,7 +310,7 @@ void INA226_Driver::SetOperatingMode(OperatingMode Mode) {
   config &= ~std::to_underlying(ConfigMask::OPERATING_MODE);
   config |= std::to_underlying(Mode)
             << std::to_underlying(ConfigOffset::OPERATING_MODE);
-  I2C_Write(Register::CONFIGURATION, config);
+  WriteRegister(Register::CONFIGURATION, config);
 }
 
 void INA226_Driver::SetAveragingMode(AveragingMode Mode) {
@@ -223,7 +318,7 @@ void INA226_Driver::SetAveragingMode(AveragingMode Mode) {
   config &= ~std::to_underlying(ConfigMask::AVERAGING_MODE);
   config |= std::to_underlying(Mode)
             << std::to_underlying(ConfigOffset::AVERAGING_MODE);
-  I2C_Write(Register::CONFIGURATION, config);
+  WriteRegister(Register::CONFIGURATION, config);
 }
 
 void INA226_Driver::SetBusVoltageConversionTime(ConversionTime Time) {
@@ -231,7 +326,7 @@ void INA226_Driver::SetBusVoltageConversionTime(ConversionTime Time) {
   config &= ~std::to_underlying(ConfigMask::BUS_VOLTAGE_CONVERSION_TIME);
   config |= std::to_underlying(Time)
             << std::to_underlying(ConfigOffset::BUS_VOLTAGE_CONVERSION_TIME);
-  I2C_Write(Register::CONFIGURATION, config);
+  WriteRegister(Register::CONFIGURATION, config);
 }
 
 void INA226_Driver::SetShuntVoltageConversionTime(ConversionTime Time) {
@@ -239,13 +334,13 @@ void INA226_Driver::SetShuntVoltageConversionTime(ConversionTime Time) {
   config &= ~std::to_underlying(ConfigMask::SHUNT_VOLTAGE_CONVERSION_TIME);
   config |= std::to_underlying(Time)
             << std::to_underlying(ConfigOffset::SHUNT_VOLTAGE_CONVERSION_TIME);
-  I2C_Write(Register::CONFIGURATION, config);
+  WriteRegister(Register::CONFIGURATION, config);
 }
 
 void INA226_Driver::SetAlertTriggerMask(AlertTriggerMask AlertTriggerMask) {
-  I2C_Write(Register::MASK_ENABLE, std::to_underlying(AlertTriggerMask));
+  WriteRegister(Register::MASK_ENABLE, std::to_underlying(AlertTriggerMask));
 }
 
 void INA226_Driver::SetAlertLimitValue(uint16_t AlertLimitValue) {
-  I2C_Write(Register::ALERT_LIMIT, AlertLimitValue);
+  WriteRegister(Register::ALERT_LIMIT, AlertLimitValue);
 }
@@ -16,8 +16,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <expected>
-#include <stdexcept>
+#include "esp_err.h"
 
 /**
  * @brief INA226 driver class for controlling and accessing the INA226 power monitor IC.
@@ -32,7 +35,8 @@
  * It also supports various operating modes, averaging modes, and conversion times.
  * 
  * @note The INA226_Driver class uses the std::expected type to handle errors and return values.
- * If an error occurs, a std::runtime_error is returned with an error message.
+ * If an error occurs, an INA226_Driver::Error is returned: the ESP-IDF error code and its kind, with a static
+ * message. Failing never allocates, and every failed register access is counted per kind.
  * 
  * @note The INA226_Driver class is not thread-safe and should be used in a single-threaded environment.
  */
@@ -110,6 +114,47 @@ public:
         ERROR = 0,                             ///< Error trigger mask
     };
 
+    /**
+     * @brief Kinds of failed register access, each with its own counter.
+     */
+    enum class ErrorKind : uint8_t {
+        LOCK_TIMEOUT = 0,               ///< The bus mutex could not be taken
+        INVALID_ARG,                    ///< The I2C driver rejected the transfer (ESP_ERR_INVALID_ARG)
+        TIMEOUT,                        ///< The transfer did not finish in time (ESP_ERR_TIMEOUT)
+        NO_ACK,                         ///< No acknowledge (ESP_ERR_INVALID_STATE or ESP_ERR_INVALID_RESPONSE)
+        BAD_RESET_VALUE,                ///< The configuration register did not read its reset value during init
+        OTHER,                          ///< Any other ESP-IDF error code
+        COUNT,
+    };
+
+    /**
+     * @brief Error of a register access.
+     *
+     * Trivially copyable, and what() returns a string from a static table, so an error path takes constant time
+     * and never allocates.
+     */
+    struct Error {
+        esp_err_t code;                 ///< ESP-IDF error code
+        ErrorKind kind;                 ///< Classification of code
+        bool write;                     ///< Whether the failed access was a write
+
+        /**
+         * @brief Static description of the error.
+         *
+         * @return const char* 
+         */
+        const char *what() const noexcept;
+    };
+
+    /**
+     * @brief Classify an ESP-IDF error code of an I2C transfer.
+     *
+     * @param[in] code The error code, not ESP_OK.
+     * @param[in] write Whether the transfer was a write.
+     * @return Error 
+     */
+    static Error MakeError(esp_err_t code, bool write) noexcept;
+
 protected:
     enum class Const : uint16_t;
     enum class Register : uint8_t;
@@ -123,9 +168,9 @@ public:
      * 
      * @param[in] ShuntResistor_mOhm Shunt resistor value in milli-Ohms. Defaults to 100mOhm.
      * @param[in] MaxCurrent_A Maximum current in Amps. Defaults to 1A.
-     * @return std::expected<void, std::runtime_error> 
+     * @return std::expected<void, Error> 
      */
-    std::expected<void, std::runtime_error> InitDriver(const uint32_t ShuntResistor_mOhm = CONFIG_INA226_SHUNT_RESISTOR_MILLIOHMS, const uint32_t MaxCurrent_A = CONFIG_INA226_MAX_CURRENT_AMPS);
+    std::expected<void, Error> InitDriver(const uint32_t ShuntResistor_mOhm = CONFIG_INA226_SHUNT_RESISTOR_MILLIOHMS, const uint32_t MaxCurrent_A = CONFIG_INA226_MAX_CURRENT_AMPS);
 
     /**
      * @name Getters
@@ -168,6 +213,35 @@ public:
      */
     uint16_t GetConfig();
 
+    /**
+     * @brief Read the Shunt Voltage in micro-Volts.
+     *
+     * @note The Get variants above return 0 on a failed read, these tell it apart from a 0 reading.
+     * @return std::expected<int32_t, Error> 
+     */
+    std::expected<int32_t, Error> ReadShuntVoltage_uV();
+
+    /**
+     * @brief Read the Bus Voltage in milli-Volts.
+     *
+     * @return std::expected<int32_t, Error> 
+     */
+    std::expected<int32_t, Error> ReadBusVoltage_mV();
+
+    /**
+     * @brief Read the Current in micro-Amps.
+     *
+     * @return std::expected<int32_t, Error> 
+     */
+    std::expected<int32_t, Error> ReadCurrent_uA();
+
+    /**
+     * @brief Read the Power in micro-Watts.
+     *
+     * @return std::expected<int32_t, Error> 
+     */
+    std::expected<int32_t, Error> ReadPower_uW();
+
     /**
      * @brief Get the manufacturer ID.
      * 
@@ -224,6 +298,14 @@ public:
      */
     uint16_t GetAlertLimitValue();
 
+    /**
+     * @brief Get the number of failed register accesses of one kind since construction.
+     * 
+     * @param[in] Kind The error kind.
+     * @return uint32_t 
+     */
+    uint32_t GetErrorCount(ErrorKind Kind) const;
+
     /** @} */
 
     /**
@@ -306,15 +388,33 @@ protected:
      * 
      * @param[in] Register The register to write to.
      * @param[in] Value The value to write.
-     * @return std::expected<void, std::runtime_error> 
+     * @return std::expected<void, Error> 
      */
-    virtual std::expected<void, std::runtime_error> I2C_Write(const Register Register, const uint16_t Value) = 0;
+    virtual std::expected<void, Error> I2C_Write(const Register Register, const uint16_t Value) = 0;
 
     /**
      * @brief Read data from the specified register.
      * 
      * @param[in] Register The register to read from.
-     * @return std::expected<uint16_t, std::runtime_error> 
+     * @return std::expected<uint16_t, Error> 
+     */
+    virtual std::expected<uint16_t, Error> I2C_Read(const Register Register) = 0;
+
+private:
+    /**
+     * @brief I2C_Write, counting a failure.
+     */
+    std::expected<void, Error> WriteRegister(const Register Register, const uint16_t Value);
+
+    /**
+     * @brief I2C_Read, counting a failure.
      */
-    virtual std::expected<uint16_t, std::runtime_error> I2C_Read(const Register Register) = 0;
+    std::expected<uint16_t, Error> ReadRegister(const Register Register);
+
+    /**
+     * @brief Count a failure and pass it on.
+     */
+    Error CountError(const Error &Failure);
+
+    std::atomic<uint32_t> ErrorCounts[static_cast<size_t>(ErrorKind::COUNT)] = {};
 };
@@ -0,0 +1,93 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef HOST_LZ4_ENCODE_HPP
+#define HOST_LZ4_ENCODE_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "include/lz4_stream.hpp"
+
+// Greedy LZ4 block compressor whose matches stay inside LZ4_STREAM_WINDOW, the scheme of lz4_compress() in
+// script/serial_pack.py except that candidates come from a hash table instead of a dictionary.
+inline std::vector<uint8_t> lz4Encode(const uint8_t* data, const size_t len) {
+    constexpr size_t HASH_BITS = 12;
+    std::vector<uint8_t> out;
+    std::vector<int64_t> table(1U << HASH_BITS, -1);
+
+    const auto hash = [data](const size_t at) {
+        uint32_t word;
+        std::memcpy(&word, data + at, sizeof(word));
+        return (word * 2654435761U) >> (32U - HASH_BITS);
+    };
+    const auto lengthBytes = [&out](size_t value) {
+        for (; value >= 255; value -= 255) {
+            out.push_back(255);
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    };
+    const auto literals = [&](const size_t from, const size_t to, const uint8_t matchToken) {
+        const size_t count = to - from;
+        const size_t token = std::min<size_t>(count, 15);
+        out.push_back(static_cast<uint8_t>((token << 4U) | matchToken));
+        if (token == 15) {
+            lengthBytes(count - 15);
+        }
+        out.insert(out.end(), data + from, data + to);
+    };
+
+    // LZ4 block rules: the last 5 bytes are literals and no match starts in the last 12 bytes
+    size_t anchor = 0;
+    size_t i = 0;
+    while (i + 12 <= len) {
+        const uint32_t key = hash(i);
+        const int64_t candidate = table[key];
+        table[key] = static_cast<int64_t>(i);
+        if (candidate < 0 || i - static_cast<size_t>(candidate) > LZ4_STREAM_WINDOW - 1 ||
+            std::memcmp(data + candidate, data + i, 4) != 0) {
+            i++;
+            continue;
+        }
+        size_t matchLen = 4;
+        while (i + matchLen < len - 5 && data[candidate + matchLen] == data[i + matchLen]) {
+            matchLen++;
+        }
+
+        const size_t matchToken = std::min<size_t>(matchLen - 4, 15);
+        literals(anchor, i, static_cast<uint8_t>(matchToken));
+        const size_t offset = i - candidate;
+        out.push_back(static_cast<uint8_t>(offset));
+        out.push_back(static_cast<uint8_t>(offset >> 8U));
+        if (matchToken == 15) {
+            lengthBytes(matchLen - 4 - 15);
+        }
+
+        for (size_t k = i + 1; k < std::min(i + matchLen, len - 4); k++) {
+            table[hash(k)] = static_cast<int64_t>(k);
+        }
+        i += matchLen;
+        anchor = i;
+    }
+    literals(anchor, len, 0);
+    return out;
+}
+
+#endif // HOST_LZ4_ENCODE_HPP
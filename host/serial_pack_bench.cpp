@@ -0,0 +1,183 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "lz4_encode.hpp"
+#include "serial_pack_loopback.hpp"
+
+// Parser throughput over a loopback link: serial_pack_bench [iterations]
+// Every pack is checked against what was sent, a mismatch fails the run.
+
+static constexpr size_t K_PACK_LEN = 16 * 1024;
+static constexpr size_t K_PACKS_PER_CHANNEL = 16;
+static constexpr size_t K_FRAME_LEN = 512;
+// the UART driver hands the parser task at most this much per read
+static constexpr size_t K_READ_LEN = 256;
+static constexpr const char* K_PATHS[SERIAL_PACK_MAX_CHANNELS] = {"ch0", "ch1", "ch2", "ch3"};
+
+struct PackCheck {
+    uint64_t expected;
+    uint64_t hash;
+    uint64_t completed;
+    uint64_t mismatched;
+};
+
+static LoopbackSink* S_SINK = nullptr;
+static PackCheck S_CHECKS[SERIAL_PACK_MAX_CHANNELS] = {};
+
+static uint64_t fnv1a64(const uint8_t* data, const size_t len, uint64_t value = 0xCBF29CE484222325ULL) {
+    for (size_t i = 0; i < len; i++) {
+        value = (value ^ data[i]) * 0x100000001B3ULL;
+    }
+    return value;
+}
+
+template <size_t I>
+static void checkHandler(const uint8_t* data, const size_t currentSize) {
+    PackCheck& check = S_CHECKS[I];
+    if (data != nullptr) {
+        check.hash = fnv1a64(data, currentSize, check.hash);
+        return;
+    }
+    if (S_SINK->aborted() || check.hash != check.expected) {
+        check.mismatched++;
+    } else {
+        check.completed++;
+    }
+    check.hash = fnv1a64(nullptr, 0);
+}
+
+static constexpr SerialPackHandler K_HANDLERS[SERIAL_PACK_MAX_CHANNELS] = {
+    checkHandler<0>, checkHandler<1>, checkHandler<2>, checkHandler<3>};
+
+// Framebuffer-like RGB565 content: smooth runs with some noise, so LZ4 finds matches but not everywhere.
+static std::vector<uint8_t> makePayload(const uint32_t seed) {
+    std::vector<uint8_t> payload(K_PACK_LEN);
+    uint32_t state = seed * 747796405U + 2891336453U;
+    for (size_t i = 0; i < payload.size(); i += 2) {
+        state = state * 1664525U + 1013904223U;
+        const uint16_t pixel = (state >> 28U) == 0 ? static_cast<uint16_t>(state >> 8U)
+                                                   : static_cast<uint16_t>(i / 64);
+        payload[i] = static_cast<uint8_t>(pixel);
+        payload[i + 1] = static_cast<uint8_t>(pixel >> 8U);
+    }
+    return payload;
+}
+
+enum class Scenario : uint8_t {
+    Legacy,
+    Multiplexed,
+    Lz4,
+};
+
+// All packs of one scenario, every pack of a channel carries the same payload. Multiplexed packs interleave their
+// Data frames across every channel.
+static LoopbackLink buildLink(const Scenario scenario, uint64_t& payloadBytes) {
+    std::vector<uint8_t> payloads[SERIAL_PACK_MAX_CHANNELS];
+    std::vector<uint8_t> wire[SERIAL_PACK_MAX_CHANNELS];
+    for (size_t channel = 0; channel < SERIAL_PACK_MAX_CHANNELS; channel++) {
+        payloads[channel] = makePayload(static_cast<uint32_t>(channel));
+        wire[channel] = scenario == Scenario::Lz4 ? lz4Encode(payloads[channel].data(), K_PACK_LEN) : payloads[channel];
+        S_CHECKS[channel].expected = fnv1a64(payloads[channel].data(), K_PACK_LEN);
+    }
+
+    LoopbackLink link;
+    for (size_t round = 0; round < K_PACKS_PER_CHANNEL; round++) {
+        for (size_t channel = 0; channel < SERIAL_PACK_MAX_CHANNELS; channel++) {
+            if (scenario == Scenario::Legacy) {
+                link.legacy(K_PATHS[channel], payloads[channel].data(), K_PACK_LEN);
+            } else {
+                link.open(static_cast<uint8_t>(channel), static_cast<uint8_t>(channel * SERIAL_PACK_PRIORITY_STEP),
+                          K_PATHS[channel], wire[channel].size(), scenario == Scenario::Lz4);
+            }
+        }
+        for (size_t offset = 0; scenario != Scenario::Legacy && offset < K_PACK_LEN; offset += K_FRAME_LEN) {
+            for (size_t channel = 0; channel < SERIAL_PACK_MAX_CHANNELS; channel++) {
+                if (offset < wire[channel].size()) {
+                    link.frame(static_cast<uint8_t>(channel), SerialPackFrameType::Data, wire[channel].data() + offset,
+                               std::min(K_FRAME_LEN, wire[channel].size() - offset));
+                }
+            }
+        }
+    }
+    payloadBytes = K_PACK_LEN * K_PACKS_PER_CHANNEL * SERIAL_PACK_MAX_CHANNELS;
+    return link;
+}
+
+static bool run(const char* name, const Scenario scenario, const size_t iterations) {
+    uint64_t payloadBytes = 0;
+    const LoopbackLink link = buildLink(scenario, payloadBytes);
+    for (PackCheck& check : S_CHECKS) {
+        check = {check.expected, fnv1a64(nullptr, 0), 0, 0};
+    }
+
+    LoopbackSink sink;
+    S_SINK = &sink;
+    for (size_t channel = 0; channel < SERIAL_PACK_MAX_CHANNELS; channel++) {
+        sink.attach(K_PATHS[channel], K_HANDLERS[channel]);
+    }
+    SerialPackParser parser(sink);
+    parser.reset();
+    LoopbackSource source(link, K_READ_LEN);
+
+    uint8_t rx[K_READ_LEN];
+    int64_t now = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        source.rewind();
+        while (!source.done()) {
+            const size_t read = source.read(rx, sizeof(rx), 0);
+            parser.feed(rx, read, ++now);
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t completed = 0;
+    uint64_t mismatched = 0;
+    for (const PackCheck& check : S_CHECKS) {
+        completed += check.completed;
+        mismatched += check.mismatched;
+    }
+    const uint64_t expectedPacks = K_PACKS_PER_CHANNEL * SERIAL_PACK_MAX_CHANNELS * iterations;
+    const double mb = 1024.0 * 1024.0;
+    std::printf("%-11s wire %8.1f MB/s  payload %8.1f MB/s  handlers %7.2f M/s  packs %llu/%llu\n", name,
+                static_cast<double>(link.bytes.size() * iterations) / mb / seconds,
+                static_cast<double>(payloadBytes * iterations) / mb / seconds,
+                static_cast<double>(sink.handlerCalls) / 1e6 / seconds, static_cast<unsigned long long>(completed),
+                static_cast<unsigned long long>(expectedPacks));
+    if (completed != expectedPacks || mismatched != 0) {
+        std::fprintf(stderr, "%s: %llu packs mismatched\n", name,
+                     static_cast<unsigned long long>(expectedPacks - completed));
+        return false;
+    }
+    return true;
+}
+
+int main(const int argc, char** argv) {
+    const size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20;
+    if (iterations == 0) {
+        std::fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 2;
+    }
+    bool ok = run("legacy", Scenario::Legacy, iterations);
+    ok = run("multiplexed", Scenario::Multiplexed, iterations) && ok;
+    ok = run("lz4", Scenario::Lz4, iterations) && ok;
+    return ok ? 0 : 1;
+}
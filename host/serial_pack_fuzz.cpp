@@ -0,0 +1,209 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "lz4_encode.hpp"
+#include "serial_pack_loopback.hpp"
+
+// Fuzz target of SerialPackParser. Input: chunk:u8 | expireEvery:u8 | link bytes.
+// The link bytes are fed `chunk` + 1 at a time; after every `expireEvery` chunks (never when 0) the clock jumps past
+// SERIAL_PACK_RX_TIMEOUT_US and expire() runs, so timeouts hit packs and frames at arbitrary points.
+// With libFuzzer (clang) this is the whole harness. Otherwise SERIAL_PACK_FUZZ_MAIN adds a main that replays the
+// files given as arguments, or mutates a few loopback streams for a fixed number of rounds.
+
+#define CHECK(condition)                                                                                             \
+    do {                                                                                                             \
+        if (!(condition)) {                                                                                          \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);                       \
+            std::abort();                                                                                            \
+        }                                                                                                            \
+    } while (false)
+
+// Checks what the device's worker relies on: bounded paths and pieces, and every delivered pack ending exactly once.
+class FuzzSink final : public SerialPackSink {
+public:
+    bool accepts(const char* path) override {
+        checkPath(path);
+        return path[0] != 'u';
+    }
+
+    void packData(const char* path, uint8_t, const uint8_t* data, const size_t len) override {
+        checkPath(path);
+        CHECK(path[0] != 'u');
+        CHECK(len <= SERIAL_PACK_POOL_BUFFER_LEN);
+        CHECK(data != nullptr || len == 0);
+        open = true;
+    }
+
+    void unhandledData(const char* path, const uint8_t* data, const size_t len, bool) override {
+        checkPath(path);
+        CHECK(len <= SERIAL_PACK_POOL_BUFFER_LEN);
+        CHECK(data != nullptr || len == 0);
+    }
+
+    void packEnd(const char* path, uint8_t, int64_t, int64_t) override {
+        checkPath(path);
+        open = false;
+    }
+
+    void packAborted(const char* path, uint8_t) override {
+        checkPath(path);
+        open = false;
+    }
+
+    void inflated(const char* path, uint32_t, uint32_t, uint32_t) override {
+        checkPath(path);
+    }
+
+    void event(const SerialPackParseEvent event, const uint8_t channel, const char* path, uint32_t) override {
+        CHECK(event <= SerialPackParseEvent::ChannelTimeout);
+        CHECK(channel < 0xFF);
+        CHECK(path != nullptr);
+        CHECK(std::strlen(path) < SERIAL_PACK_MAX_PATH_LEN);
+    }
+
+    // some pack got data but has not ended yet
+    bool open = false;
+
+private:
+    static void checkPath(const char* path) {
+        CHECK(path != nullptr);
+        const size_t len = std::strlen(path);
+        CHECK(len > 0 && len < SERIAL_PACK_MAX_PATH_LEN);
+    }
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, const size_t size) {
+    static FuzzSink sink;
+    static SerialPackParser parser(sink);
+    if (size < 2) {
+        return 0;
+    }
+    parser.reset();
+    sink.open = false;
+
+    const size_t chunk = static_cast<size_t>(data[0]) + 1;
+    const uint8_t expireEvery = data[1];
+    int64_t now = 1;
+    size_t chunks = 0;
+    for (size_t offset = 2; offset < size; offset += chunk) {
+        parser.feed(data + offset, std::min(chunk, size - offset), now++);
+        if (expireEvery != 0 && ++chunks % expireEvery == 0) {
+            now += SERIAL_PACK_RX_TIMEOUT_US + 1;
+            parser.expire(now);
+        }
+    }
+
+    // once everything went stale the parser holds nothing and every pack that got data has ended
+    parser.expire(now + SERIAL_PACK_RX_TIMEOUT_US + 1);
+    CHECK(!parser.pending());
+    CHECK(!sink.open);
+    return 0;
+}
+
+#ifdef SERIAL_PACK_FUZZ_MAIN
+
+static std::vector<uint8_t> readFile(const char* name) {
+    std::vector<uint8_t> bytes;
+    if (FILE* file = std::fopen(name, "rb")) {
+        uint8_t buffer[4096];
+        size_t read;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            bytes.insert(bytes.end(), buffer, buffer + read);
+        }
+        std::fclose(file);
+    } else {
+        std::fprintf(stderr, "cannot open %s\n", name);
+        std::exit(2);
+    }
+    return bytes;
+}
+
+// Well-formed streams for the mutator to start from: every framing, compression, an abort and an ignored path.
+static std::vector<LoopbackLink> seedLinks() {
+    std::vector<uint8_t> payload(3000);
+    for (size_t i = 0; i < payload.size(); i++) {
+        payload[i] = static_cast<uint8_t>((i / 7) ^ (i % 13));
+    }
+    const std::vector<uint8_t> compressed = lz4Encode(payload.data(), payload.size());
+
+    std::vector<LoopbackLink> links(4);
+    links[0].legacy("fb", payload.data(), payload.size());
+    links[0].legacy("unwanted", payload.data(), 100);
+    links[1].pack(0, 0, "fb", payload.data(), payload.size(), 512);
+    links[1].pack(1, 16, "cfg", payload.data(), 40, 512);
+    links[2].pack(2, 8, "page", compressed.data(), compressed.size(), 256, true);
+    links[3].open(3, 0, "fx/def", payload.size(), false);
+    links[3].frame(3, SerialPackFrameType::Data, payload.data(), 700);
+    links[3].abort(3);
+    const uint8_t stamp[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    links[3].frame(1, SerialPackFrameType::Stamp, stamp, sizeof(stamp));
+    links[3].pack(1, 0, "time", payload.data(), 16, 512);
+    return links;
+}
+
+static void mutate(std::vector<uint8_t>& input, std::mt19937& random) {
+    const size_t edits = random() % 8;
+    for (size_t i = 0; i < edits && input.size() > 2; i++) {
+        const size_t at = random() % input.size();
+        switch (random() % 4) {
+        case 0:
+            input[at] ^= static_cast<uint8_t>(1U << (random() % 8));
+            break;
+        case 1:
+            input[at] = static_cast<uint8_t>(random());
+            break;
+        case 2:
+            input.insert(input.begin() + static_cast<std::ptrdiff_t>(at), static_cast<uint8_t>(random()));
+            break;
+        default:
+            input.resize(std::max<size_t>(at, 2));
+            break;
+        }
+    }
+}
+
+int main(const int argc, char** argv) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            const std::vector<uint8_t> input = readFile(argv[i]);
+            LLVMFuzzerTestOneInput(input.data(), input.size());
+        }
+        std::printf("replayed %d inputs\n", argc - 1);
+        return 0;
+    }
+
+    const std::vector<LoopbackLink> links = seedLinks();
+    std::mt19937 random(1);
+    constexpr size_t K_ROUNDS = 20000;
+    for (size_t round = 0; round < K_ROUNDS; round++) {
+        const LoopbackLink& link = links[round % links.size()];
+        std::vector<uint8_t> input = {static_cast<uint8_t>(random()), static_cast<uint8_t>(random() % 4)};
+        input.insert(input.end(), link.bytes.begin(), link.bytes.end());
+        if (round >= links.size()) {
+            mutate(input, random);
+        }
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    std::printf("%zu rounds passed\n", K_ROUNDS);
+    return 0;
+}
+
+#endif // SERIAL_PACK_FUZZ_MAIN
@@ -0,0 +1,196 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef HOST_SERIAL_PACK_LOOPBACK_HPP
+#define HOST_SERIAL_PACK_LOOPBACK_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include "include/serial_pack_parser.hpp"
+
+// In-memory stand-ins for the UART and the worker task of serial_pack.cpp, so the parser runs on the host.
+
+// Byte pipe with the encoder side of script/serial_pack.py.
+class LoopbackLink {
+public:
+    void write(const uint8_t* data, const size_t len) {
+        bytes.insert(bytes.end(), data, data + len);
+    }
+
+    void frame(const uint8_t channel, const SerialPackFrameType type, const uint8_t* payload, const size_t len) {
+        const uint8_t header[] = {SERIAL_PACK_FRAME_MAGIC, channel, static_cast<uint8_t>(type),
+                                  static_cast<uint8_t>(len), static_cast<uint8_t>(len >> 8U)};
+        write(header, sizeof(header));
+        write(payload, len);
+    }
+
+    void legacy(const char* path, const uint8_t* data, const size_t len) {
+        write(reinterpret_cast<const uint8_t*>(path), std::strlen(path));
+        const uint8_t header[] = {'\n', static_cast<uint8_t>(len), static_cast<uint8_t>(len >> 8U),
+                                  static_cast<uint8_t>(len >> 16U), static_cast<uint8_t>(len >> 24U)};
+        write(header, sizeof(header));
+        write(data, len);
+    }
+
+    void open(const uint8_t channel, const uint8_t priority, const char* path, const size_t size,
+              const bool compressed) {
+        uint8_t payload[5 + SERIAL_PACK_MAX_PATH_LEN] = {priority, static_cast<uint8_t>(size),
+                                                         static_cast<uint8_t>(size >> 8U),
+                                                         static_cast<uint8_t>(size >> 16U),
+                                                         static_cast<uint8_t>(size >> 24U)};
+        const size_t pathLen = std::min(std::strlen(path), SERIAL_PACK_MAX_PATH_LEN - 1);
+        std::memcpy(payload + 5, path, pathLen);
+        frame(channel, compressed ? SerialPackFrameType::OpenLz4 : SerialPackFrameType::Open, payload, 5 + pathLen);
+    }
+
+    // A whole pack on one channel, `data` already compressed when `compressed` is set.
+    void pack(const uint8_t channel, const uint8_t priority, const char* path, const uint8_t* data, const size_t len,
+              const size_t frameLen, const bool compressed = false) {
+        open(channel, priority, path, len, compressed);
+        for (size_t offset = 0; offset < len; offset += frameLen) {
+            frame(channel, SerialPackFrameType::Data, data + offset, std::min(frameLen, len - offset));
+        }
+    }
+
+    void abort(const uint8_t channel) {
+        frame(channel, SerialPackFrameType::Abort, nullptr, 0);
+    }
+
+    std::vector<uint8_t> bytes;
+};
+
+// Hands out the link in pieces of at most `chunk` bytes, like reads from the driver RX buffer.
+class LoopbackSource final : public SerialPackSource {
+public:
+    LoopbackSource(const LoopbackLink& input, const size_t chunk) : link(input), chunkLen(chunk) {}
+
+    size_t read(uint8_t* data, const size_t len, uint32_t) override {
+        const size_t count = std::min({len, chunkLen, link.bytes.size() - offset});
+        std::memcpy(data, link.bytes.data() + offset, count);
+        offset += count;
+        return count;
+    }
+
+    void rewind() {
+        offset = 0;
+    }
+
+    [[nodiscard]] bool done() const {
+        return offset == link.bytes.size();
+    }
+
+private:
+    const LoopbackLink& link;
+    size_t chunkLen;
+    size_t offset = 0;
+};
+
+// Calls attached handlers right away instead of queueing them to a worker, with the device's calling convention:
+// each piece, then (nullptr, 0) at the end of the pack with aborted() telling whether it completed.
+class LoopbackSink final : public SerialPackSink {
+public:
+    static constexpr size_t MAX_HANDLERS = 8;
+
+    void attach(const char* path, const SerialPackHandler handler) {
+        if (handlerCount < MAX_HANDLERS) {
+            routes[handlerCount++] = {path, handler};
+        }
+    }
+
+    [[nodiscard]] bool aborted() const {
+        return endAborted;
+    }
+
+    bool accepts(const char* path) override {
+        return find(path) != nullptr;
+    }
+
+    void packData(const char* path, uint8_t, const uint8_t* data, const size_t len) override {
+        if (const SerialPackHandler handler = find(path)) {
+            handler(data, len);
+            handlerCalls++;
+            bytesDelivered += len;
+        }
+    }
+
+    void unhandledData(const char*, const uint8_t*, const size_t len, bool) override {
+        bytesUnhandled += len;
+    }
+
+    void packEnd(const char* path, uint8_t, int64_t, int64_t) override {
+        end(path, false);
+        packsEnded++;
+    }
+
+    void packAborted(const char* path, uint8_t) override {
+        end(path, true);
+        packsAborted++;
+    }
+
+    void inflated(const char*, const uint32_t wireBytes, const uint32_t inflatedBytes, uint32_t) override {
+        bytesInflated += inflatedBytes;
+        bytesCompressed += wireBytes;
+    }
+
+    void event(const SerialPackParseEvent event, uint8_t, const char*, uint32_t) override {
+        events[static_cast<size_t>(event)]++;
+    }
+
+    uint64_t handlerCalls = 0;
+    uint64_t bytesDelivered = 0;
+    uint64_t bytesUnhandled = 0;
+    uint64_t bytesInflated = 0;
+    uint64_t bytesCompressed = 0;
+    uint64_t packsEnded = 0;
+    uint64_t packsAborted = 0;
+    std::array<uint64_t, static_cast<size_t>(SerialPackParseEvent::ChannelTimeout) + 1> events = {};
+
+private:
+    struct Route {
+        const char* path;
+        SerialPackHandler handler;
+    };
+
+    [[nodiscard]] SerialPackHandler find(const char* path) const {
+        for (size_t i = 0; i < handlerCount; i++) {
+            if (std::strcmp(routes[i].path, path) == 0) {
+                return routes[i].handler;
+            }
+        }
+        return nullptr;
+    }
+
+    void end(const char* path, const bool wasAborted) {
+        if (const SerialPackHandler handler = find(path)) {
+            endAborted = wasAborted;
+            handler(nullptr, 0);
+            endAborted = false;
+            handlerCalls++;
+        }
+    }
+
+    Route routes[MAX_HANDLERS] = {};
+    size_t handlerCount = 0;
+    bool endAborted = false;
+};
+
+#endif // HOST_SERIAL_PACK_LOOPBACK_HPP
@@ -0,0 +1,71 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_BYTE_ORDER_HPP
+#define MAIN_INCLUDE_BYTE_ORDER_HPP
+
+#include <cstdint>
+#include <cstring>
+
+// Little-endian fields of the serial endpoints' requests and replies. Reads take unaligned pointers, writes return
+// the pointer past the bytes they wrote so a reply is built by chaining them.
+
+inline uint16_t readU16Le(const uint8_t* data) {
+    return static_cast<uint16_t>(data[0] | (data[1] << 8U));
+}
+
+inline uint32_t readU32Le(const uint8_t* data) {
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8U) |
+           (static_cast<uint32_t>(data[2]) << 16U) | (static_cast<uint32_t>(data[3]) << 24U);
+}
+
+inline uint64_t readU64Le(const uint8_t* data) {
+    return static_cast<uint64_t>(readU32Le(data)) | (static_cast<uint64_t>(readU32Le(data + 4)) << 32U);
+}
+
+inline float readF32Le(const uint8_t* data) {
+    const uint32_t bits = readU32Le(data);
+    float value = 0.0F;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline uint8_t* writeU16Le(uint8_t* out, const uint16_t value) {
+    *out++ = static_cast<uint8_t>(value & 0xFF);
+    *out++ = static_cast<uint8_t>(value >> 8U);
+    return out;
+}
+
+inline uint8_t* writeU32Le(uint8_t* out, const uint32_t value) {
+    out = writeU16Le(out, static_cast<uint16_t>(value & 0xFFFF));
+    return writeU16Le(out, static_cast<uint16_t>(value >> 16U));
+}
+
+inline uint8_t* writeU64Le(uint8_t* out, const uint64_t value) {
+    out = writeU32Le(out, static_cast<uint32_t>(value & 0xFFFFFFFF));
+    return writeU32Le(out, static_cast<uint32_t>(value >> 32U));
+}
+
+inline uint8_t* writeF32Le(uint8_t* out, const float value) {
+    uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return writeU32Le(out, bits);
+}
+
+#endif // MAIN_INCLUDE_BYTE_ORDER_HPP
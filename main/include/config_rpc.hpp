@@ -0,0 +1,91 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_CONFIG_RPC_HPP
+#define MAIN_INCLUDE_CONFIG_RPC_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Request/response access to LUMEN_CONFIG_VALUES over the `cfg` pack, so the host can reconfigure protection
+// without going through the settings pages.
+//
+// Request:  MAGIC | version:u8 | op:u8 | requestId:u8 | count:u8 | item[count]
+//   Get: item = field:u8, count 0 reads every field.
+//   Set: item = field:u8 | value:i16le. The batch is validated against lumenGetUSBInfo() first and applied only
+//        when every item is valid, so the limits never pass through a half written state.
+// Response: MAGIC | version:u8 | (op | CONFIG_RPC_REPLY):u8 | requestId:u8 | status:u8 | badField:u8 | count:u8 |
+//           { field:u8 | value:i16le }[count]
+//   The values of the requested fields after the request (all fields for a Get of count 0). `badField` names
+//   the first rejected item, 0xFF when there is none.
+// Notify:   the layout of a response to Notify with requestId 0, carrying the fields edited on the device.
+//   Edits are coalesced for CONFIG_RPC_NOTIFY_DELAY_MS so dragging a slider sends one notification.
+constexpr uint8_t CONFIG_RPC_MAGIC = 0xC8;
+constexpr uint8_t CONFIG_RPC_VERSION = 1;
+constexpr uint8_t CONFIG_RPC_REPLY = 0x80;
+constexpr uint8_t CONFIG_RPC_NO_FIELD = 0xFF;
+constexpr size_t CONFIG_RPC_MAX_BATCH = 16;
+constexpr uint32_t CONFIG_RPC_NOTIFY_DELAY_MS = 100;
+
+enum class ConfigRpcOp : uint8_t {
+    Get = 1,
+    Set = 2,
+    Notify = 3,
+};
+
+enum class ConfigRpcStatus : uint8_t {
+    Ok = 0,
+    Malformed = 1,
+    UnknownField = 2,
+    OutOfRange = 3,
+    UnsupportedVersion = 4,
+};
+
+enum class ConfigField : uint8_t {
+    OvercurrentMA = 0,
+    OvervoltageMV = 1,
+    EnableAutoFaultRecovery = 2,
+    TurnOffUsb = 3,
+    OvervoltageAlert = 4,
+    OvercurrentAlert = 5,
+    FastTrip = 6,
+    OvercurrentHardMA = 7,
+    OvercurrentTauMS = 8,
+    AcquisitionProfile = 9,
+    PersistFaults = 10,
+    Count = 11,
+};
+
+struct ConfigRpcStats {
+    uint32_t requests;
+    uint32_t rejected;
+    uint32_t notifications;
+};
+
+extern void configRpcInit();
+
+// SerialPackHandler for `cfg`.
+extern void configRpcHandler(const uint8_t* data, size_t size);
+
+// Settings callbacks. Store a value edited on the device and schedule a notification.
+extern void configRpcLocalSet(ConfigField field, int16_t value);
+
+extern ConfigRpcStats configRpcGetStats();
+
+#endif // MAIN_INCLUDE_CONFIG_RPC_HPP
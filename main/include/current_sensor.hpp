@@ -20,113 +20,119 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MAIN_INCLUDE_CURRENT_SENSOR_HPP
 #define MAIN_INCLUDE_CURRENT_SENSOR_HPP
 
-#include <bitset>
-#include <utility>
-
-#include <esp_err.h>
-#include <esp_log.h>
-
-#include <ina226_interface.h>
-
-#include "i2c_bus.hpp"
-#include "pins.hpp"
-
-inline INA226* CURRENT_SENSOR;
-
-static constexpr auto ADDRESS = 0x44;
-static constexpr auto CURRENT_SENSOR_TAG = "[lumen:current_sensor]";
-
-inline void currentSensorInit() {
-    const auto bus = lumen::i2c::get_shared_bus_handle();
-    if (bus == nullptr) {
-        ESP_LOGE(CURRENT_SENSOR_TAG, "Shared I2C bus is not available");
-        return;
-    }
-
-    CURRENT_SENSOR = new INA226{bus, ADDRESS, I2C_FREQ};
-
-    CURRENT_SENSOR->Calibrate(100, 1.6);
-    CURRENT_SENSOR->SetOperatingMode(INA226::OperatingMode::SHUNT_AND_BUS_CONTINUOUS);
-    CURRENT_SENSOR->SetAveragingMode(INA226::AveragingMode::SAMPLE_1);
-    CURRENT_SENSOR->SetBusVoltageConversionTime(INA226::ConversionTime::TIME_8244_uS);
-    CURRENT_SENSOR->SetShuntVoltageConversionTime(INA226::ConversionTime::TIME_8244_uS);
-}
-
-inline float currentSensorReadVoltage() {
-    return CURRENT_SENSOR->GetBusVoltage_mV();
-}
-
-inline float currentSensorReadCurrent() {
-    return CURRENT_SENSOR->GetCurrent_uA() / 1000.f;
-}
-
-inline float currentSensorReadPower() {
-    return CURRENT_SENSOR->GetPower_uW() / 1000.f;
-}
-
+#include <cstddef>
+#include <cstdint>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Shunt voltage register: 2.5 uV per bit up to 0x7FFF. Across the shunt that is about 819 mA, where samples and the
+// comparator saturate, so every current limit has to stay below CURRENT_SENSOR_FULL_SCALE_MA.
+constexpr uint32_t CURRENT_SENSOR_SHUNT_MILLIOHM = 100;
+constexpr float CURRENT_SENSOR_SHUNT_LSB_UV = 2.5F;
+constexpr uint16_t CURRENT_SENSOR_SHUNT_FULL_SCALE = 0x7FFF;
+constexpr int16_t CURRENT_SENSOR_FULL_SCALE_MA = static_cast<int16_t>(
+        CURRENT_SENSOR_SHUNT_FULL_SCALE * CURRENT_SENSOR_SHUNT_LSB_UV / CURRENT_SENSOR_SHUNT_MILLIOHM
+);
+
+// One INA226 reading. A sampler task reads every measurement register once per conversion cycle and publishes
+// them together, so all readers share the same bus traffic and see the same values. The four registers are read one
+// after the other: with continuous conversions shorter than the reads (fast-protect, fast conversions) they can span
+// adjacent conversions, shunt voltage and current being the closest pair. When a read fails the sample is skipped
+// rather than published with zeros, so `sequence` and `timestampUs` show the gap.
+struct CurrentSensorSample {
+    // esp_timer time when the registers were read, 0 before the first sample
+    int64_t timestampUs;
+    // increments with every sample
+    uint32_t sequence;
+    float busVoltageMV;
+    float shuntVoltageUV;
+    float currentMA;
+    float powerMW;
+};
+
+// Named INA226 set-ups, trading response time against noise and supply current. The sampler switches between two
+// samples with one configuration register write, so every sample comes from a single set-up and the alert limit
+// stays armed across the switch.
+enum class AcquisitionProfile : uint8_t {
+    // 140 us conversions, no averaging, a sample every 4 ms
+    FastProtect = 0,
+    // 1.1 ms conversions, no averaging, a sample every 16 ms
+    Balanced = 1,
+    // 588 us conversions averaged 64 times, a sample every 80 ms
+    Precision = 2,
+    // one triggered conversion (1.1 ms, averaged 4 times) every 250 ms, the INA226 idles in between
+    LowPower = 3,
+    Count = 4,
+};
+constexpr auto CURRENT_SENSOR_DEFAULT_PROFILE = AcquisitionProfile::Balanced;
+
+// What a profile delivered while it was last active, from its third sample on.
+struct AcquisitionMeasurement {
+    uint32_t samples;
+    float rateHz;
+    uint32_t maxGapUs;
+    // RMS change from one sample to the next over sqrt(2), the noise of a steady load
+    float currentNoiseMA;
+    float voltageNoiseMV;
+};
+
+// Configure the INA226 and start the sampler task.
+extern void currentSensorInit();
+
+// Any task. The sampler applies the profile before its next sample.
+extern void currentSensorSetProfile(AcquisitionProfile profile);
+extern AcquisitionProfile currentSensorGetProfile();
+extern const char* currentSensorProfileName(AcquisitionProfile profile);
+extern AcquisitionMeasurement currentSensorGetMeasurement(AcquisitionProfile profile);
+
+// Any task. The newest sample, never blocks on the bus.
+extern CurrentSensorSample currentSensorGetSample();
+// Give `task` a notification after every sample, so it can act on each one instead of polling. One task at most.
+extern void currentSensorSubscribe(TaskHandle_t task);
+
+// Called on the sampler task right after every sample is published, for work that must see each sample (such as
+// integration). Listeners must be short and never block; register them during init.
+using CurrentSensorListener = void (*)(const CurrentSensorSample& sample);
+constexpr size_t CURRENT_SENSOR_MAX_LISTENERS = 4;
+extern bool currentSensorAddListener(CurrentSensorListener listener);
+
+// Fields of the newest sample. Use currentSensorGetSample() when more than one is needed.
+extern float currentSensorReadVoltage();
+extern float currentSensorReadCurrent();
+extern float currentSensorReadPower();
+
+// Hardware overcurrent comparator: every shunt conversion is compared with `limitMA` and the result latched in
+// Mask/Enable until currentSensorAlertFired() reads it. 0 disarms. A limit the shunt cannot measure (at or above
+// CURRENT_SENSOR_FULL_SCALE_MA) is rejected: the comparator is disarmed and false returned.
+extern bool currentSensorSetOvercurrentAlert(float limitMA);
+// Read and clear the latched alert, the only register access of a fast-trip poll.
+extern bool currentSensorAlertFired();
+// Time from one shunt conversion to the next with the active profile, how often the comparator evaluates.
+extern int64_t currentSensorCycleUs();
+// Time from one published sample to the next with the active profile.
+extern int64_t currentSensorSamplePeriodUs();
+
+// Transient capture: run continuous conversions at the fastest time without averaging, and back to the active
+// profile. Samples, the alert comparator and the e-fuse keep working, the measurements are just noisier while fast.
+extern void currentSensorSetFastConversions(bool fast);
+// Read the shunt voltage register right now, bypassing the sampler, as a current in mA. NaN without a sensor.
+extern float currentSensorReadCurrentNowMA();
+
+// `acq` pack, request empty. Reply: VERSION | active:u8, then per profile samplePeriodUs:u32 | cycleUs:u32 |
+// samples:u32 | rateHz:f32 | maxGapUs:u32 | currentNoiseMA:f32 | voltageNoiseMV:f32, then failedSamples:u32 (skipped
+// on a failed register read since boot), all little endian. Profiles are switched with the `cfg` field
+// AcquisitionProfile.
+constexpr uint8_t CURRENT_SENSOR_ACQ_VERSION = 2;
+
+// SerialPackHandler for `acq`.
+extern void currentSensorProfileHandler(const uint8_t* data, size_t size);
+
+// Read the registers directly and log them with the configuration.
 [[maybe_unused]]
-inline void currentSensorReadDebug() {
-    ESP_LOGI(CURRENT_SENSOR_TAG, "\n");
-    ESP_LOGI(CURRENT_SENSOR_TAG, "Shunt voltage: %" PRIi32 " uV", CURRENT_SENSOR->GetShuntVoltage_uV());
-    ESP_LOGI(CURRENT_SENSOR_TAG, "Bus voltage raw: %d", CURRENT_SENSOR->GetBusVoltage_Raw());
-    ESP_LOGI(CURRENT_SENSOR_TAG, "Bus voltage: %d mV", currentSensorReadVoltage());
-    ESP_LOGI(CURRENT_SENSOR_TAG, "Current: %f mA", currentSensorReadCurrent());
-    ESP_LOGI(CURRENT_SENSOR_TAG, "Power: %f mW", currentSensorReadPower());
-    ESP_LOGI(CURRENT_SENSOR_TAG, "Config: %" PRIx16, CURRENT_SENSOR->GetConfig());
-    ESP_LOGI(CURRENT_SENSOR_TAG, "Operating mode: %" PRIu8, std::to_underlying(CURRENT_SENSOR->GetOperatingMode()));
-    ESP_LOGI(CURRENT_SENSOR_TAG, "Averaging mode: %" PRIu8, std::to_underlying(CURRENT_SENSOR->GetAveragingMode()));
-    ESP_LOGI(
-            CURRENT_SENSOR_TAG,
-            "Bus voltage conversion time: %" PRIu8,
-            std::to_underlying(CURRENT_SENSOR->GetBusVoltageConversionTime())
-    );
-    ESP_LOGI(
-            CURRENT_SENSOR_TAG,
-            "Shunt voltage conversion time: %" PRIu8,
-            std::to_underlying(CURRENT_SENSOR->GetShuntVoltageConversionTime())
-    );
-}
-
+extern void currentSensorReadDebug();
+// Probe the sensor address on the shared bus.
 [[maybe_unused]]
-inline void currentSensorScan() {
-    auto bus = lumen::i2c::get_shared_bus_handle();
-    if (bus == nullptr) {
-        ESP_LOGE(CURRENT_SENSOR_TAG, "Shared I2C bus is not available");
-        return;
-    }
-
-    constexpr auto addr = ADDRESS;
-    if (const esp_err_t ok = i2c_master_probe(bus, addr, 50); ok == ESP_OK) {
-        ESP_LOGI(CURRENT_SENSOR_TAG, "Found I2C device at 0x%02X\n", addr);
-    } else {
-        ESP_LOGW(CURRENT_SENSOR_TAG, "Probe failed for I2C device at 0x%02X -> %s", addr, esp_err_to_name(ok));
-    }
-
-    i2c_master_dev_handle_t dev;
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
-    constexpr i2c_device_config_t devCfg = {
-            .device_address = static_cast<uint16_t>(addr),
-            .scl_speed_hz = I2C_FREQ,
-    };
-#pragma GCC diagnostic pop
-
-    if (i2c_master_bus_add_device(bus, &devCfg, &dev) != ESP_OK) {
-        ESP_LOGE(CURRENT_SENSOR_TAG, "Failed to add temporary device for scan");
-        return;
-    }
-
-    constexpr uint8_t reg = 0xFE;
-    uint8_t rx[2];
-
-    const esp_err_t e1 = i2c_master_transmit(dev, &reg, 1, 500);
-    ESP_LOGI(CURRENT_SENSOR_TAG, "TX(reg=0x%02X) -> %s\n", reg, esp_err_to_name(e1));
-    if (e1 == ESP_OK) {
-        const esp_err_t e2 = i2c_master_receive(dev, rx, 2, 500);
-        ESP_LOGI(CURRENT_SENSOR_TAG, "RX -> %s, data=0x%02X%02X\n", esp_err_to_name(e2), rx[0], rx[1]);
-    }
-
-    i2c_master_bus_rm_device(dev);
-}
+extern void currentSensorScan();
 
 #endif // MAIN_INCLUDE_CURRENT_SENSOR_HPP
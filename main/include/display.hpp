@@ -20,6 +20,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MAIN_INCLUDE_DISPLAY_HPP
 #define MAIN_INCLUDE_DISPLAY_HPP
 
+#include <cstddef>
+#include <cstdint>
+
 #include <vision_ui_lib.h>
 
 #define LCD_H_RES 240
@@ -47,5 +50,37 @@ extern void displayDriverExtensionRGBBitmapAlphaDraw(
 
 extern void displayDriverExtensionPixelScale(uint16_t scale);
 
+extern void displayBacklightSet(bool on);
+
+// Remote framebuffer: the host drives the panel through the `fb` serial pack. A pack is one frame made of
+// tiles, each tileX:u8 | tileY:u8 | encoding:u8 | data, with RGB565 colors in panel (big-endian) byte order:
+//  - Raw: DISPLAY_REMOTE_TILE^2 colors, row major
+//  - Solid: one color
+//  - Rle: runs of (length - 1):u8 | color until the tile is covered
+// Only tiles that changed need to be sent. The touched rows are flushed when the pack ends. UI rendering pauses
+// while packs keep arriving and resumes after two idle seconds.
+constexpr size_t DISPLAY_REMOTE_TILE = 16;
+
+enum class DisplayRemoteEncoding : uint8_t {
+    Raw = 0,
+    Solid = 1,
+    Rle = 2,
+};
+
+struct DisplayRemoteStats {
+    uint32_t frames;
+    uint32_t tiles;
+    uint32_t errors;
+    uint64_t bytes;
+    // over the last completed one second window
+    float fps;
+    float bytesPerSecond;
+};
+
+// SerialPackHandler for the `fb` path.
+extern void displayRemoteHandler(const uint8_t* data, size_t size);
+extern bool displayRemoteActive();
+extern DisplayRemoteStats displayRemoteGetStats();
+
 
 #endif // MAIN_INCLUDE_DISPLAY_HPP
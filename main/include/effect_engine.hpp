@@ -0,0 +1,81 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_EFFECT_ENGINE_HPP
+#define MAIN_INCLUDE_EFFECT_ENGINE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Preloaded effects started by a one byte trigger, so host events (damage, explosion, death) get a reaction
+// without a state diff, JSON or bulk transfer on the critical path.
+//
+// Definition (`fx/def` pack): MAGIC | version:u8 | id:u8 | x:i16le | y:i16le | frameCount:u8 | hash:u64le[frameCount] |
+//                              stepCount:u8 | step[stepCount]
+//   step: track:u8 | durationMs:u16le | a:u16le | b:u16le
+//   Steps of one track play back to back, the tracks of an effect play in parallel:
+//    - Tone: a = frequency in Hz (0 is silence), b = duty 0-1023
+//    - Backlight: a = 0 off, 1 on
+//    - Sprite: a = index into the frames (image cache hashes), drawn at x, y; 0xFFFF draws nothing
+//   A definition with no steps removes the effect.
+// Trigger (`fx` pack): id:u8 per effect to start. A running effect restarts.
+constexpr uint8_t EFFECT_MAGIC = 0xC7;
+constexpr uint8_t EFFECT_VERSION = 1;
+constexpr size_t EFFECT_MAX_EFFECTS = 16;
+constexpr size_t EFFECT_MAX_STEPS = 16;
+constexpr size_t EFFECT_MAX_FRAMES = 8;
+constexpr size_t EFFECT_MAX_ACTIVE = 4;
+constexpr uint16_t EFFECT_SPRITE_NONE = 0xFFFF;
+
+enum class EffectTrack : uint8_t {
+    Tone = 0,
+    Backlight = 1,
+    Sprite = 2,
+};
+
+struct EffectStats {
+    uint32_t triggers;
+    uint32_t unknownTriggers;
+    uint32_t definitions;
+    uint32_t rejected;
+    // serial RX to buzzer/backlight output, and to the first frame drawing the sprite
+    uint32_t outputLatencyLastUs;
+    uint32_t outputLatencyMaxUs;
+    uint64_t outputLatencyTotalUs;
+    uint32_t frameSamples;
+    uint32_t frameLatencyLastUs;
+    uint32_t frameLatencyMaxUs;
+    uint64_t frameLatencyTotalUs;
+};
+
+extern void effectInit();
+
+// SerialPackHandlers for `fx/def` and `fx`.
+extern void effectDefinitionHandler(const uint8_t* data, size_t size);
+extern void effectTriggerHandler(const uint8_t* data, size_t size);
+
+// Start effect `id` as if triggered at `triggerUs` (esp_timer time). Any task.
+extern bool effectTrigger(uint8_t id, int64_t triggerUs);
+
+// UI task, while the frame is rendered. Draws the sprite track of every running effect.
+extern void effectDraw();
+
+extern EffectStats effectGetStats();
+
+#endif // MAIN_INCLUDE_EFFECT_ENGINE_HPP
@@ -20,15 +20,41 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MAIN_INCLUDE_EFUSE_HPP
 #define MAIN_INCLUDE_EFUSE_HPP
 
+#include <cstddef>
 #include <cstdint>
 
+#include "include/current_sensor.hpp"
+
 struct LumenConfigValues {
+    // sustained current limit, see trip_engine.hpp; limits are only measurable below CURRENT_SENSOR_FULL_SCALE_MA
     int16_t overcurrentMA;
     int16_t overvoltageMV;
     bool enableAutoFaultRecovery;
     bool turnOffUsb;
     bool overvoltageAlert;
     bool overcurrentAlert;
+    // Also let the INA226 compare every conversion against overcurrentHardMA in hardware. The fast-trip task polls the
+    // latched alert once per conversion cycle and cuts the output itself, before the sample is read out and reaches
+    // the efuse task. Stats on `fault`, see fault_journal.hpp.
+    bool fastTrip;
+    // instantaneous limit, also the fast-trip comparator limit; below CURRENT_SENSOR_FULL_SCALE_MA like overcurrentMA
+    int16_t overcurrentHardMA;
+    // thermal time constant of the sustained limit, 0 trips on the first sample above it
+    int16_t overcurrentTauMS;
+    // INA226 set-up, applied by the efuse task
+    AcquisitionProfile acquisitionProfile;
+    // keep the fault journal in NVS, see fault_journal.hpp
+    bool persistFaults;
+};
+
+struct EfuseFastTripStats {
+    uint32_t trips;
+    // alert register read, seen set, to the output switched off
+    uint32_t lastCutoffUs;
+    uint32_t maxCutoffUs;
+    // one poll of the alert register, the detection delay on top of the conversion time
+    uint32_t lastPollUs;
+    uint32_t maxPollUs;
 };
 
 extern LumenConfigValues LUMEN_CONFIG_VALUES;
@@ -41,4 +67,17 @@ extern bool efuseHasOVP();
 
 extern bool efuseHasFault();
 
+extern EfuseFastTripStats efuseGetFastTripStats();
+
+// `trip` pack: replay a recorded current trace through a separate TripEngine, the live e-fuse is not involved.
+// Request: MAGIC | VERSION | ratedMA:i16 | hardMA:i16 | tauMs:u16, then samples of (dtUs:u32 | currentMA:i16), all
+// little endian. Reply on `trip`: MAGIC | VERSION | status:u8 (0 ok, 1 malformed) | reason:u8 (TripReason) |
+// tripSample:u32 | tripUs:u32 | peakHeat:u16 (1/1000) | samples:u32. tripSample and tripUs count from the first
+// sample; the replay stops at the first trip.
+constexpr uint8_t EFUSE_TRIP_REPLAY_MAGIC = 0xC9;
+constexpr uint8_t EFUSE_TRIP_REPLAY_VERSION = 1;
+
+// SerialPackHandler for `trip`.
+extern void efuseTripReplayHandler(const uint8_t* data, size_t size);
+
 #endif // MAIN_INCLUDE_EFUSE_HPP
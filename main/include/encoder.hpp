@@ -29,6 +29,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <freertos/task.h>
 
 #include <driver/gpio.h>
+#include <esp_log.h>
 #include <esp_timer.h>
 
 #include "pins.hpp"
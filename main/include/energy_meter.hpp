@@ -0,0 +1,57 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_ENERGY_METER_HPP
+#define MAIN_INCLUDE_ENERGY_METER_HPP
+
+#include <cstdint>
+
+// Energy and charge delivered on the USB output, integrated on every current sample whatever the UI shows.
+// Samples are combined with the trapezoidal rule into integer nanojoule and nanocoulomb counters, so nothing is
+// lost to float rounding however long the device runs. The lifetime counters survive a reboot through NVS
+// checkpoints. The session counters start at zero on boot and restart with every session_stats session (output
+// switched back on, a new load, or a `stats` reset request), so they cover the same span as its percentiles.
+
+struct EnergyCounters {
+    float sessionWh;
+    float sessionMAh;
+    float lifetimeWh;
+    float lifetimeMAh;
+};
+
+struct EnergyMeterStats {
+    uint32_t samples;
+    // NVS writes so far, and the ones skipped because too little changed since the last
+    uint32_t checkpoints;
+    uint32_t checkpointsSkipped;
+    uint32_t checkpointErrors;
+};
+
+// Restore the counters from NVS and start integrating. Call after currentSensorInit().
+extern void energyMeterInit();
+
+// Any task.
+extern EnergyCounters energyMeterGet();
+
+// Start a new session. Takes effect on the next sample.
+extern void energyMeterResetSession();
+
+extern EnergyMeterStats energyMeterGetStats();
+
+#endif // MAIN_INCLUDE_ENERGY_METER_HPP
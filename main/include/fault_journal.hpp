@@ -0,0 +1,123 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_FAULT_JOURNAL_HPP
+#define MAIN_INCLUDE_FAULT_JOURNAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "include/current_sensor.hpp"
+
+// Every e-fuse incident as a record: when it tripped, why, how far the output went past the limits and how it
+// ended. The efuse task is the only writer; records sit in a fixed ring of SeqLock slots, so writing one is a
+// bounded copy that never waits for a reader, and readers on any task retry instead of blocking it. A low priority
+// task streams every change on `fault` and, when LumenConfigValues::persistFaults is set, keeps the ring in NVS so
+// incidents survive a reboot.
+
+constexpr size_t FAULT_JOURNAL_CAPACITY = 32;
+
+// bits of FaultRecord::causes, everything seen during the incident
+enum class FaultCause : uint8_t {
+    // the thermal (I2t) model of the sustained limit
+    Thermal = 1U << 0U,
+    // a sample over the instantaneous limit
+    HardLimit = 1U << 1U,
+    // the INA226 alert comparator, cut by the fast-trip task
+    FastTrip = 1U << 2U,
+    Overvoltage = 1U << 3U,
+};
+constexpr size_t FAULT_CAUSE_COUNT = 4;
+
+enum class FaultRecovery : uint8_t {
+    // the output is still off
+    Ongoing = 0,
+    // back on after the auto recovery delay
+    Auto = 1,
+    // the device restarted during the incident
+    Reboot = 2,
+};
+
+struct FaultRecord {
+    // from 1, keeps counting across reboots; 0 marks an empty slot
+    uint32_t id;
+    // FaultJournalStats::boot of the boot it happened in
+    uint16_t boot;
+    uint8_t causes;
+    FaultRecovery recovery;
+    // esp_timer time of the trip in that boot
+    int64_t startUs;
+    // trip to the output back on; up to now while Ongoing
+    uint32_t durationMs;
+    // highest values sampled while the fault condition held
+    float peakMA;
+    float peakMV;
+    // limits in effect at the trip
+    int16_t limitMA;
+    int16_t hardLimitMA;
+    int16_t limitMV;
+};
+
+struct FaultJournalStats {
+    // boots seen by the persisted journal, from 1
+    uint16_t boot;
+    uint32_t nextId;
+    // incidents per FaultCause bit, ever (while persisted)
+    uint32_t causes[FAULT_CAUSE_COUNT];
+    uint32_t saves;
+    uint32_t saveErrors;
+};
+
+// Restore the persisted journal and start the streaming task. Call before the efuse task starts.
+extern void faultJournalInit();
+
+// efuse task only, each call bounded and non-blocking.
+// A new incident, from the sample that tripped it.
+extern void faultJournalOpen(uint8_t causes, const CurrentSensorSample& sample);
+// Another pass with the fault condition present: add causes, raise peaks.
+extern void faultJournalUpdate(uint8_t causes, const CurrentSensorSample& sample);
+// The output is back on.
+extern void faultJournalClose(FaultRecovery recovery);
+
+// Any task. Records with id >= fromId still in the ring, oldest first; returns how many were copied.
+extern size_t faultJournalRead(uint32_t fromId, FaultRecord* out, size_t maxRecords);
+extern FaultJournalStats faultJournalGetStats();
+
+// `fault` pack, request op:u8 then
+//   Read:  fromId:u32le | max:u8, at most FAULT_JOURNAL_MAX_READ records
+//   Stats: nothing
+// Read replies, and Event packs sent on their own whenever a record changes (with count 1):
+//   (op | REPLY):u8 | boot:u16 | nowMs:u32 | nextId:u32 | count:u8 | count * (id:u32 | boot:u16 | causes:u8 |
+//   recovery:u8 | startMs:u32 | durationMs:u32 | peakMA:f32 | peakMV:f32 | limitMA:i16 | hardLimitMA:i16 |
+//   limitMV:i16). nowMs and startMs are esp_timer milliseconds, so the host can date the records of this boot.
+// Stats reply: (op | REPLY):u8 | boot:u16 | nowMs:u32 | nextId:u32 | causes[4]:u32 | saves:u32 | saveErrors:u32 |
+// fastTrips:u32 | lastCutoffUs:u32 | maxCutoffUs:u32 | lastPollUs:u32 | maxPollUs:u32, the last five from
+// EfuseFastTripStats of this boot. All little endian.
+enum class FaultJournalOp : uint8_t {
+    Read = 1,
+    Stats = 2,
+    Event = 3,
+};
+constexpr uint8_t FAULT_JOURNAL_REPLY = 0x80;
+constexpr size_t FAULT_JOURNAL_MAX_READ = 16;
+
+// SerialPackHandler for `fault`.
+extern void faultJournalHandler(const uint8_t* data, size_t size);
+
+#endif // MAIN_INCLUDE_FAULT_JOURNAL_HPP
@@ -0,0 +1,68 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_IMAGE_CACHE_HPP
+#define MAIN_INCLUDE_IMAGE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Content-addressed cache of decoded RGB565 images in the `imgcache` flash partition (see partitions.csv).
+// The partition is split into fixed slots and stays memory-mapped, so a cached image is drawn straight from
+// flash. Images are keyed by the FNV-1a 64 hash of the pack payload they were received in; eviction is least
+// recently used, tracked in RAM and seeded from the write order after boot.
+// Every consumer that keeps a mapped pointer holds a pin on its slot, and a pinned slot is never evicted.
+constexpr uint64_t IMAGE_CACHE_HASH_SEED = 0xCBF29CE484222325ULL;
+constexpr uint8_t IMAGE_CACHE_NO_SLOT = 0xFF;
+
+struct ImageCacheEntry {
+    uint16_t width = 0;
+    uint16_t height = 0;
+    // mapped flash, valid while the entry holds its pin
+    const uint16_t* pixels = nullptr;
+    // the pinned slot, IMAGE_CACHE_NO_SLOT for an entry without a pin
+    uint8_t slot = IMAGE_CACHE_NO_SLOT;
+};
+
+struct ImageCacheStats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t stores;
+    uint32_t evictions;
+    uint8_t slots;
+};
+
+// Find and map the cache partition. Safe to call multiple times; without the partition every lookup misses.
+extern bool imageCacheInit();
+// Look up `hash`, mark it most recently used and pin its slot. The caller releases the entry when it drops the
+// pointer.
+extern bool imageCacheLookup(uint64_t hash, ImageCacheEntry& out);
+// Add a pin for a copy of an entry that is pinned already, e.g. to draw it after leaving a lock. Any task.
+extern void imageCacheRetain(const ImageCacheEntry& entry);
+// Drop the pin of `entry` and clear it. Entries without a pin are left alone. Any task.
+extern void imageCacheRelease(ImageCacheEntry& entry);
+// Write an image to the least recently used slot that is not pinned, failing when every slot is. Blocks for the
+// flash erase and write. Lookups and stores come from the serial pack worker.
+extern bool imageCacheStore(uint64_t hash, uint16_t width, uint16_t height, const uint16_t* pixels);
+extern ImageCacheStats imageCacheGetStats();
+
+// Incremental FNV-1a 64, start with IMAGE_CACHE_HASH_SEED.
+extern uint64_t imageCacheHash(const uint8_t* data, size_t len, uint64_t hash);
+
+#endif // MAIN_INCLUDE_IMAGE_CACHE_HPP
@@ -0,0 +1,67 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_JSON_ARENA_HPP
+#define MAIN_INCLUDE_JSON_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <cJSON.h>
+
+// cJSON allocations are served from a static bump arena that is rewound after every message, so parsing does
+// not touch the general heap. Allocations that do not fit fall back to malloc and are counted. The arena is
+// process wide: cJSON must only be used from one task at a time.
+constexpr size_t JSON_ARENA_SIZE = 1024 * 4;
+
+struct JsonArenaStats {
+    uint32_t messages;
+    uint32_t arenaAllocations;
+    uint32_t heapAllocations;
+    // heap allocations made while parsing the most recent message
+    uint32_t lastMessageHeapAllocations;
+    size_t highWater;
+};
+
+// Install the cJSON hooks. Safe to call multiple times.
+extern void jsonArenaInit();
+// Release everything allocated since the previous reset. Call after cJSON_Delete of the message tree.
+extern void jsonArenaReset();
+
+extern JsonArenaStats jsonArenaGetStats();
+
+enum class JsonFieldType : uint8_t {
+    String,
+    Float,
+    Bool,
+};
+
+struct JsonSchemaField {
+    const char* key;
+    JsonFieldType type;
+    // destination inside the output struct, char[capacity] for String, float for Float, bool for Bool
+    size_t offset;
+    size_t capacity;
+};
+
+// Walk the members of `object` once and copy every member named in `schema` into `out`.
+// Returns a mask with bit i set when schema[i] was found with the expected type.
+extern uint32_t jsonExtract(const cJSON* object, const JsonSchemaField* schema, size_t count, void* out);
+
+#endif // MAIN_INCLUDE_JSON_ARENA_HPP
@@ -0,0 +1,89 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_LATENCY_TRACE_HPP
+#define MAIN_INCLUDE_LATENCY_TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// End-to-end latency of serial packs, from the host sending them to the first frame presented after their
+// handler finished. Every pack is traced through arrival (RX burst), handler done (worker) and presentation
+// (displayFrameRender or a remote framebuffer flush). Packs preceded by a Stamp frame also carry the host send
+// time, which is mapped onto esp_timer time with the offset from the `time` exchange:
+//  - host -> `time`: Probe | hostUs:u64le, answered on `time` with Probe | hostUs | deviceRxUs:u64le |
+//    deviceTxUs:u64le. The host computes offset (device - host) and round trip NTP style and picks the probe
+//    with the shortest round trip.
+//  - host -> `time`: Set | offsetUs:i64le | rttUs:u32le, applied to every later stamp.
+// A pack on `latency` is answered on `latency` with a LatencyReport: version:u8 | synced:u8 | offsetUs:i64le |
+// rttUs:u32le | stage[LatencyStage::Count] { count:u32le | p50 | p90 | p99 | max (u32le, us) } | dropped:u32le.
+constexpr uint8_t LATENCY_NO_TRACE = 0xFF;
+constexpr size_t LATENCY_MAX_TRACES = 16;
+constexpr size_t LATENCY_WINDOW = 128;
+constexpr uint8_t LATENCY_REPORT_VERSION = 1;
+
+enum class LatencyTimeKind : uint8_t {
+    Probe = 0,
+    Set = 1,
+};
+
+enum class LatencyStage : uint8_t {
+    // host send to arrival, stamped packs with a synced clock only
+    Link = 0,
+    // arrival to handler done, includes the worker queue
+    Handle = 1,
+    // handler done to the frame being presented
+    Present = 2,
+    // host send to presentation, stamped packs with a synced clock only
+    EndToEnd = 3,
+    Count = 4,
+};
+
+struct LatencyPercentiles {
+    uint32_t count;
+    uint32_t p50Us;
+    uint32_t p90Us;
+    uint32_t p99Us;
+    uint32_t maxUs;
+};
+
+struct LatencyReport {
+    bool synced;
+    int64_t offsetUs;
+    uint32_t rttUs;
+    // percentiles over the last LATENCY_WINDOW samples of each stage
+    LatencyPercentiles stages[static_cast<size_t>(LatencyStage::Count)];
+    uint32_t droppedTraces;
+};
+
+// Serial parser. Start tracing a completed pack; `hostSendUs` is 0 when the pack was not stamped.
+extern uint8_t latencyTraceBegin(const char* path, int64_t hostSendUs, int64_t arrivalUs);
+// Serial worker, around the end-of-pack call of the handler. A handler that presents a frame itself (the remote
+// framebuffer) completes its trace right away.
+extern void latencyTraceHandled(uint8_t trace, int64_t startUs, int64_t doneUs);
+// Whoever pushed a frame to the panel, once it is sent.
+extern void latencyFramePresented(int64_t presentUs);
+
+// SerialPackHandlers for `time` and `latency`.
+extern void latencyTimeHandler(const uint8_t* data, size_t size);
+extern void latencyReportHandler(const uint8_t* data, size_t size);
+
+extern LatencyReport latencyGetReport();
+
+#endif // MAIN_INCLUDE_LATENCY_TRACE_HPP
@@ -0,0 +1,73 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_LZ4_STREAM_HPP
+#define MAIN_INCLUDE_LZ4_STREAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Match offsets may not reach further back than this. Encoders have to be told (see script/serial_pack.py).
+constexpr size_t LZ4_STREAM_WINDOW = 1024;
+
+static_assert((LZ4_STREAM_WINDOW & (LZ4_STREAM_WINDOW - 1)) == 0, "window must be a power of two");
+
+// Decoder for one LZ4 block fed in arbitrary pieces. Output is produced into the window ring and handed to the
+// sink in contiguous slices, so memory use is the window no matter how large the block is.
+class Lz4StreamDecoder {
+public:
+    using Sink = void (*)(const uint8_t* data, size_t len, void* context);
+
+    void reset();
+    // Returns false on malformed input; the decoder then ignores everything until reset().
+    bool feed(const uint8_t* data, size_t len, Sink sink, void* context);
+    // Flush pending output. Returns false unless the block ended on a sequence boundary.
+    bool finish(Sink sink, void* context);
+
+    [[nodiscard]] uint32_t produced() const {
+        return total;
+    }
+
+private:
+    enum class State : uint8_t {
+        Token,
+        LiteralLength,
+        Literals,
+        Offset0,
+        Offset1,
+        MatchLength,
+        Failed,
+    };
+
+    void put(uint8_t byte, Sink sink, void* context);
+    void flush(Sink sink, void* context);
+    void copyMatch(Sink sink, void* context);
+
+    uint8_t window[LZ4_STREAM_WINDOW] = {};
+    size_t pos = 0;
+    size_t flushed = 0;
+    uint32_t total = 0;
+    State state = State::Token;
+    uint8_t token = 0;
+    uint32_t literalLen = 0;
+    uint32_t matchLen = 0;
+    uint16_t offset = 0;
+};
+
+#endif // MAIN_INCLUDE_LZ4_STREAM_HPP
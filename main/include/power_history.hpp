@@ -0,0 +1,83 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_POWER_HISTORY_HPP
+#define MAIN_INCLUDE_POWER_HISTORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed memory history of the output voltage, current and power for graphs.
+// The newest samples are kept as they are; above them a pyramid of levels keeps one point per 1 s, 10 s, 1 min and
+// 10 min with the min, max and average of that bucket. Each level is fed the closed buckets of the one below, so a
+// sample costs O(1) and a query only copies the points it returns.
+
+enum class HistoryResolution : uint8_t {
+    Raw = 0,
+    Second = 1,
+    TenSeconds = 2,
+    Minute = 3,
+    TenMinutes = 4,
+    Count = 5,
+};
+
+enum class HistoryChannel : uint8_t {
+    VoltageMV = 0,
+    CurrentMA = 1,
+    PowerMW = 2,
+    Count = 3,
+};
+
+constexpr size_t HISTORY_CHANNELS = static_cast<size_t>(HistoryChannel::Count);
+constexpr size_t HISTORY_RAW_POINTS = 256;
+constexpr size_t HISTORY_LEVEL_POINTS = 120;
+
+// One bucket; arrays are indexed by HistoryChannel. A raw point has min == max == avg and count 1. A bucket without
+// samples (the sensor was not sampling) has count 0 and zero values.
+struct HistoryPoint {
+    int16_t min[HISTORY_CHANNELS];
+    int16_t max[HISTORY_CHANNELS];
+    int16_t avg[HISTORY_CHANNELS];
+    uint16_t count;
+};
+
+// Start recording. Call after currentSensorInit().
+extern void powerHistoryInit();
+
+// Width of one point at `resolution`.
+extern int64_t powerHistoryPeriodUs(HistoryResolution resolution);
+
+// Copy the newest closed points at `resolution` into `out`, oldest first, and return how many were copied (at most
+// `maxPoints`). `newestEndUs`, if given, receives the esp_timer time at which the newest point ends. Any task.
+extern size_t powerHistoryQuery(
+        HistoryResolution resolution,
+        HistoryPoint* out,
+        size_t maxPoints,
+        int64_t* newestEndUs
+);
+
+// `hist` pack: request resolution:u8 | count:u16le. Reply on `hist`: resolution:u8 | count:u16le | periodMs:u32le |
+// ageMs:u32le (from the end of the newest point to now), then `count` points oldest first, each min[3] | max[3] |
+// avg[3] as i16le in HistoryChannel order and count:u16le. At most HISTORY_MAX_REPLY_POINTS per reply.
+constexpr size_t HISTORY_MAX_REPLY_POINTS = 128;
+
+// SerialPackHandler for `hist`.
+extern void powerHistoryHandler(const uint8_t* data, size_t size);
+
+#endif // MAIN_INCLUDE_POWER_HISTORY_HPP
@@ -0,0 +1,75 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_SEQLOCK_HPP
+#define MAIN_INCLUDE_SEQLOCK_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Publication of a small value from one writer task to any number of reader tasks. Unlike Snapshot, readers
+// copy the value, so there is no per-reader slot; a read that overlaps a write simply retries.
+// The writer stores inside a critical section, so a reader preempting it on the same core never spins on a write
+// that cannot finish.
+template<typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable_v<T>, "readers copy the value while it may be rewritten");
+
+public:
+    // Writer only.
+    void write(const T& value) {
+        taskENTER_CRITICAL(&lock);
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        data = value;
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        taskEXIT_CRITICAL(&lock);
+    }
+
+    // Any task. The newest value, or a default constructed T before the first write.
+    T read() const {
+        while (true) {
+            const uint32_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1U) {
+                continue;
+            }
+            T value = data;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                return value;
+            }
+        }
+    }
+
+    // Number of writes so far, any task.
+    [[nodiscard]] uint32_t written() const {
+        return sequence.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+    std::atomic<uint32_t> sequence{0};
+    T data = {};
+};
+
+#endif // MAIN_INCLUDE_SEQLOCK_HPP
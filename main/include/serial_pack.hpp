@@ -23,16 +23,99 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <cstddef>
 #include <cstdint>
 
+// Called with each piece of a pack, then once with (nullptr, 0) at its end. A pack that never completes (sender
+// abort, rx timeout, broken framing) also ends with (nullptr, 0) and serialPackAborted() set: its data is
+// incomplete and whatever the handler reassembled should be dropped.
 using SerialPackHandler = void (*)(const uint8_t* data, size_t currentSize);
 
+// Two framings share the link:
+//  - legacy pack: "<path>\n" | size:u32le | data[size], occupies the stream until complete.
+//  - multiplexed frame: MAGIC | channel:u8 | type:u8 | length:u16le | payload[length].
+//    An Open frame (priority:u8 | size:u32le | path) binds a path to a channel, Data frames then carry the
+//    pack in pieces until `size` bytes arrived. Packs on different channels interleave at frame granularity,
+//    so the sender can preempt a bulk upload with a small high-priority pack.
+//    OpenLz4 has the same payload and marks the pack as one LZ4 block of `size` bytes with match offsets of at
+//    most LZ4_STREAM_WINDOW. It is inflated as it streams in, handlers only ever see the original bytes.
+//    A Stamp frame (hostUs:u64le, the host clock when the pack was sent) right before an Open tags that pack for
+//    end-to-end latency tracing (see latency_trace.hpp).
+constexpr uint8_t SERIAL_PACK_FRAME_MAGIC = 0xA5;
+constexpr size_t SERIAL_PACK_FRAME_HEADER_LEN = 4;
+constexpr size_t SERIAL_PACK_MAX_CHANNELS = 4;
+constexpr size_t SERIAL_PACK_MAX_FRAME_LEN = 1024;
+
+enum class SerialPackFrameType : uint8_t {
+    Open = 1,
+    Data = 2,
+    Abort = 3,
+    OpenLz4 = 4,
+    Stamp = 5,
+};
+
+// Handlers do not run on the parser task: received data is copied into one of SERIAL_PACK_POOL_BUFFERS pooled
+// buffers and queued to a worker task that calls the handler. When every buffer is in use the parser waits for the
+// worker (and the driver RX buffer absorbs the link) instead of dropping data right away.
+// A piece still without a buffer or queue slot after SERIAL_PACK_POOL_WAIT_MS is dropped and fails its pack: the
+// handler gets none of the rest and an aborted end. An end that finds its lane full is queued later by the parser
+// task, ahead of any later data for the same handler.
+constexpr size_t SERIAL_PACK_POOL_BUFFERS = 6;
+constexpr size_t SERIAL_PACK_POOL_BUFFER_LEN = 1024;
+constexpr uint32_t SERIAL_PACK_POOL_WAIT_MS = 1000;
+
+// The worker keeps one queue per lane and always serves the highest lane with work, so a control pack queued
+// behind bulk chunks runs next. A pack's lane is its Open frame priority / SERIAL_PACK_PRIORITY_STEP (capped),
+// legacy packs use lane 0. Within a lane handlers run in arrival order.
+constexpr size_t SERIAL_PACK_PRIORITY_LANES = 3;
+constexpr uint8_t SERIAL_PACK_PRIORITY_STEP = 8;
+
+// A pack on `link` is answered on `link` with the counters below: version:u8 | chunksQueued:u32le |
+// bytesQueued:u32le | poolStalls:u32le | poolStallUs:u64le | chunksDropped:u32le | queueHighWater:u32le |
+// packsFailed:u32le | endsDeferred:u32le | compressedPacks:u32le | compressedBytes:u64le | inflatedBytes:u64le |
+// inflateCycles:u64le.
+constexpr uint8_t SERIAL_PACK_LINK_VERSION = 1;
+
+struct SerialPackStats {
+    uint32_t chunksQueued;
+    uint32_t bytesQueued;
+    // the parser found no free buffer and had to wait for the worker
+    uint32_t poolStalls;
+    uint64_t poolStallUs;
+    // pieces lost because the worker did not take them within SERIAL_PACK_POOL_WAIT_MS, and the packs they failed
+    uint32_t chunksDropped;
+    uint32_t queueHighWater;
+    uint32_t packsFailed;
+    // ends queued late because their lane was full
+    uint32_t endsDeferred;
+    uint32_t compressedPacks;
+    // wire and inflated size of all compressed packs, and the CPU cycles spent inflating them
+    uint64_t compressedBytes;
+    uint64_t inflatedBytes;
+    uint64_t inflateCycles;
+};
+
 // Initialize USB Serial/TAG driver and internal handler table. Safe to call multiple times.
 extern void serialPackInit();
 // Start the FreeRTOS task that parses incoming serial packs.
 extern void serialPackStart();
-// Stop the parsing task (driver remains initialized).
+// Park the parsing task until the next start (driver remains initialized). The burst already read from the driver
+// is parsed first, later bytes wait in the driver RX buffer.
 extern void serialPackStop();
 
-// Register or replace a handler for a given path. Call after init and before start.
+// Register or replace a handler for a given path. Any task after init, also while the parser runs.
 extern void serialPackAttachHandler(const char* path, SerialPackHandler handler);
 
+// Send a pack to the host as multiplexed frames (Open then Data) on SERIAL_PACK_TX_CHANNEL. The host finds them
+// in the console stream by the frame magic. Safe to call from any task once initialized.
+constexpr uint8_t SERIAL_PACK_TX_CHANNEL = 0;
+extern bool serialPackSend(const char* path, const uint8_t* data, size_t len);
+
+extern SerialPackStats serialPackGetStats();
+// SerialPackHandler for `link`.
+extern void serialPackLinkHandler(const uint8_t* data, size_t size);
+
+// Handlers only. esp_timer time at which the data being handled was read from the driver, for measuring latency
+// from arrival rather than from the worker picking it up.
+extern int64_t serialPackRxTime();
+// Handlers only, at the end of a pack. The pack was cut short, see SerialPackHandler.
+extern bool serialPackAborted();
+
 #endif // MAIN_INCLUDE_SERIAL_PACK_HPP
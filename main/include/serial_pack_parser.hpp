@@ -0,0 +1,170 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_SERIAL_PACK_PARSER_HPP
+#define MAIN_INCLUDE_SERIAL_PACK_PARSER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "include/lz4_stream.hpp"
+#include "include/serial_pack.hpp"
+
+// The framing state machine of serial_pack.hpp without the driver, tasks or logging, so it builds for any target.
+// Bytes come from a SerialPackSource, results and diagnostics go to a SerialPackSink.
+
+// A partially received pack or frame is dropped when nothing arrived for this long.
+constexpr int64_t SERIAL_PACK_RX_TIMEOUT_US = 3 * 1000 * 1000;
+constexpr size_t SERIAL_PACK_MAX_PATH_LEN = 16;
+constexpr uint32_t SERIAL_PACK_WAIT_FOREVER = UINT32_MAX;
+
+enum class SerialPackParseEvent : uint8_t {
+    // legacy framing
+    LegacyPath,
+    InvalidPath,
+    PathTooLong,
+    PackTimeout,
+    // multiplexed frames; `channel` is the frame's channel
+    FrameTooLong,
+    FrameTimeout,
+    UnknownChannel,
+    UnknownFrameType,
+    InvalidOpen,
+    InvalidChannelPath,
+    Opened,
+    Reopened,
+    DataWithoutOpen,
+    FrameOverrun,
+    CorruptLz4,
+    InvalidStamp,
+    Aborted,
+    ChannelTimeout,
+};
+
+class SerialPackSource {
+public:
+    virtual ~SerialPackSource() = default;
+    // Wait up to `timeoutMs` for data and return how many bytes were read into `data`, 0 on timeout.
+    virtual size_t read(uint8_t* data, size_t len, uint32_t timeoutMs) = 0;
+};
+
+class SerialPackSink {
+public:
+    virtual ~SerialPackSink() = default;
+    // Whether packs on `path` are wanted. Data of unwanted packs goes to unhandledData instead of packData.
+    virtual bool accepts(const char* path) = 0;
+    // Original (inflated) bytes of a pack, in order and in pieces of at most SERIAL_PACK_POOL_BUFFER_LEN.
+    // `priority` is the channel priority from the Open frame, 0 for legacy packs.
+    virtual void packData(const char* path, uint8_t priority, const uint8_t* data, size_t len) = 0;
+    virtual void unhandledData(const char* path, const uint8_t* data, size_t len, bool truncated) = 0;
+    // The pack is complete. `hostUs` is its Stamp (0 without one), `arrivalUs` when its first byte arrived.
+    virtual void packEnd(const char* path, uint8_t priority, int64_t hostUs, int64_t arrivalUs) = 0;
+    // A pack that was (partly) delivered through packData will never complete: the sender aborted it, it timed
+    // out, or its channel was reopened, overrun or carried corrupt LZ4 data. The matching event is still reported.
+    virtual void packAborted(const char* path, uint8_t priority) = 0;
+    // An LZ4 pack is complete. `cycles` excludes the time spent in packData.
+    virtual void inflated(const char* path, uint32_t wireBytes, uint32_t inflatedBytes, uint32_t cycles) = 0;
+    // Diagnostics; `path` may be empty and `value` is a length, size or frame type depending on the event.
+    virtual void event(SerialPackParseEvent event, uint8_t channel, const char* path, uint32_t value) = 0;
+    // Free running cycle counter for inflate accounting; 0 disables it.
+    virtual uint32_t cycleCount() {
+        return 0;
+    }
+};
+
+class SerialPackParser {
+public:
+    explicit SerialPackParser(SerialPackSink& output) : sink(output) {}
+
+    void reset();
+    // Parse bytes that arrived at `now`.
+    void feed(const uint8_t* bytes, size_t len, int64_t now);
+    // Drop whatever has been partially received, channels only once they are idle for SERIAL_PACK_RX_TIMEOUT_US.
+    void expire(int64_t now);
+    // A pack or frame is half received.
+    [[nodiscard]] bool pending() const;
+
+private:
+    struct Channel {
+        char path[SERIAL_PACK_MAX_PATH_LEN];
+        uint32_t remaining;
+        uint8_t priority;
+        bool open;
+        int64_t lastRxUs;
+        // LZ4 packs: `remaining` counts wire bytes, the decoder of the same index inflates them
+        bool compressed;
+        uint32_t wireSize;
+        uint32_t inflateCycles;
+        // host send time from a Stamp frame, waiting for the next Open and then carried by the open pack
+        uint64_t stampUs;
+        int64_t hostUs;
+        int64_t arrivalUs;
+    };
+
+    struct InflateContext {
+        SerialPackParser* parser;
+        const char* path;
+        uint8_t priority;
+        uint32_t dispatchCycles;
+    };
+
+    static void inflateSink(const uint8_t* data, size_t len, void* context);
+
+    void handleByte(uint8_t byte);
+    void handleFrameByte(uint8_t byte);
+    void resetLegacy();
+    void dispatchFrame();
+    void openChannel(uint8_t id, bool compressed);
+    void channelData(uint8_t id);
+    void stampChannel(uint8_t id);
+    bool inflateFrame(uint8_t id, Channel& channel);
+    void finishChannel(Channel& channel);
+    void abortChannel(Channel& channel);
+    void closeChannel(Channel& channel);
+
+    SerialPackSink& sink;
+    int64_t nowUs = 0;
+
+    // legacy pack
+    char path[SERIAL_PACK_MAX_PATH_LEN] = {};
+    size_t pathLen = 0;
+    bool inData = false;
+    bool discardUntilNewline = false;
+    uint8_t sizeBytes[sizeof(uint32_t)] = {};
+    size_t sizeIndex = 0;
+    uint32_t remaining = 0;
+    int64_t packStartUs = 0;
+
+    // multiplexed frame
+    bool inFrame = false;
+    uint8_t frameHeader[SERIAL_PACK_FRAME_HEADER_LEN] = {};
+    size_t frameHeaderLen = 0;
+    size_t frameLen = 0;
+
+    // the legacy pack chunk or the frame payload being collected
+    uint8_t data[SERIAL_PACK_POOL_BUFFER_LEN] = {};
+    size_t dataLen = 0;
+
+    Channel channels[SERIAL_PACK_MAX_CHANNELS] = {};
+    Lz4StreamDecoder decoders[SERIAL_PACK_MAX_CHANNELS];
+};
+
+static_assert(SERIAL_PACK_MAX_FRAME_LEN <= SERIAL_PACK_POOL_BUFFER_LEN, "frame payload shares the pack data buffer");
+
+#endif // MAIN_INCLUDE_SERIAL_PACK_PARSER_HPP
@@ -0,0 +1,83 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_SESSION_STATS_HPP
+#define MAIN_INCLUDE_SESSION_STATS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Distribution of the output current and power over one plug-in session, fed from every current sample.
+// A session starts when the output is switched back on, when a load appears after SESSION_STATS_IDLE_US without
+// one, or on request. Only samples with a load on an enabled output count, so idle time does not pull the
+// percentiles down. Every new session also restarts the energy meter's session counters.
+
+constexpr float SESSION_STATS_LOAD_MA = 2.0F;
+constexpr int64_t SESSION_STATS_IDLE_US = 2 * 1000 * 1000;
+
+struct SessionChannelStats {
+    float mean;
+    float stddev;
+    float p50;
+    float p95;
+    float p99;
+    float peak;
+    // esp_timer time of the peak
+    int64_t peakUs;
+};
+
+struct SessionStats {
+    uint32_t samples;
+    // esp_timer time the session started, 0 before the first one
+    int64_t startUs;
+    SessionChannelStats currentMA;
+    SessionChannelStats powerMW;
+};
+
+// Start collecting. Call after currentSensorInit().
+extern void sessionStatsInit();
+
+// Any task.
+extern SessionStats sessionStatsGet();
+
+// Start a new session. Takes effect on the next sample.
+extern void sessionStatsReset();
+
+// UI task. Whether the session view is switched on, and drawing it: percentiles and peak of current and power, and
+// the session energy. It shares the sync page like the other host-switched views.
+extern bool sessionStatsViewActive();
+extern void sessionStatsDraw();
+
+// `stats` pack, request op:u8 then
+//   Read, Reset: nothing. A reset is answered once the sampler has run on the new session.
+//   Show: on:u8, the session view on the sync page
+// Reply on `stats`: VERSION | samples:u32 | ageMs:u32 (since the session started), then for current (mA) and power
+// (mW) in order: mean | stddev | p50 | p95 | p99 | peak as f32 and peakAgeMs:u32, then the session energy Wh:f32 |
+// mAh:f32, all little endian.
+enum class SessionStatsOp : uint8_t {
+    Read = 0,
+    Reset = 1,
+    Show = 2,
+};
+constexpr uint8_t SESSION_STATS_VERSION = 2;
+
+// SerialPackHandler for `stats`.
+extern void sessionStatsHandler(const uint8_t* data, size_t size);
+
+#endif // MAIN_INCLUDE_SESSION_STATS_HPP
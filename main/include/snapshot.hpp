@@ -0,0 +1,68 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_SNAPSHOT_HPP
+#define MAIN_INCLUDE_SNAPSHOT_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free publication of a value from one writer task to one reader task (triple buffer).
+// The writer fills back() off to the side and publish() swaps it in with a single atomic exchange. The reader's
+// acquire() swaps out the newest published slot and keeps it until its next acquire(), so it never blocks, never
+// copies and never sees a half-written value. Neither side ever waits for the other.
+template<typename T>
+class Snapshot {
+public:
+    // Writer only. The slot holds an older version, anything the next version shares with it must be rewritten.
+    T& back() {
+        return slots[backIndex];
+    }
+
+    // Writer only. Make back() the newest version and hand the writer a free slot.
+    void publish() {
+        backIndex = middle.exchange(backIndex | K_FRESH, std::memory_order_acq_rel) & K_INDEX_MASK;
+        sequence.fetch_add(1, std::memory_order_release);
+    }
+
+    // Reader only. The newest published value, or a default constructed T before the first publish.
+    const T& acquire() {
+        if (middle.load(std::memory_order_relaxed) & K_FRESH) {
+            frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & K_INDEX_MASK;
+        }
+        return slots[frontIndex];
+    }
+
+    // Number of publishes so far, any task.
+    [[nodiscard]] uint32_t published() const {
+        return sequence.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr uint8_t K_INDEX_MASK = 0x3;
+    static constexpr uint8_t K_FRESH = 0x4;
+
+    T slots[3] = {};
+    uint8_t backIndex = 0;
+    std::atomic<uint8_t> middle{1};
+    uint8_t frontIndex = 2;
+    std::atomic<uint32_t> sequence{0};
+};
+
+#endif // MAIN_INCLUDE_SNAPSHOT_HPP
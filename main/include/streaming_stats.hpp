@@ -0,0 +1,102 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_STREAMING_STATS_HPP
+#define MAIN_INCLUDE_STREAMING_STATS_HPP
+
+#include <cstdint>
+
+// Constant memory estimators over a stream of readings, without hardware access.
+
+// Mean and sample variance by Welford's method, in double so a long session does not lose the small deltas.
+class RunningStats {
+public:
+    void reset();
+    void add(double value);
+
+    [[nodiscard]] uint32_t count() const {
+        return samples;
+    }
+    [[nodiscard]] double mean() const {
+        return average;
+    }
+    [[nodiscard]] double variance() const;
+    [[nodiscard]] double stddev() const;
+
+private:
+    uint32_t samples = 0;
+    double average = 0;
+    double squares = 0;
+};
+
+// One quantile by the P-square algorithm (Jain and Chlamtac, 1985): five markers whose heights follow the
+// quantile, adjusted with a parabolic fit as samples arrive. Exact for the first five samples.
+class P2Quantile {
+public:
+    explicit P2Quantile(float quantile);
+
+    void reset();
+    void add(float value);
+    [[nodiscard]] float value() const;
+
+private:
+    static constexpr int K_MARKERS = 5;
+
+    [[nodiscard]] float parabolic(int i, float direction) const;
+    [[nodiscard]] float linear(int i, int direction) const;
+
+    float p;
+    uint32_t samples = 0;
+    float heights[K_MARKERS] = {};
+    int32_t positions[K_MARKERS] = {};
+    float desired[K_MARKERS] = {};
+    float increments[K_MARKERS] = {};
+};
+
+// The largest reading and when it was taken.
+class PeakHold {
+public:
+    void reset() {
+        held = false;
+        peak = 0;
+        peakUs = 0;
+    }
+
+    void add(const float value, const int64_t timestampUs) {
+        if (!held || value > peak) {
+            held = true;
+            peak = value;
+            peakUs = timestampUs;
+        }
+    }
+
+    [[nodiscard]] float value() const {
+        return peak;
+    }
+    [[nodiscard]] int64_t timestampUs() const {
+        return peakUs;
+    }
+
+private:
+    bool held = false;
+    float peak = 0;
+    int64_t peakUs = 0;
+};
+
+#endif // MAIN_INCLUDE_STREAMING_STATS_HPP
@@ -0,0 +1,79 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_SYNC_CODEC_HPP
+#define MAIN_INCLUDE_SYNC_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary sync record: MAGIC | version:u8 | { tag:u8 | len:u8 | value[len] }*
+// Values are little endian, health fields are hundredths of a health point. Unknown tags are skipped so the
+// host can add fields without breaking older firmware. Anything not starting with MAGIC is parsed as JSON.
+// Either encoding is a patch: fields that are left out keep their current value on the device.
+constexpr uint8_t SYNC_BINARY_MAGIC = 0xC5;
+constexpr uint8_t SYNC_BINARY_VERSION = 1;
+constexpr size_t SYNC_NAME_MAX = 32;
+
+enum class SyncMode : uint8_t {
+    Creative = 0,
+    Survival = 1,
+    Spectator = 2,
+    Adventure = 3,
+    None = 4,
+};
+
+enum class SyncField : uint8_t {
+    Mode = 1,
+    Name = 2,
+    Health = 3,
+    MaxHealth = 4,
+};
+
+struct SyncPlayerState {
+    // bit (1 << SyncField) is set for every field carried by the message
+    uint8_t present;
+    SyncMode mode;
+    char name[SYNC_NAME_MAX];
+    float health;
+    float maxHealth;
+
+    [[nodiscard]] bool has(SyncField field) const {
+        return present & (1U << static_cast<uint8_t>(field));
+    }
+};
+
+struct SyncCodecStats {
+    uint32_t binaryMessages;
+    uint32_t jsonMessages;
+    uint32_t rejectedMessages;
+    uint64_t binaryBytes;
+    uint64_t jsonBytes;
+    uint64_t binaryDecodeUs;
+    uint64_t jsonDecodeUs;
+};
+
+// Decode a sync message in either encoding into `out`. Returns false if the message is malformed.
+extern bool syncDecode(const uint8_t* data, size_t size, SyncPlayerState& out);
+
+extern SyncMode syncModeFromName(const char* name, size_t len);
+
+extern SyncCodecStats syncCodecGetStats();
+
+#endif // MAIN_INCLUDE_SYNC_CODEC_HPP
@@ -0,0 +1,119 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_SYNCED_STATE_HPP
+#define MAIN_INCLUDE_SYNCED_STATE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "include/snapshot.hpp"
+
+constexpr size_t SYNCED_STATE_MAX_FIELDS = 16;
+constexpr size_t SYNCED_STATE_STRING_MAX = 32;
+constexpr size_t SYNCED_STATE_MAX_LISTENERS = 4;
+
+constexpr uint32_t syncedFieldBit(const uint8_t field) {
+    return 1U << field;
+}
+
+// One published version of a SyncedStore. Readers get it from SyncedStore::acquire() and it does not change
+// under them.
+class SyncedFields {
+public:
+    [[nodiscard]] int32_t getInt(uint8_t field) const;
+    [[nodiscard]] float getFloat(uint8_t field) const;
+    [[nodiscard]] const char* getString(uint8_t field) const;
+    [[nodiscard]] bool has(uint8_t field) const;
+
+    [[nodiscard]] uint32_t version() const;
+    [[nodiscard]] uint32_t fieldVersion(uint8_t field) const;
+    // Mask of fields committed after `since`, which is advanced to this version.
+    uint32_t changesSince(uint32_t& since) const;
+
+private:
+    friend class SyncedStore;
+
+    enum class Type : uint8_t {
+        Unset,
+        Int,
+        Float,
+        String,
+    };
+
+    struct Field {
+        Type type;
+        uint32_t version;
+        union {
+            int32_t i;
+            float f;
+            char s[SYNCED_STATE_STRING_MAX];
+        };
+    };
+
+    Field fields[SYNCED_STATE_MAX_FIELDS] = {};
+    uint32_t currentVersion = 0;
+};
+
+// Host-synced key/value state of one page. The writer applies patches field by field; only values that really
+// change get a new version, and commit() publishes them as one version step through a Snapshot, so the reader
+// task always sees a complete version without locking. Readers either poll changesSince() or register a
+// listener, so they can skip work when nothing they use has changed.
+class SyncedStore {
+public:
+    using Listener = void (*)(uint32_t changed, void* context);
+
+    // Writer task only.
+    bool setInt(uint8_t field, int32_t value);
+    bool setFloat(uint8_t field, float value);
+    bool setString(uint8_t field, const char* value, size_t len);
+
+    // Writer task only. Publish everything set since the previous commit and notify listeners from the writer
+    // task. Returns the mask of changed fields.
+    uint32_t commit();
+
+    // Reader task only (one reader). Valid until the next acquire().
+    const SyncedFields& acquire();
+
+    // Any task.
+    [[nodiscard]] uint32_t version() const;
+
+    bool addListener(Listener listener, uint32_t mask, void* context);
+
+private:
+    using Field = SyncedFields::Field;
+    using Type = SyncedFields::Type;
+
+    struct ListenerEntry {
+        Listener listener;
+        uint32_t mask;
+        void* context;
+    };
+
+    Field* writable(uint8_t field, Type type);
+
+    // the writer's working copy, published as a whole on commit
+    SyncedFields working;
+    uint32_t pending = 0;
+    Snapshot<SyncedFields> published;
+    ListenerEntry listeners[SYNCED_STATE_MAX_LISTENERS] = {};
+    size_t listenerCount = 0;
+};
+
+#endif // MAIN_INCLUDE_SYNCED_STATE_HPP
@@ -0,0 +1,108 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_TRANSIENT_CAPTURE_HPP
+#define MAIN_INCLUDE_TRANSIENT_CAPTURE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Triggered recording of the output current at the INA226's fastest conversion time, to see inrush and short
+// spikes the sampler cannot. While armed, a task reads the shunt register back to back into a RAM ring (a few
+// kHz, bounded by the I2C transfers), keeps `preSamples` before the trigger and fills the rest after it, then
+// restores the acquisition profile. The task blocks in every transfer and sits below the sampler and the
+// fast-trip poll, which take the bus between its reads, so e-fuse protection runs unchanged during a capture.
+
+constexpr size_t CAPTURE_SAMPLES = 1024;
+// stored current resolution
+constexpr float CAPTURE_LSB_MA = 0.1F;
+
+enum class CaptureTrigger : uint8_t {
+    // current at or above the threshold
+    Level = 0,
+    // current rising by at least the threshold from one sample to the next
+    Rise = 1,
+};
+
+enum class CaptureState : uint8_t {
+    Idle = 0,
+    Armed = 1,
+    Done = 2,
+    TimedOut = 3,
+    Cancelled = 4,
+};
+
+struct CaptureSettings {
+    CaptureTrigger trigger;
+    float thresholdMA;
+    uint16_t preSamples;
+    uint32_t timeoutMs;
+};
+
+struct CaptureInfo {
+    CaptureState state;
+    // valid once Done
+    uint16_t samples;
+    uint16_t triggerIndex;
+    uint32_t spanUs;
+    float minMA;
+    float maxMA;
+};
+
+struct CaptureSample {
+    // time relative to the trigger sample
+    int32_t offsetUs;
+    // in CAPTURE_LSB_MA
+    int16_t current;
+};
+
+extern void transientCaptureInit();
+
+// Start waiting for the trigger. False while a capture is armed or without a sensor.
+extern bool transientCaptureArm(const CaptureSettings& settings);
+extern void transientCaptureCancel();
+extern CaptureInfo transientCaptureGetInfo();
+// Copy samples [first, first + count) of a finished capture, returns how many were copied.
+extern size_t transientCaptureRead(size_t first, CaptureSample* out, size_t count);
+
+// UI task. Whether the scope view is switched on and has a capture to show, and drawing it.
+extern bool transientCaptureViewActive();
+extern void transientCaptureDraw();
+
+// `cap` pack, request op:u8 then
+//   Arm:    trigger:u8 | thresholdMA:i16le | preSamples:u16le | timeoutMs:u32le
+//   Status, Cancel: nothing
+//   Read:   first:u16le | count:u16le, at most CAPTURE_MAX_READ samples
+//   Show:   on:u8, the scope view on the sync page
+// Replies on `cap`: (op | REPLY):u8 | ok:u8 | state:u8 | samples:u16 | triggerIndex:u16 | spanUs:u32 | minMA:f32 |
+// maxMA:f32, and for Read then first:u16 | count:u16 | count * (offsetUs:i32 | current:i16), all little endian.
+enum class CaptureOp : uint8_t {
+    Arm = 1,
+    Status = 2,
+    Read = 3,
+    Cancel = 4,
+    Show = 5,
+};
+constexpr uint8_t CAPTURE_REPLY = 0x80;
+constexpr size_t CAPTURE_MAX_READ = 128;
+
+// SerialPackHandler for `cap`.
+extern void transientCaptureHandler(const uint8_t* data, size_t size);
+
+#endif // MAIN_INCLUDE_TRANSIENT_CAPTURE_HPP
@@ -0,0 +1,74 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_TRIP_ENGINE_HPP
+#define MAIN_INCLUDE_TRIP_ENGINE_HPP
+
+#include <cstdint>
+
+// Overcurrent trip decision of the e-fuse, without hardware access so recorded traces can be replayed through it.
+//
+// Two elements, evaluated on every current sample:
+//  - hard limit: trips on the first sample above `hardMA`.
+//  - thermal (I^2t): a first order model of the heat in the protected path, normalised so that a steady current
+//    of `ratedMA` settles at 1. heat' = ((I / ratedMA)^2 - heat) / tau; trips once heat exceeds 1. Starting cold,
+//    a current I trips after tau * ln(r / (r - 1)) with r = (I / ratedMA)^2, so a short inrush passes while a
+//    sustained overload still trips, and never above ratedMA in steady state.
+// A time constant of 0 trips on the first sample above `ratedMA`, like a plain threshold.
+
+enum class TripReason : uint8_t {
+    None = 0,
+    HardLimit = 1,
+    Thermal = 2,
+};
+
+struct TripCurve {
+    float ratedMA;
+    float hardMA;
+    float timeConstantMs;
+};
+
+class TripEngine {
+public:
+    // Change the curve and keep the accumulated heat.
+    void configure(const TripCurve& value);
+    [[nodiscard]] const TripCurve& curve() const {
+        return tripCurve;
+    }
+
+    // Back to cold, the next sample starts a new trace.
+    void reset();
+
+    // Feed one sample taken at `timestampUs` (any monotonic clock). The current applies from the previous sample
+    // to this one.
+    TripReason update(float currentMA, int64_t timestampUs);
+
+    // Accumulated heat, 1 is the trip point.
+    [[nodiscard]] float heat() const {
+        return heatLevel;
+    }
+
+private:
+    TripCurve tripCurve = {};
+    float heatLevel = 0;
+    int64_t lastUs = 0;
+    bool started = false;
+};
+
+#endif // MAIN_INCLUDE_TRIP_ENGINE_HPP
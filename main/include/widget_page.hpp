@@ -0,0 +1,78 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#ifndef MAIN_INCLUDE_WIDGET_PAGE_HPP
+#define MAIN_INCLUDE_WIDGET_PAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "include/synced_state.hpp"
+
+// Host-defined page. The host uploads a layout once and then streams only the values bound to it; the device
+// draws the widgets itself, so an update costs a few bytes instead of pixels or firmware code.
+//
+// Layout (`page/layout` pack): MAGIC | version:u8 | count:u8 | widget[count]
+//   widget: type:u8 | field:u8 | x:i16le | y:i16le | w:u16le | h:u16le | min:f32le | max:f32le | decimals:u8 |
+//           textLen:u8 | text[textLen]
+//   `text` is the caption of a Label, the unit after a Number, the prefix of a Text and the FNV-1a 64 hash
+//   (u64le) of a Sprite in the image cache. An empty layout removes the page.
+// Values (`page` pack): MAGIC | version:u8 | { field:u8 | kind:u8 | len:u8 | value[len] }*
+//   a patch like the sync record, kind Number carries an f32le, kind Text the string bytes.
+constexpr uint8_t WIDGET_PAGE_MAGIC = 0xC6;
+constexpr uint8_t WIDGET_PAGE_VERSION = 1;
+constexpr size_t WIDGET_PAGE_MAX_WIDGETS = 16;
+constexpr size_t WIDGET_PAGE_TEXT_MAX = 24;
+constexpr size_t WIDGET_PAGE_LAYOUT_MAX = 1024;
+
+static_assert(WIDGET_PAGE_MAX_WIDGETS <= SYNCED_STATE_MAX_FIELDS, "one field per widget at most");
+
+enum class WidgetType : uint8_t {
+    Label = 0,
+    Number = 1,
+    Text = 2,
+    Bar = 3,
+    Gauge = 4,
+    Sprite = 5,
+};
+
+enum class WidgetValueKind : uint8_t {
+    Number = 0,
+    Text = 1,
+};
+
+struct WidgetPageStats {
+    uint32_t layouts;
+    uint32_t updates;
+    uint32_t rejected;
+    uint64_t updateBytes;
+};
+
+// SerialPackHandlers for `page/layout` and `page`.
+extern void widgetPageLayoutHandler(const uint8_t* data, size_t size);
+extern void widgetPageValueHandler(const uint8_t* data, size_t size);
+
+// UI task. True once the host has uploaded a non-empty layout.
+extern bool widgetPageActive();
+// UI task. Draw the page with the newest layout and values.
+extern void widgetPageDraw();
+
+extern WidgetPageStats widgetPageGetStats();
+
+#endif // MAIN_INCLUDE_WIDGET_PAGE_HPP
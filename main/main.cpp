@@ -16,13 +16,31 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <esp_log.h>
+#include <esp_system.h>
+#include <nvs_flash.h>
+
 #include "include/buzzer.hpp"
+#include "include/config_rpc.hpp"
 #include "include/current_sensor.hpp"
 #include "include/display.hpp"
+#include "include/effect_engine.hpp"
 #include "include/efuse.hpp"
 #include "include/encoder.hpp"
+#include "include/energy_meter.hpp"
+#include "include/fault_journal.hpp"
+#include "include/image_cache.hpp"
+#include "include/latency_trace.hpp"
 #include "include/motion.hpp"
 #include "include/out_control.hpp"
+#include "include/power_history.hpp"
+#include "include/serial_pack.hpp"
+#include "include/session_stats.hpp"
+#include "include/transient_capture.hpp"
+#include "include/widget_page.hpp"
 
 extern "C" void main_app_run(); // NOLINT
 
@@ -62,6 +80,18 @@ extern "C" void current_sensor_read_debug() { // NOLINT
     currentSensorReadDebug();
 }
 
+extern "C" void energy_meter_init() { // NOLINT
+    energyMeterInit();
+}
+
+extern "C" void power_history_init() { // NOLINT
+    powerHistoryInit();
+}
+
+extern "C" void session_stats_init() { // NOLINT
+    sessionStatsInit();
+}
+
 extern "C" void control_init() { // NOLINT
     controlInit();
 }
@@ -98,6 +128,32 @@ extern "C" void display_measure_fps() { // NOLINT
     displayFrameRender();
 }
 
+// Serial endpoints that do not belong to a page, served from boot on. The Minecraft page adds its `sync` paths
+// when it is first opened.
+extern "C" void serial_services_init() { // NOLINT
+    serialPackInit();
+    configRpcInit();
+    effectInit();
+    imageCacheInit();
+    transientCaptureInit();
+    serialPackAttachHandler("fb", displayRemoteHandler);
+    serialPackAttachHandler("page/layout", widgetPageLayoutHandler);
+    serialPackAttachHandler("page", widgetPageValueHandler);
+    serialPackAttachHandler("fx/def", effectDefinitionHandler);
+    serialPackAttachHandler("fx", effectTriggerHandler);
+    serialPackAttachHandler("time", latencyTimeHandler);
+    serialPackAttachHandler("latency", latencyReportHandler);
+    serialPackAttachHandler("cfg", configRpcHandler);
+    serialPackAttachHandler("trip", efuseTripReplayHandler);
+    serialPackAttachHandler("hist", powerHistoryHandler);
+    serialPackAttachHandler("stats", sessionStatsHandler);
+    serialPackAttachHandler("cap", transientCaptureHandler);
+    serialPackAttachHandler("acq", currentSensorProfileHandler);
+    serialPackAttachHandler("fault", faultJournalHandler);
+    serialPackAttachHandler("link", serialPackLinkHandler);
+    serialPackStart();
+}
+
 extern "C" void motion_init() { // NOLINT
     motionInit();
 }
@@ -113,5 +169,12 @@ extern "C" void delay(const uint32_t ms) { // NOLINT
 extern "C" void app_main() { // NOLINT
     S_LOG_MUTEX = xSemaphoreCreateMutex();
 
+    // the partition is erased when it is full or was written by a newer NVS format
+    if (const esp_err_t err = nvs_flash_init();
+        err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ESP_ERROR_CHECK(nvs_flash_init());
+    }
+
     main_app_run();
 }
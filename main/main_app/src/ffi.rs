@@ -41,6 +41,9 @@ unsafe extern "C" {
     fn main_app_abort(details: *const c_char) -> !;
     fn current_sensor_init();
     fn current_sensor_read_debug();
+    fn energy_meter_init();
+    fn power_history_init();
+    fn session_stats_init();
     fn control_init();
     fn control_turn_on();
     fn control_turn_off();
@@ -50,6 +53,7 @@ unsafe extern "C" {
     fn encoder_init(long_press_duration: u32) -> *mut c_void;
     fn display_init(action: extern "C" fn() -> VisionUiAction);
     fn display_measure_fps();
+    fn serial_services_init();
     fn motion_init();
     fn motion_read_debug();
     fn delay(ms: u32);
@@ -247,6 +251,36 @@ pub mod current_sensor {
     }
 }
 
+/// Energy and charge counters of the USB output.
+pub mod energy_meter {
+    use super::*;
+
+    /// Restore the counters and start integrating. Needs the current sensor.
+    pub fn init() {
+        unsafe { energy_meter_init() }
+    }
+}
+
+/// Voltage, current and power history for graphs.
+pub mod power_history {
+    use super::*;
+
+    /// Start recording. Needs the current sensor.
+    pub fn init() {
+        unsafe { power_history_init() }
+    }
+}
+
+/// Current and power percentiles per plug-in session.
+pub mod session_stats {
+    use super::*;
+
+    /// Start collecting. Needs the current sensor.
+    pub fn init() {
+        unsafe { session_stats_init() }
+    }
+}
+
 /// USB Control subsystem.
 #[allow(unused)]
 pub mod usb {
@@ -446,6 +480,16 @@ pub mod display {
     }
 }
 
+/// Serial pack endpoints (config RPC, history, capture, fault journal, remote display...).
+pub mod serial {
+    use super::*;
+
+    /// Attach the endpoints and start the serial pack task. Needs the efuse and the display.
+    pub fn init() {
+        unsafe { serial_services_init() }
+    }
+}
+
 /// Motion sensor.
 #[allow(unused)]
 
@@ -2,8 +2,8 @@
 extern crate alloc;
 
 use crate::ffi::{
-    EncoderEvent, Task, VisionUiAction, buzzer, current_sensor, display, efuse, encoder, motion,
-    system, usb,
+    EncoderEvent, Task, VisionUiAction, buzzer, current_sensor, display, efuse, encoder,
+    energy_meter, motion, power_history, serial, session_stats, system, usb,
 };
 use core::time::Duration;
 
@@ -13,6 +13,9 @@ fn main() {
     usb::init();
     buzzer::init();
     current_sensor::init();
+    energy_meter::init();
+    power_history::init();
+    session_stats::init();
     efuse::init();
     motion::init();
     let mut encoder_queue = encoder::init(Duration::from_secs(1));
@@ -23,6 +26,7 @@ fn main() {
         Some(EncoderEvent::Press) => VisionUiAction::UiActionExit,
         None => VisionUiAction::UiActionNone,
     });
+    serial::init();
     let _ui_task = Task::spawn("ui_task", 9, 8192, move || {
         loop {
             display::frame_render();
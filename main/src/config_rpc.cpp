@@ -0,0 +1,347 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/config_rpc.hpp"
+
+#include <atomic>
+#include <cstring>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <esp_log.h>
+
+#include <vision_ui_lib.h>
+
+#include "include/byte_order.hpp"
+#include "include/efuse.hpp"
+#include "include/serial_pack.hpp"
+
+static constexpr auto CONFIG_RPC_TAG = "[lumen:config_rpc]";
+static constexpr auto K_PATH = "cfg";
+static constexpr size_t K_FIELD_COUNT = static_cast<size_t>(ConfigField::Count);
+static constexpr size_t K_REQUEST_HEADER_LEN = 5;
+static constexpr size_t K_REPLY_HEADER_LEN = 7;
+static constexpr size_t K_SET_ITEM_LEN = 1 + sizeof(int16_t);
+static constexpr size_t K_REQUEST_MAX = K_REQUEST_HEADER_LEN + CONFIG_RPC_MAX_BATCH * K_SET_ITEM_LEN;
+static constexpr size_t K_REPLY_MAX = K_REPLY_HEADER_LEN + CONFIG_RPC_MAX_BATCH * K_SET_ITEM_LEN;
+static constexpr int16_t K_MAX_TAU_MS = 10000;
+
+namespace {
+    struct SetItem {
+        ConfigField field;
+        int16_t value;
+    };
+
+    // LUMEN_CONFIG_VALUES is written by the UI task (settings pages) and the serial worker (Set), and read by the
+    // efuse task field by field. Writers take the spinlock so a batch lands as a whole.
+    portMUX_TYPE S_LOCK = portMUX_INITIALIZER_UNLOCKED;
+    ConfigRpcStats S_STATS = {};
+
+    // fields edited on the device since the last notification, one bit per ConfigField
+    std::atomic<uint32_t> S_PENDING{0};
+    // sends the notifications; low priority, since a stalled USB host blocks the send for up to its TX timeout
+    TaskHandle_t S_NOTIFY_TASK = nullptr;
+
+    // reassembly, serial worker only
+    uint8_t S_REQUEST[K_REQUEST_MAX] = {};
+    size_t S_REQUEST_LEN = 0;
+
+    bool validField(const uint8_t field) {
+        return field < K_FIELD_COUNT;
+    }
+
+    bool inRange(const ConfigField field, const int16_t value) {
+        const LumenUSBInfo usb = lumenGetUSBInfo();
+        switch (field) {
+            case ConfigField::OvercurrentMA:
+            case ConfigField::OvercurrentHardMA:
+                return value >= usb.overCurrentMin && value <= usb.hardwareLimitedCurrent;
+            case ConfigField::OvercurrentTauMS:
+                return value >= 0 && value <= K_MAX_TAU_MS;
+            case ConfigField::AcquisitionProfile:
+                return value >= 0 && value < static_cast<int16_t>(AcquisitionProfile::Count);
+            case ConfigField::OvervoltageMV:
+                return value >= usb.overVoltageMin && value <= usb.overVoltageMax;
+            case ConfigField::EnableAutoFaultRecovery:
+            case ConfigField::TurnOffUsb:
+            case ConfigField::OvervoltageAlert:
+            case ConfigField::OvercurrentAlert:
+            case ConfigField::FastTrip:
+            case ConfigField::PersistFaults:
+                return value == 0 || value == 1;
+            case ConfigField::Count:
+                break;
+        }
+        return false;
+    }
+
+    // With S_LOCK held.
+    int16_t readField(const ConfigField field) {
+        switch (field) {
+            case ConfigField::OvercurrentMA:
+                return LUMEN_CONFIG_VALUES.overcurrentMA;
+            case ConfigField::OvervoltageMV:
+                return LUMEN_CONFIG_VALUES.overvoltageMV;
+            case ConfigField::EnableAutoFaultRecovery:
+                return LUMEN_CONFIG_VALUES.enableAutoFaultRecovery;
+            case ConfigField::TurnOffUsb:
+                return LUMEN_CONFIG_VALUES.turnOffUsb;
+            case ConfigField::OvervoltageAlert:
+                return LUMEN_CONFIG_VALUES.overvoltageAlert;
+            case ConfigField::OvercurrentAlert:
+                return LUMEN_CONFIG_VALUES.overcurrentAlert;
+            case ConfigField::FastTrip:
+                return LUMEN_CONFIG_VALUES.fastTrip;
+            case ConfigField::OvercurrentHardMA:
+                return LUMEN_CONFIG_VALUES.overcurrentHardMA;
+            case ConfigField::OvercurrentTauMS:
+                return LUMEN_CONFIG_VALUES.overcurrentTauMS;
+            case ConfigField::AcquisitionProfile:
+                return static_cast<int16_t>(LUMEN_CONFIG_VALUES.acquisitionProfile);
+            case ConfigField::PersistFaults:
+                return LUMEN_CONFIG_VALUES.persistFaults;
+            case ConfigField::Count:
+                break;
+        }
+        return 0;
+    }
+
+    // With S_LOCK held.
+    void writeField(const ConfigField field, const int16_t value) {
+        switch (field) {
+            case ConfigField::OvercurrentMA:
+                LUMEN_CONFIG_VALUES.overcurrentMA = value;
+                return;
+            case ConfigField::OvervoltageMV:
+                LUMEN_CONFIG_VALUES.overvoltageMV = value;
+                return;
+            case ConfigField::EnableAutoFaultRecovery:
+                LUMEN_CONFIG_VALUES.enableAutoFaultRecovery = value != 0;
+                return;
+            case ConfigField::TurnOffUsb:
+                LUMEN_CONFIG_VALUES.turnOffUsb = value != 0;
+                return;
+            case ConfigField::OvervoltageAlert:
+                LUMEN_CONFIG_VALUES.overvoltageAlert = value != 0;
+                return;
+            case ConfigField::OvercurrentAlert:
+                LUMEN_CONFIG_VALUES.overcurrentAlert = value != 0;
+                return;
+            case ConfigField::FastTrip:
+                LUMEN_CONFIG_VALUES.fastTrip = value != 0;
+                return;
+            case ConfigField::OvercurrentHardMA:
+                LUMEN_CONFIG_VALUES.overcurrentHardMA = value;
+                return;
+            case ConfigField::OvercurrentTauMS:
+                LUMEN_CONFIG_VALUES.overcurrentTauMS = value;
+                return;
+            case ConfigField::AcquisitionProfile:
+                LUMEN_CONFIG_VALUES.acquisitionProfile = static_cast<AcquisitionProfile>(value);
+                return;
+            case ConfigField::PersistFaults:
+                LUMEN_CONFIG_VALUES.persistFaults = value != 0;
+                return;
+            case ConfigField::Count:
+                return;
+        }
+    }
+
+    // Send a reply (or notification) with the current value of `fields`.
+    void sendReply(
+            const uint8_t op,
+            const uint8_t requestId,
+            const ConfigRpcStatus status,
+            const uint8_t badField,
+            const ConfigField* fields,
+            const size_t count
+    ) {
+        uint8_t reply[K_REPLY_MAX];
+        reply[0] = CONFIG_RPC_MAGIC;
+        reply[1] = CONFIG_RPC_VERSION;
+        reply[2] = op | CONFIG_RPC_REPLY;
+        reply[3] = requestId;
+        reply[4] = static_cast<uint8_t>(status);
+        reply[5] = badField;
+        reply[6] = static_cast<uint8_t>(count);
+
+        uint8_t* out = reply + K_REPLY_HEADER_LEN;
+        taskENTER_CRITICAL(&S_LOCK);
+        for (size_t i = 0; i < count; ++i) {
+            const auto value = static_cast<uint16_t>(readField(fields[i]));
+            *out++ = static_cast<uint8_t>(fields[i]);
+            out = writeU16Le(out, value);
+        }
+        taskEXIT_CRITICAL(&S_LOCK);
+        serialPackSend(K_PATH, reply, static_cast<size_t>(out - reply));
+    }
+
+    size_t allFields(ConfigField* fields) {
+        for (size_t i = 0; i < K_FIELD_COUNT; ++i) {
+            fields[i] = static_cast<ConfigField>(i);
+        }
+        return K_FIELD_COUNT;
+    }
+
+    void handleRequest(const uint8_t* data, const size_t size) {
+        ++S_STATS.requests;
+        const uint8_t op = size >= 3 ? data[2] : 0;
+        const uint8_t requestId = size >= 4 ? data[3] : 0;
+        ConfigField fields[CONFIG_RPC_MAX_BATCH];
+
+        auto reject = [&](const ConfigRpcStatus status, const uint8_t badField) {
+            ++S_STATS.rejected;
+            ESP_LOGW(CONFIG_RPC_TAG, "request %u rejected: status %u", requestId, static_cast<unsigned>(status));
+            sendReply(op, requestId, status, badField, fields, 0);
+        };
+
+        if (size < K_REQUEST_HEADER_LEN || data[0] != CONFIG_RPC_MAGIC) {
+            reject(ConfigRpcStatus::Malformed, CONFIG_RPC_NO_FIELD);
+            return;
+        }
+        if (data[1] != CONFIG_RPC_VERSION) {
+            reject(ConfigRpcStatus::UnsupportedVersion, CONFIG_RPC_NO_FIELD);
+            return;
+        }
+
+        const size_t count = data[4];
+        const uint8_t* items = data + K_REQUEST_HEADER_LEN;
+        const size_t itemsLen = size - K_REQUEST_HEADER_LEN;
+
+        if (op == static_cast<uint8_t>(ConfigRpcOp::Get)) {
+            if (count > CONFIG_RPC_MAX_BATCH || itemsLen != count) {
+                reject(ConfigRpcStatus::Malformed, CONFIG_RPC_NO_FIELD);
+                return;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                if (!validField(items[i])) {
+                    reject(ConfigRpcStatus::UnknownField, items[i]);
+                    return;
+                }
+                fields[i] = static_cast<ConfigField>(items[i]);
+            }
+            const size_t n = count == 0 ? allFields(fields) : count;
+            sendReply(op, requestId, ConfigRpcStatus::Ok, CONFIG_RPC_NO_FIELD, fields, n);
+            return;
+        }
+
+        if (op != static_cast<uint8_t>(ConfigRpcOp::Set) || count == 0 || count > CONFIG_RPC_MAX_BATCH ||
+            itemsLen != count * K_SET_ITEM_LEN) {
+            reject(ConfigRpcStatus::Malformed, CONFIG_RPC_NO_FIELD);
+            return;
+        }
+
+        SetItem batch[CONFIG_RPC_MAX_BATCH];
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t* item = items + i * K_SET_ITEM_LEN;
+            if (!validField(item[0])) {
+                reject(ConfigRpcStatus::UnknownField, item[0]);
+                return;
+            }
+            const auto field = static_cast<ConfigField>(item[0]);
+            const auto value = static_cast<int16_t>(readU16Le(item + 1));
+            if (!inRange(field, value)) {
+                reject(ConfigRpcStatus::OutOfRange, item[0]);
+                return;
+            }
+            batch[i] = {field, value};
+            fields[i] = field;
+        }
+
+        taskENTER_CRITICAL(&S_LOCK);
+        for (size_t i = 0; i < count; ++i) {
+            writeField(batch[i].field, batch[i].value);
+        }
+        taskEXIT_CRITICAL(&S_LOCK);
+        ESP_LOGI(CONFIG_RPC_TAG, "request %u: %u fields set", requestId, static_cast<unsigned>(count));
+        sendReply(op, requestId, ConfigRpcStatus::Ok, CONFIG_RPC_NO_FIELD, fields, count);
+    }
+
+    [[noreturn]]
+    void notifyTask(void*) {
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            // edits made meanwhile ride along; their wakeups find nothing pending
+            vTaskDelay(pdMS_TO_TICKS(CONFIG_RPC_NOTIFY_DELAY_MS));
+
+            const uint32_t pending = S_PENDING.exchange(0, std::memory_order_relaxed);
+            ConfigField fields[K_FIELD_COUNT];
+            size_t count = 0;
+            for (size_t i = 0; i < K_FIELD_COUNT; ++i) {
+                if (pending & (1U << i)) {
+                    fields[count++] = static_cast<ConfigField>(i);
+                }
+            }
+            if (count == 0) {
+                continue;
+            }
+            ++S_STATS.notifications;
+            sendReply(
+                    static_cast<uint8_t>(ConfigRpcOp::Notify),
+                    0,
+                    ConfigRpcStatus::Ok,
+                    CONFIG_RPC_NO_FIELD,
+                    fields,
+                    count
+            );
+        }
+    }
+} // namespace
+
+void configRpcInit() {
+    if (S_NOTIFY_TASK) {
+        return;
+    }
+    xTaskCreate(notifyTask, "config_notify", 3072, nullptr, 2, &S_NOTIFY_TASK);
+}
+
+void configRpcHandler(const uint8_t* data, const size_t size) {
+    if (data && size > 0) {
+        if (S_REQUEST_LEN + size <= K_REQUEST_MAX) {
+            std::memcpy(S_REQUEST + S_REQUEST_LEN, data, size);
+        }
+        // keeps counting past the buffer, so an oversized request is rejected below
+        S_REQUEST_LEN += size;
+        return;
+    }
+    const size_t len = S_REQUEST_LEN;
+    S_REQUEST_LEN = 0;
+    if (serialPackAborted()) {
+        return;
+    }
+    handleRequest(S_REQUEST, len <= K_REQUEST_MAX ? len : 0);
+}
+
+void configRpcLocalSet(const ConfigField field, const int16_t value) {
+    if (!validField(static_cast<uint8_t>(field))) {
+        return;
+    }
+    taskENTER_CRITICAL(&S_LOCK);
+    writeField(field, value);
+    taskEXIT_CRITICAL(&S_LOCK);
+
+    S_PENDING.fetch_or(1U << static_cast<uint32_t>(field), std::memory_order_relaxed);
+    // the send may wait on the USB link, so it never runs on the UI task
+    if (S_NOTIFY_TASK) {
+        xTaskNotifyGive(S_NOTIFY_TASK);
+    }
+}
+
+ConfigRpcStats configRpcGetStats() {
+    return S_STATS;
+}
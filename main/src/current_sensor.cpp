@@ -0,0 +1,563 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/current_sensor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cmath>
+#include <cstring>
+#include <expected>
+#include <utility>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <ina226_interface.h>
+
+#include "include/byte_order.hpp"
+#include "include/i2c_bus.hpp"
+#include "include/pins.hpp"
+#include "include/seqlock.hpp"
+#include "include/serial_pack.hpp"
+
+static constexpr auto CURRENT_SENSOR_TAG = "[lumen:current_sensor]";
+static constexpr auto K_PROFILE_PATH = "acq";
+static constexpr uint16_t K_ADDRESS = 0x44;
+static constexpr auto K_FAST_CONVERSION_TIME = INA226::ConversionTime::TIME_140_uS;
+// configuration register: bits 14..12 always read as 100
+static constexpr uint16_t K_CONFIG_FIXED_BITS = 0x4000;
+// samples after a switch that may still hold a conversion of the previous profile
+static constexpr uint32_t K_SETTLE_SAMPLES = 2;
+static constexpr size_t K_PROFILE_COUNT = static_cast<size_t>(AcquisitionProfile::Count);
+
+namespace {
+    struct ProfileSettings {
+        const char* name;
+        INA226::AveragingMode averaging;
+        INA226::ConversionTime conversionTime;
+        // one conversion per sample, started right after the previous sample was read
+        bool triggered;
+        int64_t samplePeriodUs;
+    };
+
+    // The alert comparator sees the averaged value of every conversion cycle, so averaging delays a fast trip just as
+    // much as a long conversion time does.
+    constexpr ProfileSettings K_PROFILES[K_PROFILE_COUNT] = {
+            {"fast-protect", INA226::AveragingMode::SAMPLE_1, INA226::ConversionTime::TIME_140_uS, false, 4000},
+            {"balanced", INA226::AveragingMode::SAMPLE_1, INA226::ConversionTime::TIME_1100_uS, false, 16000},
+            {"precision", INA226::AveragingMode::SAMPLE_64, INA226::ConversionTime::TIME_588_uS, false, 80000},
+            {"low-power", INA226::AveragingMode::SAMPLE_4, INA226::ConversionTime::TIME_1100_uS, true, 250000},
+    };
+
+    constexpr int64_t conversionTimeUs(const INA226::ConversionTime time) {
+        constexpr int64_t times[] = {140, 204, 332, 588, 1100, 2116, 4156, 8244};
+        return times[std::to_underlying(time)];
+    }
+
+    constexpr int64_t averagingCount(const INA226::AveragingMode mode) {
+        constexpr int64_t counts[] = {1, 4, 16, 64, 128, 256, 512, 1024};
+        return counts[std::to_underlying(mode)];
+    }
+
+    // A new result is ready after both conversions, times the averaging.
+    constexpr int64_t conversionCycleUs(const ProfileSettings& profile) {
+        return 2 * conversionTimeUs(profile.conversionTime) * averagingCount(profile.averaging);
+    }
+
+    // how often the comparator evaluates: every cycle when continuous, once per sample when triggered
+    constexpr int64_t comparatorCycleUs(const ProfileSettings& profile) {
+        return profile.triggered ? profile.samplePeriodUs : conversionCycleUs(profile);
+    }
+
+    constexpr bool profilesValid() {
+        for (const ProfileSettings& profile : K_PROFILES) {
+            if (profile.samplePeriodUs < conversionCycleUs(profile)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    static_assert(profilesValid(), "a sampler would read the same conversion twice");
+
+    constexpr uint16_t configWord(
+            const INA226::AveragingMode averaging,
+            const INA226::ConversionTime conversionTime,
+            const INA226::OperatingMode mode
+    ) {
+        return K_CONFIG_FIXED_BITS | static_cast<uint16_t>(std::to_underlying(averaging) << 9U) |
+               static_cast<uint16_t>(std::to_underlying(conversionTime) << 6U) |
+               static_cast<uint16_t>(std::to_underlying(conversionTime) << 3U) | std::to_underlying(mode);
+    }
+
+    struct Accumulator {
+        uint32_t seen;
+        uint32_t samples;
+        int64_t firstUs;
+        int64_t lastUs;
+        uint32_t maxGapUs;
+        float lastCurrentMA;
+        float lastVoltageMV;
+        double currentSquares;
+        double voltageSquares;
+    };
+
+    struct Measurements {
+        AcquisitionMeasurement profile[K_PROFILE_COUNT];
+    };
+} // namespace
+
+static INA226* S_SENSOR = nullptr;
+static TaskHandle_t S_SAMPLER_TASK = nullptr;
+static std::atomic<TaskHandle_t> S_SUBSCRIBER{nullptr};
+static CurrentSensorListener S_LISTENERS[CURRENT_SENSOR_MAX_LISTENERS] = {};
+static std::atomic<size_t> S_LISTENER_COUNT{0};
+static esp_timer_handle_t S_SAMPLE_TIMER = nullptr;
+static SeqLock<CurrentSensorSample> S_SAMPLE;
+// requested by any task, taken over by the sampler between two samples
+static std::atomic<AcquisitionProfile> S_REQUESTED_PROFILE{CURRENT_SENSOR_DEFAULT_PROFILE};
+static std::atomic<AcquisitionProfile> S_ACTIVE_PROFILE{CURRENT_SENSOR_DEFAULT_PROFILE};
+static std::atomic<bool> S_FAST{false};
+// configuration writes come from the sampler (switches, triggers) and the capture task (fast conversions)
+static SemaphoreHandle_t S_CONFIG_LOCK = nullptr;
+static SeqLock<Measurements> S_MEASUREMENTS;
+// samples skipped because a register read failed
+static std::atomic<uint32_t> S_FAILED_SAMPLES{0};
+
+namespace {
+    const ProfileSettings& activeProfile() {
+        return K_PROFILES[static_cast<size_t>(S_ACTIVE_PROFILE.load(std::memory_order_relaxed))];
+    }
+
+    // The configuration for the active profile and fast flag. In triggered mode the write also starts a conversion.
+    void writeConfig() {
+        xSemaphoreTake(S_CONFIG_LOCK, portMAX_DELAY);
+        const ProfileSettings& profile = activeProfile();
+        if (S_FAST.load(std::memory_order_relaxed)) {
+            S_SENSOR->SetConfig(configWord(
+                    INA226::AveragingMode::SAMPLE_1,
+                    K_FAST_CONVERSION_TIME,
+                    INA226::OperatingMode::SHUNT_AND_BUS_CONTINUOUS
+            ));
+        } else {
+            S_SENSOR->SetConfig(configWord(
+                    profile.averaging,
+                    profile.conversionTime,
+                    profile.triggered ? INA226::OperatingMode::SHUNT_AND_BUS_TRIGGERED
+                                      : INA226::OperatingMode::SHUNT_AND_BUS_CONTINUOUS
+            ));
+        }
+        xSemaphoreGive(S_CONFIG_LOCK);
+    }
+
+    // Sampler only. The registers keep the last result until the first conversion with the new set-up is done, so
+    // the e-fuse never sees a gap or a zero.
+    void applyProfile(const AcquisitionProfile profile, Accumulator& accumulator) {
+        S_ACTIVE_PROFILE.store(profile, std::memory_order_relaxed);
+        writeConfig();
+        const ProfileSettings& settings = K_PROFILES[static_cast<size_t>(profile)];
+        ESP_ERROR_CHECK(esp_timer_restart(S_SAMPLE_TIMER, settings.samplePeriodUs));
+        accumulator = {};
+        ESP_LOGI(
+                CURRENT_SENSOR_TAG,
+                "profile %s: a sample every %" PRId64 " us, conversion cycle %" PRId64 " us",
+                settings.name,
+                settings.samplePeriodUs,
+                conversionCycleUs(settings)
+        );
+    }
+
+    void measure(const CurrentSensorSample& sample, Accumulator& accumulator, Measurements& measurements) {
+        if (++accumulator.seen <= K_SETTLE_SAMPLES) {
+            return;
+        }
+        if (accumulator.samples == 0) {
+            accumulator.firstUs = sample.timestampUs;
+        } else {
+            const float current = sample.currentMA - accumulator.lastCurrentMA;
+            const float voltage = sample.busVoltageMV - accumulator.lastVoltageMV;
+            accumulator.currentSquares += static_cast<double>(current) * current;
+            accumulator.voltageSquares += static_cast<double>(voltage) * voltage;
+            const auto gapUs = static_cast<uint32_t>(sample.timestampUs - accumulator.lastUs);
+            accumulator.maxGapUs = std::max(accumulator.maxGapUs, gapUs);
+        }
+        ++accumulator.samples;
+        accumulator.lastUs = sample.timestampUs;
+        accumulator.lastCurrentMA = sample.currentMA;
+        accumulator.lastVoltageMV = sample.busVoltageMV;
+        if (accumulator.samples < 2) {
+            return;
+        }
+
+        const auto differences = static_cast<double>(accumulator.samples - 1);
+        const auto spanUs = static_cast<double>(accumulator.lastUs - accumulator.firstUs);
+        measurements.profile[static_cast<size_t>(S_ACTIVE_PROFILE.load(std::memory_order_relaxed))] = {
+                .samples = accumulator.samples,
+                .rateHz = spanUs > 0 ? static_cast<float>(differences * 1e6 / spanUs) : 0,
+                .maxGapUs = accumulator.maxGapUs,
+                .currentNoiseMA = static_cast<float>(std::sqrt(accumulator.currentSquares / (2 * differences))),
+                .voltageNoiseMV = static_cast<float>(std::sqrt(accumulator.voltageSquares / (2 * differences))),
+        };
+        S_MEASUREMENTS.write(measurements);
+    }
+
+    // The four measurement registers, or the error of the first read that failed.
+    std::expected<CurrentSensorSample, INA226::Error> readSample(const int64_t timestampUs, const uint32_t sequence) {
+        const auto shuntVoltageUV = S_SENSOR->ReadShuntVoltage_uV();
+        if (!shuntVoltageUV) {
+            return std::unexpected(shuntVoltageUV.error());
+        }
+        const auto currentUA = S_SENSOR->ReadCurrent_uA();
+        if (!currentUA) {
+            return std::unexpected(currentUA.error());
+        }
+        const auto busVoltageMV = S_SENSOR->ReadBusVoltage_mV();
+        if (!busVoltageMV) {
+            return std::unexpected(busVoltageMV.error());
+        }
+        const auto powerUW = S_SENSOR->ReadPower_uW();
+        if (!powerUW) {
+            return std::unexpected(powerUW.error());
+        }
+        return CurrentSensorSample{
+                .timestampUs = timestampUs,
+                .sequence = sequence,
+                .busVoltageMV = static_cast<float>(*busVoltageMV),
+                .shuntVoltageUV = static_cast<float>(*shuntVoltageUV),
+                .currentMA = static_cast<float>(*currentUA) / 1000.f,
+                .powerMW = static_cast<float>(*powerUW) / 1000.f,
+        };
+    }
+
+    void sampleTimerCallback(void*) {
+        xTaskNotifyGive(S_SAMPLER_TASK);
+    }
+
+    [[noreturn]]
+    void samplerTask(void*) {
+        uint32_t sequence = 0;
+        Accumulator accumulator = {};
+        Measurements measurements = {};
+        bool failing = false;
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            if (const AcquisitionProfile requested = S_REQUESTED_PROFILE.load(std::memory_order_relaxed);
+                requested != S_ACTIVE_PROFILE.load(std::memory_order_relaxed)) {
+                applyProfile(requested, accumulator);
+            }
+
+            // Four separate register reads of roughly 100 us each at 400 kHz, so in continuous mode they can straddle
+            // conversions: one boundary at most with a 2 ms cycle, two or three in fast-protect and fast conversions
+            // (280 us). Gating on the Conversion Ready flag would need a Mask/Enable read, which also clears the
+            // latched alert currentSensorAlertFired() waits for. Shunt and current go first, back to back, as the
+            // e-fuse acts on those; in triggered mode all four come from the one conversion started below.
+            const auto read = readSample(esp_timer_get_time(), sequence + 1);
+            // the next sample reads the conversion started here, one period later
+            if (activeProfile().triggered && !S_FAST.load(std::memory_order_relaxed)) {
+                writeConfig();
+            }
+            // A failed read is no reading: the sample is skipped, readers keep the previous one and the measurements
+            // see a longer gap.
+            if (!read) {
+                S_FAILED_SAMPLES.fetch_add(1, std::memory_order_relaxed);
+                if (!failing) {
+                    ESP_LOGW(CURRENT_SENSOR_TAG, "sample skipped: %s", read.error().what());
+                }
+                failing = true;
+                continue;
+            }
+            if (failing) {
+                ESP_LOGI(
+                        CURRENT_SENSOR_TAG,
+                        "sampling again, %" PRIu32 " samples skipped so far",
+                        S_FAILED_SAMPLES.load(std::memory_order_relaxed)
+                );
+            }
+            failing = false;
+            const CurrentSensorSample& sample = *read;
+            sequence = sample.sequence;
+
+            S_SAMPLE.write(sample);
+            const size_t listeners = S_LISTENER_COUNT.load(std::memory_order_acquire);
+            for (size_t i = 0; i < listeners; ++i) {
+                S_LISTENERS[i](sample);
+            }
+            if (const TaskHandle_t subscriber = S_SUBSCRIBER.load(std::memory_order_acquire)) {
+                xTaskNotifyGive(subscriber);
+            }
+            // a transient capture changes the set-up, start over once it is done
+            if (S_FAST.load(std::memory_order_relaxed)) {
+                accumulator = {};
+            } else {
+                measure(sample, accumulator, measurements);
+            }
+        }
+    }
+} // namespace
+
+void currentSensorInit() {
+    const auto bus = lumen::i2c::get_shared_bus_handle();
+    if (bus == nullptr) {
+        ESP_LOGE(CURRENT_SENSOR_TAG, "Shared I2C bus is not available");
+        return;
+    }
+
+    auto* sensor = new INA226{bus, K_ADDRESS, I2C_FREQ};
+    if (!sensor->ok()) {
+        // Kept allocated, it may already hold a device on the shared bus. Every reader below copes with a missing
+        // sensor, as without a bus.
+        ESP_LOGE(CURRENT_SENSOR_TAG, "INA226 not available: %s", sensor->initError().what());
+        return;
+    }
+    S_SENSOR = sensor;
+    S_CONFIG_LOCK = xSemaphoreCreateMutex();
+
+    S_SENSOR->Calibrate(CURRENT_SENSOR_SHUNT_MILLIOHM, 1.6);
+    writeConfig();
+
+    // above the efuse task, which acts on the samples
+    xTaskCreate(samplerTask, "current_sampler", 3072, nullptr, 11, &S_SAMPLER_TASK);
+    constexpr esp_timer_create_args_t args = {
+            .callback = sampleTimerCallback,
+            .arg = nullptr,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "current_sample",
+            .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &S_SAMPLE_TIMER));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(S_SAMPLE_TIMER, activeProfile().samplePeriodUs));
+    ESP_LOGI(
+            CURRENT_SENSOR_TAG,
+            "sampler started, profile %s, every %" PRId64 " us",
+            activeProfile().name,
+            activeProfile().samplePeriodUs
+    );
+}
+
+void currentSensorSetProfile(const AcquisitionProfile profile) {
+    if (static_cast<size_t>(profile) < K_PROFILE_COUNT) {
+        S_REQUESTED_PROFILE.store(profile, std::memory_order_relaxed);
+    }
+}
+
+AcquisitionProfile currentSensorGetProfile() {
+    return S_ACTIVE_PROFILE.load(std::memory_order_relaxed);
+}
+
+const char* currentSensorProfileName(const AcquisitionProfile profile) {
+    const auto index = static_cast<size_t>(profile);
+    return index < K_PROFILE_COUNT ? K_PROFILES[index].name : "?";
+}
+
+AcquisitionMeasurement currentSensorGetMeasurement(const AcquisitionProfile profile) {
+    const auto index = static_cast<size_t>(profile);
+    return index < K_PROFILE_COUNT ? S_MEASUREMENTS.read().profile[index] : AcquisitionMeasurement{};
+}
+
+bool currentSensorSetOvercurrentAlert(const float limitMA) {
+    if (!S_SENSOR) {
+        return false;
+    }
+    // above full scale a saturated conversion would compare as under the limit, and at it every saturated one trips
+    const bool measurable = limitMA < static_cast<float>(CURRENT_SENSOR_FULL_SCALE_MA);
+    if (limitMA <= 0 || !measurable) {
+        // no trigger function selected
+        S_SENSOR->SetAlertTriggerMask(static_cast<INA226::AlertTriggerMask>(0));
+        return limitMA <= 0;
+    }
+    // mA * mOhm = uV
+    const float limit = limitMA * static_cast<float>(CURRENT_SENSOR_SHUNT_MILLIOHM) / CURRENT_SENSOR_SHUNT_LSB_UV;
+    S_SENSOR->SetAlertLimitValue(static_cast<uint16_t>(limit));
+    S_SENSOR->SetAlertTriggerMask(
+            static_cast<INA226::AlertTriggerMask>(
+                    std::to_underlying(INA226::AlertTriggerMask::SHUNT_OVER_VOLTAGE) |
+                    std::to_underlying(INA226::AlertTriggerMask::ALERT_LATCH_ENABLE)
+            )
+    );
+    return true;
+}
+
+bool currentSensorAlertFired() {
+    if (!S_SENSOR) {
+        return false;
+    }
+    return S_SENSOR->GetAlertTriggerMask() & std::to_underlying(INA226::AlertTriggerMask::ALERT_FUNCTION_FLAG);
+}
+
+int64_t currentSensorCycleUs() {
+    return comparatorCycleUs(activeProfile());
+}
+
+void currentSensorSetFastConversions(const bool fast) {
+    if (!S_SENSOR) {
+        return;
+    }
+    S_FAST.store(fast, std::memory_order_relaxed);
+    writeConfig();
+}
+
+float currentSensorReadCurrentNowMA() {
+    if (!S_SENSOR) {
+        return NAN;
+    }
+    // uV / mOhm = mA
+    return static_cast<float>(S_SENSOR->GetShuntVoltage_uV()) / static_cast<float>(CURRENT_SENSOR_SHUNT_MILLIOHM);
+}
+
+int64_t currentSensorSamplePeriodUs() {
+    return activeProfile().samplePeriodUs;
+}
+
+CurrentSensorSample currentSensorGetSample() {
+    return S_SAMPLE.read();
+}
+
+void currentSensorSubscribe(const TaskHandle_t task) {
+    S_SUBSCRIBER.store(task, std::memory_order_release);
+}
+
+bool currentSensorAddListener(const CurrentSensorListener listener) {
+    const size_t count = S_LISTENER_COUNT.load(std::memory_order_relaxed);
+    if (count >= CURRENT_SENSOR_MAX_LISTENERS) {
+        ESP_LOGE(CURRENT_SENSOR_TAG, "no room for another sample listener");
+        return false;
+    }
+    S_LISTENERS[count] = listener;
+    // the sampler only calls the slots below the published count
+    S_LISTENER_COUNT.store(count + 1, std::memory_order_release);
+    return true;
+}
+
+float currentSensorReadVoltage() {
+    return S_SAMPLE.read().busVoltageMV;
+}
+
+float currentSensorReadCurrent() {
+    return S_SAMPLE.read().currentMA;
+}
+
+float currentSensorReadPower() {
+    return S_SAMPLE.read().powerMW;
+}
+
+void currentSensorProfileHandler(const uint8_t* data, const size_t size) {
+    // requests carry no payload, answer once the pack is complete
+    if (data && size > 0) {
+        return;
+    }
+    constexpr size_t profileLen = 7 * sizeof(uint32_t);
+    uint8_t reply[2 + K_PROFILE_COUNT * profileLen + sizeof(uint32_t)];
+    uint8_t* out = reply;
+    *out++ = CURRENT_SENSOR_ACQ_VERSION;
+    *out++ = static_cast<uint8_t>(currentSensorGetProfile());
+    const Measurements measurements = S_MEASUREMENTS.read();
+    for (size_t i = 0; i < K_PROFILE_COUNT; ++i) {
+        const AcquisitionMeasurement& measurement = measurements.profile[i];
+        out = writeU32Le(out, static_cast<uint32_t>(K_PROFILES[i].samplePeriodUs));
+        out = writeU32Le(out, static_cast<uint32_t>(comparatorCycleUs(K_PROFILES[i])));
+        out = writeU32Le(out, measurement.samples);
+        out = writeF32Le(out, measurement.rateHz);
+        out = writeU32Le(out, measurement.maxGapUs);
+        out = writeF32Le(out, measurement.currentNoiseMA);
+        out = writeF32Le(out, measurement.voltageNoiseMV);
+    }
+    out = writeU32Le(out, S_FAILED_SAMPLES.load(std::memory_order_relaxed));
+    serialPackSend(K_PROFILE_PATH, reply, static_cast<size_t>(out - reply));
+}
+
+void currentSensorReadDebug() {
+    if (!S_SENSOR) {
+        return;
+    }
+    ESP_LOGI(CURRENT_SENSOR_TAG, "\n");
+    ESP_LOGI(CURRENT_SENSOR_TAG, "Shunt voltage: %" PRIi32 " uV", S_SENSOR->GetShuntVoltage_uV());
+    ESP_LOGI(CURRENT_SENSOR_TAG, "Bus voltage raw: %" PRIi32, S_SENSOR->GetBusVoltage_Raw());
+    ESP_LOGI(CURRENT_SENSOR_TAG, "Bus voltage: %" PRIi32 " mV", S_SENSOR->GetBusVoltage_mV());
+    ESP_LOGI(CURRENT_SENSOR_TAG, "Current: %f mA", S_SENSOR->GetCurrent_uA() / 1000.f);
+    ESP_LOGI(CURRENT_SENSOR_TAG, "Power: %f mW", S_SENSOR->GetPower_uW() / 1000.f);
+    ESP_LOGI(CURRENT_SENSOR_TAG, "Config: %" PRIx16, S_SENSOR->GetConfig());
+    ESP_LOGI(CURRENT_SENSOR_TAG, "Operating mode: %" PRIu8, std::to_underlying(S_SENSOR->GetOperatingMode()));
+    ESP_LOGI(CURRENT_SENSOR_TAG, "Averaging mode: %" PRIu8, std::to_underlying(S_SENSOR->GetAveragingMode()));
+    ESP_LOGI(
+            CURRENT_SENSOR_TAG,
+            "Bus voltage conversion time: %" PRIu8,
+            std::to_underlying(S_SENSOR->GetBusVoltageConversionTime())
+    );
+    ESP_LOGI(
+            CURRENT_SENSOR_TAG,
+            "Shunt voltage conversion time: %" PRIu8,
+            std::to_underlying(S_SENSOR->GetShuntVoltageConversionTime())
+    );
+    using Kind = INA226::ErrorKind;
+    ESP_LOGI(
+            CURRENT_SENSOR_TAG,
+            "I2C errors: lock %" PRIu32 ", invalid arg %" PRIu32 ", timeout %" PRIu32 ", no ack %" PRIu32
+            ", other %" PRIu32,
+            S_SENSOR->GetErrorCount(Kind::LOCK_TIMEOUT),
+            S_SENSOR->GetErrorCount(Kind::INVALID_ARG),
+            S_SENSOR->GetErrorCount(Kind::TIMEOUT),
+            S_SENSOR->GetErrorCount(Kind::NO_ACK),
+            S_SENSOR->GetErrorCount(Kind::OTHER)
+    );
+}
+
+void currentSensorScan() {
+    auto bus = lumen::i2c::get_shared_bus_handle();
+    if (bus == nullptr) {
+        ESP_LOGE(CURRENT_SENSOR_TAG, "Shared I2C bus is not available");
+        return;
+    }
+
+    constexpr auto addr = K_ADDRESS;
+    if (const esp_err_t ok = i2c_master_probe(bus, addr, 50); ok == ESP_OK) {
+        ESP_LOGI(CURRENT_SENSOR_TAG, "Found I2C device at 0x%02X\n", addr);
+    } else {
+        ESP_LOGW(CURRENT_SENSOR_TAG, "Probe failed for I2C device at 0x%02X -> %s", addr, esp_err_to_name(ok));
+    }
+
+    i2c_master_dev_handle_t dev;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+    constexpr i2c_device_config_t devCfg = {
+            .device_address = addr,
+            .scl_speed_hz = I2C_FREQ,
+    };
+#pragma GCC diagnostic pop
+
+    if (i2c_master_bus_add_device(bus, &devCfg, &dev) != ESP_OK) {
+        ESP_LOGE(CURRENT_SENSOR_TAG, "Failed to add temporary device for scan");
+        return;
+    }
+
+    constexpr uint8_t reg = 0xFE;
+    uint8_t rx[2];
+
+    const esp_err_t e1 = i2c_master_transmit(dev, &reg, 1, 500);
+    ESP_LOGI(CURRENT_SENSOR_TAG, "TX(reg=0x%02X) -> %s\n", reg, esp_err_to_name(e1));
+    if (e1 == ESP_OK) {
+        const esp_err_t e2 = i2c_master_receive(dev, rx, 2, 500);
+        ESP_LOGI(CURRENT_SENSOR_TAG, "RX -> %s, data=0x%02X%02X\n", esp_err_to_name(e2), rx[0], rx[1]);
+    }
+
+    i2c_master_bus_rm_device(dev);
+}
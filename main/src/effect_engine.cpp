@@ -0,0 +1,432 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/effect_engine.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "include/buzzer.hpp"
+#include "include/byte_order.hpp"
+#include "include/display.hpp"
+#include "include/image_cache.hpp"
+#include "include/serial_pack.hpp"
+
+static constexpr auto EFFECT_TAG = "[lumen:effect]";
+static constexpr size_t K_DEFINITION_MAX = 256;
+static constexpr size_t K_STEP_LEN = 7;
+static constexpr uint32_t K_NEVER_MS = UINT32_MAX;
+static constexpr int64_t K_MIN_TIMER_US = 100;
+// Print a latency summary every this many triggers.
+static constexpr uint32_t K_STATS_LOG_INTERVAL = 16;
+
+namespace {
+    struct EffectStep {
+        EffectTrack track;
+        uint16_t durationMs;
+        uint16_t a;
+        uint16_t b;
+    };
+
+    struct EffectDefinition {
+        bool valid;
+        int16_t x;
+        int16_t y;
+        uint8_t frameCount;
+        // pinned in the image cache for as long as the definition is installed
+        ImageCacheEntry frames[EFFECT_MAX_FRAMES];
+        uint8_t stepCount;
+        EffectStep steps[EFFECT_MAX_STEPS];
+        bool hasSprite;
+    };
+
+    struct Playback {
+        bool active;
+        uint8_t id;
+        int64_t startUs;
+        // serial RX time of the trigger, for latency
+        int64_t triggerUs;
+        bool frameMeasured;
+    };
+
+    struct SpriteDraw {
+        int64_t startUs;
+        int16_t x;
+        int16_t y;
+        // an extra pin, so a definition replaced meanwhile cannot free the slot under the draw
+        ImageCacheEntry frame;
+    };
+
+    // Everything below is shared by the serial worker (definitions, triggers), the esp_timer task (step
+    // boundaries) and the UI task (sprites), and guarded by S_LOCK.
+    SemaphoreHandle_t S_LOCK = nullptr;
+    esp_timer_handle_t S_STEP_TIMER = nullptr;
+    EffectDefinition S_EFFECTS[EFFECT_MAX_EFFECTS] = {};
+    Playback S_PLAYING[EFFECT_MAX_ACTIVE] = {};
+    // what the engine last drove the outputs to, so it only touches them on change and hands them back after
+    bool S_TONE_DRIVEN = false;
+    uint16_t S_TONE_FREQ = 0;
+    uint16_t S_TONE_DUTY = 0;
+    bool S_BACKLIGHT_DRIVEN = false;
+    bool S_BACKLIGHT_ON = true;
+    EffectStats S_STATS = {};
+
+    // reassembly, serial worker only
+    uint8_t S_DEFINITION_BUFFER[K_DEFINITION_MAX] = {};
+    size_t S_DEFINITION_LEN = 0;
+    bool S_DEFINITION_OVERFLOW = false;
+
+    // The step of `track` that plays `elapsedMs` into the effect. `nextMs` is lowered to when it ends.
+    const EffectStep* activeStep(
+            const EffectDefinition& effect,
+            const EffectTrack track,
+            const uint32_t elapsedMs,
+            uint32_t& nextMs
+    ) {
+        uint32_t start = 0;
+        for (uint8_t i = 0; i < effect.stepCount; ++i) {
+            const EffectStep& step = effect.steps[i];
+            if (step.track != track) {
+                continue;
+            }
+            if (elapsedMs < start + step.durationMs) {
+                nextMs = std::min(nextMs, start + step.durationMs);
+                return &step;
+            }
+            start += step.durationMs;
+        }
+        return nullptr;
+    }
+
+    void applyTone(const EffectStep* step) {
+        const uint16_t freq = step ? step->a : 0;
+        const uint16_t duty = step ? step->b : 0;
+        if (!step && !S_TONE_DRIVEN) {
+            return;
+        }
+        if (S_TONE_DRIVEN && freq == S_TONE_FREQ && duty == S_TONE_DUTY) {
+            return;
+        }
+        if (freq == 0 || duty == 0) {
+            buzzerOff();
+        } else {
+            buzzerTone(freq, duty);
+        }
+        S_TONE_DRIVEN = step != nullptr;
+        S_TONE_FREQ = freq;
+        S_TONE_DUTY = duty;
+    }
+
+    void applyBacklight(const EffectStep* step) {
+        // the backlight is on whenever no effect drives it
+        const bool on = step ? step->a != 0 : true;
+        if (!step && !S_BACKLIGHT_DRIVEN) {
+            return;
+        }
+        if (on != S_BACKLIGHT_ON) {
+            displayBacklightSet(on);
+            S_BACKLIGHT_ON = on;
+        }
+        S_BACKLIGHT_DRIVEN = step != nullptr;
+    }
+
+    // With S_LOCK held. Retire finished effects, drive the outputs for `now` and arm the timer for the next step
+    // boundary. When several effects use a track, the most recently started one wins.
+    void update(const int64_t now) {
+        const EffectStep* tone = nullptr;
+        const EffectStep* backlight = nullptr;
+        int64_t toneStart = 0;
+        int64_t backlightStart = 0;
+        int64_t nextUs = INT64_MAX;
+
+        for (Playback& playing : S_PLAYING) {
+            if (!playing.active) {
+                continue;
+            }
+            const EffectDefinition& effect = S_EFFECTS[playing.id];
+            const auto elapsedMs = static_cast<uint32_t>((now - playing.startUs) / 1000);
+            uint32_t nextMs = K_NEVER_MS;
+            const EffectStep* playingTone = activeStep(effect, EffectTrack::Tone, elapsedMs, nextMs);
+            const EffectStep* playingBacklight = activeStep(effect, EffectTrack::Backlight, elapsedMs, nextMs);
+            activeStep(effect, EffectTrack::Sprite, elapsedMs, nextMs);
+            if (nextMs == K_NEVER_MS) {
+                playing.active = false;
+                continue;
+            }
+            if (playingTone && (!tone || playing.startUs >= toneStart)) {
+                tone = playingTone;
+                toneStart = playing.startUs;
+            }
+            if (playingBacklight && (!backlight || playing.startUs >= backlightStart)) {
+                backlight = playingBacklight;
+                backlightStart = playing.startUs;
+            }
+            nextUs = std::min(nextUs, playing.startUs + static_cast<int64_t>(nextMs) * 1000);
+        }
+
+        applyTone(tone);
+        applyBacklight(backlight);
+
+        esp_timer_stop(S_STEP_TIMER);
+        if (nextUs != INT64_MAX) {
+            esp_timer_start_once(S_STEP_TIMER, static_cast<uint64_t>(std::max(nextUs - now, K_MIN_TIMER_US)));
+        }
+    }
+
+    void stepTimerCallback(void*) {
+        xSemaphoreTake(S_LOCK, portMAX_DELAY);
+        update(esp_timer_get_time());
+        xSemaphoreGive(S_LOCK);
+    }
+
+    void releaseFrames(EffectDefinition& effect) {
+        for (ImageCacheEntry& frame : effect.frames) {
+            imageCacheRelease(frame);
+        }
+    }
+
+    bool decodeDefinition(const uint8_t* data, const size_t size, uint8_t& id, EffectDefinition& out) {
+        if (size < 9 || data[0] != EFFECT_MAGIC || data[1] != EFFECT_VERSION || data[2] >= EFFECT_MAX_EFFECTS) {
+            return false;
+        }
+        id = data[2];
+        out = {};
+        out.x = static_cast<int16_t>(readU16Le(data + 3));
+        out.y = static_cast<int16_t>(readU16Le(data + 5));
+        out.frameCount = data[7];
+        size_t pos = 8;
+        if (out.frameCount > EFFECT_MAX_FRAMES || size - pos < out.frameCount * sizeof(uint64_t) + 1) {
+            return false;
+        }
+        for (uint8_t i = 0; i < out.frameCount; ++i, pos += sizeof(uint64_t)) {
+            uint64_t hash = 0;
+            for (size_t k = 0; k < sizeof(hash); ++k) {
+                hash |= static_cast<uint64_t>(data[pos + k]) << (8U * k);
+            }
+            if (!imageCacheLookup(hash, out.frames[i])) {
+                ESP_LOGW(EFFECT_TAG, "effect %u frame %u not cached", id, i);
+            }
+        }
+
+        out.stepCount = data[pos++];
+        if (out.stepCount > EFFECT_MAX_STEPS || size - pos != out.stepCount * K_STEP_LEN) {
+            return false;
+        }
+        for (uint8_t i = 0; i < out.stepCount; ++i, pos += K_STEP_LEN) {
+            if (data[pos] > static_cast<uint8_t>(EffectTrack::Sprite)) {
+                return false;
+            }
+            out.steps[i] = {
+                    .track = static_cast<EffectTrack>(data[pos]),
+                    .durationMs = readU16Le(data + pos + 1),
+                    .a = readU16Le(data + pos + 3),
+                    .b = readU16Le(data + pos + 5),
+            };
+            out.hasSprite |= out.steps[i].track == EffectTrack::Sprite;
+        }
+        out.valid = out.stepCount > 0;
+        return true;
+    }
+
+    void recordOutputLatency(const uint32_t latencyUs) {
+        S_STATS.outputLatencyLastUs = latencyUs;
+        S_STATS.outputLatencyMaxUs = std::max(S_STATS.outputLatencyMaxUs, latencyUs);
+        S_STATS.outputLatencyTotalUs += latencyUs;
+        if (S_STATS.triggers % K_STATS_LOG_INTERVAL != 0) {
+            return;
+        }
+        ESP_LOGI(
+                EFFECT_TAG,
+                "%u triggers, output latency avg %u us max %u us, first frame avg %u us max %u us",
+                static_cast<unsigned>(S_STATS.triggers),
+                static_cast<unsigned>(S_STATS.outputLatencyTotalUs / S_STATS.triggers),
+                static_cast<unsigned>(S_STATS.outputLatencyMaxUs),
+                static_cast<unsigned>(S_STATS.frameSamples ? S_STATS.frameLatencyTotalUs / S_STATS.frameSamples : 0),
+                static_cast<unsigned>(S_STATS.frameLatencyMaxUs)
+        );
+    }
+} // namespace
+
+void effectInit() {
+    if (S_LOCK) {
+        return;
+    }
+    S_LOCK = xSemaphoreCreateMutex();
+    assert(S_LOCK && "Failed to create effect lock");
+    constexpr esp_timer_create_args_t args = {
+            .callback = stepTimerCallback,
+            .arg = nullptr,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "effect_step",
+            .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &S_STEP_TIMER));
+}
+
+bool effectTrigger(const uint8_t id, const int64_t triggerUs) {
+    if (!S_LOCK) {
+        return false;
+    }
+    xSemaphoreTake(S_LOCK, portMAX_DELAY);
+    if (id >= EFFECT_MAX_EFFECTS || !S_EFFECTS[id].valid) {
+        ++S_STATS.unknownTriggers;
+        xSemaphoreGive(S_LOCK);
+        return false;
+    }
+
+    // restart the effect if it is running, else take a free slot, else replace the oldest
+    Playback* slot = nullptr;
+    for (Playback& playing : S_PLAYING) {
+        if (playing.active && playing.id == id) {
+            slot = &playing;
+            break;
+        }
+        if (!slot || (slot->active && (!playing.active || playing.startUs < slot->startUs))) {
+            slot = &playing;
+        }
+    }
+
+    const int64_t now = esp_timer_get_time();
+    *slot = {
+            .active = true,
+            .id = id,
+            .startUs = now,
+            .triggerUs = triggerUs,
+            .frameMeasured = !S_EFFECTS[id].hasSprite,
+    };
+    update(now);
+
+    ++S_STATS.triggers;
+    recordOutputLatency(static_cast<uint32_t>(esp_timer_get_time() - triggerUs));
+    xSemaphoreGive(S_LOCK);
+    return true;
+}
+
+void effectTriggerHandler(const uint8_t* data, const size_t size) {
+    // act on every id as soon as its chunk arrives, the end of the pack adds nothing
+    const int64_t rxUs = serialPackRxTime();
+    for (size_t i = 0; data && i < size; ++i) {
+        effectTrigger(data[i], rxUs);
+    }
+}
+
+void effectDefinitionHandler(const uint8_t* data, const size_t size) {
+    if (data && size > 0) {
+        if (S_DEFINITION_OVERFLOW || S_DEFINITION_LEN + size > sizeof(S_DEFINITION_BUFFER)) {
+            S_DEFINITION_OVERFLOW = true;
+            return;
+        }
+        std::memcpy(S_DEFINITION_BUFFER + S_DEFINITION_LEN, data, size);
+        S_DEFINITION_LEN += size;
+        return;
+    }
+
+    const bool overflow = S_DEFINITION_OVERFLOW;
+    const size_t len = S_DEFINITION_LEN;
+    S_DEFINITION_OVERFLOW = false;
+    S_DEFINITION_LEN = 0;
+    if (serialPackAborted()) {
+        return;
+    }
+
+    uint8_t id = 0;
+    EffectDefinition decoded = {};
+    if (overflow || !S_LOCK || !decodeDefinition(S_DEFINITION_BUFFER, len, id, decoded)) {
+        ESP_LOGW(EFFECT_TAG, "rejected effect definition of %u bytes", static_cast<unsigned>(len));
+        releaseFrames(decoded);
+        ++S_STATS.rejected;
+        return;
+    }
+
+    xSemaphoreTake(S_LOCK, portMAX_DELAY);
+    for (Playback& playing : S_PLAYING) {
+        if (playing.active && playing.id == id) {
+            playing.active = false;
+        }
+    }
+    releaseFrames(S_EFFECTS[id]);
+    S_EFFECTS[id] = decoded;
+    update(esp_timer_get_time());
+    ++S_STATS.definitions;
+    xSemaphoreGive(S_LOCK);
+    ESP_LOGI(EFFECT_TAG, "effect %u: %u steps, %u frames", id, decoded.stepCount, decoded.frameCount);
+}
+
+void effectDraw() {
+    if (!S_LOCK) {
+        return;
+    }
+
+    SpriteDraw draws[EFFECT_MAX_ACTIVE] = {};
+    size_t drawCount = 0;
+    xSemaphoreTake(S_LOCK, portMAX_DELAY);
+    const int64_t now = esp_timer_get_time();
+    for (Playback& playing : S_PLAYING) {
+        if (!playing.active) {
+            continue;
+        }
+        const EffectDefinition& effect = S_EFFECTS[playing.id];
+        uint32_t nextMs = K_NEVER_MS;
+        const auto elapsedMs = static_cast<uint32_t>((now - playing.startUs) / 1000);
+        const EffectStep* step = activeStep(effect, EffectTrack::Sprite, elapsedMs, nextMs);
+        if (!step || step->a >= effect.frameCount || !effect.frames[step->a].pixels) {
+            continue;
+        }
+        draws[drawCount++] = {playing.startUs, effect.x, effect.y, effect.frames[step->a]};
+        imageCacheRetain(effect.frames[step->a]);
+        if (!playing.frameMeasured) {
+            playing.frameMeasured = true;
+            const auto latency = static_cast<uint32_t>(now - playing.triggerUs);
+            ++S_STATS.frameSamples;
+            S_STATS.frameLatencyLastUs = latency;
+            S_STATS.frameLatencyMaxUs = std::max(S_STATS.frameLatencyMaxUs, latency);
+            S_STATS.frameLatencyTotalUs += latency;
+        }
+    }
+    xSemaphoreGive(S_LOCK);
+
+    // oldest first, so the newest effect ends up on top
+    std::sort(draws, draws + drawCount, [](const SpriteDraw& a, const SpriteDraw& b) { return a.startUs < b.startUs; });
+    for (size_t i = 0; i < drawCount; ++i) {
+        SpriteDraw& draw = draws[i];
+        displayDriverExtensionRGBBitmapAlphaDraw(
+                draw.x,
+                draw.y,
+                static_cast<int16_t>(draw.frame.width),
+                static_cast<int16_t>(draw.frame.height),
+                draw.frame.pixels
+        );
+        imageCacheRelease(draw.frame);
+    }
+}
+
+EffectStats effectGetStats() {
+    if (!S_LOCK) {
+        return S_STATS;
+    }
+    xSemaphoreTake(S_LOCK, portMAX_DELAY);
+    const EffectStats stats = S_STATS;
+    xSemaphoreGive(S_LOCK);
+    return stats;
+}
@@ -17,19 +17,31 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "include/efuse.hpp"
 
+#include <algorithm>
 #include <atomic>
+#include <cinttypes>
+#include <cstring>
 
 #include <esp_log.h>
 #include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
+#include "include/byte_order.hpp"
 #include "include/current_sensor.hpp"
+#include "include/fault_journal.hpp"
 #include "include/out_control.hpp"
+#include "include/seqlock.hpp"
+#include "include/serial_pack.hpp"
+#include "include/trip_engine.hpp"
 
 static constexpr auto EFUSE_TAG = "[lumen:efuse]";
 static TaskHandle_t EFUSE_TASK_HANDLE = nullptr;
+static TaskHandle_t FAST_TRIP_TASK_HANDLE = nullptr;
+static esp_timer_handle_t FAST_TRIP_TIMER = nullptr;
 static constexpr int64_t AUTO_FAULT_RECOVERY_MILLISECOND = 3000;
+// The fastest profile converts every 280 us; polling the latch that often would keep the bus busy for little gain.
+static constexpr int64_t FAST_TRIP_MIN_POLL_US = 1000;
 
 static int64_t nowMs() {
     return esp_timer_get_time() / 1000;
@@ -38,11 +50,113 @@ static int64_t nowMs() {
 static std::atomic<bool> HAS_OCP{false};
 static std::atomic<bool> HAS_OVP{false};
 static std::atomic<bool> HAS_FAULT{false};
+// set by the fast-trip task after it cut the output, taken over by the efuse task as an OCP fault
+static std::atomic<bool> FAST_TRIPPED{false};
+static SeqLock<EfuseFastTripStats> FAST_TRIP_STATS;
+
+static void fastTripTimerCallback(void*) {
+    xTaskNotifyGive(FAST_TRIP_TASK_HANDLE);
+}
+
+static int64_t fastTripPollUs() {
+    return std::max(currentSensorCycleUs(), FAST_TRIP_MIN_POLL_US);
+}
+
+// The INA226 compares every shunt conversion with the limit and latches the result; this task only reads the
+// latch, one register, once per conversion cycle (at most once a millisecond) and switches the output off itself.
+[[noreturn]]
+static void fastTripTask(void*) {
+    int16_t requestedMA = 0;
+    int16_t armedMA = 0;
+    int64_t pollUs = fastTripPollUs();
+    EfuseFastTripStats stats = {};
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // follow acquisition profile switches; the latch keeps whatever fired in between
+        if (const int64_t cycleUs = fastTripPollUs(); cycleUs != pollUs) {
+            pollUs = cycleUs;
+            ESP_ERROR_CHECK(esp_timer_restart(FAST_TRIP_TIMER, pollUs));
+            ESP_LOGI(EFUSE_TAG, "fast trip polling every %" PRId64 " us", pollUs);
+        }
+
+        const bool wanted = LUMEN_CONFIG_VALUES.overcurrentAlert && LUMEN_CONFIG_VALUES.fastTrip &&
+                            !LUMEN_CONFIG_VALUES.turnOffUsb;
+        if (const int16_t limitMA = wanted ? LUMEN_CONFIG_VALUES.overcurrentHardMA : 0; limitMA != requestedMA) {
+            requestedMA = limitMA;
+            armedMA = currentSensorSetOvercurrentAlert(limitMA) ? limitMA : 0;
+            if (armedMA != limitMA) {
+                ESP_LOGE(
+                        EFUSE_TAG,
+                        "fast trip not armed: %d mA is beyond the %d mA the shunt measures",
+                        limitMA,
+                        CURRENT_SENSOR_FULL_SCALE_MA
+                );
+            } else {
+                ESP_LOGI(EFUSE_TAG, "fast trip %s at %d mA", armedMA > 0 ? "armed" : "disarmed", armedMA);
+            }
+            continue;
+        }
+        if (armedMA <= 0) {
+            continue;
+        }
+
+        const int64_t pollStartUs = esp_timer_get_time();
+        const bool fired = currentSensorAlertFired();
+        const int64_t detectedUs = esp_timer_get_time();
+        stats.lastPollUs = static_cast<uint32_t>(detectedUs - pollStartUs);
+        stats.maxPollUs = std::max(stats.maxPollUs, stats.lastPollUs);
+        if (!fired) {
+            FAST_TRIP_STATS.write(stats);
+            continue;
+        }
+
+        controlTurnOff();
+        const int64_t cutoffUs = esp_timer_get_time();
+        FAST_TRIPPED.store(true, std::memory_order_relaxed);
+
+        ++stats.trips;
+        stats.lastCutoffUs = static_cast<uint32_t>(cutoffUs - detectedUs);
+        stats.maxCutoffUs = std::max(stats.maxCutoffUs, stats.lastCutoffUs);
+        FAST_TRIP_STATS.write(stats);
+        ESP_LOGW(
+                EFUSE_TAG,
+                "fast trip over %d mA: cut off %" PRIu32 " us after detection, poll %" PRIu32 " us",
+                armedMA,
+                stats.lastCutoffUs,
+                stats.lastPollUs
+        );
+    }
+}
+
+static TripCurve tripCurve() {
+    return {
+            .ratedMA = static_cast<float>(LUMEN_CONFIG_VALUES.overcurrentMA),
+            .hardMA = static_cast<float>(LUMEN_CONFIG_VALUES.overcurrentHardMA),
+            .timeConstantMs = static_cast<float>(LUMEN_CONFIG_VALUES.overcurrentTauMS),
+    };
+}
+
+static const char* tripReasonName(const TripReason reason) {
+    switch (reason) {
+        case TripReason::None:
+            return "none";
+        case TripReason::HardLimit:
+            return "hard limit";
+        case TripReason::Thermal:
+            return "thermal";
+    }
+    return "?";
+}
 
 [[noreturn]]
 static void efuseTask(void*) {
-    constexpr TickType_t period = pdMS_TO_TICKS(50); // 20 Hz
-    TickType_t lastWake = xTaskGetTickCount();
+    // woken by every current sample; without samples the forced off and recovery handling still runs at 20 Hz
+    constexpr TickType_t idleWait = pdMS_TO_TICKS(50);
+
+    TripEngine tripEngine;
+    uint32_t lastSequence = 0;
 
     bool faultLatched = false;
     int64_t faultSinceMs = 0;
@@ -64,33 +178,66 @@ static void efuseTask(void*) {
     };
 
     for (;;) {
+        ulTaskNotifyTake(pdTRUE, idleWait);
+
+        // the sampler switches between two samples
+        currentSensorSetProfile(LUMEN_CONFIG_VALUES.acquisitionProfile);
+
         // user forced off is not a "fault"
         if (LUMEN_CONFIG_VALUES.turnOffUsb) {
             setUsbOff();
+            tripEngine.reset();
 
             HAS_OCP.store(false, std::memory_order_relaxed);
             HAS_OVP.store(false, std::memory_order_relaxed);
             HAS_FAULT.store(false, std::memory_order_relaxed);
-
-            vTaskDelayUntil(&lastWake, period);
             continue;
         }
 
         bool ovpNow = false;
         bool ocpNow = false;
+        // FaultCause bits for the journal
+        uint8_t causes = 0;
+        const CurrentSensorSample sample = currentSensorGetSample();
+        const bool freshSample = sample.timestampUs != 0 && sample.sequence != lastSequence;
+        lastSequence = sample.sequence;
 
         if (LUMEN_CONFIG_VALUES.overvoltageAlert) {
-            if (const auto voltage = currentSensorReadVoltage(); voltage > LUMEN_CONFIG_VALUES.overvoltageMV) {
+            if (sample.busVoltageMV > LUMEN_CONFIG_VALUES.overvoltageMV) {
                 ovpNow = true;
+                causes |= static_cast<uint8_t>(FaultCause::Overvoltage);
             }
         }
 
-        if (LUMEN_CONFIG_VALUES.overcurrentAlert) {
-            if (const auto current = currentSensorReadCurrent(); current > LUMEN_CONFIG_VALUES.overcurrentMA) {
+        if (!LUMEN_CONFIG_VALUES.overcurrentAlert) {
+            tripEngine.reset();
+        } else if (freshSample) {
+            // every sample, so the thermal model integrates the whole trace
+            tripEngine.configure(tripCurve());
+            if (const TripReason reason = tripEngine.update(sample.currentMA, sample.timestampUs);
+                reason != TripReason::None) {
                 ocpNow = true;
+                causes |= static_cast<uint8_t>(
+                        reason == TripReason::HardLimit ? FaultCause::HardLimit : FaultCause::Thermal
+                );
+                if (usbOn) {
+                    ESP_LOGW(
+                            EFUSE_TAG,
+                            "overcurrent trip (%s) at %d mA, heat %d%%",
+                            tripReasonName(reason),
+                            static_cast<int>(sample.currentMA),
+                            static_cast<int>(tripEngine.heat() * 100)
+                    );
+                }
             }
         }
 
+        // the output is already off, the trip goes through the usual fault handling and recovery
+        if (FAST_TRIPPED.exchange(false, std::memory_order_relaxed)) {
+            ocpNow = true;
+            causes |= static_cast<uint8_t>(FaultCause::FastTrip);
+        }
+
         const bool faultNow = ovpNow || ocpNow;
 
         // publish realtime reasons
@@ -103,6 +250,9 @@ static void efuseTask(void*) {
             if (!faultLatched) {
                 faultLatched = true;
                 faultSinceMs = nowMs();
+                faultJournalOpen(causes, sample);
+            } else {
+                faultJournalUpdate(causes, sample);
             }
             setUsbOff();
             offByFault = true;
@@ -115,6 +265,7 @@ static void efuseTask(void*) {
                 if (LUMEN_CONFIG_VALUES.enableAutoFaultRecovery) {
                     if (const int64_t elapsed = nowMs() - faultSinceMs; elapsed >= AUTO_FAULT_RECOVERY_MILLISECOND) {
                         faultLatched = false;
+                        faultJournalClose(FaultRecovery::Auto);
                         setUsbOn();
                         offByFault = false;
                     } else {
@@ -130,14 +281,27 @@ static void efuseTask(void*) {
 
         // publish: "USB is OFF because of OVP/OCP handling"
         HAS_FAULT.store(offByFault, std::memory_order_relaxed);
-
-        vTaskDelayUntil(&lastWake, period);
     }
 }
 
 void efuseInit() {
-    xTaskCreate(efuseTask, "efuse_task", 2048, nullptr, 10, &EFUSE_TASK_HANDLE);
-    ESP_LOGI(EFUSE_TAG, "efuse task started (20Hz, prio=10)");
+    faultJournalInit();
+    xTaskCreate(efuseTask, "efuse_task", 3072, nullptr, 10, &EFUSE_TASK_HANDLE);
+    currentSensorSubscribe(EFUSE_TASK_HANDLE);
+    ESP_LOGI(EFUSE_TAG, "efuse task started (every sample, prio=10)");
+
+    // above the current sampler, a trip must not wait for a sample read
+    xTaskCreate(fastTripTask, "fast_trip_task", 2048, nullptr, 12, &FAST_TRIP_TASK_HANDLE);
+    constexpr esp_timer_create_args_t args = {
+            .callback = fastTripTimerCallback,
+            .arg = nullptr,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "fast_trip",
+            .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &FAST_TRIP_TIMER));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(FAST_TRIP_TIMER, fastTripPollUs()));
+    ESP_LOGI(EFUSE_TAG, "fast trip polling every %" PRId64 " us (prio=12)", fastTripPollUs());
 }
 
 extern bool efuseHasOCP() {
@@ -151,3 +315,135 @@ extern bool efuseHasOVP() {
 extern bool efuseHasFault() {
     return HAS_FAULT.load(std::memory_order_relaxed);
 }
+
+extern EfuseFastTripStats efuseGetFastTripStats() {
+    return FAST_TRIP_STATS.read();
+}
+
+// Replay state, only touched by the serial worker.
+namespace {
+    constexpr size_t K_REPLAY_HEADER_LEN = 8;
+    constexpr size_t K_REPLAY_SAMPLE_LEN = sizeof(uint32_t) + sizeof(int16_t);
+    constexpr size_t K_REPLAY_REPLY_LEN = 18;
+
+    struct Replay {
+        TripEngine engine;
+        uint8_t header[K_REPLAY_HEADER_LEN];
+        size_t headerLen;
+        // a sample split across two chunks
+        uint8_t partial[K_REPLAY_SAMPLE_LEN];
+        size_t partialLen;
+        bool malformed;
+        int64_t timeUs;
+        uint32_t samples;
+        TripReason reason;
+        uint32_t tripSample;
+        uint32_t tripUs;
+        float peakHeat;
+    };
+
+    Replay S_REPLAY = {};
+
+    void replayStart() {
+        const uint8_t* header = S_REPLAY.header;
+        if (header[0] != EFUSE_TRIP_REPLAY_MAGIC || header[1] != EFUSE_TRIP_REPLAY_VERSION) {
+            S_REPLAY.malformed = true;
+            return;
+        }
+        S_REPLAY.engine.reset();
+        S_REPLAY.engine.configure({
+                .ratedMA = static_cast<float>(static_cast<int16_t>(readU16Le(header + 2))),
+                .hardMA = static_cast<float>(static_cast<int16_t>(readU16Le(header + 4))),
+                .timeConstantMs = static_cast<float>(readU16Le(header + 6)),
+        });
+    }
+
+    void replaySample(const uint8_t* sample) {
+        if (S_REPLAY.malformed || S_REPLAY.reason != TripReason::None) {
+            return;
+        }
+        const auto currentMA = static_cast<int16_t>(readU16Le(sample + sizeof(uint32_t)));
+        // the first sample is time 0 whatever its delta says
+        if (S_REPLAY.samples > 0) {
+            S_REPLAY.timeUs += readU32Le(sample);
+        }
+        const TripReason reason = S_REPLAY.engine.update(currentMA, S_REPLAY.timeUs);
+        S_REPLAY.peakHeat = std::max(S_REPLAY.peakHeat, S_REPLAY.engine.heat());
+        if (reason != TripReason::None) {
+            S_REPLAY.reason = reason;
+            S_REPLAY.tripSample = S_REPLAY.samples;
+            S_REPLAY.tripUs = static_cast<uint32_t>(S_REPLAY.timeUs);
+        }
+        ++S_REPLAY.samples;
+    }
+
+    void replayFinish() {
+        const bool malformed =
+                S_REPLAY.malformed || S_REPLAY.headerLen < K_REPLAY_HEADER_LEN || S_REPLAY.partialLen != 0;
+        uint8_t reply[K_REPLAY_REPLY_LEN] = {};
+        reply[0] = EFUSE_TRIP_REPLAY_MAGIC;
+        reply[1] = EFUSE_TRIP_REPLAY_VERSION;
+        reply[2] = malformed ? 1 : 0;
+        reply[3] = static_cast<uint8_t>(S_REPLAY.reason);
+        writeU32Le(reply + 4, S_REPLAY.tripSample);
+        writeU32Le(reply + 8, S_REPLAY.tripUs);
+        const auto peak = static_cast<uint16_t>(std::min(S_REPLAY.peakHeat * 1000.F, 65535.F));
+        writeU16Le(reply + 12, peak);
+        writeU32Le(reply + 14, S_REPLAY.samples);
+        serialPackSend("trip", reply, K_REPLAY_REPLY_LEN);
+
+        if (malformed) {
+            ESP_LOGW(EFUSE_TAG, "trip replay rejected");
+        } else {
+            ESP_LOGI(
+                    EFUSE_TAG,
+                    "trip replay: %" PRIu32 " samples, %s at %" PRIu32 " us",
+                    S_REPLAY.samples,
+                    tripReasonName(S_REPLAY.reason),
+                    S_REPLAY.tripUs
+            );
+        }
+        S_REPLAY = {};
+    }
+} // namespace
+
+void efuseTripReplayHandler(const uint8_t* data, size_t size) {
+    if (!data || size == 0) {
+        if (serialPackAborted()) {
+            S_REPLAY = {};
+            return;
+        }
+        replayFinish();
+        return;
+    }
+
+    if (S_REPLAY.headerLen < K_REPLAY_HEADER_LEN) {
+        const size_t take = std::min(size, K_REPLAY_HEADER_LEN - S_REPLAY.headerLen);
+        std::memcpy(S_REPLAY.header + S_REPLAY.headerLen, data, take);
+        S_REPLAY.headerLen += take;
+        data += take;
+        size -= take;
+        if (S_REPLAY.headerLen == K_REPLAY_HEADER_LEN) {
+            replayStart();
+        }
+    }
+
+    if (S_REPLAY.partialLen > 0) {
+        const size_t take = std::min(size, K_REPLAY_SAMPLE_LEN - S_REPLAY.partialLen);
+        std::memcpy(S_REPLAY.partial + S_REPLAY.partialLen, data, take);
+        S_REPLAY.partialLen += take;
+        data += take;
+        size -= take;
+        if (S_REPLAY.partialLen < K_REPLAY_SAMPLE_LEN) {
+            return;
+        }
+        replaySample(S_REPLAY.partial);
+        S_REPLAY.partialLen = 0;
+    }
+
+    for (; size >= K_REPLAY_SAMPLE_LEN; data += K_REPLAY_SAMPLE_LEN, size -= K_REPLAY_SAMPLE_LEN) {
+        replaySample(data);
+    }
+    std::memcpy(S_REPLAY.partial, data, size);
+    S_REPLAY.partialLen = size;
+}
@@ -0,0 +1,214 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/energy_meter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <nvs.h>
+
+#include "include/current_sensor.hpp"
+#include "include/seqlock.hpp"
+
+static constexpr auto ENERGY_METER_TAG = "[lumen:energy]";
+static constexpr auto K_NVS_NAMESPACE = "lumen";
+static constexpr auto K_NVS_KEY = "energy";
+static constexpr uint32_t K_CHECKPOINT_VERSION = 1;
+
+static constexpr int64_t K_NJ_PER_WH = 3600LL * 1000 * 1000 * 1000;
+static constexpr int64_t K_NC_PER_MAH = 3600LL * 1000 * 1000;
+
+// Checkpoint coalescing. NVS spreads writes over its pages by itself, so the wear is set by how often we write: at
+// most once per period, and only after 0.01 Wh more or, for small loads, once the last write is half an hour old.
+// A power loss loses at most one period of energy. Only the lifetime counters are restored, the session ones are
+// still written so the layout stays that of version 1.
+static constexpr TickType_t K_CHECKPOINT_PERIOD = pdMS_TO_TICKS(60 * 1000);
+static constexpr int64_t K_CHECKPOINT_MIN_NJ = K_NJ_PER_WH / 100;
+static constexpr int64_t K_CHECKPOINT_MAX_AGE_US = 30LL * 60 * 1000 * 1000;
+
+namespace {
+    struct Totals {
+        int64_t sessionNJ;
+        int64_t sessionNC;
+        int64_t lifetimeNJ;
+        int64_t lifetimeNC;
+    };
+
+    struct Checkpoint {
+        uint32_t version;
+        uint32_t reserved;
+        Totals totals;
+    };
+
+    SeqLock<Totals> S_TOTALS;
+    std::atomic<bool> S_RESET_REQUESTED{false};
+    nvs_handle_t S_NVS = 0;
+    bool S_STARTED = false;
+    EnergyMeterStats S_STATS = {};
+
+    // integrator, sampler task only
+    Totals S_RUNNING = {};
+    int64_t S_LAST_US = 0;
+    int64_t S_LAST_UW = 0;
+    int64_t S_LAST_UA = 0;
+    // what the integer division left over, carried into the next step
+    int64_t S_ENERGY_REMAINDER = 0;
+    int64_t S_CHARGE_REMAINDER = 0;
+
+    // (a + b) / 2 * dt in micro units times microseconds, i.e. 2000 per nano unit
+    int64_t trapezoid(const int64_t previous, const int64_t current, const int64_t dtUs, int64_t& remainder) {
+        const int64_t area = (previous + current) * dtUs + remainder;
+        remainder = area % 2000;
+        return area / 2000;
+    }
+
+    void onSample(const CurrentSensorSample& sample) {
+        if (S_RESET_REQUESTED.exchange(false, std::memory_order_relaxed)) {
+            S_RUNNING.sessionNJ = 0;
+            S_RUNNING.sessionNC = 0;
+            S_TOTALS.write(S_RUNNING);
+        }
+
+        const auto powerUW = static_cast<int64_t>(sample.powerMW * 1000.F);
+        const auto currentUA = static_cast<int64_t>(sample.currentMA * 1000.F);
+        if (S_LAST_US != 0 && sample.timestampUs > S_LAST_US) {
+            const int64_t dtUs = sample.timestampUs - S_LAST_US;
+            const int64_t energyNJ = trapezoid(S_LAST_UW, powerUW, dtUs, S_ENERGY_REMAINDER);
+            const int64_t chargeNC = trapezoid(S_LAST_UA, currentUA, dtUs, S_CHARGE_REMAINDER);
+            S_RUNNING.sessionNJ += energyNJ;
+            S_RUNNING.lifetimeNJ += energyNJ;
+            S_RUNNING.sessionNC += chargeNC;
+            S_RUNNING.lifetimeNC += chargeNC;
+            S_TOTALS.write(S_RUNNING);
+        }
+        S_LAST_US = sample.timestampUs;
+        S_LAST_UW = powerUW;
+        S_LAST_UA = currentUA;
+        ++S_STATS.samples;
+    }
+
+    bool loadCheckpoint(Totals& totals) {
+        Checkpoint checkpoint = {};
+        size_t size = sizeof(checkpoint);
+        const esp_err_t err = nvs_get_blob(S_NVS, K_NVS_KEY, &checkpoint, &size);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            return false;
+        }
+        if (err != ESP_OK || size != sizeof(checkpoint) || checkpoint.version != K_CHECKPOINT_VERSION) {
+            ESP_LOGW(ENERGY_METER_TAG, "ignoring checkpoint: %s", esp_err_to_name(err));
+            return false;
+        }
+        totals.lifetimeNJ = checkpoint.totals.lifetimeNJ;
+        totals.lifetimeNC = checkpoint.totals.lifetimeNC;
+        return true;
+    }
+
+    bool saveCheckpoint(const Totals& totals) {
+        const Checkpoint checkpoint = {.version = K_CHECKPOINT_VERSION, .reserved = 0, .totals = totals};
+        esp_err_t err = nvs_set_blob(S_NVS, K_NVS_KEY, &checkpoint, sizeof(checkpoint));
+        if (err == ESP_OK) {
+            err = nvs_commit(S_NVS);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(ENERGY_METER_TAG, "checkpoint failed: %s", esp_err_to_name(err));
+            return false;
+        }
+        return true;
+    }
+
+    [[noreturn]]
+    void checkpointTask(void*) {
+        Totals saved = S_TOTALS.read();
+        int64_t savedUs = esp_timer_get_time();
+
+        while (true) {
+            vTaskDelay(K_CHECKPOINT_PERIOD);
+            const Totals totals = S_TOTALS.read();
+            const int64_t nowUs = esp_timer_get_time();
+            if (totals.lifetimeNJ == saved.lifetimeNJ && totals.lifetimeNC == saved.lifetimeNC) {
+                continue;
+            }
+            if (std::llabs(totals.lifetimeNJ - saved.lifetimeNJ) < K_CHECKPOINT_MIN_NJ &&
+                nowUs - savedUs < K_CHECKPOINT_MAX_AGE_US) {
+                ++S_STATS.checkpointsSkipped;
+                continue;
+            }
+            if (!saveCheckpoint(totals)) {
+                ++S_STATS.checkpointErrors;
+                continue;
+            }
+            ++S_STATS.checkpoints;
+            saved = totals;
+            savedUs = nowUs;
+        }
+    }
+
+    float toWh(const int64_t nanojoules) {
+        return static_cast<float>(static_cast<double>(nanojoules) / K_NJ_PER_WH);
+    }
+
+    float toMAh(const int64_t nanocoulombs) {
+        return static_cast<float>(static_cast<double>(nanocoulombs) / K_NC_PER_MAH);
+    }
+} // namespace
+
+void energyMeterInit() {
+    if (S_STARTED) {
+        return;
+    }
+    S_STARTED = true;
+
+    const esp_err_t err = nvs_open(K_NVS_NAMESPACE, NVS_READWRITE, &S_NVS);
+    if (err == ESP_OK) {
+        if (loadCheckpoint(S_RUNNING)) {
+            ESP_LOGI(ENERGY_METER_TAG, "restored: lifetime %.3f Wh", static_cast<double>(toWh(S_RUNNING.lifetimeNJ)));
+        }
+    } else {
+        ESP_LOGE(ENERGY_METER_TAG, "NVS unavailable, counters start at zero: %s", esp_err_to_name(err));
+    }
+    S_TOTALS.write(S_RUNNING);
+
+    if (err == ESP_OK) {
+        xTaskCreate(checkpointTask, "energy_checkpoint", 3072, nullptr, 2, nullptr);
+    }
+    currentSensorAddListener(onSample);
+}
+
+EnergyCounters energyMeterGet() {
+    const Totals totals = S_TOTALS.read();
+    return {
+            .sessionWh = toWh(totals.sessionNJ),
+            .sessionMAh = toMAh(totals.sessionNC),
+            .lifetimeWh = toWh(totals.lifetimeNJ),
+            .lifetimeMAh = toMAh(totals.lifetimeNC),
+    };
+}
+
+void energyMeterResetSession() {
+    S_RESET_REQUESTED.store(true, std::memory_order_relaxed);
+}
+
+EnergyMeterStats energyMeterGetStats() {
+    return S_STATS;
+}
@@ -0,0 +1,394 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/fault_journal.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <nvs.h>
+
+#include "include/byte_order.hpp"
+#include "include/efuse.hpp"
+#include "include/seqlock.hpp"
+#include "include/serial_pack.hpp"
+
+static constexpr auto FAULT_JOURNAL_TAG = "[lumen:fault]";
+static constexpr auto K_PATH = "fault";
+static constexpr auto K_NVS_NAMESPACE = "lumen";
+static constexpr auto K_NVS_KEY = "faults";
+static constexpr uint32_t K_SAVE_VERSION = 1;
+// A load that trips again after every auto recovery must not write the flash every few seconds; the newest state is
+// saved at most this often.
+static constexpr int64_t K_SAVE_INTERVAL_US = 30LL * 1000 * 1000;
+static constexpr size_t K_HEADER_LEN = 11;
+static constexpr size_t K_RECORD_WIRE_LEN = 30;
+static constexpr size_t K_REQUEST_MAX = 6;
+static constexpr size_t K_REPLY_MAX = K_HEADER_LEN + 1 + FAULT_JOURNAL_MAX_READ * K_RECORD_WIRE_LEN;
+
+namespace {
+    struct Saved {
+        uint32_t version;
+        uint16_t boot;
+        uint16_t reserved;
+        uint32_t nextId;
+        uint32_t causes[FAULT_CAUSE_COUNT];
+        FaultRecord records[FAULT_JOURNAL_CAPACITY];
+    };
+
+    // record id % FAULT_JOURNAL_CAPACITY
+    SeqLock<FaultRecord> S_SLOTS[FAULT_JOURNAL_CAPACITY];
+    // published after the slot of the new record is written
+    std::atomic<uint32_t> S_NEXT_ID{1};
+    std::atomic<uint32_t> S_CAUSES[FAULT_CAUSE_COUNT] = {};
+    std::atomic<uint32_t> S_SAVES{0};
+    std::atomic<uint32_t> S_SAVE_ERRORS{0};
+    uint16_t S_BOOT = 1;
+    TaskHandle_t S_TASK = nullptr;
+    nvs_handle_t S_NVS = 0;
+    bool S_NVS_OPEN = false;
+    bool S_STARTED = false;
+
+    // the incident in progress, efuse task only
+    FaultRecord S_OPEN = {};
+    bool S_IS_OPEN = false;
+
+    // journal task only
+    Saved S_SAVED = {};
+
+    // serial worker only
+    uint8_t S_REQUEST[K_REQUEST_MAX] = {};
+    size_t S_REQUEST_LEN = 0;
+    uint8_t S_REPLY[K_REPLY_MAX] = {};
+
+    void publish() {
+        S_SLOTS[S_OPEN.id % FAULT_JOURNAL_CAPACITY].write(S_OPEN);
+        if (S_TASK) {
+            xTaskNotifyGive(S_TASK);
+        }
+    }
+
+    void countCauses(const uint8_t added) {
+        for (size_t i = 0; i < FAULT_CAUSE_COUNT; ++i) {
+            if (added & (1U << i)) {
+                S_CAUSES[i].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    uint32_t toMs(const int64_t us) {
+        return static_cast<uint32_t>(us / 1000);
+    }
+
+    uint8_t* writeHeader(uint8_t* out, const FaultJournalOp op) {
+        *out++ = static_cast<uint8_t>(op) | FAULT_JOURNAL_REPLY;
+        out = writeU16Le(out, S_BOOT);
+        out = writeU32Le(out, toMs(esp_timer_get_time()));
+        return writeU32Le(out, S_NEXT_ID.load(std::memory_order_acquire));
+    }
+
+    uint8_t* writeRecord(uint8_t* out, const FaultRecord& record) {
+        out = writeU32Le(out, record.id);
+        out = writeU16Le(out, record.boot);
+        *out++ = record.causes;
+        *out++ = static_cast<uint8_t>(record.recovery);
+        out = writeU32Le(out, toMs(record.startUs));
+        out = writeU32Le(out, record.durationMs);
+        out = writeF32Le(out, record.peakMA);
+        out = writeF32Le(out, record.peakMV);
+        out = writeU16Le(out, static_cast<uint16_t>(record.limitMA));
+        out = writeU16Le(out, static_cast<uint16_t>(record.hardLimitMA));
+        return writeU16Le(out, static_cast<uint16_t>(record.limitMV));
+    }
+
+    bool load() {
+        size_t size = sizeof(S_SAVED);
+        const esp_err_t err = nvs_get_blob(S_NVS, K_NVS_KEY, &S_SAVED, &size);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            return false;
+        }
+        if (err != ESP_OK || size != sizeof(S_SAVED) || S_SAVED.version != K_SAVE_VERSION) {
+            ESP_LOGW(FAULT_JOURNAL_TAG, "ignoring saved journal: %s", esp_err_to_name(err));
+            return false;
+        }
+
+        size_t interrupted = 0;
+        for (FaultRecord record : S_SAVED.records) {
+            if (record.id == 0) {
+                continue;
+            }
+            if (record.recovery == FaultRecovery::Ongoing) {
+                record.recovery = FaultRecovery::Reboot;
+                ++interrupted;
+            }
+            S_SLOTS[record.id % FAULT_JOURNAL_CAPACITY].write(record);
+        }
+        for (size_t i = 0; i < FAULT_CAUSE_COUNT; ++i) {
+            S_CAUSES[i].store(S_SAVED.causes[i], std::memory_order_relaxed);
+        }
+        S_NEXT_ID.store(std::max<uint32_t>(S_SAVED.nextId, 1), std::memory_order_release);
+        S_BOOT = static_cast<uint16_t>(S_SAVED.boot + 1);
+        ESP_LOGI(
+                FAULT_JOURNAL_TAG,
+                "restored %u incidents (%u cut short by a restart), boot %u",
+                static_cast<unsigned>(S_SAVED.nextId - 1),
+                static_cast<unsigned>(interrupted),
+                S_BOOT
+        );
+        return true;
+    }
+
+    bool save() {
+        S_SAVED = {
+                .version = K_SAVE_VERSION,
+                .boot = S_BOOT,
+                .reserved = 0,
+                .nextId = S_NEXT_ID.load(std::memory_order_acquire),
+                .causes = {},
+                .records = {},
+        };
+        for (size_t i = 0; i < FAULT_CAUSE_COUNT; ++i) {
+            S_SAVED.causes[i] = S_CAUSES[i].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < FAULT_JOURNAL_CAPACITY; ++i) {
+            S_SAVED.records[i] = S_SLOTS[i].read();
+        }
+        esp_err_t err = nvs_set_blob(S_NVS, K_NVS_KEY, &S_SAVED, sizeof(S_SAVED));
+        if (err == ESP_OK) {
+            err = nvs_commit(S_NVS);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(FAULT_JOURNAL_TAG, "save failed: %s", esp_err_to_name(err));
+            return false;
+        }
+        return true;
+    }
+
+    // Send every record that changed since the last call as an Event: the one that was newest then (it may have
+    // been closed since) and all opened after it.
+    void stream(uint32_t& streamedId) {
+        const uint32_t next = S_NEXT_ID.load(std::memory_order_acquire);
+        uint8_t event[K_HEADER_LEN + 1 + K_RECORD_WIRE_LEN];
+        for (uint32_t id = streamedId; id < next; ++id) {
+            FaultRecord record = {};
+            if (faultJournalRead(id, &record, 1) == 0 || record.id != id) {
+                continue;
+            }
+            uint8_t* out = writeHeader(event, FaultJournalOp::Event);
+            *out++ = 1;
+            out = writeRecord(out, record);
+            serialPackSend(K_PATH, event, static_cast<size_t>(out - event));
+        }
+        streamedId = next > 1 ? next - 1 : 1;
+    }
+
+    [[noreturn]]
+    void journalTask(void*) {
+        uint32_t streamedId = S_NEXT_ID.load(std::memory_order_acquire);
+        bool dirty = false;
+        int64_t savedUs = -K_SAVE_INTERVAL_US;
+
+        while (true) {
+            TickType_t wait = portMAX_DELAY;
+            if (dirty) {
+                const int64_t remainingUs = savedUs + K_SAVE_INTERVAL_US - esp_timer_get_time();
+                wait = remainingUs > 0 ? pdMS_TO_TICKS(remainingUs / 1000) + 1 : 0;
+            }
+            if (ulTaskNotifyTake(pdTRUE, wait) > 0) {
+                stream(streamedId);
+                dirty = true;
+            }
+
+            const int64_t nowUs = esp_timer_get_time();
+            if (!dirty || nowUs - savedUs < K_SAVE_INTERVAL_US) {
+                continue;
+            }
+            dirty = false;
+            if (!S_NVS_OPEN || !LUMEN_CONFIG_VALUES.persistFaults) {
+                continue;
+            }
+            if (save()) {
+                S_SAVES.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                S_SAVE_ERRORS.fetch_add(1, std::memory_order_relaxed);
+            }
+            savedUs = nowUs;
+        }
+    }
+
+    void handleRequest(const uint8_t* data, const size_t size) {
+        const auto op = static_cast<FaultJournalOp>(size > 0 ? data[0] : 0);
+        uint8_t* out = S_REPLY;
+        if (op == FaultJournalOp::Read && size == 6) {
+            FaultRecord records[FAULT_JOURNAL_MAX_READ];
+            const size_t count = faultJournalRead(
+                    readU32Le(data + 1),
+                    records,
+                    std::min<size_t>(data[5], FAULT_JOURNAL_MAX_READ)
+            );
+            out = writeHeader(out, op);
+            *out++ = static_cast<uint8_t>(count);
+            for (size_t i = 0; i < count; ++i) {
+                out = writeRecord(out, records[i]);
+            }
+        } else if (op == FaultJournalOp::Stats && size == 1) {
+            const FaultJournalStats stats = faultJournalGetStats();
+            out = writeHeader(out, op);
+            for (const uint32_t count : stats.causes) {
+                out = writeU32Le(out, count);
+            }
+            out = writeU32Le(out, stats.saves);
+            out = writeU32Le(out, stats.saveErrors);
+            const EfuseFastTripStats fastTrip = efuseGetFastTripStats();
+            out = writeU32Le(out, fastTrip.trips);
+            out = writeU32Le(out, fastTrip.lastCutoffUs);
+            out = writeU32Le(out, fastTrip.maxCutoffUs);
+            out = writeU32Le(out, fastTrip.lastPollUs);
+            out = writeU32Le(out, fastTrip.maxPollUs);
+        } else {
+            ESP_LOGW(FAULT_JOURNAL_TAG, "malformed request (%u bytes)", static_cast<unsigned>(size));
+            return;
+        }
+        serialPackSend(K_PATH, S_REPLY, static_cast<size_t>(out - S_REPLY));
+    }
+} // namespace
+
+void faultJournalInit() {
+    if (S_STARTED) {
+        return;
+    }
+    S_STARTED = true;
+
+    const esp_err_t err = nvs_open(K_NVS_NAMESPACE, NVS_READWRITE, &S_NVS);
+    S_NVS_OPEN = err == ESP_OK;
+    if (S_NVS_OPEN) {
+        load();
+    } else {
+        ESP_LOGE(FAULT_JOURNAL_TAG, "NVS unavailable, the journal is not persisted: %s", esp_err_to_name(err));
+    }
+    xTaskCreate(journalTask, "fault_journal", 3072, nullptr, 2, &S_TASK);
+}
+
+void faultJournalOpen(const uint8_t causes, const CurrentSensorSample& sample) {
+    if (S_IS_OPEN) {
+        faultJournalUpdate(causes, sample);
+        return;
+    }
+    S_OPEN = {
+            .id = S_NEXT_ID.load(std::memory_order_relaxed),
+            .boot = S_BOOT,
+            .causes = causes,
+            .recovery = FaultRecovery::Ongoing,
+            .startUs = esp_timer_get_time(),
+            .durationMs = 0,
+            .peakMA = sample.currentMA,
+            .peakMV = sample.busVoltageMV,
+            .limitMA = LUMEN_CONFIG_VALUES.overcurrentMA,
+            .hardLimitMA = LUMEN_CONFIG_VALUES.overcurrentHardMA,
+            .limitMV = LUMEN_CONFIG_VALUES.overvoltageMV,
+    };
+    S_IS_OPEN = true;
+    countCauses(causes);
+    S_SLOTS[S_OPEN.id % FAULT_JOURNAL_CAPACITY].write(S_OPEN);
+    // readers see the slot before the id
+    S_NEXT_ID.store(S_OPEN.id + 1, std::memory_order_release);
+    if (S_TASK) {
+        xTaskNotifyGive(S_TASK);
+    }
+}
+
+void faultJournalUpdate(const uint8_t causes, const CurrentSensorSample& sample) {
+    if (!S_IS_OPEN) {
+        return;
+    }
+    const auto added = static_cast<uint8_t>(causes & ~S_OPEN.causes);
+    if (added == 0 && sample.currentMA <= S_OPEN.peakMA && sample.busVoltageMV <= S_OPEN.peakMV) {
+        return;
+    }
+    countCauses(added);
+    S_OPEN.causes |= causes;
+    S_OPEN.peakMA = std::max(S_OPEN.peakMA, sample.currentMA);
+    S_OPEN.peakMV = std::max(S_OPEN.peakMV, sample.busVoltageMV);
+    publish();
+}
+
+void faultJournalClose(const FaultRecovery recovery) {
+    if (!S_IS_OPEN) {
+        return;
+    }
+    S_OPEN.recovery = recovery;
+    S_OPEN.durationMs = toMs(esp_timer_get_time() - S_OPEN.startUs);
+    S_IS_OPEN = false;
+    publish();
+}
+
+size_t faultJournalRead(const uint32_t fromId, FaultRecord* out, const size_t maxRecords) {
+    const uint32_t next = S_NEXT_ID.load(std::memory_order_acquire);
+    const uint32_t oldest = next > FAULT_JOURNAL_CAPACITY ? next - FAULT_JOURNAL_CAPACITY : 1;
+    const int64_t nowUs = esp_timer_get_time();
+    size_t copied = 0;
+    for (uint32_t id = std::max(fromId, oldest); id < next && copied < maxRecords; ++id) {
+        FaultRecord record = S_SLOTS[id % FAULT_JOURNAL_CAPACITY].read();
+        // overwritten by a newer incident since `next` was read
+        if (record.id != id) {
+            continue;
+        }
+        if (record.recovery == FaultRecovery::Ongoing && record.boot == S_BOOT) {
+            record.durationMs = toMs(nowUs - record.startUs);
+        }
+        out[copied++] = record;
+    }
+    return copied;
+}
+
+FaultJournalStats faultJournalGetStats() {
+    FaultJournalStats stats = {
+            .boot = S_BOOT,
+            .nextId = S_NEXT_ID.load(std::memory_order_acquire),
+            .causes = {},
+            .saves = S_SAVES.load(std::memory_order_relaxed),
+            .saveErrors = S_SAVE_ERRORS.load(std::memory_order_relaxed),
+    };
+    for (size_t i = 0; i < FAULT_CAUSE_COUNT; ++i) {
+        stats.causes[i] = S_CAUSES[i].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void faultJournalHandler(const uint8_t* data, const size_t size) {
+    if (data && size > 0) {
+        if (S_REQUEST_LEN + size <= K_REQUEST_MAX) {
+            std::memcpy(S_REQUEST + S_REQUEST_LEN, data, size);
+        }
+        // keeps counting past the buffer, so an oversized request is rejected below
+        S_REQUEST_LEN += size;
+        return;
+    }
+    const size_t len = S_REQUEST_LEN;
+    S_REQUEST_LEN = 0;
+    if (serialPackAborted()) {
+        return;
+    }
+    handleRequest(S_REQUEST, len <= K_REQUEST_MAX ? len : 0);
+}
@@ -0,0 +1,258 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/image_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstring>
+
+#include <esp_log.h>
+#include <esp_partition.h>
+
+static constexpr auto IMAGE_CACHE_TAG = "[lumen:image_cache]";
+static constexpr esp_partition_subtype_t K_PARTITION_SUBTYPE = static_cast<esp_partition_subtype_t>(0x40);
+static constexpr size_t K_SLOT_SIZE = 0x1D000;
+static constexpr size_t K_SECTOR_SIZE = 0x1000;
+static constexpr size_t K_MAX_SLOTS = 8;
+static constexpr uint32_t K_MAGIC = 0x31434D49; // "IMC1"
+
+// Stored at the start of every slot, pixels follow. The magic is the last field so a header torn by a reset
+// during the write never validates.
+struct SlotHeader {
+    uint64_t hash;
+    uint32_t sequence;
+    uint16_t width;
+    uint16_t height;
+    uint32_t length;
+    uint32_t reserved[2];
+    uint32_t magic;
+};
+
+static_assert(sizeof(SlotHeader) == 32, "pixels start 4-byte aligned after the header");
+
+struct SlotState {
+    bool valid;
+    uint64_t hash;
+    uint32_t lastUse;
+    uint16_t width;
+    uint16_t height;
+};
+
+static const esp_partition_t* S_PARTITION = nullptr;
+static const uint8_t* S_MAPPED = nullptr;
+static esp_partition_mmap_handle_t S_MAP_HANDLE = 0;
+static SlotState S_SLOTS[K_MAX_SLOTS] = {};
+static uint8_t S_SLOT_COUNT = 0;
+static uint32_t S_USE_CLOCK = 0;
+// pins per slot; taken by lookups on the worker, copies may be retained and released on other tasks
+static std::atomic<uint16_t> S_PINS[K_MAX_SLOTS] = {};
+static bool S_INITIALIZED = false;
+static ImageCacheStats S_STATS = {};
+
+static const SlotHeader* slotHeader(const uint8_t slot) {
+    return reinterpret_cast<const SlotHeader*>(S_MAPPED + slot * K_SLOT_SIZE);
+}
+
+static const uint16_t* slotPixels(const uint8_t slot) {
+    return reinterpret_cast<const uint16_t*>(S_MAPPED + slot * K_SLOT_SIZE + sizeof(SlotHeader));
+}
+
+bool imageCacheInit() {
+    if (S_INITIALIZED) {
+        return S_MAPPED != nullptr;
+    }
+    S_INITIALIZED = true;
+
+    S_PARTITION = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, K_PARTITION_SUBTYPE, "imgcache");
+    if (!S_PARTITION) {
+        ESP_LOGW(IMAGE_CACHE_TAG, "no imgcache partition, caching disabled");
+        return false;
+    }
+
+    S_SLOT_COUNT = static_cast<uint8_t>(std::min(S_PARTITION->size / K_SLOT_SIZE, K_MAX_SLOTS));
+    if (S_SLOT_COUNT == 0) {
+        ESP_LOGW(IMAGE_CACHE_TAG, "imgcache partition too small");
+        return false;
+    }
+
+    const void* mapped = nullptr;
+    if (const esp_err_t err = esp_partition_mmap(
+                S_PARTITION,
+                0,
+                S_SLOT_COUNT * K_SLOT_SIZE,
+                ESP_PARTITION_MMAP_DATA,
+                &mapped,
+                &S_MAP_HANDLE
+        );
+        err != ESP_OK) {
+        ESP_LOGE(IMAGE_CACHE_TAG, "esp_partition_mmap failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    S_MAPPED = static_cast<const uint8_t*>(mapped);
+
+    for (uint8_t i = 0; i < S_SLOT_COUNT; ++i) {
+        const SlotHeader* header = slotHeader(i);
+        const size_t expected = static_cast<size_t>(header->width) * header->height * sizeof(uint16_t);
+        if (header->magic != K_MAGIC || header->length != expected || expected + sizeof(SlotHeader) > K_SLOT_SIZE) {
+            S_SLOTS[i] = {};
+            continue;
+        }
+        S_SLOTS[i] = {
+                .valid = true,
+                .hash = header->hash,
+                .lastUse = header->sequence,
+                .width = header->width,
+                .height = header->height,
+        };
+        S_USE_CLOCK = std::max(S_USE_CLOCK, header->sequence);
+    }
+
+    S_STATS.slots = S_SLOT_COUNT;
+    ESP_LOGI(IMAGE_CACHE_TAG, "%u slots of %u bytes", S_SLOT_COUNT, static_cast<unsigned>(K_SLOT_SIZE));
+    return true;
+}
+
+bool imageCacheLookup(const uint64_t hash, ImageCacheEntry& out) {
+    if (!S_MAPPED) {
+        ++S_STATS.misses;
+        return false;
+    }
+
+    for (uint8_t i = 0; i < S_SLOT_COUNT; ++i) {
+        if (SlotState& slot = S_SLOTS[i]; slot.valid && slot.hash == hash) {
+            slot.lastUse = ++S_USE_CLOCK;
+            S_PINS[i].fetch_add(1, std::memory_order_relaxed);
+            out = {
+                    .width = slot.width,
+                    .height = slot.height,
+                    .pixels = slotPixels(i),
+                    .slot = i,
+            };
+            ++S_STATS.hits;
+            return true;
+        }
+    }
+    ++S_STATS.misses;
+    return false;
+}
+
+bool imageCacheStore(const uint64_t hash, const uint16_t width, const uint16_t height, const uint16_t* pixels) {
+    if (!S_MAPPED || !pixels) {
+        return false;
+    }
+
+    const size_t length = static_cast<size_t>(width) * height * sizeof(uint16_t);
+    if (length == 0 || length + sizeof(SlotHeader) > K_SLOT_SIZE) {
+        ESP_LOGW(IMAGE_CACHE_TAG, "image %ux%u does not fit a slot", width, height);
+        return false;
+    }
+
+    for (uint8_t i = 0; i < S_SLOT_COUNT; ++i) {
+        if (SlotState& slot = S_SLOTS[i]; slot.valid && slot.hash == hash) {
+            slot.lastUse = ++S_USE_CLOCK;
+            return true;
+        }
+    }
+
+    // A pin is only ever added to a pinned slot outside this task, so a slot seen unpinned here stays unpinned
+    // until the write is done.
+    uint8_t victim = IMAGE_CACHE_NO_SLOT;
+    for (uint8_t i = 0; i < S_SLOT_COUNT; ++i) {
+        if (S_PINS[i].load(std::memory_order_acquire) != 0) {
+            continue;
+        }
+        if (!S_SLOTS[i].valid) {
+            victim = i;
+            break;
+        }
+        if (victim == IMAGE_CACHE_NO_SLOT || S_SLOTS[i].lastUse < S_SLOTS[victim].lastUse) {
+            victim = i;
+        }
+    }
+    if (victim == IMAGE_CACHE_NO_SLOT) {
+        ESP_LOGW(IMAGE_CACHE_TAG, "every slot is in use, %016" PRIx64 " not stored", hash);
+        return false;
+    }
+
+    if (S_SLOTS[victim].valid) {
+        ++S_STATS.evictions;
+    }
+    S_SLOTS[victim].valid = false;
+
+    const size_t offset = victim * K_SLOT_SIZE;
+    const size_t eraseLen = (sizeof(SlotHeader) + length + K_SECTOR_SIZE - 1) & ~(K_SECTOR_SIZE - 1);
+    const SlotHeader header = {
+            .hash = hash,
+            .sequence = ++S_USE_CLOCK,
+            .width = width,
+            .height = height,
+            .length = static_cast<uint32_t>(length),
+            .reserved = {},
+            .magic = K_MAGIC,
+    };
+
+    esp_err_t err = esp_partition_erase_range(S_PARTITION, offset, eraseLen);
+    if (err == ESP_OK) {
+        err = esp_partition_write(S_PARTITION, offset + sizeof(SlotHeader), pixels, length);
+    }
+    if (err == ESP_OK) {
+        // header last: the slot only validates once the pixels are in place
+        err = esp_partition_write(S_PARTITION, offset, &header, sizeof(header));
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(IMAGE_CACHE_TAG, "slot %u write failed: %s", victim, esp_err_to_name(err));
+        return false;
+    }
+
+    S_SLOTS[victim] = {
+            .valid = true,
+            .hash = hash,
+            .lastUse = header.sequence,
+            .width = width,
+            .height = height,
+    };
+    ++S_STATS.stores;
+    ESP_LOGI(IMAGE_CACHE_TAG, "stored %016" PRIx64 " (%ux%u) in slot %u", hash, width, height, victim);
+    return true;
+}
+
+void imageCacheRetain(const ImageCacheEntry& entry) {
+    if (entry.slot < S_SLOT_COUNT) {
+        S_PINS[entry.slot].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void imageCacheRelease(ImageCacheEntry& entry) {
+    if (entry.slot < S_SLOT_COUNT) {
+        S_PINS[entry.slot].fetch_sub(1, std::memory_order_release);
+    }
+    entry = {};
+}
+
+ImageCacheStats imageCacheGetStats() {
+    return S_STATS;
+}
+
+uint64_t imageCacheHash(const uint8_t* data, const size_t len, uint64_t hash) {
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
@@ -0,0 +1,131 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/json_arena.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <esp_log.h>
+
+static constexpr auto JSON_ARENA_TAG = "[lumen:json_arena]";
+static constexpr size_t K_ALIGN = alignof(double);
+
+alignas(K_ALIGN) static uint8_t S_ARENA[JSON_ARENA_SIZE];
+static size_t S_USED = 0;
+static bool S_HOOKED = false;
+static JsonArenaStats S_STATS = {};
+
+static void* arenaMalloc(const size_t size) {
+    const size_t aligned = (size + K_ALIGN - 1) & ~(K_ALIGN - 1);
+    if (aligned <= JSON_ARENA_SIZE - S_USED) {
+        void* ptr = S_ARENA + S_USED;
+        S_USED += aligned;
+        S_STATS.highWater = std::max(S_STATS.highWater, S_USED);
+        ++S_STATS.arenaAllocations;
+        return ptr;
+    }
+
+    ++S_STATS.heapAllocations;
+    ++S_STATS.lastMessageHeapAllocations;
+    return malloc(size);
+}
+
+static void arenaFree(void* ptr) {
+    // arena memory is reclaimed in bulk by jsonArenaReset
+    if (const auto* p = static_cast<uint8_t*>(ptr); p >= S_ARENA && p < S_ARENA + JSON_ARENA_SIZE) {
+        return;
+    }
+    free(ptr);
+}
+
+void jsonArenaInit() {
+    if (S_HOOKED) {
+        return;
+    }
+    cJSON_Hooks hooks = {
+            .malloc_fn = arenaMalloc,
+            .free_fn = arenaFree,
+    };
+    cJSON_InitHooks(&hooks);
+    S_HOOKED = true;
+}
+
+void jsonArenaReset() {
+    if (S_STATS.lastMessageHeapAllocations > 0) {
+        ESP_LOGW(
+                JSON_ARENA_TAG,
+                "message spilled to heap: %" PRIu32 " allocations, arena %u B",
+                S_STATS.lastMessageHeapAllocations,
+                static_cast<unsigned>(JSON_ARENA_SIZE)
+        );
+    }
+    S_USED = 0;
+    ++S_STATS.messages;
+    S_STATS.lastMessageHeapAllocations = 0;
+}
+
+JsonArenaStats jsonArenaGetStats() {
+    return S_STATS;
+}
+
+uint32_t jsonExtract(const cJSON* object, const JsonSchemaField* schema, const size_t count, void* out) {
+    if (!cJSON_IsObject(object)) {
+        return 0;
+    }
+
+    auto* base = static_cast<uint8_t*>(out);
+    uint32_t found = 0;
+    for (const cJSON* item = object->child; item; item = item->next) {
+        if (!item->string) {
+            continue;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const JsonSchemaField& field = schema[i];
+            if ((found & (1U << i)) || strcmp(field.key, item->string) != 0) {
+                continue;
+            }
+            switch (field.type) {
+                case JsonFieldType::String:
+                    if (cJSON_IsString(item) && item->valuestring && field.capacity > 0) {
+                        const size_t n = std::min(strlen(item->valuestring), field.capacity - 1);
+                        std::memcpy(base + field.offset, item->valuestring, n);
+                        base[field.offset + n] = '\0';
+                        found |= 1U << i;
+                    }
+                    break;
+                case JsonFieldType::Float:
+                    if (cJSON_IsNumber(item)) {
+                        const auto value = static_cast<float>(item->valuedouble);
+                        std::memcpy(base + field.offset, &value, sizeof(value));
+                        found |= 1U << i;
+                    }
+                    break;
+                case JsonFieldType::Bool:
+                    if (cJSON_IsBool(item)) {
+                        const bool value = cJSON_IsTrue(item);
+                        std::memcpy(base + field.offset, &value, sizeof(value));
+                        found |= 1U << i;
+                    }
+                    break;
+            }
+            break;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,259 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/latency_trace.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "include/byte_order.hpp"
+#include "include/serial_pack.hpp"
+
+static constexpr auto LATENCY_TAG = "[lumen:latency]";
+static constexpr auto K_TIME_PATH = "time";
+static constexpr auto K_REPORT_PATH = "latency";
+static constexpr size_t K_TIME_MAX = 16;
+static constexpr size_t K_STAGE_COUNT = static_cast<size_t>(LatencyStage::Count);
+static constexpr size_t K_REPORT_LEN = 1 + 1 + 8 + 4 + K_STAGE_COUNT * 5 * sizeof(uint32_t) + sizeof(uint32_t);
+
+namespace {
+    enum class TraceState : uint8_t {
+        Free,
+        Pending,
+        Handled,
+    };
+
+    struct Trace {
+        TraceState state;
+        // host send time on the esp_timer clock, 0 when unknown
+        int64_t hostUs;
+        int64_t arrivalUs;
+        int64_t handledUs;
+    };
+
+    struct StageWindow {
+        uint32_t samples[LATENCY_WINDOW];
+        uint32_t next;
+        uint32_t count;
+    };
+
+    // Shared by the serial parser, the serial worker and the UI task; every access is a few loads and stores,
+    // so a spinlock is enough.
+    portMUX_TYPE S_LOCK = portMUX_INITIALIZER_UNLOCKED;
+    Trace S_TRACES[LATENCY_MAX_TRACES] = {};
+    uint8_t S_NEXT_TRACE = 0;
+    uint32_t S_DROPPED = 0;
+    int64_t S_PRESENTED_US = 0;
+    StageWindow S_STAGES[K_STAGE_COUNT] = {};
+    bool S_SYNCED = false;
+    int64_t S_OFFSET_US = 0;
+    uint32_t S_RTT_US = 0;
+
+    // reassembly, serial worker only
+    uint8_t S_TIME_BUFFER[K_TIME_MAX] = {};
+    size_t S_TIME_LEN = 0;
+
+    void addSample(const LatencyStage stage, const int64_t us) {
+        StageWindow& window = S_STAGES[static_cast<size_t>(stage)];
+        window.samples[window.next] = static_cast<uint32_t>(std::clamp<int64_t>(us, 0, UINT32_MAX));
+        window.next = (window.next + 1) % LATENCY_WINDOW;
+        window.count = std::min<uint32_t>(window.count + 1, LATENCY_WINDOW);
+    }
+
+    // nearest rank on a sorted window
+    uint32_t percentile(const uint32_t* sorted, const uint32_t count, const uint32_t p) {
+        const uint32_t rank = (p * count + 99) / 100;
+        return sorted[std::clamp<uint32_t>(rank, 1, count) - 1];
+    }
+
+    LatencyPercentiles stagePercentiles(const LatencyStage stage) {
+        uint32_t sorted[LATENCY_WINDOW];
+        taskENTER_CRITICAL(&S_LOCK);
+        const StageWindow& window = S_STAGES[static_cast<size_t>(stage)];
+        const uint32_t count = window.count;
+        std::memcpy(sorted, window.samples, count * sizeof(uint32_t));
+        taskEXIT_CRITICAL(&S_LOCK);
+
+        if (count == 0) {
+            return {};
+        }
+        std::sort(sorted, sorted + count);
+        return {
+                .count = count,
+                .p50Us = percentile(sorted, count, 50),
+                .p90Us = percentile(sorted, count, 90),
+                .p99Us = percentile(sorted, count, 99),
+                .maxUs = sorted[count - 1],
+        };
+    }
+
+    void handleTime(const uint8_t* data, const size_t size) {
+        if (size == 1 + sizeof(uint64_t) && data[0] == static_cast<uint8_t>(LatencyTimeKind::Probe)) {
+            uint8_t reply[1 + 3 * sizeof(uint64_t)];
+            uint8_t* out = reply;
+            *out++ = static_cast<uint8_t>(LatencyTimeKind::Probe);
+            std::memcpy(out, data + 1, sizeof(uint64_t));
+            out += sizeof(uint64_t);
+            out = writeU64Le(out, static_cast<uint64_t>(serialPackRxTime()));
+            writeU64Le(out, static_cast<uint64_t>(esp_timer_get_time()));
+            serialPackSend(K_TIME_PATH, reply, sizeof(reply));
+            return;
+        }
+
+        if (size == 1 + sizeof(int64_t) + sizeof(uint32_t) && data[0] == static_cast<uint8_t>(LatencyTimeKind::Set)) {
+            const auto offset = static_cast<int64_t>(readU64Le(data + 1));
+            const uint32_t rtt = readU32Le(data + 1 + sizeof(int64_t));
+            taskENTER_CRITICAL(&S_LOCK);
+            S_OFFSET_US = offset;
+            S_RTT_US = rtt;
+            S_SYNCED = true;
+            taskEXIT_CRITICAL(&S_LOCK);
+            ESP_LOGI(LATENCY_TAG, "clock synced, offset %" PRId64 " us, rtt %u us", offset, static_cast<unsigned>(rtt));
+            return;
+        }
+        ESP_LOGW(LATENCY_TAG, "malformed time message of %u bytes", static_cast<unsigned>(size));
+    }
+} // namespace
+
+uint8_t latencyTraceBegin(const char* path, const int64_t hostSendUs, const int64_t arrivalUs) {
+    // the measurement traffic itself never reaches the screen
+    if (strcmp(path, K_TIME_PATH) == 0 || strcmp(path, K_REPORT_PATH) == 0) {
+        return LATENCY_NO_TRACE;
+    }
+
+    taskENTER_CRITICAL(&S_LOCK);
+    const uint8_t index = S_NEXT_TRACE;
+    S_NEXT_TRACE = static_cast<uint8_t>((S_NEXT_TRACE + 1) % LATENCY_MAX_TRACES);
+    Trace& trace = S_TRACES[index];
+    if (trace.state != TraceState::Free) {
+        // nothing was presented for a long time (another page, or the display is idle)
+        ++S_DROPPED;
+    }
+    trace = {
+            .state = TraceState::Pending,
+            .hostUs = hostSendUs != 0 && S_SYNCED ? hostSendUs + S_OFFSET_US : 0,
+            .arrivalUs = arrivalUs,
+            .handledUs = 0,
+    };
+    taskEXIT_CRITICAL(&S_LOCK);
+    return index;
+}
+
+void latencyTraceHandled(const uint8_t index, const int64_t startUs, const int64_t doneUs) {
+    if (index >= LATENCY_MAX_TRACES) {
+        return;
+    }
+    taskENTER_CRITICAL(&S_LOCK);
+    if (Trace& trace = S_TRACES[index]; trace.state == TraceState::Pending) {
+        if (trace.hostUs != 0) {
+            addSample(LatencyStage::Link, trace.arrivalUs - trace.hostUs);
+        }
+        if (S_PRESENTED_US >= startUs) {
+            // the handler pushed its own frame, waiting for the next one would count a whole frame interval
+            addSample(LatencyStage::Handle, S_PRESENTED_US - trace.arrivalUs);
+            addSample(LatencyStage::Present, 0);
+            if (trace.hostUs != 0) {
+                addSample(LatencyStage::EndToEnd, S_PRESENTED_US - trace.hostUs);
+            }
+            trace.state = TraceState::Free;
+        } else {
+            addSample(LatencyStage::Handle, doneUs - trace.arrivalUs);
+            trace.state = TraceState::Handled;
+            trace.handledUs = doneUs;
+        }
+    }
+    taskEXIT_CRITICAL(&S_LOCK);
+}
+
+void latencyFramePresented(const int64_t presentUs) {
+    taskENTER_CRITICAL(&S_LOCK);
+    S_PRESENTED_US = presentUs;
+    for (Trace& trace : S_TRACES) {
+        if (trace.state != TraceState::Handled) {
+            continue;
+        }
+        addSample(LatencyStage::Present, presentUs - trace.handledUs);
+        if (trace.hostUs != 0) {
+            addSample(LatencyStage::EndToEnd, presentUs - trace.hostUs);
+        }
+        trace.state = TraceState::Free;
+    }
+    taskEXIT_CRITICAL(&S_LOCK);
+}
+
+void latencyTimeHandler(const uint8_t* data, const size_t size) {
+    if (data && size > 0) {
+        if (S_TIME_LEN + size <= K_TIME_MAX) {
+            std::memcpy(S_TIME_BUFFER + S_TIME_LEN, data, size);
+        }
+        // keeps counting past the buffer, so an oversized message is rejected below
+        S_TIME_LEN += size;
+        return;
+    }
+    const size_t len = S_TIME_LEN;
+    S_TIME_LEN = 0;
+    if (serialPackAborted()) {
+        return;
+    }
+    if (len <= K_TIME_MAX) {
+        handleTime(S_TIME_BUFFER, len);
+    }
+}
+
+void latencyReportHandler(const uint8_t* data, const size_t size) {
+    if (data && size > 0) {
+        return;
+    }
+
+    const LatencyReport report = latencyGetReport();
+    uint8_t payload[K_REPORT_LEN];
+    uint8_t* out = payload;
+    *out++ = LATENCY_REPORT_VERSION;
+    *out++ = report.synced ? 1 : 0;
+    out = writeU64Le(out, static_cast<uint64_t>(report.offsetUs));
+    out = writeU32Le(out, report.rttUs);
+    for (const LatencyPercentiles& stage : report.stages) {
+        out = writeU32Le(out, stage.count);
+        out = writeU32Le(out, stage.p50Us);
+        out = writeU32Le(out, stage.p90Us);
+        out = writeU32Le(out, stage.p99Us);
+        out = writeU32Le(out, stage.maxUs);
+    }
+    writeU32Le(out, report.droppedTraces);
+    serialPackSend(K_REPORT_PATH, payload, sizeof(payload));
+}
+
+LatencyReport latencyGetReport() {
+    LatencyReport report = {};
+    taskENTER_CRITICAL(&S_LOCK);
+    report.synced = S_SYNCED;
+    report.offsetUs = S_OFFSET_US;
+    report.rttUs = S_RTT_US;
+    report.droppedTraces = S_DROPPED;
+    taskEXIT_CRITICAL(&S_LOCK);
+    for (size_t i = 0; i < K_STAGE_COUNT; ++i) {
+        report.stages[i] = stagePercentiles(static_cast<LatencyStage>(i));
+    }
+    return report;
+}
@@ -0,0 +1,136 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/lz4_stream.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr size_t K_WINDOW_MASK = LZ4_STREAM_WINDOW - 1;
+static constexpr uint8_t K_LENGTH_MORE = 0x0F;
+static constexpr uint32_t K_MIN_MATCH = 4;
+
+void Lz4StreamDecoder::reset() {
+    pos = 0;
+    flushed = 0;
+    total = 0;
+    state = State::Token;
+    token = 0;
+    literalLen = 0;
+    matchLen = 0;
+    offset = 0;
+}
+
+void Lz4StreamDecoder::flush(const Sink sink, void* context) {
+    if (pos > flushed) {
+        sink(window + flushed, pos - flushed, context);
+    }
+    flushed = pos;
+}
+
+void Lz4StreamDecoder::put(const uint8_t byte, const Sink sink, void* context) {
+    window[pos++] = byte;
+    ++total;
+    if (pos == LZ4_STREAM_WINDOW) {
+        flush(sink, context);
+        pos = 0;
+        flushed = 0;
+    }
+}
+
+void Lz4StreamDecoder::copyMatch(const Sink sink, void* context) {
+    // byte by byte: the source may overlap the bytes being written (offset < length repeats a run)
+    for (uint32_t i = 0; i < matchLen; ++i) {
+        put(window[(pos - offset) & K_WINDOW_MASK], sink, context);
+    }
+    state = State::Token;
+}
+
+bool Lz4StreamDecoder::feed(const uint8_t* data, const size_t len, const Sink sink, void* context) {
+    size_t i = 0;
+    while (i < len) {
+        switch (state) {
+            case State::Token:
+                token = data[i++];
+                literalLen = token >> 4U;
+                matchLen = (token & K_LENGTH_MORE) + K_MIN_MATCH;
+                if (literalLen == K_LENGTH_MORE) {
+                    state = State::LiteralLength;
+                } else {
+                    state = literalLen > 0 ? State::Literals : State::Offset0;
+                }
+                break;
+            case State::LiteralLength: {
+                const uint8_t more = data[i++];
+                literalLen += more;
+                if (more != 0xFF) {
+                    state = State::Literals;
+                }
+                break;
+            }
+            case State::Literals: {
+                const size_t n = std::min<size_t>(literalLen, len - i);
+                for (size_t k = 0; k < n; ++k) {
+                    put(data[i + k], sink, context);
+                }
+                i += n;
+                literalLen -= static_cast<uint32_t>(n);
+                if (literalLen == 0) {
+                    state = State::Offset0;
+                }
+                break;
+            }
+            case State::Offset0:
+                offset = data[i++];
+                state = State::Offset1;
+                break;
+            case State::Offset1:
+                offset |= static_cast<uint16_t>(data[i++] << 8U);
+                if (offset == 0 || offset > LZ4_STREAM_WINDOW || offset > total) {
+                    state = State::Failed;
+                    return false;
+                }
+                if ((token & K_LENGTH_MORE) == K_LENGTH_MORE) {
+                    state = State::MatchLength;
+                } else {
+                    copyMatch(sink, context);
+                }
+                break;
+            case State::MatchLength: {
+                const uint8_t more = data[i++];
+                matchLen += more;
+                if (more != 0xFF) {
+                    copyMatch(sink, context);
+                }
+                break;
+            }
+            case State::Failed:
+                return false;
+        }
+    }
+    flush(sink, context);
+    return true;
+}
+
+bool Lz4StreamDecoder::finish(const Sink sink, void* context) {
+    if (state == State::Failed) {
+        return false;
+    }
+    flush(sink, context);
+    // the last sequence of a block carries literals only
+    return state == State::Offset0 || (state == State::Token && total == 0);
+}
@@ -0,0 +1,266 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/power_history.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "include/byte_order.hpp"
+#include "include/current_sensor.hpp"
+#include "include/serial_pack.hpp"
+
+static constexpr auto POWER_HISTORY_TAG = "[lumen:history]";
+static constexpr size_t K_LEVELS = static_cast<size_t>(HistoryResolution::Count) - 1;
+static constexpr int64_t K_LEVEL_PERIOD_US[K_LEVELS] = {
+        1000LL * 1000,
+        10LL * 1000 * 1000,
+        60LL * 1000 * 1000,
+        600LL * 1000 * 1000,
+};
+static constexpr size_t K_POINT_WIRE_LEN = (3 * HISTORY_CHANNELS + 1) * sizeof(int16_t);
+static constexpr size_t K_REPLY_HEADER_LEN = 11;
+
+namespace {
+    // The min, max and sum of a bucket being filled.
+    struct Aggregate {
+        int16_t min[HISTORY_CHANNELS];
+        int16_t max[HISTORY_CHANNELS];
+        int64_t sum[HISTORY_CHANNELS];
+        uint32_t count;
+    };
+
+    struct Level {
+        HistoryPoint points[HISTORY_LEVEL_POINTS];
+        // next slot to write, and how many slots hold points
+        size_t head;
+        size_t size;
+        Aggregate open;
+        int64_t openIndex;
+    };
+
+    struct RawPoint {
+        int16_t value[HISTORY_CHANNELS];
+    };
+
+    // written by the sampler task, copied out by queries
+    portMUX_TYPE S_LOCK = portMUX_INITIALIZER_UNLOCKED;
+    RawPoint S_RAW[HISTORY_RAW_POINTS] = {};
+    size_t S_RAW_HEAD = 0;
+    size_t S_RAW_SIZE = 0;
+    int64_t S_RAW_NEWEST_US = 0;
+    Level S_LEVELS[K_LEVELS] = {};
+    bool S_STARTED = false;
+
+    // serial worker only
+    uint8_t S_REQUEST[3] = {};
+    size_t S_REQUEST_LEN = 0;
+    HistoryPoint S_QUERY[HISTORY_MAX_REPLY_POINTS] = {};
+    uint8_t S_REPLY[K_REPLY_HEADER_LEN + HISTORY_MAX_REPLY_POINTS * K_POINT_WIRE_LEN] = {};
+
+    int16_t saturate(const float value) {
+        constexpr float lowest = std::numeric_limits<int16_t>::min();
+        constexpr float highest = std::numeric_limits<int16_t>::max();
+        return static_cast<int16_t>(std::lround(std::clamp(value, lowest, highest)));
+    }
+
+    void merge(Aggregate& into, const Aggregate& from) {
+        if (into.count == 0) {
+            into = from;
+            return;
+        }
+        for (size_t i = 0; i < HISTORY_CHANNELS; ++i) {
+            into.min[i] = std::min(into.min[i], from.min[i]);
+            into.max[i] = std::max(into.max[i], from.max[i]);
+            into.sum[i] += from.sum[i];
+        }
+        into.count += from.count;
+    }
+
+    void push(Level& level, const HistoryPoint& point) {
+        level.points[level.head] = point;
+        level.head = (level.head + 1) % HISTORY_LEVEL_POINTS;
+        level.size = std::min(level.size + 1, HISTORY_LEVEL_POINTS);
+    }
+
+    // Add a raw sample (level 0) or a closed bucket of the level below, starting at `timeUs`. With S_LOCK held.
+    void feed(const size_t index, const Aggregate& value, const int64_t timeUs) {
+        Level& level = S_LEVELS[index];
+        const int64_t bucket = timeUs / K_LEVEL_PERIOD_US[index];
+
+        if (level.open.count > 0 && bucket != level.openIndex) {
+            const Aggregate closed = level.open;
+            const int64_t closedIndex = level.openIndex;
+            HistoryPoint point = {};
+            for (size_t i = 0; i < HISTORY_CHANNELS; ++i) {
+                point.min[i] = closed.min[i];
+                point.max[i] = closed.max[i];
+                point.avg[i] = static_cast<int16_t>(closed.sum[i] / closed.count);
+            }
+            point.count = static_cast<uint16_t>(std::min<uint32_t>(closed.count, UINT16_MAX));
+            push(level, point);
+
+            // buckets nothing arrived for stay in the ring as empty points, so positions keep mapping to time
+            const int64_t missing = std::min<int64_t>(bucket - closedIndex - 1, HISTORY_LEVEL_POINTS);
+            for (int64_t i = 0; i < missing; ++i) {
+                push(level, {});
+            }
+
+            level.open = {};
+            if (index + 1 < K_LEVELS) {
+                feed(index + 1, closed, closedIndex * K_LEVEL_PERIOD_US[index]);
+            }
+        }
+
+        merge(level.open, value);
+        level.openIndex = bucket;
+    }
+
+    void onSample(const CurrentSensorSample& sample) {
+        const int16_t values[HISTORY_CHANNELS] = {
+                saturate(sample.busVoltageMV),
+                saturate(sample.currentMA),
+                saturate(sample.powerMW),
+        };
+        Aggregate single = {};
+        RawPoint raw = {};
+        for (size_t i = 0; i < HISTORY_CHANNELS; ++i) {
+            single.min[i] = values[i];
+            single.max[i] = values[i];
+            single.sum[i] = values[i];
+            raw.value[i] = values[i];
+        }
+        single.count = 1;
+
+        taskENTER_CRITICAL(&S_LOCK);
+        S_RAW[S_RAW_HEAD] = raw;
+        S_RAW_HEAD = (S_RAW_HEAD + 1) % HISTORY_RAW_POINTS;
+        S_RAW_SIZE = std::min(S_RAW_SIZE + 1, HISTORY_RAW_POINTS);
+        S_RAW_NEWEST_US = sample.timestampUs;
+        feed(0, single, sample.timestampUs);
+        taskEXIT_CRITICAL(&S_LOCK);
+    }
+} // namespace
+
+void powerHistoryInit() {
+    if (S_STARTED) {
+        return;
+    }
+    S_STARTED = true;
+    currentSensorAddListener(onSample);
+    ESP_LOGI(POWER_HISTORY_TAG, "recording, %u bytes", static_cast<unsigned>(sizeof(S_RAW) + sizeof(S_LEVELS)));
+}
+
+int64_t powerHistoryPeriodUs(const HistoryResolution resolution) {
+    if (resolution == HistoryResolution::Raw) {
+        return currentSensorSamplePeriodUs();
+    }
+    const auto index = static_cast<size_t>(resolution) - 1;
+    return index < K_LEVELS ? K_LEVEL_PERIOD_US[index] : 0;
+}
+
+size_t powerHistoryQuery(
+        const HistoryResolution resolution,
+        HistoryPoint* out,
+        const size_t maxPoints,
+        int64_t* newestEndUs
+) {
+    size_t count = 0;
+    int64_t endUs = 0;
+
+    taskENTER_CRITICAL(&S_LOCK);
+    if (resolution == HistoryResolution::Raw) {
+        count = std::min(maxPoints, S_RAW_SIZE);
+        for (size_t i = 0; i < count; ++i) {
+            const RawPoint& raw = S_RAW[(S_RAW_HEAD + HISTORY_RAW_POINTS - count + i) % HISTORY_RAW_POINTS];
+            HistoryPoint& point = out[i];
+            for (size_t channel = 0; channel < HISTORY_CHANNELS; ++channel) {
+                point.min[channel] = raw.value[channel];
+                point.max[channel] = raw.value[channel];
+                point.avg[channel] = raw.value[channel];
+            }
+            point.count = 1;
+        }
+        endUs = S_RAW_NEWEST_US;
+    } else if (const auto index = static_cast<size_t>(resolution) - 1; index < K_LEVELS) {
+        const Level& level = S_LEVELS[index];
+        count = std::min(maxPoints, level.size);
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = level.points[(level.head + HISTORY_LEVEL_POINTS - count + i) % HISTORY_LEVEL_POINTS];
+        }
+        // the newest closed bucket ends where the open one starts
+        endUs = level.openIndex * K_LEVEL_PERIOD_US[index];
+    }
+    taskEXIT_CRITICAL(&S_LOCK);
+
+    if (newestEndUs) {
+        *newestEndUs = endUs;
+    }
+    return count;
+}
+
+void powerHistoryHandler(const uint8_t* data, const size_t size) {
+    if (data && size > 0) {
+        if (S_REQUEST_LEN + size <= sizeof(S_REQUEST)) {
+            std::memcpy(S_REQUEST + S_REQUEST_LEN, data, size);
+        }
+        // keeps counting past the buffer, so an oversized request is rejected below
+        S_REQUEST_LEN += size;
+        return;
+    }
+    const size_t len = S_REQUEST_LEN;
+    S_REQUEST_LEN = 0;
+    if (serialPackAborted()) {
+        return;
+    }
+    if (len != sizeof(S_REQUEST) || S_REQUEST[0] >= static_cast<uint8_t>(HistoryResolution::Count)) {
+        ESP_LOGW(POWER_HISTORY_TAG, "malformed query (%u bytes)", static_cast<unsigned>(len));
+        return;
+    }
+
+    const auto resolution = static_cast<HistoryResolution>(S_REQUEST[0]);
+    const size_t wanted = static_cast<size_t>(S_REQUEST[1]) | (static_cast<size_t>(S_REQUEST[2]) << 8U);
+    int64_t newestEndUs = 0;
+    const size_t count =
+            powerHistoryQuery(resolution, S_QUERY, std::min(wanted, HISTORY_MAX_REPLY_POINTS), &newestEndUs);
+    const int64_t ageUs = count > 0 ? std::max<int64_t>(esp_timer_get_time() - newestEndUs, 0) : 0;
+
+    uint8_t* out = S_REPLY;
+    *out++ = static_cast<uint8_t>(resolution);
+    out = writeU16Le(out, static_cast<uint16_t>(count));
+    out = writeU32Le(out, static_cast<uint32_t>(powerHistoryPeriodUs(resolution) / 1000));
+    out = writeU32Le(out, static_cast<uint32_t>(ageUs / 1000));
+    for (size_t i = 0; i < count; ++i) {
+        const HistoryPoint& point = S_QUERY[i];
+        for (const int16_t* values : {point.min, point.max, point.avg}) {
+            for (size_t channel = 0; channel < HISTORY_CHANNELS; ++channel) {
+                out = writeU16Le(out, static_cast<uint16_t>(values[channel]));
+            }
+        }
+        out = writeU16Le(out, point.count);
+    }
+    serialPackSend("hist", S_REPLY, static_cast<size_t>(out - S_REPLY));
+}
@@ -18,30 +18,94 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "include/serial_pack.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 
 #include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <freertos/task.h>
 
 #include <driver/usb_serial_jtag.h>
+#include <esp_cpu.h>
 #include <esp_err.h>
 #include <esp_log.h>
 #include <esp_timer.h>
 
+#include "include/byte_order.hpp"
+#include "include/latency_trace.hpp"
+#include "include/serial_pack_parser.hpp"
+
 
 constexpr char SERIAL_PACK_TAG[] = "[lumen:serial_pack]";
-constexpr size_t K_MAX_HANDLERS = 2;
-constexpr size_t K_MAX_PATH_LEN = 16;
-constexpr size_t K_MAX_DATA_LEN = 1024 * 2;
-constexpr int64_t K_RX_TIMEOUT_US = 3 * 1000 * 1000;
+constexpr size_t K_MAX_HANDLERS = 20;
+constexpr size_t K_RX_CHUNK_LEN = 512;
+// How long the parser task waits for more of a half received pack: a tick past SERIAL_PACK_RX_TIMEOUT_US, so
+// expire() sees the channels as idle once the read comes back empty.
+constexpr uint32_t K_RX_IDLE_WAIT_MS = SERIAL_PACK_RX_TIMEOUT_US / 1000 + portTICK_PERIOD_MS;
+constexpr uint8_t K_NO_SLOT = 0xFF;
+constexpr size_t K_WORK_QUEUE_LEN = SERIAL_PACK_POOL_BUFFERS * 2;
+constexpr uint32_t K_WORKER_STACK_SIZE = 1024 * 4;
+constexpr UBaseType_t K_WORKER_PRIORITY = 5;
+constexpr TickType_t K_POOL_WAIT = pdMS_TO_TICKS(SERIAL_PACK_POOL_WAIT_MS);
+// How often the parser task retries queueing a deferred end while the link is quiet.
+constexpr uint32_t K_END_RETRY_MS = 10;
+constexpr TickType_t K_TX_TIMEOUT = pdMS_TO_TICKS(100);
+constexpr char K_LINK_PATH[] = "link";
+constexpr size_t K_LINK_REPORT_LEN = 1 + 8 * sizeof(uint32_t) + 4 * sizeof(uint64_t);
 
 struct HandlerEntry {
-    char path[K_MAX_PATH_LEN];
-    SerialPackHandler handler;
+    char path[SERIAL_PACK_MAX_PATH_LEN];
+    std::atomic<SerialPackHandler> handler;
 };
 
+// Handlers may be attached while the parser task looks them up: a new entry is filled in before the count that
+// makes it visible is published. Writers serialize on S_HANDLER_LOCK.
 HandlerEntry S_HANDLERS[K_MAX_HANDLERS] = {};
-size_t S_HANDLER_COUNT = 0;
+std::atomic<size_t> S_HANDLER_COUNT{0};
+portMUX_TYPE S_HANDLER_LOCK = portMUX_INITIALIZER_UNLOCKED;
+
+// One unit of handler work. End-of-pack markers carry no buffer.
+struct WorkItem {
+    SerialPackHandler handler;
+    uint16_t len;
+    uint8_t slot;
+    // when the RX burst carrying this data was read
+    int64_t rxUs;
+    // latency trace of the pack, end-of-pack markers only
+    uint8_t trace;
+    // end-of-pack marker of a pack that never completed
+    bool aborted;
+};
+
+static_assert(SERIAL_PACK_POOL_BUFFERS < K_NO_SLOT, "slot index must fit in a byte");
+
+// Delivery of the pack in flight on each handler table entry, parser task only.
+struct PackDelivery {
+    // a piece of the pack was dropped: the rest is skipped and the pack ends aborted
+    bool failed;
+    // an end that found its lane full, queued before any later work of the handler
+    bool endPending;
+    uint8_t endPriority;
+    WorkItem end;
+};
+
+uint8_t S_POOL[SERIAL_PACK_POOL_BUFFERS][SERIAL_PACK_POOL_BUFFER_LEN] = {};
+QueueHandle_t S_FREE_SLOTS = nullptr;
+QueueHandle_t S_WORK_QUEUES[SERIAL_PACK_PRIORITY_LANES] = {};
+// counts the items in all lanes, the worker sleeps on it
+SemaphoreHandle_t S_WORK_READY = nullptr;
+TaskHandle_t S_WORKER_TASK = nullptr;
+PackDelivery S_DELIVERIES[K_MAX_HANDLERS] = {};
+size_t S_ENDS_PENDING = 0;
+SerialPackStats S_STATS = {};
+// RX time of the burst being parsed (parser task) and of the item being handled (worker task)
+int64_t S_BURST_US = 0;
+int64_t S_HANDLING_RX_US = 0;
+bool S_HANDLING_ABORTED = false;
+
+SemaphoreHandle_t S_TX_LOCK = nullptr;
 
 TaskHandle_t S_SERIAL_TASK = nullptr;
 volatile bool S_RUNNING = false;
@@ -66,164 +130,325 @@ void logUnhandledData(const char* path, const uint8_t* data, const size_t len, c
     );
 }
 
-SerialPackHandler findHandler(const char* path) {
-    for (size_t i = 0; i < S_HANDLER_COUNT; ++i) {
-        if (strcmp(S_HANDLERS[i].path, path) == 0) {
-            return S_HANDLERS[i].handler;
+[[noreturn]]
+void serialPackWorkerTask(void*) {
+    while (true) {
+        if (xSemaphoreTake(S_WORK_READY, portMAX_DELAY) != pdTRUE) {
+            continue;
         }
+        WorkItem item;
+        bool found = false;
+        for (size_t lane = SERIAL_PACK_PRIORITY_LANES; lane > 0 && !found; --lane) {
+            found = xQueueReceive(S_WORK_QUEUES[lane - 1], &item, 0) == pdTRUE;
+        }
+        if (!found) {
+            continue;
+        }
+        S_HANDLING_RX_US = item.rxUs;
+        if (item.slot == K_NO_SLOT) {
+            const int64_t start = esp_timer_get_time();
+            S_HANDLING_ABORTED = item.aborted;
+            item.handler(nullptr, 0);
+            S_HANDLING_ABORTED = false;
+            latencyTraceHandled(item.trace, start, esp_timer_get_time());
+            continue;
+        }
+        item.handler(S_POOL[item.slot], item.len);
+        xQueueSend(S_FREE_SLOTS, &item.slot, 0);
     }
-    return nullptr;
 }
 
-void resetState(char* path, size_t& pathLen, uint8_t* data, size_t& dataLen, bool& inData) {
-    path[0] = '\0';
-    pathLen = 0;
-    dataLen = 0;
-    inData = false;
+size_t workLane(const uint8_t priority) {
+    return std::min<size_t>(priority / SERIAL_PACK_PRIORITY_STEP, SERIAL_PACK_PRIORITY_LANES - 1);
 }
 
-void logUnhandledPath(const char* path, const uint8_t* data, const size_t len, const bool truncated) {
-    if (len > 0) {
-        logUnhandledData(path, data, len, truncated);
-    } else {
-        ESP_LOGW(SERIAL_PACK_TAG, "unhandled path '%s', size=0", path);
+bool queueWork(const WorkItem& item, const uint8_t priority, const TickType_t wait) {
+    if (xQueueSend(S_WORK_QUEUES[workLane(priority)], &item, wait) != pdTRUE) {
+        return false;
     }
+    // given after the item is queued, so the worker never wakes to empty lanes
+    xSemaphoreGive(S_WORK_READY);
+    const auto waiting = static_cast<uint32_t>(uxSemaphoreGetCount(S_WORK_READY));
+    S_STATS.queueHighWater = std::max(S_STATS.queueHighWater, waiting);
+    return true;
 }
 
-[[noreturn]]
-void serialPackTask(void*) {
-    static char path[K_MAX_PATH_LEN] = {};
-    size_t pathLen = 0;
-    static uint8_t data[K_MAX_DATA_LEN] = {};
-    size_t dataLen = 0;
-    bool inData = false;
-    bool discardUntilNewline = false;
-    uint8_t sizeBytes[sizeof(uint32_t)] = {};
-    size_t sizeIndex = 0;
-    uint32_t remaining = 0;
-    int64_t lastRxUs = esp_timer_get_time();
-
-    resetState(path, pathLen, data, dataLen, inData);
-
-    auto handleByte = [&](const uint8_t byte) {
-        if (discardUntilNewline) {
-            if (byte == '\n') {
-                discardUntilNewline = false;
-                resetState(path, pathLen, data, dataLen, inData);
-            }
-            return;
-        }
-
-        if (!inData) {
-            if (byte == '\r') {
-                return;
-            }
-            if (byte == '\n') {
-                if (pathLen == 0) {
-                    return;
-                }
-                path[pathLen] = '\0';
-                inData = true;
-                dataLen = 0;
-                sizeIndex = 0;
-                remaining = 0;
-                ESP_LOGD(SERIAL_PACK_TAG, "path is %s", path);
-                return;
-            }
+// Queue the end `delivery` still owes its handler. False while its lane stays full for `wait`.
+bool settleEnd(PackDelivery& delivery, const TickType_t wait) {
+    if (!delivery.endPending) {
+        return true;
+    }
+    if (!queueWork(delivery.end, delivery.endPriority, wait)) {
+        return false;
+    }
+    delivery.endPending = false;
+    --S_ENDS_PENDING;
+    return true;
+}
 
-            if (byte == ' ') {
-                ESP_LOGE(SERIAL_PACK_TAG, "invalid path: contains space");
-                discardUntilNewline = true;
-                return;
-            }
+// Retry every deferred end without blocking. True once none is left.
+bool settleEnds() {
+    for (size_t i = 0; i < K_MAX_HANDLERS && S_ENDS_PENDING > 0; ++i) {
+        settleEnd(S_DELIVERIES[i], 0);
+    }
+    return S_ENDS_PENDING == 0;
+}
 
-            if (pathLen + 1 >= K_MAX_PATH_LEN) {
-                ESP_LOGE(SERIAL_PACK_TAG, "path too long");
-                discardUntilNewline = true;
-                return;
-            }
+void failPack(PackDelivery& delivery) {
+    delivery.failed = true;
+    ++S_STATS.packsFailed;
+}
 
-            path[pathLen++] = static_cast<char>(byte);
-            return;
-        }
+// Copy `data` into pooled buffers and queue them for the worker, blocking while the pool is exhausted. A piece
+// that cannot be queued fails the pack of handler `index`: the handler gets none of the rest, and an aborted end.
+void dispatchData(const size_t index, const uint8_t priority, const uint8_t* data, size_t len) {
+    PackDelivery& delivery = S_DELIVERIES[index];
+    // data must not overtake the end of the previous pack
+    if (!delivery.failed && !settleEnd(delivery, K_POOL_WAIT)) {
+        ESP_LOGE(SERIAL_PACK_TAG, "worker stalled, failing pack of handler %u", static_cast<unsigned>(index));
+        failPack(delivery);
+    }
+    if (delivery.failed) {
+        ++S_STATS.chunksDropped;
+        return;
+    }
 
-        if (sizeIndex < sizeof(uint32_t)) {
-            sizeBytes[sizeIndex++] = byte;
-            if (sizeIndex < sizeof(uint32_t)) {
+    const SerialPackHandler handler = S_HANDLERS[index].handler.load(std::memory_order_relaxed);
+    while (len > 0) {
+        uint8_t slot = K_NO_SLOT;
+        if (xQueueReceive(S_FREE_SLOTS, &slot, 0) != pdTRUE) {
+            const int64_t start = esp_timer_get_time();
+            ++S_STATS.poolStalls;
+            const bool got = xQueueReceive(S_FREE_SLOTS, &slot, K_POOL_WAIT) == pdTRUE;
+            S_STATS.poolStallUs += static_cast<uint64_t>(esp_timer_get_time() - start);
+            if (!got) {
+                ++S_STATS.chunksDropped;
+                ESP_LOGE(SERIAL_PACK_TAG, "worker stalled, dropping %u bytes", static_cast<unsigned>(len));
+                failPack(delivery);
                 return;
             }
+        }
 
-            const uint32_t size = static_cast<uint32_t>(sizeBytes[0]) | (static_cast<uint32_t>(sizeBytes[1]) << 8U) |
-                                  (static_cast<uint32_t>(sizeBytes[2]) << 16U) |
-                                  (static_cast<uint32_t>(sizeBytes[3]) << 24U);
-            remaining = size;
-
-            if (remaining == 0) {
-                if (const SerialPackHandler handler = findHandler(path)) {
-                    handler(nullptr, 0);
-                } else {
-                    logUnhandledPath(path, nullptr, 0, false);
-                }
-                resetState(path, pathLen, data, dataLen, inData);
-            }
+        const size_t n = std::min(len, SERIAL_PACK_POOL_BUFFER_LEN);
+        std::memcpy(S_POOL[slot], data, n);
+        const WorkItem item = {handler, static_cast<uint16_t>(n), slot, S_BURST_US, LATENCY_NO_TRACE, false};
+        if (!queueWork(item, priority, K_POOL_WAIT)) {
+            xQueueSend(S_FREE_SLOTS, &slot, 0);
+            ++S_STATS.chunksDropped;
+            ESP_LOGE(SERIAL_PACK_TAG, "work queue full, dropping %u bytes", static_cast<unsigned>(n));
+            failPack(delivery);
             return;
         }
+        ++S_STATS.chunksQueued;
+        S_STATS.bytesQueued += static_cast<uint32_t>(n);
+        data += n;
+        len -= n;
+    }
+}
 
-        data[dataLen++] = byte;
-        if (remaining > 0) {
-            --remaining;
+// Queue the end of the pack of handler `index`. An end that finds its lane full is kept and queued later by the
+// parser task, before any later data of the handler.
+void dispatchEnd(const size_t index, const uint8_t priority, const uint8_t trace, const bool aborted) {
+    PackDelivery& delivery = S_DELIVERIES[index];
+    const bool failed = delivery.failed;
+    delivery.failed = false;
+    if (!settleEnd(delivery, K_POOL_WAIT)) {
+        // Still owing the previous end, this pack got none of its data through (see dispatchData). The owed end
+        // leaves the handler with nothing reassembled, which is all this one would do.
+        if (!failed) {
+            ++S_STATS.packsFailed;
         }
+        return;
+    }
 
-        if (dataLen >= K_MAX_DATA_LEN || remaining == 0) {
-            if (const SerialPackHandler handler = findHandler(path)) {
-                if (dataLen > 0) {
-                    handler(data, dataLen);
-                }
-            } else {
-                logUnhandledData(path, data, dataLen, remaining > 0);
-            }
-            dataLen = 0;
+    const SerialPackHandler handler = S_HANDLERS[index].handler.load(std::memory_order_relaxed);
+    const WorkItem end = {handler, 0, K_NO_SLOT, S_BURST_US, trace, aborted || failed};
+    if (!queueWork(end, priority, K_POOL_WAIT)) {
+        delivery.end = end;
+        delivery.endPriority = priority;
+        delivery.endPending = true;
+        ++S_ENDS_PENDING;
+        ++S_STATS.endsDeferred;
+        ESP_LOGW(SERIAL_PACK_TAG, "work queue full, deferring end of pack");
+    }
+}
+
+// Index of the handler table entry of `path`, K_MAX_HANDLERS if none is attached.
+size_t findHandler(const char* path) {
+    const size_t count = S_HANDLER_COUNT.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+        if (strcmp(S_HANDLERS[i].path, path) == 0) {
+            return i;
         }
+    }
+    return K_MAX_HANDLERS;
+}
 
-        if (remaining == 0) {
-            if (const SerialPackHandler handler = findHandler(path)) {
-                handler(nullptr, 0);
-            } else {
-                logUnhandledPath(path, nullptr, 0, false);
-            }
-            resetState(path, pathLen, data, dataLen, inData);
+// Hands parsed packs to the worker pool and turns parser diagnostics into log lines.
+class WorkerSink final : public SerialPackSink {
+public:
+    bool accepts(const char* path) override {
+        return findHandler(path) < K_MAX_HANDLERS;
+    }
+
+    void packData(const char* path, const uint8_t priority, const uint8_t* data, const size_t len) override {
+        if (const size_t index = findHandler(path); index < K_MAX_HANDLERS) {
+            dispatchData(index, priority, data, len);
         }
-    };
+    }
 
-    static uint8_t rx[128] = {};
-    while (S_RUNNING) {
-        const int read = usb_serial_jtag_read_bytes(rx, sizeof(rx), pdMS_TO_TICKS(20));
-        if (!S_RUNNING) {
-            break;
+    void unhandledData(const char* path, const uint8_t* data, const size_t len, const bool truncated) override {
+        logUnhandledData(path, data, len, truncated);
+    }
+
+    void packEnd(const char* path, const uint8_t priority, const int64_t hostUs, const int64_t arrivalUs) override {
+        if (const size_t index = findHandler(path); index < K_MAX_HANDLERS) {
+            dispatchEnd(index, priority, latencyTraceBegin(path, hostUs, arrivalUs), false);
+        } else {
+            ESP_LOGW(SERIAL_PACK_TAG, "unhandled path '%s', size=0", path);
         }
-        if (read <= 0) {
-            if (inData && sizeIndex >= sizeof(uint32_t) && remaining > 0) {
-                const int64_t now = esp_timer_get_time();
-                if (now - lastRxUs > K_RX_TIMEOUT_US) {
-                    ESP_LOGW(SERIAL_PACK_TAG, "rx timeout, aborting pack");
-                    resetState(path, pathLen, data, dataLen, inData);
-                    discardUntilNewline = false;
-                    sizeIndex = 0;
-                    remaining = 0;
-                    lastRxUs = now;
-                }
-            }
-            continue;
+    }
+
+    void packAborted(const char* path, const uint8_t priority) override {
+        if (const size_t index = findHandler(path); index < K_MAX_HANDLERS) {
+            dispatchEnd(index, priority, LATENCY_NO_TRACE, true);
         }
-        lastRxUs = esp_timer_get_time();
-        for (int i = 0; i < read; ++i) {
-            handleByte(rx[i]);
+    }
+
+    void inflated(const char* path, const uint32_t wireBytes, const uint32_t inflatedBytes, const uint32_t cycles)
+            override {
+        ++S_STATS.compressedPacks;
+        S_STATS.compressedBytes += wireBytes;
+        S_STATS.inflatedBytes += inflatedBytes;
+        S_STATS.inflateCycles += cycles;
+        // fixed point: this runs on the small parser task stack, which has no room for float formatting
+        const uint64_t ratio100 = wireBytes ? static_cast<uint64_t>(inflatedBytes) * 100 / wireBytes : 0;
+        const uint64_t perByte10 = inflatedBytes ? static_cast<uint64_t>(cycles) * 10 / inflatedBytes : 0;
+        ESP_LOGI(
+                SERIAL_PACK_TAG,
+                "'%s' lz4 %u -> %u bytes (x%u.%02u), %u cycles (%u.%u/byte)",
+                path,
+                static_cast<unsigned>(wireBytes),
+                static_cast<unsigned>(inflatedBytes),
+                static_cast<unsigned>(ratio100 / 100),
+                static_cast<unsigned>(ratio100 % 100),
+                static_cast<unsigned>(cycles),
+                static_cast<unsigned>(perByte10 / 10),
+                static_cast<unsigned>(perByte10 % 10)
+        );
+    }
+
+    void event(const SerialPackParseEvent event, const uint8_t channel, const char* path, const uint32_t value)
+            override {
+        const auto size = static_cast<unsigned>(value);
+        switch (event) {
+            case SerialPackParseEvent::LegacyPath:
+                ESP_LOGD(SERIAL_PACK_TAG, "path is %s", path);
+                return;
+            case SerialPackParseEvent::InvalidPath:
+                ESP_LOGE(SERIAL_PACK_TAG, "invalid path: contains space");
+                return;
+            case SerialPackParseEvent::PathTooLong:
+                ESP_LOGE(SERIAL_PACK_TAG, "path too long");
+                return;
+            case SerialPackParseEvent::PackTimeout:
+                ESP_LOGW(SERIAL_PACK_TAG, "rx timeout, aborting pack");
+                return;
+            case SerialPackParseEvent::FrameTooLong:
+                ESP_LOGE(SERIAL_PACK_TAG, "frame too long: %u", size);
+                return;
+            case SerialPackParseEvent::FrameTimeout:
+                ESP_LOGW(SERIAL_PACK_TAG, "rx timeout, dropping partial frame");
+                return;
+            case SerialPackParseEvent::UnknownChannel:
+                ESP_LOGE(SERIAL_PACK_TAG, "frame on unknown channel %u", channel);
+                return;
+            case SerialPackParseEvent::UnknownFrameType:
+                ESP_LOGE(SERIAL_PACK_TAG, "channel %u: unknown frame type %u", channel, size);
+                return;
+            case SerialPackParseEvent::InvalidOpen:
+                ESP_LOGE(SERIAL_PACK_TAG, "channel %u: invalid open frame", channel);
+                return;
+            case SerialPackParseEvent::InvalidChannelPath:
+                ESP_LOGE(SERIAL_PACK_TAG, "channel %u: invalid path", channel);
+                return;
+            case SerialPackParseEvent::Opened:
+                ESP_LOGD(SERIAL_PACK_TAG, "channel %u: path is %s, size=%u", channel, path, size);
+                return;
+            case SerialPackParseEvent::Reopened:
+                ESP_LOGW(SERIAL_PACK_TAG, "channel %u: reopened while '%s' was in flight", channel, path);
+                return;
+            case SerialPackParseEvent::DataWithoutOpen:
+                ESP_LOGW(SERIAL_PACK_TAG, "channel %u: data without open, size=%u", channel, size);
+                return;
+            case SerialPackParseEvent::FrameOverrun:
+                ESP_LOGE(SERIAL_PACK_TAG, "channel %u: frame overruns pack, aborting '%s'", channel, path);
+                return;
+            case SerialPackParseEvent::CorruptLz4:
+                ESP_LOGE(SERIAL_PACK_TAG, "channel %u: corrupt lz4 data, aborting '%s'", channel, path);
+                return;
+            case SerialPackParseEvent::InvalidStamp:
+                ESP_LOGE(SERIAL_PACK_TAG, "channel %u: invalid stamp frame", channel);
+                return;
+            case SerialPackParseEvent::Aborted:
+                ESP_LOGW(SERIAL_PACK_TAG, "channel %u: '%s' aborted by sender", channel, path);
+                return;
+            case SerialPackParseEvent::ChannelTimeout:
+                ESP_LOGW(SERIAL_PACK_TAG, "channel %u: rx timeout, aborting '%s'", channel, path);
+                return;
         }
     }
 
-    S_SERIAL_TASK = nullptr;
-    vTaskDelete(nullptr);
+    uint32_t cycleCount() override {
+        return esp_cpu_get_cycle_count();
+    }
+};
+
+class UsbSerialSource final : public SerialPackSource {
+public:
+    size_t read(uint8_t* data, const size_t len, const uint32_t timeoutMs) override {
+        const TickType_t wait = timeoutMs == SERIAL_PACK_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+        const int n = usb_serial_jtag_read_bytes(data, len, wait);
+        return n > 0 ? static_cast<size_t>(n) : 0;
+    }
+};
+
+WorkerSink S_SINK;
+UsbSerialSource S_SOURCE;
+SerialPackParser S_PARSER{S_SINK};
+
+[[noreturn]]
+void serialPackTask(void*) {
+    S_PARSER.reset();
+
+    // Block in the driver until the RX ring buffer has data, then drain whatever is queued before sleeping
+    // again. An idle link costs no wakeups and a bulk transfer is consumed in K_RX_CHUNK_LEN pieces.
+    static uint8_t rx[K_RX_CHUNK_LEN] = {};
     while (true) {
+        while (!S_RUNNING) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+
+        // A read that was blocked across serialPackStop still carries stream bytes; it is parsed before the task
+        // parks, so the parser never skips the middle of a pack. While a pack is half received the read is bounded,
+        // so a stalled sender still gets it aborted and its handler sees the aborted end. Deferred ends are retried
+        // every K_END_RETRY_MS until the worker makes room for them.
+        uint32_t waitMs = S_PARSER.pending() ? K_RX_IDLE_WAIT_MS : SERIAL_PACK_WAIT_FOREVER;
+        if (!settleEnds()) {
+            waitMs = std::min(waitMs, K_END_RETRY_MS);
+        }
+        size_t read = S_SOURCE.read(rx, sizeof(rx), waitMs);
+        const int64_t now = esp_timer_get_time();
+        if (S_PARSER.pending() && now - S_BURST_US > SERIAL_PACK_RX_TIMEOUT_US) {
+            S_PARSER.expire(now);
+        }
+        if (read > 0) {
+            S_BURST_US = now;
+        }
+        while (read > 0) {
+            S_PARSER.feed(rx, read, now);
+            read = S_RUNNING ? S_SOURCE.read(rx, sizeof(rx), 0) : 0;
+        }
     }
 }
 
@@ -242,6 +467,22 @@ void serialPackInit() {
         return;
     }
 
+    S_TX_LOCK = xSemaphoreCreateMutex();
+    S_FREE_SLOTS = xQueueCreate(SERIAL_PACK_POOL_BUFFERS, sizeof(uint8_t));
+    S_WORK_READY = xSemaphoreCreateCounting(K_WORK_QUEUE_LEN * SERIAL_PACK_PRIORITY_LANES, 0);
+    bool queuesCreated = S_TX_LOCK && S_FREE_SLOTS && S_WORK_READY;
+    for (QueueHandle_t& queue : S_WORK_QUEUES) {
+        queue = xQueueCreate(K_WORK_QUEUE_LEN, sizeof(WorkItem));
+        queuesCreated = queuesCreated && queue;
+    }
+    if (!queuesCreated) {
+        ESP_LOGE(SERIAL_PACK_TAG, "failed to create worker queues");
+        return;
+    }
+    for (uint8_t i = 0; i < SERIAL_PACK_POOL_BUFFERS; ++i) {
+        xQueueSend(S_FREE_SLOTS, &i, 0);
+    }
+
     S_INITIALIZED = true;
 }
 
@@ -254,7 +495,24 @@ void serialPackStart() {
         return;
     }
 
+    if (!S_WORKER_TASK) {
+        xTaskCreate(
+                serialPackWorkerTask,
+                "serial_pack_worker",
+                K_WORKER_STACK_SIZE,
+                nullptr,
+                K_WORKER_PRIORITY,
+                &S_WORKER_TASK
+        );
+    }
+
     S_RUNNING = true;
+    if (S_SERIAL_TASK) {
+        // parked by serialPackStop with the parser state kept and the rest of the stream left in the driver, so a
+        // pack split across a stop survives unless it goes stale (SERIAL_PACK_RX_TIMEOUT_US) in between
+        xTaskNotifyGive(S_SERIAL_TASK);
+        return;
+    }
     xTaskCreate(serialPackTask, "serial_pack", 1024 * 2, nullptr, 6, &S_SERIAL_TASK);
 }
 
@@ -272,22 +530,103 @@ void serialPackAttachHandler(const char* path, const SerialPackHandler handler)
         return;
     }
 
-    for (size_t i = 0; i < S_HANDLER_COUNT; ++i) {
+    bool replaced = false;
+    bool full = false;
+    taskENTER_CRITICAL(&S_HANDLER_LOCK);
+    const size_t count = S_HANDLER_COUNT.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count && !replaced; ++i) {
         if (strcmp(S_HANDLERS[i].path, path) == 0) {
-            S_HANDLERS[i].handler = handler;
-            return;
+            S_HANDLERS[i].handler.store(handler, std::memory_order_relaxed);
+            replaced = true;
         }
     }
+    if (!replaced && count >= K_MAX_HANDLERS) {
+        full = true;
+    } else if (!replaced) {
+        std::strncpy(S_HANDLERS[count].path, path, SERIAL_PACK_MAX_PATH_LEN - 1);
+        S_HANDLERS[count].path[SERIAL_PACK_MAX_PATH_LEN - 1] = '\0';
+        S_HANDLERS[count].handler.store(handler, std::memory_order_relaxed);
+        S_HANDLER_COUNT.store(count + 1, std::memory_order_release);
+    }
+    taskEXIT_CRITICAL(&S_HANDLER_LOCK);
 
-    if (S_HANDLER_COUNT >= K_MAX_HANDLERS) {
+    if (full) {
         ESP_LOGE(SERIAL_PACK_TAG, "handler table full");
-        return;
+    } else if (!replaced) {
+        ESP_LOGI(SERIAL_PACK_TAG, "handler %s is attached", path);
+    }
+}
+
+bool serialPackSend(const char* path, const uint8_t* data, const size_t len) {
+    const size_t pathLen = path ? strnlen(path, SERIAL_PACK_MAX_PATH_LEN) : 0;
+    if (!S_INITIALIZED || pathLen == 0 || pathLen >= SERIAL_PACK_MAX_PATH_LEN || (!data && len > 0)) {
+        return false;
+    }
+
+    // header plus the largest payload, either an Open frame or one Data frame
+    static uint8_t frame[SERIAL_PACK_FRAME_HEADER_LEN + 1 + SERIAL_PACK_MAX_FRAME_LEN] = {};
+    auto writeFrame = [](const SerialPackFrameType type, const size_t payloadLen) {
+        frame[0] = SERIAL_PACK_FRAME_MAGIC;
+        frame[1] = SERIAL_PACK_TX_CHANNEL;
+        frame[2] = static_cast<uint8_t>(type);
+        frame[3] = static_cast<uint8_t>(payloadLen & 0xFF);
+        frame[4] = static_cast<uint8_t>(payloadLen >> 8U);
+        const size_t total = SERIAL_PACK_FRAME_HEADER_LEN + 1 + payloadLen;
+        return usb_serial_jtag_write_bytes(frame, total, K_TX_TIMEOUT) == static_cast<int>(total);
+    };
+
+    if (xSemaphoreTake(S_TX_LOCK, K_TX_TIMEOUT) != pdTRUE) {
+        return false;
     }
 
-    ESP_LOGI(SERIAL_PACK_TAG, "handler %s is attached", path);
+    uint8_t* payload = frame + SERIAL_PACK_FRAME_HEADER_LEN + 1;
+    payload[0] = 0;
+    writeU32Le(payload + 1, static_cast<uint32_t>(len));
+    std::memcpy(payload + 1 + sizeof(uint32_t), path, pathLen);
+    bool ok = writeFrame(SerialPackFrameType::Open, 1 + sizeof(uint32_t) + pathLen);
+
+    for (size_t offset = 0; ok && offset < len; offset += SERIAL_PACK_MAX_FRAME_LEN) {
+        const size_t n = std::min(len - offset, SERIAL_PACK_MAX_FRAME_LEN);
+        std::memcpy(payload, data + offset, n);
+        ok = writeFrame(SerialPackFrameType::Data, n);
+    }
+
+    xSemaphoreGive(S_TX_LOCK);
+    return ok;
+}
+
+int64_t serialPackRxTime() {
+    return S_HANDLING_RX_US;
+}
+
+bool serialPackAborted() {
+    return S_HANDLING_ABORTED;
+}
+
+SerialPackStats serialPackGetStats() {
+    return S_STATS;
+}
+
+void serialPackLinkHandler(const uint8_t* data, const size_t size) {
+    if (data && size > 0) {
+        return;
+    }
 
-    std::strncpy(S_HANDLERS[S_HANDLER_COUNT].path, path, K_MAX_PATH_LEN - 1);
-    S_HANDLERS[S_HANDLER_COUNT].path[K_MAX_PATH_LEN - 1] = '\0';
-    S_HANDLERS[S_HANDLER_COUNT].handler = handler;
-    ++S_HANDLER_COUNT;
+    const SerialPackStats stats = serialPackGetStats();
+    uint8_t payload[K_LINK_REPORT_LEN];
+    uint8_t* out = payload;
+    *out++ = SERIAL_PACK_LINK_VERSION;
+    out = writeU32Le(out, stats.chunksQueued);
+    out = writeU32Le(out, stats.bytesQueued);
+    out = writeU32Le(out, stats.poolStalls);
+    out = writeU64Le(out, stats.poolStallUs);
+    out = writeU32Le(out, stats.chunksDropped);
+    out = writeU32Le(out, stats.queueHighWater);
+    out = writeU32Le(out, stats.packsFailed);
+    out = writeU32Le(out, stats.endsDeferred);
+    out = writeU32Le(out, stats.compressedPacks);
+    out = writeU64Le(out, stats.compressedBytes);
+    out = writeU64Le(out, stats.inflatedBytes);
+    writeU64Le(out, stats.inflateCycles);
+    serialPackSend(K_LINK_PATH, payload, sizeof(payload));
 }
@@ -0,0 +1,356 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/serial_pack_parser.hpp"
+
+#include <cstring>
+
+#include "include/byte_order.hpp"
+
+void SerialPackParser::reset() {
+    resetLegacy();
+    discardUntilNewline = false;
+    inFrame = false;
+    frameHeaderLen = 0;
+    frameLen = 0;
+    for (Channel& channel : channels) {
+        closeChannel(channel);
+        channel.stampUs = 0;
+    }
+}
+
+void SerialPackParser::feed(const uint8_t* bytes, const size_t len, const int64_t now) {
+    nowUs = now;
+    for (size_t i = 0; i < len; ++i) {
+        handleByte(bytes[i]);
+    }
+}
+
+void SerialPackParser::expire(const int64_t now) {
+    for (size_t i = 0; i < SERIAL_PACK_MAX_CHANNELS; ++i) {
+        if (Channel& channel = channels[i]; channel.open && now - channel.lastRxUs > SERIAL_PACK_RX_TIMEOUT_US) {
+            sink.event(SerialPackParseEvent::ChannelTimeout, static_cast<uint8_t>(i), channel.path, 0);
+            abortChannel(channel);
+        }
+    }
+    if (inFrame) {
+        sink.event(SerialPackParseEvent::FrameTimeout, frameHeader[0], "", 0);
+        inFrame = false;
+        frameHeaderLen = 0;
+        dataLen = 0;
+    }
+    if (inData) {
+        sink.event(SerialPackParseEvent::PackTimeout, 0, path, 0);
+        sink.packAborted(path, 0);
+        resetLegacy();
+        discardUntilNewline = false;
+    }
+}
+
+bool SerialPackParser::pending() const {
+    if (inFrame || inData) {
+        return true;
+    }
+    for (const Channel& channel : channels) {
+        if (channel.open) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SerialPackParser::resetLegacy() {
+    path[0] = '\0';
+    pathLen = 0;
+    dataLen = 0;
+    inData = false;
+    sizeIndex = 0;
+    remaining = 0;
+}
+
+void SerialPackParser::handleByte(const uint8_t byte) {
+    if (inFrame) {
+        handleFrameByte(byte);
+        return;
+    }
+
+    if (discardUntilNewline) {
+        if (byte == '\n') {
+            discardUntilNewline = false;
+            resetLegacy();
+        }
+        return;
+    }
+
+    if (!inData) {
+        if (pathLen == 0 && byte == SERIAL_PACK_FRAME_MAGIC) {
+            inFrame = true;
+            frameHeaderLen = 0;
+            return;
+        }
+        if (byte == '\r') {
+            return;
+        }
+        if (byte == '\n') {
+            if (pathLen == 0) {
+                return;
+            }
+            path[pathLen] = '\0';
+            inData = true;
+            dataLen = 0;
+            sizeIndex = 0;
+            remaining = 0;
+            sink.event(SerialPackParseEvent::LegacyPath, 0, path, 0);
+            return;
+        }
+
+        // a NUL would silently cut the path short, multiplexed Open frames reject it as well
+        if (byte == ' ' || byte == '\0') {
+            sink.event(SerialPackParseEvent::InvalidPath, 0, "", 0);
+            discardUntilNewline = true;
+            return;
+        }
+
+        if (pathLen + 1 >= SERIAL_PACK_MAX_PATH_LEN) {
+            sink.event(SerialPackParseEvent::PathTooLong, 0, "", 0);
+            discardUntilNewline = true;
+            return;
+        }
+
+        if (pathLen == 0) {
+            packStartUs = nowUs;
+        }
+        path[pathLen++] = static_cast<char>(byte);
+        return;
+    }
+
+    if (sizeIndex < sizeof(uint32_t)) {
+        sizeBytes[sizeIndex++] = byte;
+        if (sizeIndex < sizeof(uint32_t)) {
+            return;
+        }
+        remaining = readU32Le(sizeBytes);
+        if (remaining == 0) {
+            sink.packEnd(path, 0, 0, packStartUs);
+            resetLegacy();
+        }
+        return;
+    }
+
+    data[dataLen++] = byte;
+    --remaining;
+
+    if (dataLen >= SERIAL_PACK_POOL_BUFFER_LEN || remaining == 0) {
+        if (sink.accepts(path)) {
+            sink.packData(path, 0, data, dataLen);
+        } else {
+            sink.unhandledData(path, data, dataLen, remaining > 0);
+        }
+        dataLen = 0;
+    }
+
+    if (remaining == 0) {
+        sink.packEnd(path, 0, 0, packStartUs);
+        resetLegacy();
+    }
+}
+
+void SerialPackParser::handleFrameByte(const uint8_t byte) {
+    if (frameHeaderLen < SERIAL_PACK_FRAME_HEADER_LEN) {
+        frameHeader[frameHeaderLen++] = byte;
+        if (frameHeaderLen < SERIAL_PACK_FRAME_HEADER_LEN) {
+            return;
+        }
+        frameLen = static_cast<size_t>(frameHeader[2]) | (static_cast<size_t>(frameHeader[3]) << 8U);
+        dataLen = 0;
+        if (frameLen > SERIAL_PACK_MAX_FRAME_LEN) {
+            sink.event(SerialPackParseEvent::FrameTooLong, frameHeader[0], "", static_cast<uint32_t>(frameLen));
+        }
+    } else {
+        if (dataLen < SERIAL_PACK_MAX_FRAME_LEN) {
+            data[dataLen] = byte;
+        }
+        ++dataLen;
+    }
+
+    if (dataLen < frameLen) {
+        return;
+    }
+    // an oversized frame is skipped as a whole, so the stream stays in sync
+    if (frameLen <= SERIAL_PACK_MAX_FRAME_LEN) {
+        dispatchFrame();
+    }
+    inFrame = false;
+    frameHeaderLen = 0;
+    dataLen = 0;
+}
+
+void SerialPackParser::dispatchFrame() {
+    const uint8_t id = frameHeader[0];
+    if (id >= SERIAL_PACK_MAX_CHANNELS) {
+        sink.event(SerialPackParseEvent::UnknownChannel, id, "", 0);
+        return;
+    }
+
+    switch (static_cast<SerialPackFrameType>(frameHeader[1])) {
+        case SerialPackFrameType::Open:
+            openChannel(id, false);
+            return;
+        case SerialPackFrameType::OpenLz4:
+            openChannel(id, true);
+            return;
+        case SerialPackFrameType::Data:
+            channelData(id);
+            return;
+        case SerialPackFrameType::Stamp:
+            stampChannel(id);
+            return;
+        case SerialPackFrameType::Abort:
+            sink.event(SerialPackParseEvent::Aborted, id, channels[id].path, 0);
+            abortChannel(channels[id]);
+            return;
+    }
+    sink.event(SerialPackParseEvent::UnknownFrameType, id, "", frameHeader[1]);
+}
+
+void SerialPackParser::openChannel(const uint8_t id, const bool compressed) {
+    constexpr size_t fixedLen = sizeof(uint8_t) + sizeof(uint32_t);
+    const size_t len = frameLen;
+    if (len <= fixedLen || len - fixedLen >= SERIAL_PACK_MAX_PATH_LEN) {
+        sink.event(SerialPackParseEvent::InvalidOpen, id, "", static_cast<uint32_t>(len));
+        return;
+    }
+
+    Channel& channel = channels[id];
+    const uint64_t stampUs = channel.stampUs;
+    channel.stampUs = 0;
+    if (channel.open) {
+        sink.event(SerialPackParseEvent::Reopened, id, channel.path, channel.remaining);
+        abortChannel(channel);
+    }
+
+    const size_t channelPathLen = len - fixedLen;
+    if (memchr(data + fixedLen, ' ', channelPathLen) || memchr(data + fixedLen, '\0', channelPathLen)) {
+        sink.event(SerialPackParseEvent::InvalidChannelPath, id, "", 0);
+        closeChannel(channel);
+        return;
+    }
+    std::memcpy(channel.path, data + fixedLen, channelPathLen);
+    channel.path[channelPathLen] = '\0';
+    channel.priority = data[0];
+    channel.remaining = readU32Le(data + 1);
+    channel.lastRxUs = nowUs;
+    channel.arrivalUs = nowUs;
+    channel.hostUs = static_cast<int64_t>(stampUs);
+    channel.open = true;
+    channel.compressed = compressed && channel.remaining > 0;
+    channel.wireSize = channel.remaining;
+    channel.inflateCycles = 0;
+    if (channel.compressed) {
+        decoders[id].reset();
+    }
+    sink.event(SerialPackParseEvent::Opened, id, channel.path, channel.remaining);
+
+    if (channel.remaining == 0) {
+        finishChannel(channel);
+    }
+}
+
+void SerialPackParser::channelData(const uint8_t id) {
+    Channel& channel = channels[id];
+    const size_t len = frameLen;
+    if (!channel.open) {
+        sink.event(SerialPackParseEvent::DataWithoutOpen, id, "", static_cast<uint32_t>(len));
+        return;
+    }
+    if (len > channel.remaining) {
+        sink.event(SerialPackParseEvent::FrameOverrun, id, channel.path, static_cast<uint32_t>(len));
+        abortChannel(channel);
+        return;
+    }
+
+    channel.lastRxUs = nowUs;
+    channel.remaining -= static_cast<uint32_t>(len);
+    if (sink.accepts(channel.path)) {
+        if (!channel.compressed) {
+            sink.packData(channel.path, channel.priority, data, len);
+        } else if (!inflateFrame(id, channel)) {
+            sink.event(SerialPackParseEvent::CorruptLz4, id, channel.path, 0);
+            abortChannel(channel);
+            return;
+        }
+    } else {
+        sink.unhandledData(channel.path, data, len, channel.remaining > 0);
+    }
+
+    if (channel.remaining == 0) {
+        if (channel.compressed) {
+            sink.inflated(channel.path, channel.wireSize, decoders[id].produced(), channel.inflateCycles);
+        }
+        finishChannel(channel);
+    }
+}
+
+void SerialPackParser::stampChannel(const uint8_t id) {
+    if (frameLen != sizeof(uint64_t)) {
+        sink.event(SerialPackParseEvent::InvalidStamp, id, "", static_cast<uint32_t>(frameLen));
+        return;
+    }
+    channels[id].stampUs = readU64Le(data);
+}
+
+void SerialPackParser::inflateSink(const uint8_t* bytes, const size_t len, void* context) {
+    auto* inflate = static_cast<InflateContext*>(context);
+    SerialPackSink& sink = inflate->parser->sink;
+    const uint32_t start = sink.cycleCount();
+    sink.packData(inflate->path, inflate->priority, bytes, len);
+    inflate->dispatchCycles += sink.cycleCount() - start;
+}
+
+// Inflate one frame of an LZ4 pack straight into the sink. Cycles spent in the sink (which may wait for the
+// handler) are not counted as decompression.
+bool SerialPackParser::inflateFrame(const uint8_t id, Channel& channel) {
+    Lz4StreamDecoder& decoder = decoders[id];
+    InflateContext context = {this, channel.path, channel.priority, 0};
+    const uint32_t start = sink.cycleCount();
+    bool ok = decoder.feed(data, frameLen, inflateSink, &context);
+    if (ok && channel.remaining == 0) {
+        ok = decoder.finish(inflateSink, &context);
+    }
+    channel.inflateCycles += (sink.cycleCount() - start) - context.dispatchCycles;
+    return ok;
+}
+
+void SerialPackParser::finishChannel(Channel& channel) {
+    sink.packEnd(channel.path, channel.priority, channel.hostUs, channel.arrivalUs);
+    closeChannel(channel);
+}
+
+void SerialPackParser::abortChannel(Channel& channel) {
+    if (channel.open) {
+        sink.packAborted(channel.path, channel.priority);
+    }
+    closeChannel(channel);
+}
+
+void SerialPackParser::closeChannel(Channel& channel) {
+    channel.path[0] = '\0';
+    channel.remaining = 0;
+    channel.open = false;
+    channel.compressed = false;
+    channel.hostUs = 0;
+}
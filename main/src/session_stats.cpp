@@ -0,0 +1,284 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/session_stats.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <vision_ui_lib.h>
+
+#include "include/byte_order.hpp"
+#include "include/current_sensor.hpp"
+#include "include/efuse.hpp"
+#include "include/energy_meter.hpp"
+#include "include/seqlock.hpp"
+#include "include/serial_pack.hpp"
+#include "include/streaming_stats.hpp"
+
+static constexpr auto SESSION_STATS_TAG = "[lumen:session_stats]";
+static constexpr size_t K_CHANNEL_WIRE_LEN = 6 * sizeof(float) + sizeof(uint32_t);
+static constexpr size_t K_REPLY_LEN = 1 + 2 * sizeof(uint32_t) + 2 * K_CHANNEL_WIRE_LEN + 2 * sizeof(float);
+static constexpr size_t K_REQUEST_MAX = 2;
+// the view, below the sync page title like the transient capture scope
+static constexpr uint16_t K_VIEW_X = 10;
+static constexpr uint16_t K_VIEW_Y = 60;
+static constexpr uint16_t K_VIEW_ROW = 20;
+
+namespace {
+    struct ChannelEstimators {
+        RunningStats running;
+        P2Quantile p50{0.50F};
+        P2Quantile p95{0.95F};
+        P2Quantile p99{0.99F};
+        PeakHold peak;
+
+        void reset() {
+            running.reset();
+            p50.reset();
+            p95.reset();
+            p99.reset();
+            peak.reset();
+        }
+
+        void add(const float value, const int64_t timestampUs) {
+            running.add(value);
+            p50.add(value);
+            p95.add(value);
+            p99.add(value);
+            peak.add(value, timestampUs);
+        }
+
+        [[nodiscard]] SessionChannelStats summary() const {
+            return {
+                    .mean = static_cast<float>(running.mean()),
+                    .stddev = static_cast<float>(running.stddev()),
+                    .p50 = p50.value(),
+                    .p95 = p95.value(),
+                    .p99 = p99.value(),
+                    .peak = peak.value(),
+                    .peakUs = peak.timestampUs(),
+            };
+        }
+    };
+
+    SeqLock<SessionStats> S_PUBLISHED;
+    std::atomic<bool> S_RESET_REQUESTED{false};
+    // a `stats` reset waits for its reply
+    std::atomic<bool> S_RESET_REPLY{false};
+    std::atomic<bool> S_SHOW{false};
+    TaskHandle_t S_TASK = nullptr;
+    bool S_STARTED = false;
+
+    // sampler task only
+    ChannelEstimators S_CURRENT;
+    ChannelEstimators S_POWER;
+    SessionStats S_SESSION = {};
+    bool S_OUTPUT_WAS_OFF = true;
+    int64_t S_LAST_LOAD_US = 0;
+    bool S_REPLY_ON_NEXT = false;
+
+    // serial worker only
+    uint8_t S_REQUEST[K_REQUEST_MAX] = {};
+    size_t S_REQUEST_LEN = 0;
+
+    void startSession(const int64_t nowUs, const char* reason) {
+        S_CURRENT.reset();
+        S_POWER.reset();
+        S_SESSION = {.samples = 0, .startUs = nowUs, .currentMA = {}, .powerMW = {}};
+        S_PUBLISHED.write(S_SESSION);
+        energyMeterResetSession();
+        ESP_LOGI(SESSION_STATS_TAG, "new session: %s", reason);
+    }
+
+    void onSample(const CurrentSensorSample& sample) {
+        const int64_t nowUs = sample.timestampUs;
+        if (S_REPLY_ON_NEXT) {
+            // runs once this sample is done, the sampler has the higher priority
+            S_REPLY_ON_NEXT = false;
+            xTaskNotifyGive(S_TASK);
+        }
+        if (S_RESET_REQUESTED.exchange(false, std::memory_order_relaxed)) {
+            startSession(nowUs, "requested");
+            // the energy meter starts its session on its next sample, the reply waits for that one
+            S_REPLY_ON_NEXT = S_RESET_REPLY.exchange(false, std::memory_order_relaxed) && S_TASK;
+        }
+
+        const bool outputOff = LUMEN_CONFIG_VALUES.turnOffUsb || efuseHasFault();
+        if (outputOff) {
+            S_OUTPUT_WAS_OFF = true;
+            return;
+        }
+        if (sample.currentMA < SESSION_STATS_LOAD_MA) {
+            return;
+        }
+
+        if (S_OUTPUT_WAS_OFF) {
+            startSession(nowUs, "output on");
+        } else if (nowUs - S_LAST_LOAD_US >= SESSION_STATS_IDLE_US) {
+            startSession(nowUs, "plugged in");
+        }
+        S_OUTPUT_WAS_OFF = false;
+        S_LAST_LOAD_US = nowUs;
+
+        S_CURRENT.add(sample.currentMA, nowUs);
+        S_POWER.add(sample.powerMW, nowUs);
+        ++S_SESSION.samples;
+        S_SESSION.currentMA = S_CURRENT.summary();
+        S_SESSION.powerMW = S_POWER.summary();
+        S_PUBLISHED.write(S_SESSION);
+    }
+
+    uint32_t ageMs(const int64_t nowUs, const int64_t timestampUs) {
+        return timestampUs > 0 && nowUs > timestampUs ? static_cast<uint32_t>((nowUs - timestampUs) / 1000) : 0;
+    }
+
+    uint8_t* writeChannel(uint8_t* out, const SessionChannelStats& channel, const int64_t nowUs) {
+        for (const float value : {channel.mean, channel.stddev, channel.p50, channel.p95, channel.p99, channel.peak}) {
+            out = writeF32Le(out, value);
+        }
+        return writeU32Le(out, ageMs(nowUs, channel.peakUs));
+    }
+
+    void sendReply() {
+        const SessionStats stats = sessionStatsGet();
+        const EnergyCounters energy = energyMeterGet();
+        const int64_t nowUs = esp_timer_get_time();
+        uint8_t reply[K_REPLY_LEN];
+        uint8_t* out = reply;
+        *out++ = SESSION_STATS_VERSION;
+        out = writeU32Le(out, stats.samples);
+        out = writeU32Le(out, ageMs(nowUs, stats.startUs));
+        out = writeChannel(out, stats.currentMA, nowUs);
+        out = writeChannel(out, stats.powerMW, nowUs);
+        out = writeF32Le(out, energy.sessionWh);
+        out = writeF32Le(out, energy.sessionMAh);
+        serialPackSend("stats", reply, static_cast<size_t>(out - reply));
+    }
+
+    // Answers reset requests, so neither the serial worker nor the sampler waits on the other or on the link.
+    [[noreturn]]
+    void replyTask(void*) {
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            sendReply();
+        }
+    }
+} // namespace
+
+void sessionStatsInit() {
+    if (S_STARTED) {
+        return;
+    }
+    S_STARTED = true;
+    xTaskCreate(replyTask, "session_stats", 3072, nullptr, 2, &S_TASK);
+    currentSensorAddListener(onSample);
+}
+
+SessionStats sessionStatsGet() {
+    return S_PUBLISHED.read();
+}
+
+void sessionStatsReset() {
+    S_RESET_REQUESTED.store(true, std::memory_order_relaxed);
+}
+
+bool sessionStatsViewActive() {
+    return S_SHOW.load(std::memory_order_relaxed);
+}
+
+void sessionStatsDraw() {
+    const SessionStats stats = sessionStatsGet();
+    const EnergyCounters energy = energyMeterGet();
+    char text[32];
+    uint16_t y = K_VIEW_Y;
+    if (stats.samples == 0) {
+        vision_ui_driver_str_draw(K_VIEW_X, y, "SESSION -");
+        return;
+    }
+    const uint32_t ageS = ageMs(esp_timer_get_time(), stats.startUs) / 1000;
+    std::snprintf(text, sizeof(text), "SESSION %us", static_cast<unsigned>(ageS));
+    vision_ui_driver_str_draw(K_VIEW_X, y, text);
+
+    const SessionChannelStats& current = stats.currentMA;
+    const SessionChannelStats& power = stats.powerMW;
+    const std::pair<const char*, float SessionChannelStats::*> rows[] = {
+            {"P50", &SessionChannelStats::p50},
+            {"P95", &SessionChannelStats::p95},
+            {"P99", &SessionChannelStats::p99},
+            {"PEAK", &SessionChannelStats::peak},
+    };
+    for (const auto& [name, field] : rows) {
+        y += K_VIEW_ROW;
+        std::snprintf(
+                text,
+                sizeof(text),
+                "%-4s %.2fA %.2fW",
+                name,
+                static_cast<double>(current.*field / 1000.0F),
+                static_cast<double>(power.*field / 1000.0F)
+        );
+        vision_ui_driver_str_draw(K_VIEW_X, y, text);
+    }
+    y += K_VIEW_ROW;
+    std::snprintf(
+            text,
+            sizeof(text),
+            "%.3fWh %.1fmAh",
+            static_cast<double>(energy.sessionWh),
+            static_cast<double>(energy.sessionMAh)
+    );
+    vision_ui_driver_str_draw(K_VIEW_X, y, text);
+}
+
+void sessionStatsHandler(const uint8_t* data, const size_t size) {
+    if (data && size > 0) {
+        if (S_REQUEST_LEN + size <= K_REQUEST_MAX) {
+            std::memcpy(S_REQUEST + S_REQUEST_LEN, data, size);
+        }
+        // keeps counting past the buffer, so an oversized request is rejected below
+        S_REQUEST_LEN += size;
+        return;
+    }
+    const size_t len = S_REQUEST_LEN;
+    S_REQUEST_LEN = 0;
+    if (serialPackAborted()) {
+        return;
+    }
+    const auto op = static_cast<SessionStatsOp>(len > 0 ? S_REQUEST[0] : 0xFF);
+    if (op == SessionStatsOp::Read && len == 1) {
+        sendReply();
+    } else if (op == SessionStatsOp::Reset && len == 1) {
+        // answered by the reply task once the sampler ran on the new session
+        S_RESET_REPLY.store(true, std::memory_order_relaxed);
+        sessionStatsReset();
+    } else if (op == SessionStatsOp::Show && len == 2) {
+        S_SHOW.store(S_REQUEST[1] != 0, std::memory_order_relaxed);
+        sendReply();
+    } else {
+        ESP_LOGW(SESSION_STATS_TAG, "malformed request (%u bytes)", static_cast<unsigned>(len));
+    }
+}
@@ -0,0 +1,133 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/streaming_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void RunningStats::reset() {
+    samples = 0;
+    average = 0;
+    squares = 0;
+}
+
+void RunningStats::add(const double value) {
+    ++samples;
+    const double delta = value - average;
+    average += delta / samples;
+    squares += delta * (value - average);
+}
+
+double RunningStats::variance() const {
+    return samples > 1 ? squares / (samples - 1) : 0;
+}
+
+double RunningStats::stddev() const {
+    return std::sqrt(variance());
+}
+
+P2Quantile::P2Quantile(const float quantile) : p(quantile) {
+    reset();
+}
+
+void P2Quantile::reset() {
+    samples = 0;
+    for (int i = 0; i < K_MARKERS; ++i) {
+        heights[i] = 0;
+        positions[i] = i;
+    }
+    desired[0] = 0;
+    desired[1] = 2 * p;
+    desired[2] = 4 * p;
+    desired[3] = 2 + 2 * p;
+    desired[4] = 4;
+    increments[0] = 0;
+    increments[1] = p / 2;
+    increments[2] = p;
+    increments[3] = (1 + p) / 2;
+    increments[4] = 1;
+}
+
+void P2Quantile::add(const float value) {
+    if (samples < K_MARKERS) {
+        heights[samples++] = value;
+        if (samples == K_MARKERS) {
+            std::sort(heights, heights + K_MARKERS);
+        }
+        return;
+    }
+    ++samples;
+
+    // the cell the value falls in, widening the outer markers if it is a new extreme
+    int cell = 0;
+    if (value < heights[0]) {
+        heights[0] = value;
+    } else if (value >= heights[K_MARKERS - 1]) {
+        heights[K_MARKERS - 1] = value;
+        cell = K_MARKERS - 2;
+    } else {
+        while (cell < K_MARKERS - 2 && value >= heights[cell + 1]) {
+            ++cell;
+        }
+    }
+    for (int i = cell + 1; i < K_MARKERS; ++i) {
+        ++positions[i];
+    }
+    for (int i = 0; i < K_MARKERS; ++i) {
+        desired[i] += increments[i];
+    }
+
+    // move the middle markers one position towards where they should be
+    for (int i = 1; i < K_MARKERS - 1; ++i) {
+        const float offset = desired[i] - static_cast<float>(positions[i]);
+        if ((offset >= 1 && positions[i + 1] - positions[i] > 1) ||
+            (offset <= -1 && positions[i - 1] - positions[i] < -1)) {
+            const int direction = offset > 0 ? 1 : -1;
+            const float candidate = parabolic(i, static_cast<float>(direction));
+            heights[i] = heights[i - 1] < candidate && candidate < heights[i + 1] ? candidate : linear(i, direction);
+            positions[i] += direction;
+        }
+    }
+}
+
+float P2Quantile::value() const {
+    if (samples == 0) {
+        return 0;
+    }
+    if (samples >= K_MARKERS) {
+        return heights[2];
+    }
+    float sorted[K_MARKERS];
+    std::copy_n(heights, samples, sorted);
+    std::sort(sorted, sorted + samples);
+    return sorted[static_cast<size_t>(std::lround(p * static_cast<float>(samples - 1)))];
+}
+
+float P2Quantile::parabolic(const int i, const float direction) const {
+    const auto below = static_cast<float>(positions[i] - positions[i - 1]);
+    const auto above = static_cast<float>(positions[i + 1] - positions[i]);
+    const auto span = static_cast<float>(positions[i + 1] - positions[i - 1]);
+    return heights[i] + direction / span *
+                                ((below + direction) * (heights[i + 1] - heights[i]) / above +
+                                 (above - direction) * (heights[i] - heights[i - 1]) / below);
+}
+
+float P2Quantile::linear(const int i, const int direction) const {
+    return heights[i] + static_cast<float>(direction) * (heights[i + direction] - heights[i]) /
+                                static_cast<float>(positions[i + direction] - positions[i]);
+}
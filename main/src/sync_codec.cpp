@@ -0,0 +1,231 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/sync_codec.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <cJSON.h>
+
+#include "include/json_arena.hpp"
+
+static constexpr auto SYNC_CODEC_TAG = "[lumen:sync_codec]";
+// Print a decode summary every this many messages.
+static constexpr uint32_t K_STATS_LOG_INTERVAL = 64;
+
+static SyncCodecStats S_STATS = {};
+
+namespace {
+    void markPresent(SyncPlayerState& out, const SyncField field) {
+        out.present |= static_cast<uint8_t>(1U << static_cast<uint8_t>(field));
+    }
+
+    void copyName(SyncPlayerState& out, const char* name, const size_t len) {
+        const size_t n = std::min(len, SYNC_NAME_MAX - 1);
+        std::memcpy(out.name, name, n);
+        out.name[n] = '\0';
+        markPresent(out, SyncField::Name);
+    }
+
+    bool decodeBinary(const uint8_t* data, const size_t size, SyncPlayerState& out) {
+        if (size < 2 || data[0] != SYNC_BINARY_MAGIC || data[1] != SYNC_BINARY_VERSION) {
+            return false;
+        }
+
+        size_t pos = 2;
+        while (pos < size) {
+            if (size - pos < 2) {
+                return false;
+            }
+            const uint8_t tag = data[pos];
+            const uint8_t len = data[pos + 1];
+            pos += 2;
+            if (size - pos < len) {
+                return false;
+            }
+            const uint8_t* value = data + pos;
+            pos += len;
+
+            switch (static_cast<SyncField>(tag)) {
+                case SyncField::Mode:
+                    if (len != 1) {
+                        return false;
+                    }
+                    out.mode = value[0] < static_cast<uint8_t>(SyncMode::None) ? static_cast<SyncMode>(value[0])
+                                                                               : SyncMode::None;
+                    markPresent(out, SyncField::Mode);
+                    break;
+                case SyncField::Name:
+                    copyName(out, reinterpret_cast<const char*>(value), len);
+                    break;
+                case SyncField::Health:
+                case SyncField::MaxHealth: {
+                    if (len != sizeof(uint16_t)) {
+                        return false;
+                    }
+                    const float hp = static_cast<float>(value[0] | (value[1] << 8)) / 100.0F;
+                    if (static_cast<SyncField>(tag) == SyncField::Health) {
+                        out.health = hp;
+                    } else {
+                        out.maxHealth = hp;
+                    }
+                    markPresent(out, static_cast<SyncField>(tag));
+                    break;
+                }
+                default:
+                    // newer host, unknown field
+                    break;
+            }
+        }
+        return true;
+    }
+
+    struct JsonSyncFields {
+        char mode[16];
+        char name[SYNC_NAME_MAX];
+        float health;
+        float maxHealth;
+    };
+
+    constexpr JsonSchemaField K_JSON_SYNC_SCHEMA[] = {
+            {"mode", JsonFieldType::String, offsetof(JsonSyncFields, mode), sizeof(JsonSyncFields::mode)},
+            {"name", JsonFieldType::String, offsetof(JsonSyncFields, name), sizeof(JsonSyncFields::name)},
+            {"health", JsonFieldType::Float, offsetof(JsonSyncFields, health), 0},
+            {"max_health", JsonFieldType::Float, offsetof(JsonSyncFields, maxHealth), 0},
+    };
+
+    bool decodeJson(const uint8_t* data, const size_t size, SyncPlayerState& out) {
+        jsonArenaInit();
+        cJSON* root = cJSON_ParseWithLength(reinterpret_cast<const char*>(data), size);
+        if (!root) {
+            jsonArenaReset();
+            return false;
+        }
+
+        JsonSyncFields fields = {};
+        const uint32_t found = jsonExtract(root, K_JSON_SYNC_SCHEMA, std::size(K_JSON_SYNC_SCHEMA), &fields);
+        cJSON_Delete(root);
+        jsonArenaReset();
+
+        if (found & (1U << 0)) {
+            out.mode = syncModeFromName(fields.mode, strlen(fields.mode));
+            markPresent(out, SyncField::Mode);
+        }
+        if (found & (1U << 1)) {
+            copyName(out, fields.name, strlen(fields.name));
+        }
+        if (found & (1U << 2)) {
+            out.health = fields.health;
+            markPresent(out, SyncField::Health);
+        }
+        if (found & (1U << 3)) {
+            out.maxHealth = fields.maxHealth;
+            markPresent(out, SyncField::MaxHealth);
+        }
+        return true;
+    }
+
+    void logStats() {
+        const auto avg = [](const uint64_t total, const uint32_t count) {
+            return count ? static_cast<unsigned>(total / count) : 0U;
+        };
+        ESP_LOGI(
+                SYNC_CODEC_TAG,
+                "decode avg: json %u us / %u B (%" PRIu32 "), binary %u us / %u B (%" PRIu32 "), rejected %" PRIu32,
+                avg(S_STATS.jsonDecodeUs, S_STATS.jsonMessages),
+                avg(S_STATS.jsonBytes, S_STATS.jsonMessages),
+                S_STATS.jsonMessages,
+                avg(S_STATS.binaryDecodeUs, S_STATS.binaryMessages),
+                avg(S_STATS.binaryBytes, S_STATS.binaryMessages),
+                S_STATS.binaryMessages,
+                S_STATS.rejectedMessages
+        );
+        const JsonArenaStats arena = jsonArenaGetStats();
+        ESP_LOGI(
+                SYNC_CODEC_TAG,
+                "json heap allocations: %" PRIu32 " over %" PRIu32 " messages, arena high water %u B",
+                arena.heapAllocations,
+                arena.messages,
+                static_cast<unsigned>(arena.highWater)
+        );
+    }
+} // namespace
+
+SyncMode syncModeFromName(const char* name, const size_t len) {
+    static constexpr struct {
+        const char* name;
+        SyncMode mode;
+    } modes[] = {
+            {"Survival", SyncMode::Survival},
+            {"Spectator", SyncMode::Spectator},
+            {"Creative", SyncMode::Creative},
+            {"Adventure", SyncMode::Adventure},
+    };
+    for (const auto& [modeName, mode] : modes) {
+        if (strlen(modeName) == len && std::memcmp(modeName, name, len) == 0) {
+            return mode;
+        }
+    }
+    return SyncMode::None;
+}
+
+bool syncDecode(const uint8_t* data, const size_t size, SyncPlayerState& out) {
+    out.present = 0;
+    if (!data || size == 0) {
+        return false;
+    }
+
+    const bool binary = data[0] == SYNC_BINARY_MAGIC;
+    const int64_t start = esp_timer_get_time();
+    const bool ok = binary ? decodeBinary(data, size, out) : decodeJson(data, size, out);
+    const auto elapsed = static_cast<uint64_t>(esp_timer_get_time() - start);
+
+    if (!ok) {
+        ++S_STATS.rejectedMessages;
+        ESP_LOGW(
+                SYNC_CODEC_TAG,
+                "rejected %s sync message, size=%u",
+                binary ? "binary" : "json",
+                static_cast<unsigned>(size)
+        );
+        return false;
+    }
+
+    if (binary) {
+        ++S_STATS.binaryMessages;
+        S_STATS.binaryBytes += size;
+        S_STATS.binaryDecodeUs += elapsed;
+    } else {
+        ++S_STATS.jsonMessages;
+        S_STATS.jsonBytes += size;
+        S_STATS.jsonDecodeUs += elapsed;
+    }
+    if ((S_STATS.binaryMessages + S_STATS.jsonMessages) % K_STATS_LOG_INTERVAL == 0) {
+        logStats();
+    }
+    return true;
+}
+
+SyncCodecStats syncCodecGetStats() {
+    return S_STATS;
+}
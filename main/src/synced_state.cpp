@@ -0,0 +1,154 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/synced_state.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <esp_log.h>
+
+static constexpr auto SYNCED_STATE_TAG = "[lumen:synced_state]";
+
+SyncedStore::Field* SyncedStore::writable(const uint8_t field, const Type type) {
+    if (field >= SYNCED_STATE_MAX_FIELDS) {
+        ESP_LOGE(SYNCED_STATE_TAG, "field %u out of range", field);
+        return nullptr;
+    }
+    Field& entry = working.fields[field];
+    if (entry.type != type) {
+        // first write, or the host changed the field's type: always a change
+        entry.type = type;
+        std::memset(entry.s, 0, sizeof(entry.s));
+        pending |= syncedFieldBit(field);
+    }
+    return &entry;
+}
+
+bool SyncedStore::setInt(const uint8_t field, const int32_t value) {
+    Field* entry = writable(field, Type::Int);
+    if (!entry || (entry->i == value && !(pending & syncedFieldBit(field)))) {
+        return false;
+    }
+    entry->i = value;
+    pending |= syncedFieldBit(field);
+    return true;
+}
+
+bool SyncedStore::setFloat(const uint8_t field, const float value) {
+    Field* entry = writable(field, Type::Float);
+    if (!entry || (entry->f == value && !(pending & syncedFieldBit(field)))) {
+        return false;
+    }
+    entry->f = value;
+    pending |= syncedFieldBit(field);
+    return true;
+}
+
+bool SyncedStore::setString(const uint8_t field, const char* value, const size_t len) {
+    Field* entry = writable(field, Type::String);
+    if (!entry) {
+        return false;
+    }
+    const size_t n = std::min(len, SYNCED_STATE_STRING_MAX - 1);
+    if (strncmp(entry->s, value, n) == 0 && entry->s[n] == '\0' && !(pending & syncedFieldBit(field))) {
+        return false;
+    }
+    std::memcpy(entry->s, value, n);
+    entry->s[n] = '\0';
+    pending |= syncedFieldBit(field);
+    return true;
+}
+
+uint32_t SyncedStore::commit() {
+    const uint32_t changed = pending;
+    if (changed == 0) {
+        return 0;
+    }
+    pending = 0;
+
+    const uint32_t next = working.currentVersion + 1;
+    for (uint8_t i = 0; i < SYNCED_STATE_MAX_FIELDS; ++i) {
+        if (changed & syncedFieldBit(i)) {
+            working.fields[i].version = next;
+        }
+    }
+    working.currentVersion = next;
+    published.back() = working;
+    published.publish();
+
+    for (size_t i = 0; i < listenerCount; ++i) {
+        if (const ListenerEntry& entry = listeners[i]; entry.mask & changed) {
+            entry.listener(entry.mask & changed, entry.context);
+        }
+    }
+    return changed;
+}
+
+const SyncedFields& SyncedStore::acquire() {
+    return published.acquire();
+}
+
+uint32_t SyncedStore::version() const {
+    return published.published();
+}
+
+int32_t SyncedFields::getInt(const uint8_t field) const {
+    return field < SYNCED_STATE_MAX_FIELDS && fields[field].type == Type::Int ? fields[field].i : 0;
+}
+
+float SyncedFields::getFloat(const uint8_t field) const {
+    return field < SYNCED_STATE_MAX_FIELDS && fields[field].type == Type::Float ? fields[field].f : 0.0F;
+}
+
+const char* SyncedFields::getString(const uint8_t field) const {
+    return field < SYNCED_STATE_MAX_FIELDS && fields[field].type == Type::String ? fields[field].s : "";
+}
+
+bool SyncedFields::has(const uint8_t field) const {
+    return field < SYNCED_STATE_MAX_FIELDS && fields[field].version != 0;
+}
+
+uint32_t SyncedFields::version() const {
+    return currentVersion;
+}
+
+uint32_t SyncedFields::fieldVersion(const uint8_t field) const {
+    return field < SYNCED_STATE_MAX_FIELDS ? fields[field].version : 0;
+}
+
+uint32_t SyncedFields::changesSince(uint32_t& since) const {
+    uint32_t changed = 0;
+    if (currentVersion != since) {
+        for (uint8_t i = 0; i < SYNCED_STATE_MAX_FIELDS; ++i) {
+            if (fields[i].version > since) {
+                changed |= syncedFieldBit(i);
+            }
+        }
+    }
+    since = currentVersion;
+    return changed;
+}
+
+bool SyncedStore::addListener(const Listener listener, const uint32_t mask, void* context) {
+    if (!listener || listenerCount >= SYNCED_STATE_MAX_LISTENERS) {
+        ESP_LOGE(SYNCED_STATE_TAG, "listener table full");
+        return false;
+    }
+    listeners[listenerCount++] = {listener, mask, context};
+    return true;
+}
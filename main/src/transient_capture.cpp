@@ -0,0 +1,362 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/transient_capture.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <vision_ui_lib.h>
+
+#include "include/byte_order.hpp"
+#include "include/current_sensor.hpp"
+#include "include/serial_pack.hpp"
+
+static constexpr auto TRANSIENT_CAPTURE_TAG = "[lumen:capture]";
+static constexpr auto K_PATH = "cap";
+static constexpr size_t K_STATUS_LEN = 19;
+static constexpr size_t K_SAMPLE_WIRE_LEN = sizeof(int32_t) + sizeof(int16_t);
+static constexpr size_t K_REQUEST_MAX = 10;
+static constexpr size_t K_REPLY_MAX = K_STATUS_LEN + 2 * sizeof(uint16_t) + CAPTURE_MAX_READ * K_SAMPLE_WIRE_LEN;
+
+// scope view
+static constexpr uint16_t K_SCOPE_X = 10;
+static constexpr uint16_t K_SCOPE_Y = 60;
+static constexpr uint16_t K_SCOPE_W = 220;
+static constexpr uint16_t K_SCOPE_H = 140;
+
+namespace {
+    TaskHandle_t S_TASK = nullptr;
+    std::atomic<CaptureState> S_STATE{CaptureState::Idle};
+    std::atomic<bool> S_CANCEL{false};
+    std::atomic<bool> S_SHOW{false};
+    // written before the task is notified
+    CaptureSettings S_SETTINGS = {};
+
+    // The ring while armed, in time order from index 0 once Done. Written by the capture task only; S_INFO and the
+    // samples are published by the release store of S_STATE.
+    int16_t S_CURRENT[CAPTURE_SAMPLES] = {};
+    uint32_t S_TIME_US[CAPTURE_SAMPLES] = {};
+    CaptureInfo S_INFO = {};
+
+    // serial worker only
+    uint8_t S_REQUEST[K_REQUEST_MAX] = {};
+    size_t S_REQUEST_LEN = 0;
+    uint8_t S_REPLY[K_REPLY_MAX] = {};
+
+    int16_t toUnits(const float currentMA) {
+        constexpr float lowest = std::numeric_limits<int16_t>::min();
+        constexpr float highest = std::numeric_limits<int16_t>::max();
+        return static_cast<int16_t>(std::lround(std::clamp(currentMA / CAPTURE_LSB_MA, lowest, highest)));
+    }
+
+    float toMA(const int16_t units) {
+        return static_cast<float>(units) * CAPTURE_LSB_MA;
+    }
+
+    void capture() {
+        const CaptureSettings settings = S_SETTINGS;
+        const size_t pre = std::min<size_t>(settings.preSamples, CAPTURE_SAMPLES - 1);
+
+        currentSensorSetFastConversions(true);
+        const int64_t startUs = esp_timer_get_time();
+        const int64_t deadlineUs = startUs + static_cast<int64_t>(settings.timeoutMs) * 1000;
+
+        size_t head = 0;
+        size_t written = 0;
+        bool triggered = false;
+        // samples before the trigger that stay in the window, and samples after it
+        size_t kept = 0;
+        size_t after = 0;
+        float previousMA = NAN;
+        CaptureState result = CaptureState::Done;
+
+        while (!triggered || after < CAPTURE_SAMPLES - 1 - kept) {
+            if (S_CANCEL.exchange(false, std::memory_order_relaxed)) {
+                result = CaptureState::Cancelled;
+                break;
+            }
+            const float currentMA = currentSensorReadCurrentNowMA();
+            const int64_t nowUs = esp_timer_get_time();
+            S_CURRENT[head] = toUnits(currentMA);
+            S_TIME_US[head] = static_cast<uint32_t>(nowUs - startUs);
+            head = (head + 1) % CAPTURE_SAMPLES;
+            ++written;
+
+            if (triggered) {
+                ++after;
+                continue;
+            }
+            const bool fire = settings.trigger == CaptureTrigger::Level
+                                      ? currentMA >= settings.thresholdMA
+                                      : !std::isnan(previousMA) && currentMA - previousMA >= settings.thresholdMA;
+            previousMA = currentMA;
+            if (fire) {
+                triggered = true;
+                kept = std::min(written - 1, pre);
+            } else if (nowUs >= deadlineUs) {
+                result = CaptureState::TimedOut;
+                break;
+            }
+        }
+        currentSensorSetFastConversions(false);
+
+        if (result == CaptureState::Done) {
+            const size_t total = kept + 1 + after;
+            // put the window at the start of the arrays, oldest first
+            const size_t oldest = (head + CAPTURE_SAMPLES - total) % CAPTURE_SAMPLES;
+            std::rotate(S_CURRENT, S_CURRENT + oldest, S_CURRENT + CAPTURE_SAMPLES);
+            std::rotate(S_TIME_US, S_TIME_US + oldest, S_TIME_US + CAPTURE_SAMPLES);
+
+            const auto [low, high] = std::minmax_element(S_CURRENT, S_CURRENT + total);
+            S_INFO = {
+                    .state = CaptureState::Done,
+                    .samples = static_cast<uint16_t>(total),
+                    .triggerIndex = static_cast<uint16_t>(kept),
+                    .spanUs = S_TIME_US[total - 1] - S_TIME_US[0],
+                    .minMA = toMA(*low),
+                    .maxMA = toMA(*high),
+            };
+            ESP_LOGI(
+                    TRANSIENT_CAPTURE_TAG,
+                    "captured %u samples over %" PRIu32 " us, %.1f to %.1f mA",
+                    static_cast<unsigned>(total),
+                    S_INFO.spanUs,
+                    static_cast<double>(S_INFO.minMA),
+                    static_cast<double>(S_INFO.maxMA)
+            );
+        } else {
+            ESP_LOGI(TRANSIENT_CAPTURE_TAG, "capture %s", result == CaptureState::TimedOut ? "timed out" : "cancelled");
+        }
+        S_STATE.store(result, std::memory_order_release);
+    }
+
+    [[noreturn]]
+    void captureTask(void*) {
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            capture();
+        }
+    }
+
+    uint8_t* writeStatus(uint8_t* out, const uint8_t op, const bool ok) {
+        const CaptureInfo info = transientCaptureGetInfo();
+        *out++ = op | CAPTURE_REPLY;
+        *out++ = ok ? 1 : 0;
+        *out++ = static_cast<uint8_t>(info.state);
+        out = writeU16Le(out, info.samples);
+        out = writeU16Le(out, info.triggerIndex);
+        out = writeU32Le(out, info.spanUs);
+        out = writeF32Le(out, info.minMA);
+        return writeF32Le(out, info.maxMA);
+    }
+
+    void handleRequest(const uint8_t* data, const size_t size) {
+        const uint8_t op = size > 0 ? data[0] : 0;
+        bool ok = false;
+        size_t first = 0;
+        size_t count = 0;
+        CaptureSample samples[CAPTURE_MAX_READ];
+
+        switch (static_cast<CaptureOp>(op)) {
+            case CaptureOp::Arm:
+                if (size == 10 && data[1] <= static_cast<uint8_t>(CaptureTrigger::Rise)) {
+                    ok = transientCaptureArm({
+                            .trigger = static_cast<CaptureTrigger>(data[1]),
+                            .thresholdMA = static_cast<float>(static_cast<int16_t>(readU16Le(data + 2))),
+                            .preSamples = readU16Le(data + 4),
+                            .timeoutMs = readU32Le(data + 6),
+                    });
+                }
+                break;
+            case CaptureOp::Status:
+                ok = size == 1;
+                break;
+            case CaptureOp::Read:
+                if (size == 5) {
+                    first = readU16Le(data + 1);
+                    count = std::min<size_t>(readU16Le(data + 3), CAPTURE_MAX_READ);
+                    count = transientCaptureRead(first, samples, count);
+                    ok = true;
+                }
+                break;
+            case CaptureOp::Cancel:
+                ok = size == 1;
+                if (ok) {
+                    transientCaptureCancel();
+                }
+                break;
+            case CaptureOp::Show:
+                ok = size == 2;
+                if (ok) {
+                    S_SHOW.store(data[1] != 0, std::memory_order_relaxed);
+                }
+                break;
+        }
+        if (!ok) {
+            ESP_LOGW(TRANSIENT_CAPTURE_TAG, "request %u rejected (%u bytes)", op, static_cast<unsigned>(size));
+        }
+
+        uint8_t* out = writeStatus(S_REPLY, op, ok);
+        if (ok && static_cast<CaptureOp>(op) == CaptureOp::Read) {
+            out = writeU16Le(out, static_cast<uint16_t>(first));
+            out = writeU16Le(out, static_cast<uint16_t>(count));
+            for (size_t i = 0; i < count; ++i) {
+                out = writeU32Le(out, static_cast<uint32_t>(samples[i].offsetUs));
+                out = writeU16Le(out, static_cast<uint16_t>(samples[i].current));
+            }
+        }
+        serialPackSend(K_PATH, S_REPLY, static_cast<size_t>(out - S_REPLY));
+    }
+} // namespace
+
+void transientCaptureInit() {
+    if (S_TASK) {
+        return;
+    }
+    // with the e-fuse task, below the sampler and the fast-trip poll so they get the bus between captured reads
+    xTaskCreate(captureTask, "capture_task", 3072, nullptr, 10, &S_TASK);
+}
+
+bool transientCaptureArm(const CaptureSettings& settings) {
+    if (!S_TASK || std::isnan(currentSensorReadCurrentNowMA())) {
+        return false;
+    }
+    if (S_STATE.load(std::memory_order_acquire) == CaptureState::Armed) {
+        return false;
+    }
+    S_SETTINGS = settings;
+    S_CANCEL.store(false, std::memory_order_relaxed);
+    S_STATE.store(CaptureState::Armed, std::memory_order_release);
+    xTaskNotifyGive(S_TASK);
+    ESP_LOGI(
+            TRANSIENT_CAPTURE_TAG,
+            "armed: %s %.0f mA, %u before, timeout %" PRIu32 " ms",
+            settings.trigger == CaptureTrigger::Level ? "level" : "rise",
+            static_cast<double>(settings.thresholdMA),
+            settings.preSamples,
+            settings.timeoutMs
+    );
+    return true;
+}
+
+void transientCaptureCancel() {
+    if (S_STATE.load(std::memory_order_acquire) == CaptureState::Armed) {
+        S_CANCEL.store(true, std::memory_order_relaxed);
+    }
+}
+
+CaptureInfo transientCaptureGetInfo() {
+    const CaptureState state = S_STATE.load(std::memory_order_acquire);
+    if (state != CaptureState::Done) {
+        return {.state = state, .samples = 0, .triggerIndex = 0, .spanUs = 0, .minMA = 0, .maxMA = 0};
+    }
+    return S_INFO;
+}
+
+size_t transientCaptureRead(const size_t first, CaptureSample* out, const size_t count) {
+    const CaptureInfo info = transientCaptureGetInfo();
+    if (info.state != CaptureState::Done || first >= info.samples) {
+        return 0;
+    }
+    const size_t copied = std::min(count, info.samples - first);
+    const int64_t triggerUs = S_TIME_US[info.triggerIndex];
+    for (size_t i = 0; i < copied; ++i) {
+        out[i] = {
+                .offsetUs = static_cast<int32_t>(static_cast<int64_t>(S_TIME_US[first + i]) - triggerUs),
+                .current = S_CURRENT[first + i],
+        };
+    }
+    return copied;
+}
+
+bool transientCaptureViewActive() {
+    const CaptureState state = S_STATE.load(std::memory_order_acquire);
+    return S_SHOW.load(std::memory_order_relaxed) && (state == CaptureState::Armed || state == CaptureState::Done);
+}
+
+// One column per pixel with the min and max of the samples that fall in it; the x axis is sample index, which is
+// close to linear in time since the reads are back to back.
+void transientCaptureDraw() {
+    const CaptureInfo info = transientCaptureGetInfo();
+    char text[32];
+    if (info.state != CaptureState::Done || info.samples == 0) {
+        vision_ui_driver_str_draw(K_SCOPE_X, K_SCOPE_Y - 10, "ARMED");
+        vision_ui_driver_frame_draw(K_SCOPE_X, K_SCOPE_Y, K_SCOPE_W, K_SCOPE_H);
+        return;
+    }
+
+    std::snprintf(
+            text,
+            sizeof(text),
+            "%.0f mA  %.1f ms",
+            static_cast<double>(info.maxMA),
+            static_cast<double>(info.spanUs) / 1000.0
+    );
+    vision_ui_driver_str_draw(K_SCOPE_X, K_SCOPE_Y - 10, text);
+    vision_ui_driver_frame_draw(K_SCOPE_X, K_SCOPE_Y, K_SCOPE_W, K_SCOPE_H);
+
+    // include 0 mA so a spike is shown against the idle level
+    const float low = std::min(info.minMA, 0.0F);
+    const float range = std::max(info.maxMA - low, 1.0F);
+    constexpr uint16_t plotH = K_SCOPE_H - 2;
+    auto rowOf = [&](const float currentMA) {
+        const auto scaled = static_cast<int>((currentMA - low) / range * static_cast<float>(plotH - 1));
+        return static_cast<uint16_t>(K_SCOPE_Y + K_SCOPE_H - 2 - std::clamp(scaled, 0, plotH - 1));
+    };
+
+    constexpr uint16_t plotW = K_SCOPE_W - 2;
+    for (uint16_t x = 0; x < plotW; ++x) {
+        const size_t begin = static_cast<size_t>(x) * info.samples / plotW;
+        const size_t end = std::max(begin + 1, static_cast<size_t>(x + 1) * info.samples / plotW);
+        const auto [columnLow, columnHigh] = std::minmax_element(S_CURRENT + begin, S_CURRENT + end);
+        const uint16_t top = rowOf(toMA(*columnHigh));
+        const uint16_t bottom = rowOf(toMA(*columnLow));
+        vision_ui_driver_line_v_draw(K_SCOPE_X + 1 + x, top, bottom - top + 1);
+    }
+
+    const auto triggerX = static_cast<uint16_t>(static_cast<size_t>(info.triggerIndex) * plotW / info.samples);
+    vision_ui_driver_line_v_dotted_draw(K_SCOPE_X + 1 + triggerX, K_SCOPE_Y + 1, plotH);
+}
+
+void transientCaptureHandler(const uint8_t* data, const size_t size) {
+    if (data && size > 0) {
+        if (S_REQUEST_LEN + size <= K_REQUEST_MAX) {
+            std::memcpy(S_REQUEST + S_REQUEST_LEN, data, size);
+        }
+        // keeps counting past the buffer, so an oversized request is rejected below
+        S_REQUEST_LEN += size;
+        return;
+    }
+    const size_t len = S_REQUEST_LEN;
+    S_REQUEST_LEN = 0;
+    if (serialPackAborted()) {
+        return;
+    }
+    handleRequest(S_REQUEST, len <= K_REQUEST_MAX ? len : 0);
+}
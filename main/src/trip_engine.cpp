@@ -0,0 +1,54 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/trip_engine.hpp"
+
+#include <cmath>
+
+void TripEngine::configure(const TripCurve& value) {
+    tripCurve = value;
+}
+
+void TripEngine::reset() {
+    heatLevel = 0;
+    lastUs = 0;
+    started = false;
+}
+
+TripReason TripEngine::update(const float currentMA, const int64_t timestampUs) {
+    const float magnitude = std::fabs(currentMA);
+    const float elapsedMs = started && timestampUs > lastUs ? static_cast<float>(timestampUs - lastUs) / 1000.F : 0;
+    lastUs = timestampUs;
+    started = true;
+
+    if (tripCurve.ratedMA <= 0) {
+        return TripReason::None;
+    }
+    if (tripCurve.hardMA > 0 && magnitude > tripCurve.hardMA) {
+        return TripReason::HardLimit;
+    }
+
+    const float ratio = magnitude / tripCurve.ratedMA;
+    const float target = ratio * ratio;
+    if (tripCurve.timeConstantMs <= 0) {
+        heatLevel = target;
+        return magnitude > tripCurve.ratedMA ? TripReason::Thermal : TripReason::None;
+    }
+    // exact step response over the interval, stable for any sample spacing
+    heatLevel = target + (heatLevel - target) * std::exp(-elapsedMs / tripCurve.timeConstantMs);
+    return heatLevel > 1.F ? TripReason::Thermal : TripReason::None;
+}
@@ -10,18 +10,26 @@
 
 #include <esp_timer.h>
 
-#include <cJSON.h>
-
 #include <u8g2.h>
 
 #include <vision_ui_lib.h>
 
 #include "include/buzzer.hpp"
+#include "include/byte_order.hpp"
+#include "include/config_rpc.hpp"
 #include "include/current_sensor.hpp"
 #include "include/display.hpp"
 #include "include/efuse.hpp"
+#include "include/energy_meter.hpp"
+#include "include/image_cache.hpp"
 #include "include/motion.hpp"
 #include "include/serial_pack.hpp"
+#include "include/session_stats.hpp"
+#include "include/snapshot.hpp"
+#include "include/sync_codec.hpp"
+#include "include/synced_state.hpp"
+#include "include/transient_capture.hpp"
+#include "include/widget_page.hpp"
 
 // 'logo', 240x240px
 // 'logo', 240x240px
@@ -1318,17 +1326,25 @@ LumenConfigValues LUMEN_CONFIG_VALUES = {
         .turnOffUsb = false,
         .overvoltageAlert = true,
         .overcurrentAlert = true,
+        .fastTrip = true,
+        .overcurrentHardMA = lumenGetUSBInfo().hardwareLimitedCurrent,
+        // lets a typical plug-in inrush of twice the limit pass for about 60 ms
+        .overcurrentTauMS = 200,
+        .acquisitionProfile = CURRENT_SENSOR_DEFAULT_PROFILE,
+        .persistFaults = true,
 };
 
 LumenConfigCallbacks lumenSetConfigCallbacks() {
     return {
-            .overcurrentOnChange = [](const int16_t value) { LUMEN_CONFIG_VALUES.overcurrentMA = value; },
-            .overvoltageOnChange = [](const int16_t value) { LUMEN_CONFIG_VALUES.overvoltageMV = value; },
-            .enableAutoFaultRecoveryOnChange = [](const bool value
-                                               ) { LUMEN_CONFIG_VALUES.enableAutoFaultRecovery = value; },
-            .turnOffUsbOnChange = [](const bool value) { LUMEN_CONFIG_VALUES.turnOffUsb = value; },
-            .overvoltageAlertOnChange = [](const bool value) { LUMEN_CONFIG_VALUES.overvoltageAlert = value; },
-            .overcurrentAlertOnChange = [](const bool value) { LUMEN_CONFIG_VALUES.overcurrentAlert = value; },
+            .overcurrentOnChange = [](const int16_t value) { configRpcLocalSet(ConfigField::OvercurrentMA, value); },
+            .overvoltageOnChange = [](const int16_t value) { configRpcLocalSet(ConfigField::OvervoltageMV, value); },
+            .enableAutoFaultRecoveryOnChange =
+                    [](const bool value) { configRpcLocalSet(ConfigField::EnableAutoFaultRecovery, value); },
+            .turnOffUsbOnChange = [](const bool value) { configRpcLocalSet(ConfigField::TurnOffUsb, value); },
+            .overvoltageAlertOnChange =
+                    [](const bool value) { configRpcLocalSet(ConfigField::OvervoltageAlert, value); },
+            .overcurrentAlertOnChange =
+                    [](const bool value) { configRpcLocalSet(ConfigField::OvercurrentAlert, value); },
     };
 }
 LumenSystemInfo lumenGetSystemInfo() {
@@ -1380,15 +1396,19 @@ LumenSystemConfig lumenGetSystemConfig() {
 LumenUSBInfo lumenGetUSBInfo() {
     static constexpr LumenUSBInfo usb = {
             // current: mA
-            .overCurrentMin = 500, // 0.5 A
-            .hardwareLimitedCurrent = 2000, // 2 A
-            .overCurrentDefault = 1000, // 1 A
+            // limits stay below CURRENT_SENSOR_FULL_SCALE_MA, where the shunt measurement saturates
+            .overCurrentMin = 200, // 0.2 A
+            .hardwareLimitedCurrent = 800, // 0.8 A, also the default instantaneous limit
+            // sustained limit; the default leaves the thermal curve room below the hard limit for inrush
+            .overCurrentDefault = 500, // 0.5 A
 
             // voltage: mV
             .overVoltageMin = 4500, // 4.5 V
             .overVoltageMax = 5600, // 6 V (PD upper bound)
             .overVoltageDefault = 5000, // 5 V
     };
+    static_assert(usb.hardwareLimitedCurrent < CURRENT_SENSOR_FULL_SCALE_MA, "current limits must be measurable");
+    static_assert(usb.overCurrentDefault < usb.hardwareLimitedCurrent, "hard limit must sit above the thermal curve");
     return usb;
 }
 
@@ -1413,28 +1433,15 @@ VisionUIMotionStatus lumenMotionGetStatus() {
 }
 
 StatsPower lumenStatsGetPower() {
-    static float energyWh = 0.0f;
-    static int64_t lastUs = 0;
-
-    const int64_t nowUs = esp_timer_get_time();
-
-    if (lastUs != 0) {
-        const float dtHours = (nowUs - lastUs) / 1e6f / 3600.0f;
-
-        const float powerW = currentSensorReadPower() / 1000.0f;
-        energyWh += powerW * dtHours;
-    }
-
-    lastUs = nowUs;
-
-    const float currentMA = currentSensorReadCurrent();
+    const CurrentSensorSample sample = currentSensorGetSample();
+    const float powerW = sample.powerMW / 1000.0f;
 
     return {
-            currentMA / LUMEN_CONFIG_VALUES.overcurrentMA,
-            currentSensorReadPower() / 1000.0f,
-            energyWh,
-            currentSensorReadVoltage() / 1000.0f,
-            currentMA / 1000.0f,
+            sample.currentMA / LUMEN_CONFIG_VALUES.overcurrentMA,
+            powerW,
+            energyMeterGet().sessionWh,
+            sample.busVoltageMV / 1000.0f,
+            sample.currentMA / 1000.0f,
     };
 }
 
@@ -2012,141 +2019,209 @@ LumenEasterEggState lumenGetEasterEggState() {
 }
 
 namespace {
-    constexpr size_t K_MINECRAFT_SYNC_JSON_MAX = 1024;
+    constexpr size_t K_MINECRAFT_SYNC_STATE_MAX = 1024;
     constexpr size_t K_MINECRAFT_SYNC_SKIN_MAX = LCD_H_RES * LCD_V_RES * 2 + 4;
 
+    constexpr uint8_t syncFieldId(const SyncField field) {
+        return static_cast<uint8_t>(field);
+    }
+
+    struct MinecraftSkin {
+        uint16_t width = 0;
+        uint16_t height = 0;
+        std::vector<uint16_t> pixels;
+        // pinned instead of `pixels` when the skin is drawn straight from the flash image cache
+        ImageCacheEntry cached;
+
+        [[nodiscard]] const uint16_t* data() const {
+            return cached.pixels ? cached.pixels : pixels.data();
+        }
+
+        [[nodiscard]] bool empty() const {
+            return !cached.pixels && pixels.empty();
+        }
+    };
+
+    // Written by the serial pack worker, read by the UI task. Both the state store and the skin are handed over
+    // through snapshots, so the page never draws a half-applied record or a skin that is being rewritten.
     struct MinecraftSyncState {
-        enum class Mode {
-            Creative,
-            Survival,
-            Spectator,
-            Adventure,
-            None,
-        } mode;
-        std::string name;
-        float health = 0.0F;
-        float maxHealth = 0.0F;
-        bool hasState = false;
+        SyncedStore state;
+        Snapshot<MinecraftSkin> skin;
         bool serialAttached = false;
-        bool jsonOverflow = false;
+        bool stateOverflow = false;
+        uint8_t stateBuffer[K_MINECRAFT_SYNC_STATE_MAX] = {};
+        size_t stateLen = 0;
+        // skin pack decode progress, pixels are converted straight into skin.back() as chunks arrive
+        uint8_t skinHeader[4] = {};
+        size_t skinHeaderLen = 0;
+        uint8_t skinCarry = 0;
+        bool skinHasCarry = false;
         bool skinOverflow = false;
-        uint16_t skinWidth = 0;
-        uint16_t skinHeight = 0;
-        bool skinReady = false;
-        std::vector<uint8_t> jsonBuffer;
-        std::vector<uint8_t> skinBuffer;
-        std::vector<uint16_t> skinPixels;
+        // FNV-1a of the skin pack payload, the key it is cached under
+        uint64_t skinHash = IMAGE_CACHE_HASH_SEED;
+        uint8_t hashQuery[sizeof(uint64_t)] = {};
+        size_t hashQueryLen = 0;
     };
 
     MinecraftSyncState S_MINECRAFT_SYNC;
 
-    uint16_t readU16Le(const uint8_t* data) {
-        return static_cast<uint16_t>(data[0] | (static_cast<uint16_t>(data[1]) << 8));
-    }
+    // What the page last drew from the store; refreshed only for fields whose version moved.
+    struct MinecraftSyncView {
+        uint32_t version = 0;
+        SyncMode mode = SyncMode::None;
+        char name[SYNC_NAME_MAX] = {};
+        int16_t nameX = 0;
+        int16_t nameY = 0;
+        float health = 0.0F;
+        float prevHealth = 0.0F;
+        float maxHealth = 0.0F;
+        bool hasHealth = false;
+    };
 
-    void minecraftSyncJsonHandler(const uint8_t* data, const size_t size) {
+    MinecraftSyncView S_MINECRAFT_SYNC_VIEW;
+
+    void minecraftSyncStateHandler(const uint8_t* data, const size_t size) {
         if (data && size > 0) {
-            if (S_MINECRAFT_SYNC.jsonBuffer.size() + size > K_MINECRAFT_SYNC_JSON_MAX) {
-                S_MINECRAFT_SYNC.jsonOverflow = true;
-                S_MINECRAFT_SYNC.jsonBuffer.clear();
+            if (S_MINECRAFT_SYNC.stateLen + size > K_MINECRAFT_SYNC_STATE_MAX) {
+                S_MINECRAFT_SYNC.stateOverflow = true;
+                S_MINECRAFT_SYNC.stateLen = 0;
                 return;
             }
-            S_MINECRAFT_SYNC.jsonBuffer.insert(S_MINECRAFT_SYNC.jsonBuffer.end(), data, data + size);
+            std::memcpy(S_MINECRAFT_SYNC.stateBuffer + S_MINECRAFT_SYNC.stateLen, data, size);
+            S_MINECRAFT_SYNC.stateLen += size;
             return;
         }
 
-        if (S_MINECRAFT_SYNC.jsonOverflow) {
-            S_MINECRAFT_SYNC.jsonOverflow = false;
+        if (S_MINECRAFT_SYNC.stateOverflow || serialPackAborted()) {
+            S_MINECRAFT_SYNC.stateOverflow = false;
+            S_MINECRAFT_SYNC.stateLen = 0;
             return;
         }
 
-        if (S_MINECRAFT_SYNC.jsonBuffer.empty()) {
+        if (S_MINECRAFT_SYNC.stateLen == 0) {
             return;
         }
 
-        cJSON* root = cJSON_ParseWithLength(
-                reinterpret_cast<const char*>(S_MINECRAFT_SYNC.jsonBuffer.data()), S_MINECRAFT_SYNC.jsonBuffer.size()
-        );
-        S_MINECRAFT_SYNC.jsonBuffer.clear();
-        if (!root) {
+        SyncPlayerState decoded;
+        const bool ok = syncDecode(S_MINECRAFT_SYNC.stateBuffer, S_MINECRAFT_SYNC.stateLen, decoded);
+        S_MINECRAFT_SYNC.stateLen = 0;
+        if (!ok) {
             return;
         }
 
-        if (const cJSON* mode = cJSON_GetObjectItem(root, "mode"); cJSON_IsString(mode) && mode->valuestring) {
-            if (!strcmp(mode->valuestring, "Survival")) {
-                S_MINECRAFT_SYNC.mode = MinecraftSyncState::Mode::Survival;
-            } else if (!strcmp(mode->valuestring, "Spectator")) {
-                S_MINECRAFT_SYNC.mode = MinecraftSyncState::Mode::Spectator;
-            } else if (!strcmp(mode->valuestring, "Creative")) {
-                S_MINECRAFT_SYNC.mode = MinecraftSyncState::Mode::Creative;
-            } else if (!strcmp(mode->valuestring, "Adventure")) {
-                S_MINECRAFT_SYNC.mode = MinecraftSyncState::Mode::Adventure;
-            } else {
-                S_MINECRAFT_SYNC.mode = MinecraftSyncState::Mode::None;
-            }
+        // a record only carries the fields the host wants to change; values equal to the stored ones keep their
+        // version so the page does not redo work for them
+        SyncedStore& state = S_MINECRAFT_SYNC.state;
+        if (decoded.has(SyncField::Mode)) {
+            state.setInt(syncFieldId(SyncField::Mode), static_cast<int32_t>(decoded.mode));
         }
-
-        if (const cJSON* name = cJSON_GetObjectItem(root, "name"); cJSON_IsString(name) && name->valuestring) {
-            S_MINECRAFT_SYNC.name = name->valuestring;
+        if (decoded.has(SyncField::Name)) {
+            state.setString(syncFieldId(SyncField::Name), decoded.name, strnlen(decoded.name, sizeof(decoded.name)));
         }
-        if (const cJSON* health = cJSON_GetObjectItem(root, "health"); cJSON_IsNumber(health)) {
-            S_MINECRAFT_SYNC.health = health->valuedouble;
+        if (decoded.has(SyncField::Health)) {
+            state.setFloat(syncFieldId(SyncField::Health), decoded.health);
         }
-        if (const cJSON* maxHealth = cJSON_GetObjectItem(root, "max_health"); cJSON_IsNumber(maxHealth)) {
-            S_MINECRAFT_SYNC.maxHealth = maxHealth->valuedouble;
+        if (decoded.has(SyncField::MaxHealth)) {
+            state.setFloat(syncFieldId(SyncField::MaxHealth), decoded.maxHealth);
         }
-        S_MINECRAFT_SYNC.hasState = true;
-
-        cJSON_Delete(root);
+        state.commit();
     }
 
     void minecraftSyncSkinHandler(const uint8_t* data, const size_t size) {
+        MinecraftSyncState& sync = S_MINECRAFT_SYNC;
+        MinecraftSkin& skin = sync.skin.back();
+
         if (data && size > 0) {
-            if (S_MINECRAFT_SYNC.skinReady) {
-                S_MINECRAFT_SYNC.skinReady = false;
-                S_MINECRAFT_SYNC.skinBuffer.clear();
-            }
-            if (S_MINECRAFT_SYNC.skinBuffer.size() + size > K_MINECRAFT_SYNC_SKIN_MAX) {
-                S_MINECRAFT_SYNC.skinOverflow = true;
-                S_MINECRAFT_SYNC.skinBuffer.clear();
+            if (sync.skinOverflow) {
                 return;
             }
-            S_MINECRAFT_SYNC.skinBuffer.insert(S_MINECRAFT_SYNC.skinBuffer.end(), data, data + size);
+            sync.skinHash = imageCacheHash(data, size, sync.skinHash);
+
+            size_t i = 0;
+            while (sync.skinHeaderLen < sizeof(sync.skinHeader) && i < size) {
+                sync.skinHeader[sync.skinHeaderLen++] = data[i++];
+                if (sync.skinHeaderLen < sizeof(sync.skinHeader)) {
+                    continue;
+                }
+                skin.width = readU16Le(sync.skinHeader);
+                skin.height = readU16Le(sync.skinHeader + 2);
+                const size_t pixelCount = static_cast<size_t>(skin.width) * static_cast<size_t>(skin.height);
+                if (pixelCount * 2 + sizeof(sync.skinHeader) > K_MINECRAFT_SYNC_SKIN_MAX) {
+                    sync.skinOverflow = true;
+                    return;
+                }
+                skin.pixels.clear();
+                skin.pixels.reserve(pixelCount);
+                // the back slot is never on screen, its pin can go
+                imageCacheRelease(skin.cached);
+            }
+
+            const size_t pixelCount = static_cast<size_t>(skin.width) * static_cast<size_t>(skin.height);
+            for (; i < size; ++i) {
+                if (!sync.skinHasCarry) {
+                    sync.skinCarry = data[i];
+                    sync.skinHasCarry = true;
+                    continue;
+                }
+                sync.skinHasCarry = false;
+                if (skin.pixels.size() < pixelCount) {
+                    const uint8_t pair[2] = {sync.skinCarry, data[i]};
+                    skin.pixels.push_back(readU16Le(pair));
+                }
+            }
             return;
         }
 
-        if (S_MINECRAFT_SYNC.skinOverflow) {
-            S_MINECRAFT_SYNC.skinOverflow = false;
+        const bool complete = !serialPackAborted() && !sync.skinOverflow &&
+                              sync.skinHeaderLen == sizeof(sync.skinHeader) &&
+                              !skin.pixels.empty() &&
+                              skin.pixels.size() == static_cast<size_t>(skin.width) * static_cast<size_t>(skin.height);
+        const uint64_t hash = sync.skinHash;
+        sync.skinHeaderLen = 0;
+        sync.skinHasCarry = false;
+        sync.skinOverflow = false;
+        sync.skinHash = IMAGE_CACHE_HASH_SEED;
+        if (!complete) {
             return;
         }
+        sync.skin.publish();
+        // the published slot is only read from here on, caching it does not race the UI
+        imageCacheStore(hash, skin.width, skin.height, skin.pixels.data());
+    }
 
-        if (S_MINECRAFT_SYNC.skinBuffer.size() < 4) {
-            S_MINECRAFT_SYNC.skinBuffer.clear();
-            S_MINECRAFT_SYNC.skinReady = false;
+    // The host asks for a skin by the hash of its `sync/skin` payload before uploading it. On a hit the cached
+    // copy is shown at once and the host skips the upload.
+    void minecraftSyncSkinHashHandler(const uint8_t* data, const size_t size) {
+        MinecraftSyncState& sync = S_MINECRAFT_SYNC;
+        if (data && size > 0) {
+            for (size_t i = 0; i < size && sync.hashQueryLen < sizeof(sync.hashQuery); ++i) {
+                sync.hashQuery[sync.hashQueryLen++] = data[i];
+            }
             return;
         }
 
-        const uint16_t width = readU16Le(S_MINECRAFT_SYNC.skinBuffer.data());
-        const uint16_t height = readU16Le(S_MINECRAFT_SYNC.skinBuffer.data() + 2);
-        const size_t pixelCount = static_cast<size_t>(width) * static_cast<size_t>(height);
-        const size_t expectedBytes = pixelCount * 2;
-
-        if (const size_t payloadBytes = S_MINECRAFT_SYNC.skinBuffer.size() - 4;
-            pixelCount == 0 || payloadBytes < expectedBytes) {
-            S_MINECRAFT_SYNC.skinBuffer.clear();
-            S_MINECRAFT_SYNC.skinReady = false;
+        const bool complete = !serialPackAborted() && sync.hashQueryLen == sizeof(sync.hashQuery);
+        sync.hashQueryLen = 0;
+        if (!complete) {
             return;
         }
 
-        S_MINECRAFT_SYNC.skinPixels.assign(pixelCount, 0);
-        const uint8_t* pixelData = S_MINECRAFT_SYNC.skinBuffer.data() + 4;
-        for (size_t i = 0; i < pixelCount; ++i) {
-            S_MINECRAFT_SYNC.skinPixels[i] = readU16Le(pixelData + i * 2);
+        const uint64_t hash = readU64Le(sync.hashQuery);
+
+        ImageCacheEntry entry = {};
+        const bool hit = imageCacheLookup(hash, entry);
+        if (hit) {
+            MinecraftSkin& skin = sync.skin.back();
+            skin.width = entry.width;
+            skin.height = entry.height;
+            skin.pixels.clear();
+            imageCacheRelease(skin.cached);
+            skin.cached = entry;
+            sync.skin.publish();
         }
-        S_MINECRAFT_SYNC.skinWidth = width;
-        S_MINECRAFT_SYNC.skinHeight = height;
-        S_MINECRAFT_SYNC.skinReady = true;
-        S_MINECRAFT_SYNC.skinBuffer.clear();
+
+        const uint8_t reply = hit ? 1 : 0;
+        serialPackSend("sync/skin/hash", &reply, sizeof(reply));
     }
 
     void rgb565ArrayToBe(uint16_t* data, const size_t count) {
@@ -2303,12 +2378,12 @@ namespace {
     void minecraftSyncDrawHeartHud(
             const uint16_t x,
             const uint16_t y,
-            const MinecraftSyncState::Mode mode,
+            const SyncMode mode,
             const float health,
             const float prevHealth,
             const float maxHealth
     ) {
-        if (mode == MinecraftSyncState::Mode::Spectator || mode == MinecraftSyncState::Mode::Creative) {
+        if (mode == SyncMode::Spectator || mode == SyncMode::Creative) {
             return;
         }
 
@@ -2351,7 +2426,7 @@ namespace {
         displayDriverExtensionPixelScale(SCALE);
 
         static constexpr int lines = 10;
-        const bool hardcore = (S_MINECRAFT_SYNC.mode == MinecraftSyncState::Mode::Adventure);
+        const bool hardcore = (mode == SyncMode::Adventure);
 
         for (int l = totalHearts - 1; l >= 0; --l) {
             const int row = l / 10;
@@ -2386,53 +2461,88 @@ namespace {
         displayDriverExtensionPixelScale(1);
     }
 
+    void minecraftSyncRefreshView() {
+        const SyncedFields& state = S_MINECRAFT_SYNC.state.acquire();
+        MinecraftSyncView& view = S_MINECRAFT_SYNC_VIEW;
+
+        view.prevHealth = view.health;
+        const uint32_t changed = state.changesSince(view.version);
+        if (changed == 0) {
+            return;
+        }
+
+        if (changed & syncedFieldBit(syncFieldId(SyncField::Mode))) {
+            view.mode = static_cast<SyncMode>(state.getInt(syncFieldId(SyncField::Mode)));
+        }
+        if (changed & syncedFieldBit(syncFieldId(SyncField::Name))) {
+            std::snprintf(view.name, sizeof(view.name), "%s", state.getString(syncFieldId(SyncField::Name)));
+
+            static constexpr int16_t healthY = LCD_V_RES - 20;
+            const uint16_t nameWidth = vision_ui_driver_str_width_get(view.name);
+            const uint16_t lineHeight = vision_ui_driver_str_height_get();
+            view.nameX = static_cast<int16_t>((LCD_H_RES - nameWidth) / 2);
+            view.nameY = static_cast<int16_t>(healthY - lineHeight - 2);
+        }
+        if (changed & syncedFieldBit(syncFieldId(SyncField::Health))) {
+            view.health = state.getFloat(syncFieldId(SyncField::Health));
+            if (!view.hasHealth) {
+                // first value: nothing was lost, do not blink
+                view.prevHealth = view.health;
+                view.hasHealth = true;
+            }
+        }
+        if (changed & syncedFieldBit(syncFieldId(SyncField::MaxHealth))) {
+            view.maxHealth = state.getFloat(syncFieldId(SyncField::MaxHealth));
+        }
+    }
+
     void minecraftSyncDraw() {
+        // a host-defined page replaces the Minecraft layout until the host clears it
+        if (widgetPageActive()) {
+            widgetPageDraw();
+            return;
+        }
+        if (transientCaptureViewActive()) {
+            transientCaptureDraw();
+            return;
+        }
+        if (sessionStatsViewActive()) {
+            sessionStatsDraw();
+            return;
+        }
+
         static constexpr auto skinY = 20;
-        if (!S_MINECRAFT_SYNC.hasState && !S_MINECRAFT_SYNC.skinReady) {
+        const bool hasState = S_MINECRAFT_SYNC.state.version() != 0;
+        if (!hasState && S_MINECRAFT_SYNC.skin.published() == 0) {
             return;
         }
 
-        if (S_MINECRAFT_SYNC.skinReady && !S_MINECRAFT_SYNC.skinPixels.empty()) {
-            const int16_t skinX = static_cast<int16_t>((LCD_H_RES - S_MINECRAFT_SYNC.skinWidth) / 2);
+        if (const MinecraftSkin& skin = S_MINECRAFT_SYNC.skin.acquire(); !skin.empty()) {
+            const int16_t skinX = static_cast<int16_t>((LCD_H_RES - skin.width) / 2);
             displayDriverExtensionRGBBitmapDraw(
                     skinX,
                     skinY,
-                    static_cast<int16_t>(S_MINECRAFT_SYNC.skinWidth),
-                    static_cast<int16_t>(S_MINECRAFT_SYNC.skinHeight),
-                    S_MINECRAFT_SYNC.skinPixels.data()
+                    static_cast<int16_t>(skin.width),
+                    static_cast<int16_t>(skin.height),
+                    skin.data()
             );
         }
 
-        if (S_MINECRAFT_SYNC.hasState) {
-            char playerName[32] = {};
-
-            std::snprintf(playerName, sizeof(playerName), "%s", S_MINECRAFT_SYNC.name.c_str());
+        if (hasState) {
+            minecraftSyncRefreshView();
+            const MinecraftSyncView& view = S_MINECRAFT_SYNC_VIEW;
 
-            const uint16_t nameWidth = vision_ui_driver_str_width_get(playerName);
-            const uint16_t lineHeight = vision_ui_driver_str_height_get();
-
-            const int16_t nameX = static_cast<int16_t>((LCD_H_RES - nameWidth) / 2);
-            static constexpr int16_t healthY = LCD_V_RES - 20;
-            const int16_t nameY = static_cast<int16_t>(healthY - lineHeight - 2);
-
-            vision_ui_driver_str_draw(static_cast<uint16_t>(nameX), static_cast<uint16_t>(nameY), playerName);
-            static bool once = false;
-            static float prevHealth;
-            if (!once) {
-                prevHealth = S_MINECRAFT_SYNC.health;
-                once = true;
-            }
+            vision_ui_driver_str_draw(static_cast<uint16_t>(view.nameX), static_cast<uint16_t>(view.nameY), view.name);
             static constexpr int16_t healthXLogic = 40 / SCALE;
             static constexpr int16_t healthYLogic = 210 / SCALE;
             minecraftSyncDrawHeartHud(
                     healthXLogic,
                     healthYLogic,
-                    S_MINECRAFT_SYNC.mode,
-                    S_MINECRAFT_SYNC.health,
-                    prevHealth,
-                    S_MINECRAFT_SYNC.maxHealth
+                    view.mode,
+                    view.health,
+                    view.prevHealth,
+                    view.maxHealth
             );
-            prevHealth = S_MINECRAFT_SYNC.health;
         }
     }
 } // namespace
@@ -2442,9 +2552,9 @@ LumenMinecraftSync lumenGetMinecraftSync() {
             .initFunction =
                     []() {
                         if (!S_MINECRAFT_SYNC.serialAttached) {
-                            serialPackAttachHandler("sync", minecraftSyncJsonHandler);
+                            serialPackAttachHandler("sync", minecraftSyncStateHandler);
                             serialPackAttachHandler("sync/skin", minecraftSyncSkinHandler);
-                            S_MINECRAFT_SYNC.skinBuffer.reserve((1024 * 10) / sizeof(uint16_t));
+                            serialPackAttachHandler("sync/skin/hash", minecraftSyncSkinHashHandler);
                             S_MINECRAFT_SYNC.serialAttached = true;
 
                             rgb565ArrayToBe(CONTAINER, std::size(CONTAINER));
@@ -2462,9 +2572,8 @@ LumenMinecraftSync lumenGetMinecraftSync() {
                         }
                         const auto config = lumenGetSystemConfig();
                         vision_ui_driver_font_set(config.normal);
-                        serialPackStart();
                     },
             .loopFunction = []() { minecraftSyncDraw(); },
-            .exitFunction = []() { serialPackStop(); },
+            .exitFunction = []() {},
     };
 }
@@ -19,6 +19,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
 #include <esp_log.h>
 #include <esp_timer.h>
 
@@ -32,7 +35,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <vision_ui_lib.h>
 
+#include "include/effect_engine.hpp"
+#include "include/latency_trace.hpp"
 #include "include/pins.hpp"
+#include "include/serial_pack.hpp"
 
 #define HW_TAG "[lumen:display_hw_driver]"
 
@@ -90,15 +96,28 @@ static uint8_t u8x8DLumenCb(u8x8_t* u8x8, const uint8_t msg, const uint8_t argIn
     return 1;
 }
 
-static bool onColorTransDone(esp_lcd_panel_io_handle_t, esp_lcd_panel_io_event_data_t*, void*) {
-    static volatile int sNextDoneIdx = 0;
+// Buffers handed to the panel in submission order. Color transfers complete in the same order, so the done
+// callback releases the oldest one. Partial (remote framebuffer) flushes do not alternate between the two buffers.
+static constexpr uint8_t K_INFLIGHT_SLOTS = 4;
+static volatile uint8_t S_INFLIGHT[K_INFLIGHT_SLOTS] = {};
+static volatile uint8_t S_INFLIGHT_HEAD = 0;
+static volatile uint8_t S_INFLIGHT_TAIL = 0;
 
-    const int idx = sNextDoneIdx;
-    S_BUF_BUSY[idx] = false;
-    sNextDoneIdx ^= 1;
+static bool onColorTransDone(esp_lcd_panel_io_handle_t, esp_lcd_panel_io_event_data_t*, void*) {
+    const uint8_t tail = S_INFLIGHT_TAIL;
+    S_BUF_BUSY[S_INFLIGHT[tail % K_INFLIGHT_SLOTS]] = false;
+    S_INFLIGHT_TAIL = static_cast<uint8_t>(tail + 1);
     return false;
 }
 
+static void displaySubmitLines(const int bufIdx, const int startY, const int endY, const uint16_t* data) {
+    const uint8_t head = S_INFLIGHT_HEAD;
+    S_INFLIGHT[head % K_INFLIGHT_SLOTS] = static_cast<uint8_t>(bufIdx);
+    S_INFLIGHT_HEAD = static_cast<uint8_t>(head + 1);
+    S_BUF_BUSY[bufIdx] = true;
+    ESP_ERROR_CHECK(esp_lcd_panel_draw_bitmap(PANEL, 0, startY, LCD_H_RES, endY, data));
+}
+
 static constexpr uint16_t rgb565(const uint8_t r, const uint8_t g, const uint8_t b) {
     return static_cast<uint16_t>(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
 }
@@ -122,19 +141,29 @@ static void displayPrepareRGBBuffers() {
 }
 
 static bool DISPLAY_READY = false;
+// Held while the UI renders a frame or the remote framebuffer handles a piece of a pack, the two never share
+// S_LINES. Never held across handler calls, so a host that stalls mid-frame cannot freeze the UI.
+static SemaphoreHandle_t S_FRAME_LOCK = nullptr;
+// UI frames rendered, under S_FRAME_LOCK; tells a remote pack that the UI drew over its half decoded tiles
+static uint32_t S_UI_FRAMES = 0;
 
 void displayFrameRender() {
-    if (!DISPLAY_READY) {
+    if (!DISPLAY_READY || displayRemoteActive()) {
         return;
     }
+    xSemaphoreTake(S_FRAME_LOCK, portMAX_DELAY);
     const uint32_t start = esp_timer_get_time();
 
     vision_ui_driver_buffer_clear();
     displayPrepareRGBBuffers();
     vision_ui_step_render();
+    effectDraw();
 
     const uint32_t flash = esp_timer_get_time();
     vision_ui_driver_buffer_send();
+    ++S_UI_FRAMES;
+    xSemaphoreGive(S_FRAME_LOCK);
+    latencyFramePresented(esp_timer_get_time());
 
     const uint32_t end = esp_timer_get_time();
     const float elapsed = (end - start) / 1e6;
@@ -256,6 +285,9 @@ void displayInit(vision_ui_action_t (*callback)()) {
     // Turn on backlight
     ESP_ERROR_CHECK(gpio_set_level(PIN_NUM_BK, BK_LIGHT_ON_LEVEL));
 
+    S_FRAME_LOCK = xSemaphoreCreateMutex();
+    assert(S_FRAME_LOCK && "Failed to create frame lock");
+
     vision_ui_driver_bind(&U8G2);
     vision_ui_allocator_set(allocator);
 
@@ -312,8 +344,7 @@ void vision_ui_driver_buffer_send() {
             }
         }
 
-        S_BUF_BUSY[bufIdx] = true;
-        ESP_ERROR_CHECK(esp_lcd_panel_draw_bitmap(PANEL, 0, startY, LCD_H_RES, startY + linesThisBlock, block));
+        displaySubmitLines(bufIdx, startY, startY + linesThisBlock, block);
         bufIdx ^= 1;
     }
 }
@@ -510,6 +541,276 @@ extern void displayDriverExtensionRGBBitmapAlphaDraw(
     }
 }
 
+// Remote framebuffer. Tiles are written straight into S_LINES (which together hold the whole rotated frame) and
+// the touched rows of each buffer are flushed when the pack ends.
+static constexpr int64_t K_REMOTE_IDLE_US = 2 * 1000 * 1000;
+static constexpr int64_t K_REMOTE_LOG_US = 5 * 1000 * 1000;
+// A 128 line DMA transfer takes about 15 ms; a buffer busy for much longer means the panel stopped completing them.
+static constexpr int64_t K_REMOTE_DMA_WAIT_US = 100 * 1000;
+static constexpr size_t K_TILE_PIXELS = DISPLAY_REMOTE_TILE * DISPLAY_REMOTE_TILE;
+static constexpr uint8_t K_TILES_X = LCD_H_RES / DISPLAY_REMOTE_TILE;
+static constexpr uint8_t K_TILES_Y = LCD_V_RES / DISPLAY_REMOTE_TILE;
+
+static_assert(LCD_H_RES % DISPLAY_REMOTE_TILE == 0 && LCD_V_RES % DISPLAY_REMOTE_TILE == 0, "whole tiles only");
+static_assert(PARALLEL_LINES % DISPLAY_REMOTE_TILE == 0, "a tile never straddles two DMA buffers");
+
+enum class RemoteParse : uint8_t {
+    Header,
+    Raw,
+    Solid,
+    RunLength,
+    RunColor,
+    Skip,
+};
+
+struct RemoteState {
+    RemoteParse parse = RemoteParse::Header;
+    uint8_t header[3] = {};
+    size_t headerLen = 0;
+    uint8_t colorBytes[2] = {};
+    size_t colorLen = 0;
+    uint16_t runLeft = 0;
+    size_t pixel = 0;
+    int tileBuf = 0;
+    int tileRow0 = 0;
+    int tileCol0 = 0;
+    // a pack is being decoded, and the UI frame count when it started
+    bool inPack = false;
+    uint32_t uiFrames = 0;
+    bool corrupt = false;
+    // dirty rows per DMA buffer, relative to the buffer
+    int dirtyMin[2] = {PARALLEL_LINES, PARALLEL_LINES};
+    int dirtyMax[2] = {-1, -1};
+};
+
+static RemoteState S_REMOTE;
+static volatile int64_t S_REMOTE_LAST_US = 0;
+static DisplayRemoteStats S_REMOTE_STATS = {};
+static int64_t S_REMOTE_WINDOW_US = 0;
+static uint32_t S_REMOTE_WINDOW_FRAMES = 0;
+static uint64_t S_REMOTE_WINDOW_BYTES = 0;
+static int64_t S_REMOTE_LOG_US = 0;
+
+static bool remoteBeginTile(const uint8_t tileX, const uint8_t tileY) {
+    // rotate 180 degrees like every other draw into S_LINES
+    const int dstTop = LCD_V_RES - DISPLAY_REMOTE_TILE * (tileY + 1);
+    S_REMOTE.tileBuf = dstTop / PARALLEL_LINES;
+    S_REMOTE.tileRow0 = dstTop - S_REMOTE.tileBuf * PARALLEL_LINES;
+    S_REMOTE.tileCol0 = LCD_H_RES - DISPLAY_REMOTE_TILE * (tileX + 1);
+    S_REMOTE.pixel = 0;
+    const int64_t deadline = esp_timer_get_time() + K_REMOTE_DMA_WAIT_US;
+    while (S_BUF_BUSY[S_REMOTE.tileBuf]) {
+        if (esp_timer_get_time() > deadline) {
+            // never write into a buffer the DMA may still read, drop the rest of the pack instead
+            ESP_LOGW(HW_TAG, "remote: DMA buffer %d stuck, dropping frame", S_REMOTE.tileBuf);
+            return false;
+        }
+        taskYIELD();
+    }
+    int& dirtyMin = S_REMOTE.dirtyMin[S_REMOTE.tileBuf];
+    int& dirtyMax = S_REMOTE.dirtyMax[S_REMOTE.tileBuf];
+    dirtyMin = std::min(dirtyMin, S_REMOTE.tileRow0);
+    dirtyMax = std::max(dirtyMax, S_REMOTE.tileRow0 + static_cast<int>(DISPLAY_REMOTE_TILE) - 1);
+    ++S_REMOTE_STATS.tiles;
+    return true;
+}
+
+static void remotePut(const uint8_t* colorBytes, size_t count) {
+    // wire colors are in panel byte order, like every buffer in S_LINES
+    const uint16_t color = static_cast<uint16_t>(colorBytes[0] | (colorBytes[1] << 8U));
+    count = std::min(count, K_TILE_PIXELS - S_REMOTE.pixel);
+    for (; count > 0; --count, ++S_REMOTE.pixel) {
+        const int x = static_cast<int>(S_REMOTE.pixel % DISPLAY_REMOTE_TILE);
+        const int y = static_cast<int>(S_REMOTE.pixel / DISPLAY_REMOTE_TILE);
+        const int row = S_REMOTE.tileRow0 + (DISPLAY_REMOTE_TILE - 1 - y);
+        const int col = S_REMOTE.tileCol0 + (DISPLAY_REMOTE_TILE - 1 - x);
+        S_LINES[S_REMOTE.tileBuf][row * LCD_H_RES + col] = color;
+    }
+}
+
+static void remoteParse(const uint8_t byte) {
+    switch (S_REMOTE.parse) {
+        case RemoteParse::Header: {
+            S_REMOTE.header[S_REMOTE.headerLen++] = byte;
+            if (S_REMOTE.headerLen < sizeof(S_REMOTE.header)) {
+                return;
+            }
+            S_REMOTE.headerLen = 0;
+            S_REMOTE.colorLen = 0;
+            const uint8_t tileX = S_REMOTE.header[0];
+            const uint8_t tileY = S_REMOTE.header[1];
+            if (tileX >= K_TILES_X || tileY >= K_TILES_Y) {
+                S_REMOTE.corrupt = true;
+                S_REMOTE.parse = RemoteParse::Skip;
+                return;
+            }
+            if (!remoteBeginTile(tileX, tileY)) {
+                S_REMOTE.corrupt = true;
+                S_REMOTE.parse = RemoteParse::Skip;
+                return;
+            }
+            switch (static_cast<DisplayRemoteEncoding>(S_REMOTE.header[2])) {
+                case DisplayRemoteEncoding::Raw:
+                    S_REMOTE.parse = RemoteParse::Raw;
+                    return;
+                case DisplayRemoteEncoding::Solid:
+                    S_REMOTE.parse = RemoteParse::Solid;
+                    return;
+                case DisplayRemoteEncoding::Rle:
+                    S_REMOTE.parse = RemoteParse::RunLength;
+                    return;
+            }
+            S_REMOTE.corrupt = true;
+            S_REMOTE.parse = RemoteParse::Skip;
+            return;
+        }
+        case RemoteParse::Raw:
+        case RemoteParse::Solid:
+        case RemoteParse::RunColor:
+            S_REMOTE.colorBytes[S_REMOTE.colorLen++] = byte;
+            if (S_REMOTE.colorLen < sizeof(S_REMOTE.colorBytes)) {
+                return;
+            }
+            S_REMOTE.colorLen = 0;
+            if (S_REMOTE.parse == RemoteParse::Raw) {
+                remotePut(S_REMOTE.colorBytes, 1);
+            } else if (S_REMOTE.parse == RemoteParse::Solid) {
+                remotePut(S_REMOTE.colorBytes, K_TILE_PIXELS);
+            } else {
+                remotePut(S_REMOTE.colorBytes, S_REMOTE.runLeft);
+                S_REMOTE.parse = RemoteParse::RunLength;
+            }
+            if (S_REMOTE.pixel >= K_TILE_PIXELS) {
+                S_REMOTE.parse = RemoteParse::Header;
+            }
+            return;
+        case RemoteParse::RunLength:
+            // runs store length - 1, so one byte covers 1..256 pixels
+            S_REMOTE.runLeft = static_cast<uint16_t>(byte + 1);
+            S_REMOTE.parse = RemoteParse::RunColor;
+            return;
+        case RemoteParse::Skip:
+            return;
+    }
+}
+
+static void remoteFlush() {
+    for (int i = 0; i < 2; ++i) {
+        if (S_REMOTE.dirtyMax[i] < S_REMOTE.dirtyMin[i]) {
+            continue;
+        }
+        const int startY = i * PARALLEL_LINES + S_REMOTE.dirtyMin[i];
+        const int endY = std::min(LCD_V_RES, i * PARALLEL_LINES + S_REMOTE.dirtyMax[i] + 1);
+        displaySubmitLines(i, startY, endY, S_LINES[i] + S_REMOTE.dirtyMin[i] * LCD_H_RES);
+        S_REMOTE.dirtyMin[i] = PARALLEL_LINES;
+        S_REMOTE.dirtyMax[i] = -1;
+    }
+    latencyFramePresented(esp_timer_get_time());
+}
+
+static void remoteCountFrame(const int64_t now) {
+    ++S_REMOTE_STATS.frames;
+    ++S_REMOTE_WINDOW_FRAMES;
+    if (S_REMOTE_WINDOW_US == 0) {
+        S_REMOTE_WINDOW_US = now;
+        S_REMOTE_LOG_US = now;
+        return;
+    }
+    if (const int64_t elapsed = now - S_REMOTE_WINDOW_US; elapsed >= 1000 * 1000) {
+        S_REMOTE_STATS.fps = static_cast<float>(S_REMOTE_WINDOW_FRAMES) * 1e6F / static_cast<float>(elapsed);
+        S_REMOTE_STATS.bytesPerSecond =
+                static_cast<float>(S_REMOTE_WINDOW_BYTES) * 1e6F / static_cast<float>(elapsed);
+        S_REMOTE_WINDOW_US = now;
+        S_REMOTE_WINDOW_FRAMES = 0;
+        S_REMOTE_WINDOW_BYTES = 0;
+    }
+    if (now - S_REMOTE_LOG_US >= K_REMOTE_LOG_US) {
+        S_REMOTE_LOG_US = now;
+        ESP_LOGI(
+                HW_TAG,
+                "remote: %.1f fps, %.1f kB/s, %u frames, %u tiles",
+                S_REMOTE_STATS.fps,
+                S_REMOTE_STATS.bytesPerSecond / 1024.0F,
+                static_cast<unsigned>(S_REMOTE_STATS.frames),
+                static_cast<unsigned>(S_REMOTE_STATS.tiles)
+        );
+    }
+}
+
+// Flush what the pack decoded, with S_FRAME_LOCK held.
+static void remoteEndPack() {
+    remoteFlush();
+    S_REMOTE.parse = RemoteParse::Header;
+    S_REMOTE.headerLen = 0;
+    S_REMOTE.colorLen = 0;
+    S_REMOTE.corrupt = false;
+    S_REMOTE.inPack = false;
+}
+
+void displayRemoteHandler(const uint8_t* data, const size_t size) {
+    if (!DISPLAY_READY) {
+        return;
+    }
+    // only for this piece: the UI takes over once the remote is idle for K_REMOTE_IDLE_US, even mid-pack
+    xSemaphoreTake(S_FRAME_LOCK, portMAX_DELAY);
+    if (S_REMOTE.inPack && S_REMOTE.uiFrames != S_UI_FRAMES) {
+        // the host stalled long enough for the UI to draw over the tiles decoded so far, they are gone
+        S_REMOTE.corrupt = true;
+        S_REMOTE.parse = RemoteParse::Skip;
+        S_REMOTE.dirtyMin[0] = S_REMOTE.dirtyMin[1] = PARALLEL_LINES;
+        S_REMOTE.dirtyMax[0] = S_REMOTE.dirtyMax[1] = -1;
+        S_REMOTE.uiFrames = S_UI_FRAMES;
+    }
+
+    if (serialPackAborted()) {
+        // the host went away or gave up mid-frame
+        if (S_REMOTE.inPack) {
+            ESP_LOGW(HW_TAG, "remote: frame aborted, showing what was decoded");
+            ++S_REMOTE_STATS.errors;
+            remoteEndPack();
+        }
+        xSemaphoreGive(S_FRAME_LOCK);
+        return;
+    }
+    const int64_t now = esp_timer_get_time();
+    S_REMOTE_LAST_US = now;
+    if (!S_REMOTE.inPack) {
+        S_REMOTE.inPack = true;
+        S_REMOTE.uiFrames = S_UI_FRAMES;
+    }
+
+    if (data && size > 0) {
+        S_REMOTE_STATS.bytes += size;
+        S_REMOTE_WINDOW_BYTES += size;
+        for (size_t i = 0; i < size; ++i) {
+            remoteParse(data[i]);
+        }
+        xSemaphoreGive(S_FRAME_LOCK);
+        return;
+    }
+
+    if (S_REMOTE.corrupt || S_REMOTE.parse != RemoteParse::Header || S_REMOTE.headerLen != 0) {
+        ESP_LOGW(HW_TAG, "remote: malformed frame, showing what was decoded");
+        ++S_REMOTE_STATS.errors;
+    }
+    remoteEndPack();
+    xSemaphoreGive(S_FRAME_LOCK);
+    remoteCountFrame(now);
+}
+
+bool displayRemoteActive() {
+    const int64_t last = S_REMOTE_LAST_US;
+    return last != 0 && esp_timer_get_time() - last < K_REMOTE_IDLE_US;
+}
+
+DisplayRemoteStats displayRemoteGetStats() {
+    return S_REMOTE_STATS;
+}
+
+void displayBacklightSet(const bool on) {
+    gpio_set_level(PIN_NUM_BK, on ? BK_LIGHT_ON_LEVEL : BK_LIGHT_OFF_LEVEL);
+}
+
 void displayDriverExtensionPixelScale(const uint16_t scale) {
     S_PIXEL_SCALE = scale > 0 ? scale : 1;
 }
@@ -0,0 +1,408 @@
+/*
+Lumen
+Copyright (C) 2025  Finn Sheng
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "include/widget_page.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <esp_log.h>
+
+#include <vision_ui_lib.h>
+
+#include "include/byte_order.hpp"
+#include "include/display.hpp"
+#include "include/image_cache.hpp"
+#include "include/serial_pack.hpp"
+#include "include/snapshot.hpp"
+
+static constexpr auto WIDGET_PAGE_TAG = "[lumen:widget_page]";
+static constexpr size_t K_WIDGET_HEADER_LEN = 20;
+static constexpr size_t K_VALUES_MAX = 512;
+// Gauges sweep 270 degrees, starting bottom left.
+static constexpr float K_GAUGE_START = 0.75F * static_cast<float>(M_PI);
+static constexpr float K_GAUGE_SWEEP = 1.5F * static_cast<float>(M_PI);
+
+namespace {
+    struct Widget {
+        WidgetType type;
+        uint8_t field;
+        int16_t x;
+        int16_t y;
+        uint16_t w;
+        uint16_t h;
+        float min;
+        float max;
+        uint8_t decimals;
+        char text[WIDGET_PAGE_TEXT_MAX];
+        // Sprite only, resolved from the image cache when the layout arrives and pinned while the layout lives in
+        // its snapshot slot.
+        ImageCacheEntry sprite;
+    };
+
+    struct WidgetLayout {
+        // bumped by every layout upload, so the view notices a new layout
+        uint32_t generation;
+        uint8_t count;
+        Widget widgets[WIDGET_PAGE_MAX_WIDGETS];
+    };
+
+    // Reassembly of the two pack kinds. They may arrive interleaved on different channels.
+    struct WidgetPageState {
+        Snapshot<WidgetLayout> layout;
+        SyncedStore values;
+        uint32_t layoutGeneration = 0;
+        uint8_t layoutBuffer[WIDGET_PAGE_LAYOUT_MAX] = {};
+        size_t layoutLen = 0;
+        bool layoutOverflow = false;
+        uint8_t valueBuffer[K_VALUES_MAX] = {};
+        size_t valueLen = 0;
+        bool valueOverflow = false;
+    };
+
+    // What the page last drew; formatted text is only redone for widgets whose field changed.
+    struct WidgetPageView {
+        uint32_t layoutGeneration = 0;
+        uint32_t version = 0;
+        float value[WIDGET_PAGE_MAX_WIDGETS] = {};
+        char text[WIDGET_PAGE_MAX_WIDGETS][SYNCED_STATE_STRING_MAX + WIDGET_PAGE_TEXT_MAX] = {};
+    };
+
+    WidgetPageState S_PAGE;
+    WidgetPageView S_VIEW;
+    WidgetPageStats S_STATS = {};
+
+    bool accumulate(
+            uint8_t* buffer,
+            const size_t capacity,
+            size_t& len,
+            bool& overflow,
+            const uint8_t* data,
+            const size_t size
+    ) {
+        if (overflow) {
+            return false;
+        }
+        if (len + size > capacity) {
+            overflow = true;
+            len = 0;
+            return false;
+        }
+        std::memcpy(buffer + len, data, size);
+        len += size;
+        return true;
+    }
+
+    bool decodeWidget(const uint8_t* data, const size_t size, size_t& pos, Widget& out) {
+        if (size - pos < K_WIDGET_HEADER_LEN) {
+            return false;
+        }
+        const uint8_t* p = data + pos;
+        const uint8_t textLen = p[19];
+        if (size - pos - K_WIDGET_HEADER_LEN < textLen || p[0] > static_cast<uint8_t>(WidgetType::Sprite) ||
+            p[1] >= SYNCED_STATE_MAX_FIELDS) {
+            return false;
+        }
+
+        out = {
+                .type = static_cast<WidgetType>(p[0]),
+                .field = p[1],
+                .x = static_cast<int16_t>(readU16Le(p + 2)),
+                .y = static_cast<int16_t>(readU16Le(p + 4)),
+                .w = readU16Le(p + 6),
+                .h = readU16Le(p + 8),
+                .min = readF32Le(p + 10),
+                .max = readF32Le(p + 14),
+                .decimals = std::min<uint8_t>(p[18], 6),
+                .text = {},
+                .sprite = {},
+        };
+        const uint8_t* text = p + K_WIDGET_HEADER_LEN;
+        pos += K_WIDGET_HEADER_LEN + textLen;
+
+        if (out.type != WidgetType::Sprite) {
+            const size_t n = std::min<size_t>(textLen, WIDGET_PAGE_TEXT_MAX - 1);
+            std::memcpy(out.text, text, n);
+            out.text[n] = '\0';
+            return true;
+        }
+
+        if (textLen != sizeof(uint64_t)) {
+            return false;
+        }
+        const uint64_t hash = readU64Le(text);
+        if (imageCacheLookup(hash, out.sprite)) {
+            out.w = out.sprite.width;
+            out.h = out.sprite.height;
+        } else {
+            ESP_LOGW(WIDGET_PAGE_TAG, "sprite %016llx not cached", static_cast<unsigned long long>(hash));
+        }
+        return true;
+    }
+
+    bool decodeLayout(const uint8_t* data, const size_t size, WidgetLayout& out) {
+        if (size < 3 || data[0] != WIDGET_PAGE_MAGIC || data[1] != WIDGET_PAGE_VERSION ||
+            data[2] > WIDGET_PAGE_MAX_WIDGETS) {
+            return false;
+        }
+        // `out` is the snapshot's back slot, which the UI no longer draws
+        for (uint8_t i = 0; i < out.count; ++i) {
+            imageCacheRelease(out.widgets[i].sprite);
+        }
+        out.count = 0;
+        size_t pos = 3;
+        for (uint8_t i = 0; i < data[2]; ++i) {
+            if (!decodeWidget(data, size, pos, out.widgets[out.count])) {
+                return false;
+            }
+            ++out.count;
+        }
+        return pos == size;
+    }
+
+    // Walk a value patch; with `values` null it is only validated.
+    bool applyValues(const uint8_t* data, const size_t size, SyncedStore* values) {
+        if (size < 2 || data[0] != WIDGET_PAGE_MAGIC || data[1] != WIDGET_PAGE_VERSION) {
+            return false;
+        }
+        size_t pos = 2;
+        while (pos < size) {
+            if (size - pos < 3) {
+                return false;
+            }
+            const uint8_t field = data[pos];
+            const auto kind = static_cast<WidgetValueKind>(data[pos + 1]);
+            const uint8_t len = data[pos + 2];
+            pos += 3;
+            if (size - pos < len) {
+                return false;
+            }
+            const uint8_t* value = data + pos;
+            pos += len;
+
+            if (field >= SYNCED_STATE_MAX_FIELDS) {
+                return false;
+            }
+            if (kind == WidgetValueKind::Number && len == sizeof(float)) {
+                if (values) {
+                    values->setFloat(field, readF32Le(value));
+                }
+            } else if (kind == WidgetValueKind::Text) {
+                if (values) {
+                    values->setString(field, reinterpret_cast<const char*>(value), len);
+                }
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    float fraction(const Widget& widget, const float value) {
+        if (!(widget.max > widget.min)) {
+            return 0.0F;
+        }
+        return std::clamp((value - widget.min) / (widget.max - widget.min), 0.0F, 1.0F);
+    }
+
+    void refreshView(const WidgetLayout& layout) {
+        const SyncedFields& values = S_PAGE.values.acquire();
+        WidgetPageView& view = S_VIEW;
+        if (view.layoutGeneration != layout.generation) {
+            // new layout, every widget is stale
+            view.layoutGeneration = layout.generation;
+            view.version = 0;
+        }
+
+        const uint32_t changed = values.changesSince(view.version);
+        if (changed == 0) {
+            return;
+        }
+        for (uint8_t i = 0; i < layout.count; ++i) {
+            const Widget& widget = layout.widgets[i];
+            if (!(changed & syncedFieldBit(widget.field))) {
+                continue;
+            }
+            switch (widget.type) {
+                case WidgetType::Number:
+                    view.value[i] = values.getFloat(widget.field);
+                    std::snprintf(
+                            view.text[i],
+                            sizeof(view.text[i]),
+                            "%.*f%s",
+                            widget.decimals,
+                            static_cast<double>(view.value[i]),
+                            widget.text
+                    );
+                    break;
+                case WidgetType::Text:
+                    std::snprintf(
+                            view.text[i],
+                            sizeof(view.text[i]),
+                            "%s%s",
+                            widget.text,
+                            values.getString(widget.field)
+                    );
+                    break;
+                case WidgetType::Bar:
+                case WidgetType::Gauge:
+                    view.value[i] = fraction(widget, values.getFloat(widget.field));
+                    break;
+                case WidgetType::Label:
+                case WidgetType::Sprite:
+                    break;
+            }
+        }
+    }
+
+    void drawBar(const Widget& widget, const float filled) {
+        vision_ui_driver_frame_draw(widget.x, widget.y, widget.w, widget.h);
+        if (widget.w <= 2 || widget.h <= 2) {
+            return;
+        }
+        const auto inner = static_cast<uint16_t>(std::lround(static_cast<float>(widget.w - 2) * filled));
+        if (inner > 0) {
+            vision_ui_driver_box_draw(widget.x + 1, widget.y + 1, inner, widget.h - 2);
+        }
+    }
+
+    void drawGauge(const Widget& widget, const float filled) {
+        const uint16_t r = std::min(widget.w, widget.h) / 2;
+        if (r < 2) {
+            return;
+        }
+        const int cx = widget.x + r;
+        const int cy = widget.y + r;
+        const float angle = K_GAUGE_START + K_GAUGE_SWEEP * filled;
+        const float needle = static_cast<float>(r - 2);
+        vision_ui_driver_circle_draw(cx, cy, r);
+        vision_ui_driver_line_draw(
+                cx,
+                cy,
+                static_cast<uint16_t>(std::lround(static_cast<float>(cx) + needle * cosf(angle))),
+                static_cast<uint16_t>(std::lround(static_cast<float>(cy) + needle * sinf(angle)))
+        );
+        if (widget.text[0] != '\0') {
+            const uint16_t width = vision_ui_driver_str_width_get(widget.text);
+            vision_ui_driver_str_draw(
+                    static_cast<uint16_t>(cx - width / 2),
+                    static_cast<uint16_t>(widget.y + 2 * r),
+                    widget.text
+            );
+        }
+    }
+} // namespace
+
+void widgetPageLayoutHandler(const uint8_t* data, const size_t size) {
+    WidgetPageState& page = S_PAGE;
+    if (data && size > 0) {
+        accumulate(page.layoutBuffer, sizeof(page.layoutBuffer), page.layoutLen, page.layoutOverflow, data, size);
+        return;
+    }
+
+    const bool overflow = page.layoutOverflow;
+    const size_t len = page.layoutLen;
+    page.layoutOverflow = false;
+    page.layoutLen = 0;
+    if (serialPackAborted()) {
+        return;
+    }
+    WidgetLayout& layout = page.layout.back();
+    if (overflow || !decodeLayout(page.layoutBuffer, len, layout)) {
+        ESP_LOGW(
+                WIDGET_PAGE_TAG,
+                "rejected layout of %u bytes%s",
+                static_cast<unsigned>(len),
+                overflow ? " (overflow)" : ""
+        );
+        ++S_STATS.rejected;
+        return;
+    }
+    layout.generation = ++page.layoutGeneration;
+    page.layout.publish();
+    ++S_STATS.layouts;
+}
+
+void widgetPageValueHandler(const uint8_t* data, const size_t size) {
+    WidgetPageState& page = S_PAGE;
+    if (data && size > 0) {
+        accumulate(page.valueBuffer, sizeof(page.valueBuffer), page.valueLen, page.valueOverflow, data, size);
+        return;
+    }
+
+    const bool overflow = page.valueOverflow;
+    const size_t len = page.valueLen;
+    page.valueOverflow = false;
+    page.valueLen = 0;
+    if (serialPackAborted()) {
+        return;
+    }
+    // validate before applying, a malformed patch changes nothing
+    if (overflow || !applyValues(page.valueBuffer, len, nullptr)) {
+        ++S_STATS.rejected;
+        return;
+    }
+    applyValues(page.valueBuffer, len, &page.values);
+    page.values.commit();
+    ++S_STATS.updates;
+    S_STATS.updateBytes += len;
+}
+
+bool widgetPageActive() {
+    return S_PAGE.layout.published() != 0 && S_PAGE.layout.acquire().count > 0;
+}
+
+void widgetPageDraw() {
+    const WidgetLayout& layout = S_PAGE.layout.acquire();
+    refreshView(layout);
+
+    for (uint8_t i = 0; i < layout.count; ++i) {
+        const Widget& widget = layout.widgets[i];
+        switch (widget.type) {
+            case WidgetType::Label:
+                vision_ui_driver_str_draw(widget.x, widget.y, widget.text);
+                break;
+            case WidgetType::Number:
+            case WidgetType::Text:
+                vision_ui_driver_str_draw(widget.x, widget.y, S_VIEW.text[i]);
+                break;
+            case WidgetType::Bar:
+                drawBar(widget, S_VIEW.value[i]);
+                break;
+            case WidgetType::Gauge:
+                drawGauge(widget, S_VIEW.value[i]);
+                break;
+            case WidgetType::Sprite:
+                if (widget.sprite.pixels) {
+                    displayDriverExtensionRGBBitmapDraw(
+                            widget.x,
+                            widget.y,
+                            static_cast<int16_t>(widget.w),
+                            static_cast<int16_t>(widget.h),
+                            widget.sprite.pixels
+                    );
+                }
+                break;
+        }
+    }
+}
+
+WidgetPageStats widgetPageGetStats() {
+    return S_STATS;
+}
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Show the INA226 acquisition profiles and what each delivered on the device, over the `acq` pack.
+
+    acquisition.py                  the measurements of every profile that has run since boot
+    acquisition.py --measure 10     run each profile for 10 seconds, then print the table
+    acquisition.py --set precision  switch profile (the `cfg` field "profile")
+
+Noise is the RMS change between consecutive samples over sqrt(2), so measure with a steady load. See
+main/include/current_sensor.hpp.
+"""
+import argparse
+import struct
+import time
+
+import config
+from serial_pack import FrameReader, encode_pack
+
+PATH = "acq"
+VERSION = 2
+PROFILES = ("fast-protect", "balanced", "precision", "low-power")
+PROFILE = struct.Struct("<IIIfIff")
+
+
+def decode_reply(data: bytes):
+    """Returns (active, [dict per profile], failed samples) or None."""
+    if len(data) != 2 + len(PROFILES) * PROFILE.size + 4 or data[0] != VERSION:
+        return None
+    names = ("period_us", "cycle_us", "samples", "rate_hz", "max_gap_us", "noise_ma", "noise_mv")
+    profiles = [dict(zip(names, PROFILE.unpack_from(data, 2 + i * PROFILE.size))) for i in range(len(PROFILES))]
+    (failed,) = struct.unpack_from("<I", data, 2 + len(PROFILES) * PROFILE.size)
+    return data[1], profiles, failed
+
+
+def query(ser, reader: FrameReader, timeout: float):
+    ser.write(encode_pack(PATH, b""))
+    ser.flush()
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        for path, data in reader.feed(ser.read(ser.in_waiting or 1)):
+            reply = decode_reply(data) if path == PATH else None
+            if reply:
+                return reply
+    return None
+
+
+def set_profile(ser, reader: FrameReader, profile: int, timeout: float) -> bool:
+    items = struct.pack("<Bh", config.FIELDS["profile"], profile)
+    reply = config.request(ser, reader, config.OP_SET, 1, items, 1, timeout)
+    return reply is not None and reply[2] == 0
+
+
+def print_table(active: int, profiles, failed: int):
+    print(f"{'profile':<14} {'period':>8} {'cycle':>8} {'samples':>8} {'rate Hz':>8} {'max gap':>8} "
+          f"{'noise mA':>9} {'noise mV':>9}")
+    for i, (name, profile) in enumerate(zip(PROFILES, profiles)):
+        marker = "*" if i == active else " "
+        measured = (f"{profile['samples']:>8} {profile['rate_hz']:>8.1f} {profile['max_gap_us'] / 1000:>6.1f}ms "
+                    f"{profile['noise_ma']:>9.3f} {profile['noise_mv']:>9.3f}") if profile["samples"] else "not run"
+        print(f"{marker}{name:<13} {profile['period_us'] / 1000:>6.1f}ms {profile['cycle_us'] / 1000:>6.2f}ms "
+              f"{measured}")
+    if failed:
+        print(f"{failed} samples skipped on failed register reads since boot")
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", default="/dev/cu.usbmodem1101", help="Serial device path")
+    parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--timeout", type=float, default=1.0, help="Seconds to wait for each answer")
+    parser.add_argument("--set", choices=PROFILES, help="Switch to this profile")
+    parser.add_argument("--measure", type=float, metavar="SECONDS", help="Run every profile this long, then restore")
+    args = parser.parse_args()
+
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=0.05, write_timeout=2) as ser:
+        reader = FrameReader()
+        reply = query(ser, reader, args.timeout)
+        if reply is None:
+            print("device did not answer")
+            return 1
+        if args.set and not set_profile(ser, reader, PROFILES.index(args.set), args.timeout):
+            print("switch rejected")
+            return 1
+        if args.measure:
+            original = reply[0]
+            for i, name in enumerate(PROFILES):
+                print(f"measuring {name} for {args.measure:g} s")
+                if not set_profile(ser, reader, i, args.timeout):
+                    print("switch rejected")
+                    return 1
+                time.sleep(args.measure)
+            # before switching back, which starts the original profile's measurement over
+            reply = query(ser, reader, args.timeout)
+            set_profile(ser, reader, original, args.timeout)
+        elif args.set:
+            # the switch lands on the next sample
+            time.sleep(0.5)
+            reply = query(ser, reader, args.timeout)
+        if reply is None:
+            print("device did not answer")
+            return 1
+    print_table(*reply)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Record a current transient on the device over the `cap` pack and save it as CSV.
+
+    capture.py --level 500 > inrush.csv             first sample at or above 500 mA
+    capture.py --rise 200 --pre 256 --show -o a.csv  a jump of 200 mA between two samples, shown on the screen
+
+The device reads the shunt back to back at its fastest conversion time while armed, see
+main/include/transient_capture.hpp. Times in the CSV are relative to the trigger sample.
+"""
+import argparse
+import struct
+import sys
+import time
+
+from serial_pack import FrameReader, encode_pack
+
+PATH = "cap"
+OP_ARM, OP_STATUS, OP_READ, OP_CANCEL, OP_SHOW = 1, 2, 3, 4, 5
+REPLY = 0x80
+STATES = ("idle", "armed", "done", "timed out", "cancelled")
+STATUS = struct.Struct("<BBBHHIff")
+SAMPLE = struct.Struct("<ih")
+LSB_MA = 0.1
+MAX_READ = 128
+
+
+def decode_reply(data: bytes):
+    """Returns (op, ok, state, samples, trigger_index, span_us, min_ma, max_ma, read) or None."""
+    if len(data) < STATUS.size or not data[0] & REPLY:
+        return None
+    op, ok, state, samples, trigger, span_us, low, high = STATUS.unpack_from(data)
+    read = []
+    if op & ~REPLY == OP_READ and ok and len(data) >= STATUS.size + 4:
+        first, count = struct.unpack_from("<HH", data, STATUS.size)
+        if len(data) != STATUS.size + 4 + count * SAMPLE.size:
+            return None
+        read = [SAMPLE.unpack_from(data, STATUS.size + 4 + i * SAMPLE.size) for i in range(count)]
+    return op & ~REPLY, bool(ok), state, samples, trigger, span_us, low, high, read
+
+
+def request(ser, reader: FrameReader, payload: bytes, timeout: float):
+    ser.write(encode_pack(PATH, payload))
+    ser.flush()
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        for path, data in reader.feed(ser.read(ser.in_waiting or 1)):
+            reply = decode_reply(data) if path == PATH else None
+            if reply and reply[0] == payload[0]:
+                return reply
+    return None
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", default="/dev/cu.usbmodem1101", help="Serial device path")
+    parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--timeout", type=float, default=1.0, help="Seconds to wait for each answer")
+    trigger = parser.add_mutually_exclusive_group(required=True)
+    trigger.add_argument("--level", type=int, metavar="MA", help="Trigger at or above this current")
+    trigger.add_argument("--rise", type=int, metavar="MA", help="Trigger on a rise of this much between samples")
+    parser.add_argument("--pre", type=int, default=128, help="Samples to keep before the trigger")
+    parser.add_argument("--wait", type=float, default=30.0, help="Seconds to wait for the trigger")
+    parser.add_argument("--show", action="store_true", help="Show the capture on the device screen")
+    parser.add_argument("-o", "--output", help="CSV file, standard output by default")
+    args = parser.parse_args()
+
+    import serial
+
+    kind, threshold = (0, args.level) if args.level is not None else (1, args.rise)
+    arm = struct.pack("<BBhHI", OP_ARM, kind, threshold, args.pre, round(args.wait * 1000))
+    with serial.Serial(args.port, args.baud, timeout=0.05, write_timeout=2) as ser:
+        reader = FrameReader()
+        if args.show and not request(ser, reader, bytes([OP_SHOW, 1]), args.timeout):
+            print("device did not answer", file=sys.stderr)
+            return 1
+        reply = request(ser, reader, arm, args.timeout)
+        if reply is None or not reply[1]:
+            print("device did not answer" if reply is None else "arm rejected", file=sys.stderr)
+            return 1
+        print("armed, waiting for the trigger", file=sys.stderr)
+
+        try:
+            while reply[2] == 1:
+                time.sleep(0.2)
+                reply = request(ser, reader, bytes([OP_STATUS]), args.timeout)
+                if reply is None:
+                    print("device did not answer", file=sys.stderr)
+                    return 1
+        except KeyboardInterrupt:
+            request(ser, reader, bytes([OP_CANCEL]), args.timeout)
+            print("cancelled", file=sys.stderr)
+            return 1
+        _, _, state, samples, trigger_index, span_us, low, high, _ = reply
+        if STATES[state] != "done":
+            print(STATES[state] if state < len(STATES) else f"state {state}", file=sys.stderr)
+            return 1
+        print(
+            f"{samples} samples over {span_us / 1000:.1f} ms, trigger at {trigger_index}, {low:.1f} to {high:.1f} mA",
+            file=sys.stderr,
+        )
+
+        rows = []
+        while len(rows) < samples:
+            reply = request(ser, reader, struct.pack("<BHH", OP_READ, len(rows), MAX_READ), args.timeout)
+            if reply is None or not reply[8]:
+                print("download failed", file=sys.stderr)
+                return 1
+            rows += reply[8]
+
+    lines = ["time_us,current_ma"] + [f"{offset_us},{current * LSB_MA:.1f}" for offset_us, current in rows]
+    if args.output:
+        with open(args.output, "w") as file:
+            file.write("\n".join(lines) + "\n")
+    else:
+        print("\n".join(lines))
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
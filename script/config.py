@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Read and write the protection settings of the device over the `cfg` pack.
+
+    config.py                           print every field
+    config.py overcurrent=600 ocp=1     set fields as one batch, all or nothing
+    config.py --watch                   print the edits made on the device
+Booleans take 0/1, profile 0 fast-protect, 1 balanced, 2 precision, 3 low-power. See main/include/config_rpc.hpp for the wire format.
+"""
+import argparse
+import struct
+import time
+
+from serial_pack import FrameReader, encode_pack
+
+PATH = "cfg"
+MAGIC = 0xC8
+VERSION = 1
+REPLY = 0x80
+OP_GET = 1
+OP_SET = 2
+OP_NOTIFY = 3
+NO_FIELD = 0xFF
+FIELDS = {
+    "overcurrent": 0,
+    "overvoltage": 1,
+    "auto-recovery": 2,
+    "usb-off": 3,
+    "ovp": 4,
+    "ocp": 5,
+    "fast-trip": 6,
+    "hard-limit": 7,
+    "trip-tau": 8,
+    "profile": 9,
+    "persist-faults": 10,
+}
+FIELD_NAMES = {value: name for name, value in FIELDS.items()}
+STATUS = ("ok", "malformed", "unknown field", "out of range", "unsupported version")
+
+
+def encode_request(op: int, request_id: int, items: bytes, count: int) -> bytes:
+    return struct.pack("<BBBBB", MAGIC, VERSION, op, request_id, count) + items
+
+
+def decode_reply(data: bytes):
+    """Returns (op, request_id, status, bad_field, {field: value}) or None."""
+    if len(data) < 7 or data[0] != MAGIC or data[1] != VERSION:
+        return None
+    op, request_id, status, bad_field, count = struct.unpack_from("<BBBBB", data, 2)
+    if len(data) != 7 + count * 3:
+        return None
+    values = {}
+    for i in range(count):
+        field, value = struct.unpack_from("<Bh", data, 7 + i * 3)
+        values[field] = value
+    return op & ~REPLY, request_id, status, bad_field, values
+
+
+def request(ser, reader: FrameReader, op: int, request_id: int, items: bytes, count: int, timeout: float):
+    ser.write(encode_pack(PATH, encode_request(op, request_id, items, count)))
+    ser.flush()
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        for path, data in reader.feed(ser.read(ser.in_waiting or 1)):
+            reply = decode_reply(data) if path == PATH else None
+            if reply and reply[0] == op and reply[1] == request_id:
+                return reply
+    return None
+
+
+def print_values(values: dict):
+    for field, value in sorted(values.items()):
+        print(f"{FIELD_NAMES.get(field, field)}={value}")
+
+
+def parse_assignment(text: str):
+    name, _, value = text.partition("=")
+    if name not in FIELDS or not value:
+        raise argparse.ArgumentTypeError(f"expected one of {', '.join(FIELDS)} as name=value")
+    return FIELDS[name], int(value, 0)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", default="/dev/cu.usbmodem1101", help="Serial device path")
+    parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--timeout", type=float, default=1.0, help="Seconds to wait for the answer")
+    parser.add_argument("--watch", action="store_true", help="Print device side edits until interrupted")
+    parser.add_argument("set", nargs="*", type=parse_assignment, metavar="NAME=VALUE", help="Fields to set")
+    args = parser.parse_args()
+
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=0.05, write_timeout=2) as ser:
+        reader = FrameReader()
+        if args.set:
+            items = b"".join(struct.pack("<Bh", field, value) for field, value in args.set)
+            reply = request(ser, reader, OP_SET, 1, items, len(args.set), args.timeout)
+        else:
+            reply = request(ser, reader, OP_GET, 1, b"", 0, args.timeout)
+        if reply is None:
+            print("device did not answer")
+            return 1
+        _, _, status, bad_field, values = reply
+        if status != 0:
+            reason = STATUS[status] if status < len(STATUS) else f"status {status}"
+            field = "" if bad_field == NO_FIELD else f" ({FIELD_NAMES.get(bad_field, bad_field)})"
+            print(f"rejected: {reason}{field}")
+            return 1
+        print_values(values)
+
+        while args.watch:
+            for path, data in reader.feed(ser.read(ser.in_waiting or 1)):
+                reply = decode_reply(data) if path == PATH else None
+                if reply and reply[0] == OP_NOTIFY:
+                    print_values(reply[4])
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
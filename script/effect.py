@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Preload effects on the device and trigger them.
+
+An effect file is JSON:
+    {"id": 1, "x": 100, "y": 40, "frames": ["<hash>", ...],
+     "steps": [{"track": "tone", "ms": 80, "a": 880, "b": 512},
+               {"track": "backlight", "ms": 60, "a": 0},
+               {"track": "sprite", "ms": 100, "a": 0}]}
+Frame hashes are the FNV-1a 64 keys of images already in the device image cache (see minecraft_sync_skin.py).
+Steps of one track play back to back; tracks play in parallel.
+"""
+import argparse
+import json
+import struct
+
+from serial_pack import encode_pack
+
+DEFINE_PATH = "fx/def"
+TRIGGER_PATH = "fx"
+MAGIC = 0xC7
+VERSION = 1
+TRACKS = {"tone": 0, "backlight": 1, "sprite": 2}
+
+# a short descending beep with a backlight flash, no sprite needed
+DAMAGE = {
+    "id": 0,
+    "steps": [
+        {"track": "tone", "ms": 60, "a": 1400, "b": 512},
+        {"track": "tone", "ms": 90, "a": 700, "b": 512},
+        {"track": "backlight", "ms": 40, "a": 0},
+        {"track": "backlight", "ms": 40, "a": 1},
+        {"track": "backlight", "ms": 40, "a": 0},
+    ],
+}
+
+
+def encode_effect(effect: dict) -> bytes:
+    frames = [int(str(h), 16) for h in effect.get("frames", [])]
+    steps = effect.get("steps", [])
+    header = (MAGIC, VERSION, effect["id"], effect.get("x", 0), effect.get("y", 0), len(frames))
+    out = bytearray(struct.pack("<BBBhhB", *header))
+    for digest in frames:
+        out += struct.pack("<Q", digest)
+    out.append(len(steps))
+    for step in steps:
+        out += struct.pack("<BHHH", TRACKS[step["track"]], step["ms"], step.get("a", 0), step.get("b", 0))
+    return bytes(out)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", default="/dev/cu.usbmodem1101", help="Serial device path")
+    parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--define", action="append", default=[], metavar="FILE", help="Effect JSON to preload")
+    parser.add_argument("--demo", action="store_true", help="Preload the built-in damage effect as id 0")
+    parser.add_argument("--remove", type=int, action="append", default=[], metavar="ID", help="Remove an effect")
+    parser.add_argument("trigger", nargs="*", type=int, help="Effect ids to trigger")
+    args = parser.parse_args()
+
+    effects = [DAMAGE] if args.demo else []
+    for path in args.define:
+        with open(path, "r", encoding="utf-8") as f:
+            effects.append(json.load(f))
+    effects += [{"id": effect_id, "steps": []} for effect_id in args.remove]
+
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=0.05, write_timeout=2) as ser:
+        for effect in effects:
+            ser.write(encode_pack(DEFINE_PATH, encode_effect(effect)))
+        if args.trigger:
+            ser.write(encode_pack(TRIGGER_PATH, bytes(args.trigger)))
+        ser.flush()
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
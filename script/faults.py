@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""Read the e-fuse fault journal of the device over the `fault` pack.
+
+    faults.py                   every incident still in the journal
+    faults.py --from 40 --csv   incidents from id 40 on, as CSV
+    faults.py --watch           also print incidents as they open and close
+    faults.py --stats           incident counts per cause and fast-trip timings
+
+Times of incidents in the current boot are converted to local time; older boots only have their uptime. See
+main/include/fault_journal.hpp.
+"""
+import argparse
+import datetime
+import struct
+import time
+
+from serial_pack import FrameReader, encode_pack
+
+PATH = "fault"
+OP_READ, OP_STATS, OP_EVENT = 1, 2, 3
+REPLY = 0x80
+MAX_READ = 16
+HEADER = struct.Struct("<BHII")
+RECORD = struct.Struct("<IHBBIIffhhh")
+STATS = struct.Struct("<11I")
+CAUSES = ("thermal", "hard-limit", "fast-trip", "overvoltage")
+RECOVERIES = ("ongoing", "auto", "reboot")
+
+
+def decode_records(data: bytes):
+    """Returns (op, boot, now_ms, next_id, [record dict]) or None."""
+    if len(data) < HEADER.size + 1:
+        return None
+    op, boot, now_ms, next_id = HEADER.unpack_from(data)
+    count = data[HEADER.size]
+    if len(data) != HEADER.size + 1 + count * RECORD.size:
+        return None
+    names = ("id", "boot", "causes", "recovery", "start_ms", "duration_ms", "peak_ma", "peak_mv", "limit_ma",
+             "hard_limit_ma", "limit_mv")
+    records = [dict(zip(names, RECORD.unpack_from(data, HEADER.size + 1 + i * RECORD.size))) for i in range(count)]
+    return op & ~REPLY, boot, now_ms, next_id, records
+
+
+def request(ser, reader: FrameReader, payload: bytes, timeout: float):
+    ser.write(encode_pack(PATH, payload))
+    ser.flush()
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        for path, data in reader.feed(ser.read(ser.in_waiting or 1)):
+            if path == PATH and data and data[0] == payload[0] | REPLY:
+                return data
+    return None
+
+
+def cause_names(bits: int) -> str:
+    return "+".join(name for i, name in enumerate(CAUSES) if bits & (1 << i)) or "-"
+
+
+def when(record: dict, boot: int, now_ms: int) -> str:
+    if record["boot"] != boot:
+        return f"boot {record['boot']} +{record['start_ms'] / 1000:.1f}s"
+    moment = datetime.datetime.now() - datetime.timedelta(milliseconds=now_ms - record["start_ms"])
+    return moment.strftime("%Y-%m-%d %H:%M:%S")
+
+
+def print_record(record: dict, boot: int, now_ms: int, csv: bool):
+    recovery = RECOVERIES[record["recovery"]] if record["recovery"] < len(RECOVERIES) else str(record["recovery"])
+    if csv:
+        values = [record["id"], when(record, boot, now_ms), cause_names(record["causes"]), recovery,
+                  record["duration_ms"], f"{record['peak_ma']:.0f}", f"{record['peak_mv']:.0f}", record["limit_ma"],
+                  record["hard_limit_ma"], record["limit_mv"]]
+        print(",".join(str(value) for value in values))
+        return
+    print(f"#{record['id']:<5} {when(record, boot, now_ms):<22} {cause_names(record['causes']):<22} "
+          f"{record['peak_ma']:>7.0f} mA {record['peak_mv']:>6.0f} mV  {record['duration_ms'] / 1000:>7.1f}s "
+          f"{recovery:<8} limits {record['limit_ma']}/{record['hard_limit_ma']} mA {record['limit_mv']} mV")
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", default="/dev/cu.usbmodem1101", help="Serial device path")
+    parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--timeout", type=float, default=1.0, help="Seconds to wait for each answer")
+    parser.add_argument("--from", dest="first", type=int, default=0, help="First incident id")
+    parser.add_argument("--csv", action="store_true", help="Print CSV")
+    parser.add_argument("--watch", action="store_true", help="Keep printing incidents as they change")
+    parser.add_argument("--stats", action="store_true", help="Print counts per cause and fast-trip timings instead")
+    args = parser.parse_args()
+
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=0.05, write_timeout=2) as ser:
+        reader = FrameReader()
+        if args.stats:
+            data = request(ser, reader, bytes([OP_STATS]), args.timeout)
+            if data is None or len(data) != HEADER.size + STATS.size:
+                print("device did not answer")
+                return 1
+            _, boot, _, next_id = HEADER.unpack_from(data)
+            counts = STATS.unpack_from(data, HEADER.size)
+            print(f"boot {boot}, {next_id - 1} incidents, saved {counts[4]} times ({counts[5]} failed)")
+            for name, count in zip(CAUSES, counts[:4]):
+                print(f"{name:>12} {count}")
+            trips, last_cutoff, max_cutoff, last_poll, max_poll = counts[6:]
+            print(f"fast trips this boot: {trips}, cutoff {last_cutoff} us (max {max_cutoff}), "
+                  f"poll {last_poll} us (max {max_poll})")
+            return 0
+
+        if args.csv:
+            print("id,time,causes,recovery,duration_ms,peak_ma,peak_mv,limit_ma,hard_limit_ma,limit_mv")
+        first = args.first
+        while True:
+            data = request(ser, reader, struct.pack("<BIB", OP_READ, first, MAX_READ), args.timeout)
+            reply = decode_records(data) if data else None
+            if reply is None:
+                print("device did not answer")
+                return 1
+            _, boot, now_ms, _, records = reply
+            for record in records:
+                print_record(record, boot, now_ms, args.csv)
+            if len(records) < MAX_READ:
+                break
+            first = records[-1]["id"] + 1
+
+        while args.watch:
+            for path, data in reader.feed(ser.read(ser.in_waiting or 1)):
+                reply = decode_records(data) if path == PATH else None
+                if reply and reply[0] == OP_EVENT:
+                    for record in reply[4]:
+                        print_record(record, reply[1], reply[2], args.csv)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Fetch the voltage, current and power history of the device over the `hist` pack.
+
+    history.py                          last 60 one-second points
+    history.py --resolution 10min -n 120 --csv > day.csv
+
+Each point has the min, max and average of its bucket; see main/include/power_history.hpp.
+"""
+import argparse
+import struct
+import time
+
+from serial_pack import FrameReader, encode_pack
+
+PATH = "hist"
+RESOLUTIONS = {"raw": 0, "1s": 1, "10s": 2, "1min": 3, "10min": 4}
+CHANNELS = ("mV", "mA", "mW")
+HEADER = struct.Struct("<BHII")
+POINT = struct.Struct("<9hH")
+SPARK = " ▁▂▃▄▅▆▇█"
+
+
+def decode_reply(data: bytes):
+    """Returns (resolution, period_ms, age_ms, [(min, max, avg, count)]) or None; min/max/avg are per channel."""
+    if len(data) < HEADER.size:
+        return None
+    resolution, count, period_ms, age_ms = HEADER.unpack_from(data)
+    if len(data) != HEADER.size + count * POINT.size:
+        return None
+    points = []
+    for i in range(count):
+        values = POINT.unpack_from(data, HEADER.size + i * POINT.size)
+        points.append((values[0:3], values[3:6], values[6:9], values[9]))
+    return resolution, period_ms, age_ms, points
+
+
+def query(ser, reader: FrameReader, resolution: int, count: int, timeout: float):
+    ser.write(encode_pack(PATH, struct.pack("<BH", resolution, count)))
+    ser.flush()
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        for path, data in reader.feed(ser.read(ser.in_waiting or 1)):
+            reply = decode_reply(data) if path == PATH else None
+            if reply and reply[0] == resolution:
+                return reply
+    return None
+
+
+def sparkline(values) -> str:
+    low, high = min(values), max(values)
+    span = (high - low) or 1
+    return "".join(SPARK[round((value - low) / span * (len(SPARK) - 1))] for value in values)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", default="/dev/cu.usbmodem1101", help="Serial device path")
+    parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--timeout", type=float, default=1.0, help="Seconds to wait for the answer")
+    parser.add_argument("--resolution", choices=RESOLUTIONS, default="1s", help="Point width")
+    parser.add_argument("-n", type=int, default=60, help="Number of points, the newest ones")
+    parser.add_argument("--csv", action="store_true", help="Print every point instead of a summary")
+    args = parser.parse_args()
+
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=0.05, write_timeout=2) as ser:
+        reply = query(ser, FrameReader(), RESOLUTIONS[args.resolution], args.n, args.timeout)
+    if reply is None:
+        print("device did not answer")
+        return 1
+    _, period_ms, age_ms, points = reply
+
+    if args.csv:
+        columns = [f"{kind}_{unit}" for unit in CHANNELS for kind in ("min", "avg", "max")]
+        print(",".join(["seconds_ago", "samples"] + columns))
+        for i, (low, high, avg, count) in enumerate(points):
+            ago = (age_ms + (len(points) - i) * period_ms) / 1000
+            values = [value for channel in range(3) for value in (low[channel], avg[channel], high[channel])]
+            print(",".join(str(value) for value in [f"{ago:.3f}", count] + values))
+        return 0
+
+    valid = [point for point in points if point[3] > 0]
+    print(f"{len(points)} points of {period_ms} ms, newest ended {age_ms} ms ago, {len(points) - len(valid)} empty")
+    for channel, unit in enumerate(CHANNELS):
+        if not valid:
+            break
+        averages = [point[2][channel] for point in valid]
+        low = min(point[0][channel] for point in valid)
+        high = max(point[1][channel] for point in valid)
+        print(f"{unit:>3} min {low:>6} max {high:>6}  {sparkline(averages)}")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
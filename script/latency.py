@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Synchronise the device clock with the host and report end-to-end latency of serial packs.
+
+The host sends time probes on `time`, keeps the one with the shortest round trip and tells the device the offset
+between the two clocks. Stamped packs are then traced from the host send to the first frame presented after
+their handler ran, and `latency` returns per-stage percentiles (see main/include/latency_trace.hpp). `link` adds the
+worker pool counters of the serial pack link (see main/include/serial_pack.hpp).
+"""
+import argparse
+import struct
+import time
+
+from serial_pack import FrameReader, MuxScheduler, PRIORITY_CONTROL, encode_pack, host_clock_us
+
+TIME_PATH = "time"
+REPORT_PATH = "latency"
+TIME_PROBE = 0
+TIME_SET = 1
+REPORT_VERSION = 1
+LINK_PATH = "link"
+LINK_VERSION = 1
+LINK_FORMAT = "<B3IQ5I3Q"
+LINK_FIELDS = (
+    "chunks queued", "bytes queued", "pool stalls", "pool stall us", "chunks dropped", "queue high water",
+    "packs failed", "ends deferred", "compressed packs", "compressed bytes", "inflated bytes", "inflate cycles",
+)
+STAGES = ("link", "handle", "present", "end-to-end")
+
+
+def wait_pack(ser, reader: FrameReader, path: str, timeout: float):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        for got, data in reader.feed(ser.read(ser.in_waiting or 1)):
+            if got == path:
+                return data
+    return None
+
+
+def probe(ser, reader: FrameReader, timeout: float):
+    """One NTP style exchange, returns (offset, rtt) in microseconds or None."""
+    sent = host_clock_us()
+    ser.write(encode_pack(TIME_PATH, struct.pack("<BQ", TIME_PROBE, sent)))
+    ser.flush()
+    data = wait_pack(ser, reader, TIME_PATH, timeout)
+    received = host_clock_us()
+    if data is None or len(data) != 25:
+        return None
+    kind, echoed, device_rx, device_tx = struct.unpack("<BQQQ", data)
+    if kind != TIME_PROBE or echoed != sent:
+        return None
+    offset = ((device_rx - sent) + (device_tx - received)) // 2
+    rtt = (received - sent) - (device_tx - device_rx)
+    return offset, rtt
+
+
+def sync_clock(ser, reader: FrameReader, count: int, timeout: float):
+    samples = [s for s in (probe(ser, reader, timeout) for _ in range(count)) if s is not None]
+    if not samples:
+        return None
+    offset, rtt = min(samples, key=lambda s: s[1])
+    ser.write(encode_pack(TIME_PATH, struct.pack("<BqI", TIME_SET, offset, max(rtt, 0))))
+    ser.flush()
+    return offset, rtt, len(samples)
+
+
+def send_stamped(ser, path: str, payload: bytes, count: int, interval: float):
+    for _ in range(count):
+        scheduler = MuxScheduler()
+        scheduler.submit(path, payload, PRIORITY_CONTROL, stamp=True)
+        for frame in scheduler.frames():
+            ser.write(frame)
+        ser.flush()
+        time.sleep(interval)
+
+
+def print_report(data: bytes):
+    if len(data) < 14 or data[0] != REPORT_VERSION:
+        print("unexpected latency report")
+        return
+    synced, offset, rtt = struct.unpack_from("<BqI", data, 1)
+    print(f"clock {'synced' if synced else 'not synced'}, offset {offset} us, rtt {rtt} us")
+    pos = 14
+    for name in STAGES:
+        count, p50, p90, p99, worst = struct.unpack_from("<5I", data, pos)
+        pos += 20
+        print(f"{name:>10}: n={count:<4} p50={p50:>7} p90={p90:>7} p99={p99:>7} max={worst:>7} us")
+    (dropped,) = struct.unpack_from("<I", data, pos)
+    print(f"dropped traces: {dropped}")
+
+
+def print_link_stats(data: bytes):
+    if len(data) != struct.calcsize(LINK_FORMAT) or data[0] != LINK_VERSION:
+        print("unexpected link stats")
+        return
+    for name, value in zip(LINK_FIELDS, struct.unpack(LINK_FORMAT, data)[1:]):
+        print(f"{name:>16}: {value}")
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", default="/dev/cu.usbmodem1101", help="Serial device path")
+    parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--timeout", type=float, default=0.5, help="Seconds to wait for each answer")
+    parser.add_argument("--probes", type=int, default=16, help="Time probes, the shortest round trip wins")
+    parser.add_argument("--send", type=int, default=0, metavar="N", help="Stamped test packs to send")
+    parser.add_argument("--path", default="fx", help="Path of the test packs (an empty `fx` trigger by default)")
+    parser.add_argument("--payload", default="", help="Hex payload of the test packs")
+    parser.add_argument("--interval", type=float, default=0.05, help="Seconds between test packs")
+    args = parser.parse_args()
+
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=0.05, write_timeout=2) as ser:
+        reader = FrameReader()
+        synced = sync_clock(ser, reader, args.probes, args.timeout)
+        if synced is None:
+            print("device did not answer the time probes")
+            return 1
+        offset, rtt, answered = synced
+        print(f"offset {offset} us, rtt {rtt} us ({answered}/{args.probes} probes answered)")
+
+        if args.send:
+            send_stamped(ser, args.path, bytes.fromhex(args.payload), args.send, args.interval)
+            # let the last packs reach a frame
+            time.sleep(0.2)
+
+        ser.write(encode_pack(REPORT_PATH, b""))
+        ser.flush()
+        report = wait_pack(ser, reader, REPORT_PATH, args.timeout)
+        if report is None:
+            print("device did not answer the latency request")
+            return 1
+        print_report(report)
+
+        ser.write(encode_pack(LINK_PATH, b""))
+        ser.flush()
+        link = wait_pack(ser, reader, LINK_PATH, args.timeout)
+        if link is None:
+            print("device did not answer the link request")
+            return 1
+        print_link_stats(link)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
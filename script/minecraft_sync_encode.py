@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""Encode Minecraft sync state for the `sync` pack (see main/include/sync_codec.hpp)."""
+import argparse
+import json
+import struct
+import sys
+import time
+
+from serial_pack import encode_pack
+
+SYNC_BINARY_MAGIC = 0xC5
+SYNC_BINARY_VERSION = 1
+
+FIELD_MODE = 1
+FIELD_NAME = 2
+FIELD_HEALTH = 3
+FIELD_MAX_HEALTH = 4
+
+MODES = {"Creative": 0, "Survival": 1, "Spectator": 2, "Adventure": 3}
+
+
+def _tlv(tag: int, value: bytes) -> bytes:
+    if len(value) > 255:
+        raise ValueError("field too long")
+    return struct.pack("<BB", tag, len(value)) + value
+
+
+def _hp(value: float) -> bytes:
+    return struct.pack("<H", max(0, min(0xFFFF, round(value * 100))))
+
+
+def encode_binary(mode=None, name=None, health=None, max_health=None) -> bytes:
+    """Only the given fields are encoded, the device keeps the others."""
+    out = bytearray([SYNC_BINARY_MAGIC, SYNC_BINARY_VERSION])
+    if mode is not None:
+        out += _tlv(FIELD_MODE, bytes([MODES.get(mode, 4)]))
+    if name is not None:
+        out += _tlv(FIELD_NAME, name.encode("utf-8")[:31])
+    if health is not None:
+        out += _tlv(FIELD_HEALTH, _hp(health))
+    if max_health is not None:
+        out += _tlv(FIELD_MAX_HEALTH, _hp(max_health))
+    return bytes(out)
+
+
+def encode_json(mode=None, name=None, health=None, max_health=None) -> bytes:
+    doc = {}
+    if mode is not None:
+        doc["mode"] = mode
+    if name is not None:
+        doc["name"] = name
+    if health is not None:
+        doc["health"] = health
+    if max_health is not None:
+        doc["max_health"] = max_health
+    return json.dumps(doc, separators=(",", ":")).encode("utf-8")
+
+
+def delta(previous: dict, state: dict) -> dict:
+    """Keep only the fields that differ from what the device was last sent."""
+    return {key: value for key, value in state.items() if value is not None and previous.get(key) != value}
+
+
+def load_state(path: str) -> dict:
+    try:
+        with open(path, "r", encoding="utf-8") as f:
+            return json.load(f)
+    except FileNotFoundError:
+        return {}
+
+
+def save_state(path: str, previous: dict, state: dict) -> None:
+    merged = dict(previous)
+    merged.update({key: value for key, value in state.items() if value is not None})
+    with open(path, "w", encoding="utf-8") as f:
+        json.dump(merged, f)
+
+
+def bench(state: dict, count: int) -> None:
+    for label, encoder in (("json", encode_json), ("binary", encode_binary)):
+        payload = encoder(**state)
+        start = time.perf_counter()
+        for _ in range(count):
+            encoder(**state)
+        elapsed = (time.perf_counter() - start) / count * 1e6
+        wire = len(encode_pack("sync", payload))
+        print(f"{label:>6}: payload {len(payload):4d} B, on wire {wire:4d} B, host encode {elapsed:6.2f} us")
+    print("device decode cost is logged by [lumen:sync_codec] every 64 messages")
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="Encode and optionally send a Minecraft sync state.")
+    parser.add_argument("--mode", choices=sorted(MODES))
+    parser.add_argument("--name")
+    parser.add_argument("--health", type=float)
+    parser.add_argument("--max-health", type=float)
+    parser.add_argument("--format", choices=("binary", "json"), default="binary")
+    parser.add_argument("--out", help="Write the payload to a file")
+    parser.add_argument("--port", help="Send the pack to this serial device")
+    parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--repeat", type=int, default=1, help="Send the pack this many times")
+    parser.add_argument("--bench", type=int, metavar="N", help="Compare encodings over N iterations")
+    parser.add_argument(
+        "--state-file",
+        help="Remember what was sent here and only encode fields that changed since (binary patch)",
+    )
+    args = parser.parse_args()
+
+    state = {"mode": args.mode, "name": args.name, "health": args.health, "max_health": args.max_health}
+    if all(value is None for value in state.values()):
+        print("no fields given", file=sys.stderr)
+        return 2
+
+    if args.bench:
+        bench(state, args.bench)
+        return 0
+
+    previous = {}
+    if args.state_file:
+        previous = load_state(args.state_file)
+        state = delta(previous, state)
+        if not state:
+            print("nothing changed", file=sys.stderr)
+            return 0
+
+    payload = encode_binary(**state) if args.format == "binary" else encode_json(**state)
+    if args.out:
+        with open(args.out, "wb") as f:
+            f.write(payload)
+    if args.port:
+        import serial
+
+        with serial.Serial(args.port, args.baud, timeout=1, write_timeout=2) as ser:
+            for _ in range(args.repeat):
+                ser.write(encode_pack("sync", payload))
+            ser.flush()
+    if not args.out and not args.port:
+        sys.stdout.write(payload.hex() + "\n")
+    if args.state_file:
+        save_state(args.state_file, previous, state)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+"""Send a skin to the Minecraft sync page, skipping the upload when the device has it cached."""
+import argparse
+import struct
+import sys
+import time
+from pathlib import Path
+
+from serial_pack import FrameReader, encode_pack, fnv1a64
+
+HASH_PATH = "sync/skin/hash"
+SKIN_PATH = "sync/skin"
+
+
+def query_cache(ser, digest: int, timeout: float):
+    """Returns True on a hit, False on a miss and None when the device did not answer."""
+    ser.write(encode_pack(HASH_PATH, struct.pack("<Q", digest)))
+    ser.flush()
+    reader = FrameReader()
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        for path, data in reader.feed(ser.read(ser.in_waiting or 1)):
+            if path == HASH_PATH and data:
+                return data[0] == 1
+    return None
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("file", help="Skin payload: width:u16le | height:u16le | RGB565 pixels")
+    parser.add_argument("--port", default="/dev/cu.usbmodem1101", help="Serial device path")
+    parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--timeout", type=float, default=1.0, help="Seconds to wait for the cache answer")
+    parser.add_argument("--force", action="store_true", help="Upload without asking the cache")
+    args = parser.parse_args()
+
+    path = Path(args.file)
+    if not path.exists():
+        print(f"file not found: {path}", file=sys.stderr)
+        return 2
+    payload = path.read_bytes()
+    digest = fnv1a64(payload)
+
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=0.05, write_timeout=2) as ser:
+        if not args.force:
+            hit = query_cache(ser, digest, args.timeout)
+            if hit:
+                print(f"{digest:016x}: cached on device, upload skipped")
+                return 0
+            print(f"{digest:016x}: {'miss' if hit is False else 'no answer'}, uploading {len(payload)} bytes")
+        start = time.monotonic()
+        ser.write(encode_pack(SKIN_PATH, payload))
+        ser.flush()
+        print(f"uploaded in {time.monotonic() - start:.2f} s")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
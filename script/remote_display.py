@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""Drive the panel as a remote framebuffer through the `fb` serial pack, sending only the tiles that changed."""
+import argparse
+import struct
+import sys
+import time
+
+try:
+    from PIL import Image
+except ImportError:  # pragma: no cover
+    raise SystemExit("Pillow is required: pip install pillow")
+
+from serial_pack import encode_pack
+
+FB_PATH = "fb"
+WIDTH = 240
+HEIGHT = 240
+TILE = 16
+TILE_PIXELS = TILE * TILE
+ENC_RAW = 0
+ENC_SOLID = 1
+ENC_RLE = 2
+
+
+def to_rgb565(image: Image.Image) -> list:
+    """Row-major RGB565 colors of a WIDTH x HEIGHT frame."""
+    image = image.convert("RGB")
+    if image.size != (WIDTH, HEIGHT):
+        image = image.resize((WIDTH, HEIGHT), Image.LANCZOS)
+    return [((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3) for r, g, b in image.getdata()]
+
+
+def tile_colors(frame: list, tx: int, ty: int) -> list:
+    colors = []
+    for y in range(ty * TILE, (ty + 1) * TILE):
+        colors.extend(frame[y * WIDTH + tx * TILE : y * WIDTH + (tx + 1) * TILE])
+    return colors
+
+
+def encode_tile(tx: int, ty: int, colors: list) -> bytes:
+    """Smallest of solid, RLE and raw. Colors go out big-endian, the panel byte order."""
+    if all(c == colors[0] for c in colors):
+        return struct.pack(">BBBH", tx, ty, ENC_SOLID, colors[0])
+
+    runs = bytearray()
+    i = 0
+    while i < TILE_PIXELS:
+        j = i + 1
+        while j < TILE_PIXELS and j - i < 256 and colors[j] == colors[i]:
+            j += 1
+        runs += struct.pack(">BH", j - i - 1, colors[i])
+        i = j
+    if len(runs) < TILE_PIXELS * 2:
+        return bytes((tx, ty, ENC_RLE)) + bytes(runs)
+    return bytes((tx, ty, ENC_RAW)) + struct.pack(f">{TILE_PIXELS}H", *colors)
+
+
+def encode_frame(frame: list, previous) -> bytes:
+    out = bytearray()
+    for ty in range(HEIGHT // TILE):
+        for tx in range(WIDTH // TILE):
+            colors = tile_colors(frame, tx, ty)
+            if previous is not None and colors == tile_colors(previous, tx, ty):
+                continue
+            out += encode_tile(tx, ty, colors)
+    return bytes(out)
+
+
+def demo_frames():
+    background = Image.new("RGB", (WIDTH, HEIGHT), (16, 16, 32))
+    t = 0
+    while True:
+        image = background.copy()
+        phase = t % 120
+        x = (WIDTH - 48) * min(phase, 120 - phase) // 60
+        y = (t * 3) % (HEIGHT - 48)
+        image.paste((240, 160, 32), (x, y, x + 48, y + 48))
+        yield image
+        t += 1
+
+
+def screen_frames():
+    from PIL import ImageGrab
+
+    while True:
+        yield ImageGrab.grab()
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--image", help="Show a single image")
+    source.add_argument("--screen", action="store_true", help="Mirror the host screen")
+    source.add_argument("--demo", action="store_true", help="Animated test pattern")
+    parser.add_argument("--port", default="/dev/cu.usbmodem1101", help="Serial device path")
+    parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--fps", type=float, default=30.0, help="Frame rate cap")
+    args = parser.parse_args()
+
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=0.05, write_timeout=2) as ser:
+        if args.image:
+            payload = encode_frame(to_rgb565(Image.open(args.image)), None)
+            ser.write(encode_pack(FB_PATH, payload))
+            ser.flush()
+            print(f"sent {len(payload)} bytes")
+            return 0
+
+        frames = screen_frames() if args.screen else demo_frames()
+        previous = None
+        sent = 0
+        count = 0
+        window = time.monotonic()
+        for image in frames:
+            start = time.monotonic()
+            frame = to_rgb565(image)
+            payload = encode_frame(frame, previous)
+            previous = frame
+            if payload:
+                ser.write(encode_pack(FB_PATH, payload))
+                sent += len(payload)
+                count += 1
+            if (now := time.monotonic()) - window >= 1.0:
+                print(f"{count / (now - window):5.1f} fps, {sent / (now - window) / 1024:6.1f} kB/s", file=sys.stderr)
+                window, sent, count = now, 0, 0
+            time.sleep(max(0.0, 1.0 / args.fps - (time.monotonic() - start)))
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
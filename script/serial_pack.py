@@ -0,0 +1,245 @@
+#!/usr/bin/env python3
+"""Host-side encoding of Lumen serial packs (see main/include/serial_pack.hpp)."""
+import heapq
+import struct
+import time
+from dataclasses import dataclass, field
+
+FRAME_MAGIC = 0xA5
+FRAME_OPEN = 1
+FRAME_DATA = 2
+FRAME_ABORT = 3
+FRAME_OPEN_LZ4 = 4
+FRAME_STAMP = 5
+LZ4_WINDOW = 1024
+MAX_CHANNELS = 4
+MAX_FRAME_LEN = 1024
+
+# Higher value is scheduled first.
+PRIORITY_BULK = 0
+PRIORITY_STATE = 8
+PRIORITY_CONTROL = 16
+
+
+def check_path(path: str) -> bytes:
+    path_bytes = path.encode("ascii")
+    if b" " in path_bytes or b"\n" in path_bytes or b"\0" in path_bytes:
+        raise ValueError("path must not contain spaces, newlines or NUL")
+    if not path_bytes or len(path_bytes) >= 16:
+        raise ValueError("path must be 1..15 bytes")
+    return path_bytes
+
+
+def encode_pack(path: str, data: bytes) -> bytes:
+    """Legacy framing: the pack occupies the link until it is complete."""
+    return check_path(path) + b"\n" + struct.pack("<I", len(data)) + data
+
+
+def lz4_compress(data: bytes, window: int = LZ4_WINDOW) -> bytes:
+    """Greedy LZ4 block compressor whose matches stay inside the device's decode window."""
+    out = bytearray()
+    n = len(data)
+    table = {}
+    anchor = 0
+    i = 0
+
+    def length_bytes(value: int):
+        while value >= 255:
+            out.append(255)
+            value -= 255
+        out.append(value)
+
+    # LZ4 block rules: the last 5 bytes are literals and no match starts in the last 12 bytes
+    while i + 12 <= n:
+        key = data[i:i + 4]
+        candidate = table.get(key)
+        table[key] = i
+        if candidate is None or i - candidate > window - 1:
+            i += 1
+            continue
+        match_len = 4
+        limit = n - 5
+        while i + match_len < limit and data[candidate + match_len] == data[i + match_len]:
+            match_len += 1
+
+        literals = data[anchor:i]
+        lit_token = min(len(literals), 15)
+        match_token = min(match_len - 4, 15)
+        out.append((lit_token << 4) | match_token)
+        if lit_token == 15:
+            length_bytes(len(literals) - 15)
+        out += literals
+        out += struct.pack("<H", i - candidate)
+        if match_token == 15:
+            length_bytes(match_len - 4 - 15)
+
+        for k in range(i + 1, min(i + match_len, n - 4)):
+            table[data[k:k + 4]] = k
+        i += match_len
+        anchor = i
+
+    literals = data[anchor:]
+    lit_token = min(len(literals), 15)
+    out.append(lit_token << 4)
+    if lit_token == 15:
+        length_bytes(len(literals) - 15)
+    out += literals
+    return bytes(out)
+
+
+def host_clock_us() -> int:
+    """Host clock of Stamp frames and time probes (see main/include/latency_trace.hpp)."""
+    return time.monotonic_ns() // 1000
+
+
+def encode_frame(channel: int, frame_type: int, payload: bytes) -> bytes:
+    if len(payload) > MAX_FRAME_LEN:
+        raise ValueError(f"frame payload too long: {len(payload)}")
+    return struct.pack("<BBBH", FRAME_MAGIC, channel, frame_type, len(payload)) + payload
+
+
+@dataclass(order=True)
+class _Stream:
+    sort_key: tuple
+    channel: int = field(compare=False)
+    path: str = field(compare=False)
+    data: bytes = field(compare=False)
+    priority: int = field(compare=False)
+    compressed: bool = field(default=False, compare=False)
+    stamp: bool = field(default=False, compare=False)
+    offset: int = field(default=-1, compare=False)
+
+
+class MuxScheduler:
+    """Splits packs into frames and interleaves them by priority.
+
+    Each call to next_frame() picks the highest-priority stream with pending data (round-robin between equal
+    priorities), so a pack submitted while a bulk transfer is in flight goes out after at most one frame.
+    """
+
+    def __init__(self, frame_len: int = 512):
+        if not 0 < frame_len <= MAX_FRAME_LEN:
+            raise ValueError("frame_len out of range")
+        self.frame_len = frame_len
+        self._ready = []
+        self._free = list(range(MAX_CHANNELS))
+        self._waiting = []
+        self._turn = 0
+
+    def submit(self, path: str, data: bytes, priority: int = PRIORITY_BULK, compress: bool = False,
+               stamp: bool = False):
+        """With `compress` the pack travels LZ4 compressed and is inflated by the device before its handler.
+
+        With `stamp` the Open frame is preceded by a Stamp frame carrying the host clock when it is sent, so the
+        device can trace the pack end to end.
+        """
+        check_path(path)
+        data = bytes(data)
+        if compress:
+            data = lz4_compress(data)
+        self._waiting.append((path, data, priority, compress, stamp))
+        self._admit()
+
+    def pending(self) -> bool:
+        return bool(self._ready or self._waiting)
+
+    def _admit(self):
+        self._waiting.sort(key=lambda item: -item[2])
+        while self._waiting and self._free:
+            path, data, priority, compressed, stamp = self._waiting.pop(0)
+            self._push(_Stream((0, 0), self._free.pop(0), path, data, priority, compressed, stamp))
+
+    def _push(self, stream: _Stream):
+        self._turn += 1
+        stream.sort_key = (-stream.priority, self._turn)
+        heapq.heappush(self._ready, stream)
+
+    def next_frame(self) -> bytes:
+        stream = heapq.heappop(self._ready)
+        if stream.offset < 0:
+            stream.offset = 0
+            payload = struct.pack("<BI", stream.priority & 0xFF, len(stream.data)) + check_path(stream.path)
+            frame = encode_frame(stream.channel, FRAME_OPEN_LZ4 if stream.compressed else FRAME_OPEN, payload)
+            if stream.stamp:
+                frame = encode_frame(stream.channel, FRAME_STAMP, struct.pack("<Q", host_clock_us())) + frame
+        else:
+            chunk = stream.data[stream.offset:stream.offset + self.frame_len]
+            stream.offset += len(chunk)
+            frame = encode_frame(stream.channel, FRAME_DATA, chunk)
+
+        if stream.offset >= len(stream.data):
+            # The device closes a channel once `size` bytes arrived; an empty pack completes with its Open frame.
+            self._free.append(stream.channel)
+            self._admit()
+        else:
+            self._push(stream)
+        return frame
+
+    def frames(self):
+        while self._ready:
+            yield self.next_frame()
+
+
+def fnv1a64(data: bytes, value: int = 0xCBF29CE484222325) -> int:
+    """Content hash used for cache lookups (see main/include/image_cache.hpp)."""
+    for byte in data:
+        value ^= byte
+        value = (value * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+    return value
+
+
+class FrameReader:
+    """Reassembles packs the device sends as multiplexed frames.
+
+    The device shares the link with its console log, so bytes outside a frame are skipped. feed() returns the
+    (path, data) of every pack completed by the new bytes.
+    """
+
+    def __init__(self):
+        self._buffer = bytearray()
+        self._channels = {}
+
+    def feed(self, data: bytes):
+        self._buffer += data
+        done = []
+        while True:
+            start = self._buffer.find(bytes([FRAME_MAGIC]))
+            if start < 0:
+                self._buffer.clear()
+                return done
+            del self._buffer[:start]
+            if len(self._buffer) < 5:
+                return done
+            channel, frame_type, length = struct.unpack_from("<BBH", self._buffer, 1)
+            if channel >= MAX_CHANNELS or frame_type not in (FRAME_OPEN, FRAME_DATA, FRAME_ABORT) or \
+                    length > MAX_FRAME_LEN:
+                del self._buffer[:1]
+                continue
+            if len(self._buffer) < 5 + length:
+                return done
+            payload = bytes(self._buffer[5:5 + length])
+            del self._buffer[:5 + length]
+            pack = self._frame(channel, frame_type, payload)
+            if pack is not None:
+                done.append(pack)
+
+    def _frame(self, channel: int, frame_type: int, payload: bytes):
+        if frame_type == FRAME_OPEN:
+            if len(payload) < 6:
+                return None
+            size = struct.unpack_from("<I", payload, 1)[0]
+            path = payload[5:].decode("ascii", errors="replace")
+            self._channels[channel] = (path, size, bytearray())
+        elif frame_type == FRAME_DATA and channel in self._channels:
+            self._channels[channel][2].extend(payload)
+        elif frame_type == FRAME_ABORT:
+            self._channels.pop(channel, None)
+            return None
+        else:
+            return None
+
+        path, size, data = self._channels[channel]
+        if len(data) < size:
+            return None
+        del self._channels[channel]
+        return path, bytes(data[:size])
@@ -1,11 +1,31 @@
 #!/usr/bin/env python3
 import argparse
-import struct
 import sys
 from pathlib import Path
 
 import serial
 
+from serial_pack import MuxScheduler, encode_pack, lz4_compress
+
+
+def load_payload(source: str) -> bytes:
+    if source.startswith("@"):
+        file_path = Path(source[1:])
+        if not file_path.exists():
+            raise FileNotFoundError(f"file not found: {file_path}")
+        return file_path.read_bytes()
+    return source.encode("utf-8")
+
+
+def write_all(ser: serial.Serial, pkt: bytes) -> bool:
+    offset = 0
+    while offset < len(pkt):
+        written = ser.write(pkt[offset:])
+        if written is None or written <= 0:
+            return False
+        offset += written
+    return True
+
 
 def main() -> int:
     parser = argparse.ArgumentParser(description="Send a serial pack over USB Serial/JTAG.")
@@ -14,38 +34,55 @@ def main() -> int:
     parser.add_argument("--data", help="Payload string")
     parser.add_argument("--file", help="Binary payload file")
     parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--mux", action="store_true", help="Send as multiplexed frames")
+    parser.add_argument("--priority", type=int, default=0, help="Lane priority of the pack in --mux mode")
+    parser.add_argument("--frame-len", type=int, default=512, help="Frame payload size in --mux mode")
+    parser.add_argument("--compress", action="store_true", help="LZ4 compress every pack (requires --mux)")
+    parser.add_argument(
+        "--pack",
+        nargs=3,
+        action="append",
+        default=[],
+        metavar=("PATH", "PRIORITY", "DATA"),
+        help="Additional pack to interleave in --mux mode, DATA is a string or @file",
+    )
     args = parser.parse_args()
 
-    path_bytes = args.path.encode("ascii")
-    if b" " in path_bytes or b"\n" in path_bytes:
-        print("path must not contain spaces or newlines", file=sys.stderr)
-        return 2
-
     if args.data is None and args.file is None:
         print("must provide --data or --file", file=sys.stderr)
         return 2
     if args.data is not None and args.file is not None:
         print("use only one of --data or --file", file=sys.stderr)
         return 2
+    if (args.pack or args.compress) and not args.mux:
+        print("--pack and --compress require --mux", file=sys.stderr)
+        return 2
 
-    if args.file is not None:
-        file_path = Path(args.file)
-        if not file_path.exists():
-            print(f"file not found: {file_path}", file=sys.stderr)
-            return 2
-        data_bytes = file_path.read_bytes()
-    else:
-        data_bytes = args.data.encode("utf-8")
-    pkt = path_bytes + b"\n" + struct.pack("<I", len(data_bytes)) + data_bytes
+    try:
+        data_bytes = load_payload("@" + args.file if args.file is not None else args.data)
+        extra = [(path, int(priority), load_payload(source)) for path, priority, source in args.pack]
+        if args.mux:
+            scheduler = MuxScheduler(args.frame_len)
+            scheduler.submit(args.path, data_bytes, args.priority, args.compress)
+            for path, priority, payload in extra:
+                scheduler.submit(path, payload, priority, args.compress)
+            if args.compress:
+                for path, payload in [(args.path, data_bytes)] + [(p, d) for p, _, d in extra]:
+                    wire = len(lz4_compress(payload))
+                    ratio = len(payload) / wire if wire else 0.0
+                    print(f"{path}: {len(payload)} -> {wire} bytes (x{ratio:.2f})")
+            packets = list(scheduler.frames())
+        else:
+            packets = [encode_pack(args.path, data_bytes)]
+    except (FileNotFoundError, ValueError) as exc:
+        print(exc, file=sys.stderr)
+        return 2
 
     with serial.Serial(args.port, args.baud, timeout=1, write_timeout=2) as ser:
-        offset = 0
-        while offset < len(pkt):
-            written = ser.write(pkt[offset:])
-            if written is None or written <= 0:
+        for pkt in packets:
+            if not write_all(ser, pkt):
                 print("serial write failed", file=sys.stderr)
                 return 1
-            offset += written
         ser.flush()
     return 0
 
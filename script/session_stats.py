@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Print the current and power distribution of the device's plug-in session over the `stats` pack.
+
+    session_stats.py            the running session
+    session_stats.py --reset    start a new session and print its (empty) stats
+    session_stats.py --watch 5  print every 5 seconds
+    session_stats.py --show on  also switch the session view on the sync page on (or off)
+
+Percentiles are P-square estimates; see main/include/session_stats.hpp.
+"""
+import argparse
+import struct
+import time
+
+from serial_pack import FrameReader, encode_pack
+
+PATH = "stats"
+VERSION = 2
+OP_READ = 0
+OP_RESET = 1
+OP_SHOW = 2
+HEADER = struct.Struct("<BII")
+CHANNEL = struct.Struct("<6fI")
+ENERGY = struct.Struct("<2f")
+NAMES = ("mean", "stddev", "p50", "p95", "p99", "peak")
+
+
+def decode_reply(data: bytes):
+    """Returns (samples, age_ms, [current, power], (wh, mah)) with each channel a dict, or None."""
+    if len(data) != HEADER.size + 2 * CHANNEL.size + ENERGY.size or data[0] != VERSION:
+        return None
+    _, samples, age_ms = HEADER.unpack_from(data)
+    channels = []
+    for i in range(2):
+        values = CHANNEL.unpack_from(data, HEADER.size + i * CHANNEL.size)
+        channel = dict(zip(NAMES, values[:6]))
+        channel["peak_age_ms"] = values[6]
+        channels.append(channel)
+    energy = ENERGY.unpack_from(data, HEADER.size + 2 * CHANNEL.size)
+    return samples, age_ms, channels, energy
+
+
+def request(ser, reader: FrameReader, payload: bytes, timeout: float):
+    ser.write(encode_pack(PATH, payload))
+    ser.flush()
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        for path, data in reader.feed(ser.read(ser.in_waiting or 1)):
+            reply = decode_reply(data) if path == PATH else None
+            if reply:
+                return reply
+    return None
+
+
+def print_stats(reply):
+    samples, age_ms, channels, (wh, mah) = reply
+    print(f"session: {samples} samples over {age_ms / 1000:.1f} s")
+    print(f"{'':>8} " + " ".join(f"{name:>9}" for name in NAMES) + f" {'peak ago':>9}")
+    for unit, channel in zip(("mA", "mW"), channels):
+        values = " ".join(f"{channel[name]:>9.1f}" for name in NAMES)
+        print(f"{unit:>8} {values} {channel['peak_age_ms'] / 1000:>8.1f}s")
+    print(f"energy: {wh:.4f} Wh, {mah:.2f} mAh")
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", default="/dev/cu.usbmodem1101", help="Serial device path")
+    parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--timeout", type=float, default=1.0, help="Seconds to wait for the answer")
+    parser.add_argument("--reset", action="store_true", help="Start a new session first")
+    parser.add_argument("--watch", type=float, metavar="SECONDS", help="Keep printing at this interval")
+    parser.add_argument("--show", choices=("on", "off"), help="Switch the session view on the sync page")
+    args = parser.parse_args()
+
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=0.05, write_timeout=2) as ser:
+        reader = FrameReader()
+        if args.show and request(ser, reader, bytes([OP_SHOW, args.show == "on"]), args.timeout) is None:
+            print("device did not answer")
+            return 1
+        op = OP_RESET if args.reset else OP_READ
+        while True:
+            reply = request(ser, reader, bytes([op]), args.timeout)
+            if reply is None:
+                print("device did not answer")
+                return 1
+            print_stats(reply)
+            if not args.watch:
+                return 0
+            op = OP_READ
+            time.sleep(args.watch)
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Replay current traces through the e-fuse trip engine on the device and report when they trip.
+
+    trip_replay.py trace.csv --rated 1000 --tau 100 200 400     one row per time constant
+    trip_replay.py --step 1200 1500 2000 --tau 200              constant currents, the trip curve itself
+
+A trace is CSV with a time in milliseconds and a current in milliamps per row; a header row is skipped. The replay
+runs the firmware's own TripEngine (see main/include/trip_engine.hpp) on a separate instance, the output is not
+affected.
+"""
+import argparse
+import csv
+import struct
+import time
+
+from serial_pack import FrameReader, encode_pack
+
+PATH = "trip"
+MAGIC = 0xC9
+VERSION = 1
+REASONS = ("none", "hard limit", "thermal")
+
+
+def load_trace(path: str):
+    """Returns [(time_us, current_ma)]."""
+    samples = []
+    with open(path, newline="") as file:
+        for row in csv.reader(file):
+            try:
+                samples.append((round(float(row[0]) * 1000), round(float(row[1]))))
+            except (ValueError, IndexError):
+                continue
+    return samples
+
+
+def step_trace(current_ma: int, duration_ms: int, period_ms: float):
+    count = int(duration_ms / period_ms) + 1
+    return [(round(i * period_ms * 1000), current_ma) for i in range(count)]
+
+
+def encode_request(rated: int, hard: int, tau: int, samples) -> bytes:
+    out = bytearray(struct.pack("<BBhhH", MAGIC, VERSION, rated, hard, tau))
+    previous = samples[0][0] if samples else 0
+    for time_us, current_ma in samples:
+        out += struct.pack("<Ih", max(0, time_us - previous), max(-32768, min(32767, current_ma)))
+        previous = time_us
+    return bytes(out)
+
+
+def decode_reply(data: bytes):
+    """Returns (status, reason, trip_sample, trip_us, peak_heat, samples) or None."""
+    if len(data) != 18 or data[0] != MAGIC or data[1] != VERSION:
+        return None
+    status, reason, trip_sample, trip_us, peak, samples = struct.unpack_from("<BBIIHI", data, 2)
+    return status, reason, trip_sample, trip_us, peak / 1000, samples
+
+
+def replay(ser, reader: FrameReader, request: bytes, timeout: float):
+    ser.write(encode_pack(PATH, request))
+    ser.flush()
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        for path, data in reader.feed(ser.read(ser.in_waiting or 1)):
+            reply = decode_reply(data) if path == PATH else None
+            if reply:
+                return reply
+    return None
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("trace", nargs="*", help="CSV traces (time ms, current mA)")
+    parser.add_argument("--port", default="/dev/cu.usbmodem1101", help="Serial device path")
+    parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--timeout", type=float, default=5.0, help="Seconds to wait for each result")
+    parser.add_argument("--rated", type=int, default=1000, help="Sustained limit in mA")
+    parser.add_argument("--hard", type=int, default=2000, help="Instantaneous limit in mA, 0 for none")
+    parser.add_argument("--tau", type=int, nargs="+", default=[200], help="Time constants in ms to compare")
+    parser.add_argument("--step", type=int, nargs="*", default=[], metavar="MA", help="Constant current traces")
+    parser.add_argument("--duration", type=int, default=5000, help="Length of --step traces in ms")
+    parser.add_argument("--period", type=float, default=16, help="Sample period of --step traces in ms")
+    args = parser.parse_args()
+
+    traces = [(path, load_trace(path)) for path in args.trace]
+    traces += [(f"{ma} mA", step_trace(ma, args.duration, args.period)) for ma in args.step]
+    if not traces:
+        parser.error("give a trace or --step")
+
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=0.05, write_timeout=2) as ser:
+        reader = FrameReader()
+        print(f"{'trace':<24} {'tau ms':>7} {'result':<12} {'trip ms':>9} {'sample':>7} {'peak heat':>9}")
+        for name, samples in traces:
+            for tau in args.tau:
+                reply = replay(ser, reader, encode_request(args.rated, args.hard, tau, samples), args.timeout)
+                if reply is None:
+                    print(f"{name:<24} {tau:>7} device did not answer")
+                    return 1
+                status, reason, trip_sample, trip_us, peak, _ = reply
+                if status != 0:
+                    print(f"{name:<24} {tau:>7} rejected")
+                    return 1
+                result = REASONS[reason] if reason < len(REASONS) else f"reason {reason}"
+                if reason == 0:
+                    print(f"{name:<24} {tau:>7} {'no trip':<12} {'':>9} {'':>7} {peak:>9.3f}")
+                else:
+                    print(f"{name:<24} {tau:>7} {result:<12} {trip_us / 1000:>9.1f} {trip_sample:>7} {peak:>9.3f}")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""Upload a widget page layout to the device and stream values to it.
+
+The layout is a JSON list of widgets, for example
+    [{"type": "label", "x": 20, "y": 30, "text": "CPU"},
+     {"type": "bar", "field": 0, "x": 20, "y": 40, "w": 200, "h": 12, "min": 0, "max": 100},
+     {"type": "number", "field": 0, "x": 20, "y": 70, "decimals": 1, "text": " %"}]
+Values are sent as field=value pairs; numbers are sent as numbers, anything else as text.
+"""
+import argparse
+import json
+import struct
+import sys
+import time
+
+from serial_pack import encode_pack
+
+LAYOUT_PATH = "page/layout"
+VALUE_PATH = "page"
+MAGIC = 0xC6
+VERSION = 1
+TYPES = {"label": 0, "number": 1, "text": 2, "bar": 3, "gauge": 4, "sprite": 5}
+KIND_NUMBER = 0
+KIND_TEXT = 1
+MAX_WIDGETS = 16
+
+SYSTEM_MONITOR = [
+    {"type": "label", "x": 20, "y": 40, "text": "CPU"},
+    {"type": "number", "field": 0, "x": 160, "y": 40, "decimals": 0, "text": " %"},
+    {"type": "bar", "field": 0, "x": 20, "y": 48, "w": 200, "h": 12, "min": 0, "max": 100},
+    {"type": "label", "x": 20, "y": 90, "text": "MEM"},
+    {"type": "number", "field": 1, "x": 160, "y": 90, "decimals": 0, "text": " %"},
+    {"type": "bar", "field": 1, "x": 20, "y": 98, "w": 200, "h": 12, "min": 0, "max": 100},
+    {"type": "gauge", "field": 2, "x": 80, "y": 130, "w": 80, "h": 80, "min": 0, "max": 100, "text": "load"},
+    {"type": "text", "field": 3, "x": 20, "y": 230, "text": "up "},
+]
+
+
+def encode_layout(widgets: list) -> bytes:
+    if len(widgets) > MAX_WIDGETS:
+        raise ValueError(f"at most {MAX_WIDGETS} widgets")
+    out = bytearray((MAGIC, VERSION, len(widgets)))
+    for widget in widgets:
+        kind = widget["type"]
+        if kind == "sprite":
+            text = struct.pack("<Q", int(str(widget["hash"]), 16))
+        else:
+            text = str(widget.get("text", "")).encode("utf-8")[:23]
+        out += struct.pack(
+            "<BBhhHHffBB",
+            TYPES[kind],
+            widget.get("field", 0),
+            widget.get("x", 0),
+            widget.get("y", 0),
+            widget.get("w", 0),
+            widget.get("h", 0),
+            float(widget.get("min", 0)),
+            float(widget.get("max", 0)),
+            widget.get("decimals", 0),
+            len(text),
+        )
+        out += text
+    return bytes(out)
+
+
+def encode_values(values: dict) -> bytes:
+    out = bytearray((MAGIC, VERSION))
+    for field, value in values.items():
+        if isinstance(value, (int, float)):
+            out += struct.pack("<BBBf", field, KIND_NUMBER, 4, float(value))
+        else:
+            text = str(value).encode("utf-8")[:31]
+            out += struct.pack("<BBB", field, KIND_TEXT, len(text)) + text
+    return bytes(out)
+
+
+def parse_value(text: str):
+    try:
+        return float(text)
+    except ValueError:
+        return text
+
+
+def system_values() -> dict:
+    import psutil
+
+    uptime = int(time.time() - psutil.boot_time())
+    return {
+        0: psutil.cpu_percent(),
+        1: psutil.virtual_memory().percent,
+        2: min(100.0, psutil.getloadavg()[0] * 100 / psutil.cpu_count()),
+        3: f"{uptime // 3600}h{uptime // 60 % 60:02d}m",
+    }
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", default="/dev/cu.usbmodem1101", help="Serial device path")
+    parser.add_argument("--baud", type=int, default=460800, help="Baud rate")
+    parser.add_argument("--layout", help="Layout JSON file to upload")
+    parser.add_argument("--clear", action="store_true", help="Remove the page, the device shows its own again")
+    parser.add_argument("--set", nargs="*", default=[], metavar="FIELD=VALUE", help="Values to send once")
+    parser.add_argument("--monitor", action="store_true", help="Built-in system monitor page (needs psutil)")
+    parser.add_argument("--interval", type=float, default=1.0, help="Seconds between --monitor updates")
+    args = parser.parse_args()
+
+    import serial
+
+    with serial.Serial(args.port, args.baud, timeout=0.05, write_timeout=2) as ser:
+        if args.clear:
+            ser.write(encode_pack(LAYOUT_PATH, encode_layout([])))
+        if args.layout:
+            with open(args.layout, "r", encoding="utf-8") as f:
+                layout = encode_layout(json.load(f))
+            ser.write(encode_pack(LAYOUT_PATH, layout))
+            print(f"layout: {len(layout)} bytes")
+        if args.set:
+            values = {}
+            for item in args.set:
+                field, _, value = item.partition("=")
+                values[int(field)] = parse_value(value)
+            ser.write(encode_pack(VALUE_PATH, encode_values(values)))
+        if args.monitor:
+            layout = encode_layout(SYSTEM_MONITOR)
+            ser.write(encode_pack(LAYOUT_PATH, layout))
+            print(f"layout: {len(layout)} bytes", file=sys.stderr)
+            while True:
+                payload = encode_values(system_values())
+                ser.write(encode_pack(VALUE_PATH, payload))
+                print(f"update: {len(payload)} bytes", file=sys.stderr)
+                time.sleep(args.interval)
+        ser.flush()
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())